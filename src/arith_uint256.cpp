@@ -101,6 +101,18 @@ base_uint<BITS> &base_uint<BITS>::operator/=(const base_uint &b) {
     if (div_bits > num_bits) {
         return *this;
     }
+    // a divisor that fits in a single limb, as most constants do, only needs
+    // one pass of long division over the limbs.
+    if (div_bits <= 32) {
+        const uint64_t d = div.pn[0];
+        uint64_t rem = 0;
+        for (int i = WIDTH - 1; i >= 0; i--) {
+            const uint64_t cur = (rem << 32) | num.pn[i];
+            pn[i] = uint32_t(cur / d);
+            rem = cur % d;
+        }
+        return *this;
+    }
     int shift = num_bits - div_bits;
     // shift so that div and num align.
     div <<= shift;
@@ -3,9 +3,14 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include <bench/bench.h>
+#include <chainparams.h>
 #include <config.h>
+#include <consensus/consensus.h>
 #include <consensus/validation.h>
+#include <miner.h>
+#include <random.h>
 #include <script/standard.h>
+#include <test/setup_common.h>
 #include <test/util.h>
 #include <txmempool.h>
 #include <validation.h>
@@ -57,3 +62,75 @@ static void AssembleBlock(benchmark::State &state) {
 }
 
 BENCHMARK(AssembleBlock, 700);
+
+// The benchmarks below select the transactions of a block from a large
+// synthetic mempool: chains of up to 5 transactions spending each other, with
+// random fees. The transactions don't spend real coins, so the template is not
+// checked for validity, and the block is large enough to hold all of them.
+
+static constexpr size_t LARGE_MEMPOOL_TXS = 50000;
+
+static BlockAssembler LargeMempoolAssembler(const CTxMemPool &pool) {
+    BlockAssembler::Options options;
+    options.nExcessiveBlockSize = DEFAULT_EXCESSIVE_BLOCK_SIZE;
+    options.nMaxGeneratedBlockSize = DEFAULT_EXCESSIVE_BLOCK_SIZE;
+    options.fTestBlockValidity = false;
+    return BlockAssembler(GetConfig().GetChainParams(), pool, options);
+}
+
+static void AddSyntheticTxs(FastRandomContext &rng, size_t nTx,
+                            CTxMemPool &pool)
+    EXCLUSIVE_LOCKS_REQUIRED(pool.cs) {
+    TestMemPoolEntryHelper entry;
+    CTransactionRef parent;
+    for (size_t i = 0; i < nTx; i++) {
+        CMutableTransaction tx;
+        tx.vin.resize(1);
+        tx.vin[0].scriptSig = CScript() << OP_1;
+        if (parent && rng.randrange(5) != 0) {
+            // Extend the current chain.
+            tx.vin[0].prevout = COutPoint(parent->GetId(), 0);
+        } else {
+            tx.vin[0].prevout = COutPoint(TxId(rng.rand256()), 0);
+        }
+        tx.vout.resize(1);
+        tx.vout[0].scriptPubKey = CScript() << OP_TRUE;
+        tx.vout[0].nValue = COIN;
+        parent = MakeTransactionRef(tx);
+        pool.addUnchecked(
+            entry.Fee(int64_t(1000 + rng.randrange(10000)) * FIXOSHI)
+                .FromTx(parent));
+    }
+}
+
+static void AssembleBlockLargeMempool(benchmark::State &state) {
+    const CScript scriptPubKey = CScript() << OP_TRUE;
+    FastRandomContext rng(true);
+    CTxMemPool pool;
+    LOCK2(cs_main, pool.cs);
+    AddSyntheticTxs(rng, LARGE_MEMPOOL_TXS, pool);
+
+    while (state.KeepRunning()) {
+        LargeMempoolAssembler(pool).CreateNewBlock(scriptPubKey);
+    }
+}
+
+static void AssembleBlockLargeMempoolIncremental(benchmark::State &state) {
+    const CScript scriptPubKey = CScript() << OP_TRUE;
+    FastRandomContext rng(true);
+    CTxMemPool pool;
+    LOCK2(cs_main, pool.cs);
+    AddSyntheticTxs(rng, LARGE_MEMPOOL_TXS, pool);
+
+    // Each template resumes from the previous one, after 100 transactions
+    // entered the mempool.
+    BlockTemplateCandidate candidate(pool);
+    LargeMempoolAssembler(pool).CreateNewBlock(scriptPubKey, &candidate);
+    while (state.KeepRunning()) {
+        AddSyntheticTxs(rng, 100, pool);
+        LargeMempoolAssembler(pool).CreateNewBlock(scriptPubKey, &candidate);
+    }
+}
+
+BENCHMARK(AssembleBlockLargeMempool, 2);
+BENCHMARK(AssembleBlockLargeMempoolIncremental, 50);
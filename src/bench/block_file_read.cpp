@@ -0,0 +1,97 @@
+// Copyright (c) 2020 The Bitcoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/bench.h>
+
+#include <amount.h>
+#include <clientversion.h>
+#include <flatfile.h>
+#include <fs.h>
+#include <primitives/block.h>
+#include <random.h>
+#include <streams.h>
+
+#include <vector>
+
+// These benchmarks read blocks at random positions of a few block files, as
+// done by rescans, getblock, REST and txindex lookups, opening the file for
+// every block or deserializing from a cached mapping of the file. The files
+// were just written, so both read them from the page cache.
+
+static constexpr int NUM_FILES = 4;
+static constexpr int BLOCKS_PER_FILE = 64;
+static constexpr int TXS_PER_BLOCK = 250;
+static constexpr size_t FILE_CHUNK_SIZE = 0x1000000;
+
+static CBlock MakeBlock(FastRandomContext &rng) {
+    CBlock block;
+    block.nTime = rng.rand32();
+    for (int i = 0; i < TXS_PER_BLOCK; i++) {
+        CMutableTransaction tx;
+        tx.vin.emplace_back(TxId(rng.rand256()), rng.randrange(4));
+        tx.vin[0].scriptSig = CScript() << rng.randbytes(72)
+                                        << rng.randbytes(33);
+        for (int j = 0; j < 2; j++) {
+            tx.vout.emplace_back(int64_t(rng.randrange(1000000)) * FIXOSHI,
+                                 CScript() << rng.randbytes(20));
+        }
+        block.vtx.push_back(MakeTransactionRef(std::move(tx)));
+    }
+    return block;
+}
+
+struct BlockFiles {
+    const fs::path dir;
+    FlatFileSeq seq;
+    std::vector<FlatFilePos> positions;
+
+    BlockFiles()
+        : dir(fs::temp_directory_path() / fs::unique_path()),
+          seq(dir, "blk", FILE_CHUNK_SIZE) {
+        FastRandomContext rng(true);
+        for (int file = 0; file < NUM_FILES; file++) {
+            CAutoFile fileout(seq.Open(FlatFilePos(file, 0)), SER_DISK,
+                              CLIENT_VERSION);
+            for (int i = 0; i < BLOCKS_PER_FILE; i++) {
+                const CBlock block = MakeBlock(rng);
+                const uint32_t size = GetSerializeSize(block, CLIENT_VERSION);
+                fileout << size;
+                positions.emplace_back(file, ftell(fileout.Get()));
+                fileout << block;
+            }
+        }
+    }
+
+    ~BlockFiles() { fs::remove_all(dir); }
+};
+
+static void BlockFileRead(benchmark::State &state, bool mapped) {
+    BlockFiles files;
+    FastRandomContext rng(true);
+    CBlock block;
+    while (state.KeepRunning()) {
+        const FlatFilePos &pos =
+            files.positions[rng.randrange(files.positions.size())];
+        if (mapped) {
+            const auto mapping = files.seq.Map(pos, 1);
+            SpanReader(SER_DISK, CLIENT_VERSION,
+                       mapping->Data().subspan(pos.nPos)) >>
+                block;
+        } else {
+            CAutoFile(files.seq.Open(pos, true), SER_DISK, CLIENT_VERSION) >>
+                block;
+        }
+    }
+}
+
+static void BlockFileReadOpen(benchmark::State &state) {
+    BlockFileRead(state, false);
+}
+
+static void BlockFileReadMapped(benchmark::State &state) {
+    BlockFileRead(state, true);
+}
+
+BENCHMARK(BlockFileReadOpen, 500);
+BENCHMARK(BlockFileReadMapped, 500);
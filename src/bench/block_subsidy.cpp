@@ -0,0 +1,112 @@
+// Copyright (c) 2020 The Bitcoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/bench.h>
+
+#include <arith_uint256.h>
+#include <chain.h>
+#include <chainparams.h>
+#include <consensus/activation.h>
+#include <pow.h>
+#include <primitives/block.h>
+#include <validation.h>
+
+#include <memory>
+#include <vector>
+
+// These benchmarks compute the subsidy and the next target at the tip of a
+// synthetic mainnet-like block index of 1M blocks, with EMA activated half
+// way, as done for every block template, header and block.
+
+static constexpr int CHAIN_LENGTH = 1000000;
+static constexpr uint32_t CHAIN_BITS = 0x1a04b500;
+
+static const Consensus::Params &MainParams() {
+    static const std::unique_ptr<CChainParams> chainParams =
+        CreateChainParams(CBaseChainParams::MAIN);
+    return chainParams->GetConsensus();
+}
+
+static const std::vector<CBlockIndex> &SyntheticChain() {
+    static const std::vector<CBlockIndex> chain = [] {
+        const Consensus::Params &params = MainParams();
+        std::vector<CBlockIndex> blocks(CHAIN_LENGTH);
+        for (int i = 0; i < CHAIN_LENGTH; i++) {
+            CBlockIndex &index = blocks[i];
+            index.nHeight = i;
+            // Alternate early and late blocks around a 10 minutes spacing
+            index.nTime = params.emaDAATime + (i - CHAIN_LENGTH / 2) * 600 +
+                          (i % 3) * 100;
+            index.nBits = CHAIN_BITS;
+            index.nChainWork = GetBlockProof(index);
+            if (i > 0) {
+                index.pprev = &blocks[i - 1];
+                index.nChainWork += index.pprev->nChainWork;
+                index.BuildSkip();
+            }
+        }
+        return blocks;
+    }();
+    return chain;
+}
+
+// The subsidy as computed before the EMA anchor was cached and the decay done
+// on native integers: the anchor is searched for on every call.
+static Amount WalkingBlockSubsidy(const CBlockIndex *pindexPrev,
+                                  uint32_t nBits, int nHeight,
+                                  const Consensus::Params &params) {
+    arith_uint256 bnTarget;
+    bnTarget.SetCompact(nBits);
+    arith_uint256 aWork = (~bnTarget / (bnTarget + 1)) + 1;
+
+    const CBlockIndex *emaBlock = pindexPrev;
+    while (emaBlock->pprev) {
+        if (IsEMAEnabled(params, emaBlock->pskip)) {
+            emaBlock = emaBlock->pskip;
+            continue;
+        }
+        if (!IsEMAEnabled(params, emaBlock->pprev)) {
+            break;
+        }
+        emaBlock = emaBlock->pprev;
+    }
+    int divisions = nHeight / params.nSubsidyHalvingInterval;
+    int emaHeight = emaBlock->nHeight / params.nSubsidyHalvingInterval;
+    for (int a = 0; a < divisions; a++) {
+        aWork *= a < emaHeight ? 99826 : 99918;
+        aWork /= 100000;
+    }
+
+    aWork /= params.nValueCalibration;
+    return int64_t(ArithToUint256(aWork).GetUint64(0)) * Amount::fixoshi();
+}
+
+static void BlockSubsidyWalking(benchmark::State &state) {
+    const Consensus::Params &params = MainParams();
+    const CBlockIndex *tip = &SyntheticChain().back();
+    while (state.KeepRunning()) {
+        WalkingBlockSubsidy(tip, CHAIN_BITS, tip->nHeight + 1, params);
+    }
+}
+
+static void BlockSubsidy(benchmark::State &state) {
+    const Consensus::Params &params = MainParams();
+    CBlockIndex *tip = const_cast<CBlockIndex *>(&SyntheticChain().back());
+    while (state.KeepRunning()) {
+        GetBlockSubsidy(tip, CHAIN_BITS, tip->nHeight + 1, params);
+    }
+}
+
+static void NextExpWorkRequired(benchmark::State &state) {
+    const Consensus::Params &params = MainParams();
+    const CBlockIndex *tip = &SyntheticChain().back();
+    CBlockHeader header;
+    while (state.KeepRunning()) {
+        GetNextExpWorkRequired(tip, &header, params);
+    }
+}
+
+BENCHMARK(BlockSubsidyWalking, 20);
+BENCHMARK(BlockSubsidy, 2000);
+BENCHMARK(NextExpWorkRequired, 50000);
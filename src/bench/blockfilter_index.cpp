@@ -0,0 +1,73 @@
+// Copyright (c) 2020 The Bitcoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/bench.h>
+#include <bench/data.h>
+
+#include <blockfilter.h>
+#include <clientversion.h>
+#include <hash.h>
+#include <script/standard.h>
+#include <streams.h>
+#include <undo.h>
+
+#include <vector>
+
+// These benchmarks measure the work the block filter index does for each block
+// while it syncs in the background: building the basic filter of the block
+// from the block and its undo data, chaining its header, and serializing it as
+// it is appended to the filter files. The coins spent by the block are not
+// available, so each of them is given a distinct P2PKH script.
+
+static CBlock LoadBlock(const std::vector<uint8_t> &data) {
+    CDataStream stream(data, SER_NETWORK, PROTOCOL_VERSION);
+    CBlock block;
+    stream >> block;
+    return block;
+}
+
+static CBlockUndo MakeBlockUndo(const CBlock &block) {
+    CBlockUndo block_undo;
+    for (const auto &tx : block.vtx) {
+        if (tx->IsCoinBase()) {
+            continue;
+        }
+
+        CTxUndo tx_undo;
+        for (const CTxIn &in : tx->vin) {
+            const CKeyID key_id(Hash160(in.prevout.GetTxId().begin(),
+                                        in.prevout.GetTxId().end()));
+            tx_undo.vprevout.emplace_back(
+                CTxOut(FIXOSHI, GetScriptForDestination(key_id)), 1, false);
+        }
+        block_undo.vtxundo.push_back(std::move(tx_undo));
+    }
+    return block_undo;
+}
+
+static void BlockFilterIndexBuild(const std::vector<uint8_t> &data,
+                                  benchmark::State &state) {
+    const CBlock block = LoadBlock(data);
+    const CBlockUndo block_undo = MakeBlockUndo(block);
+
+    uint256 header;
+    CDataStream fileout(SER_DISK, CLIENT_VERSION);
+    while (state.KeepRunning()) {
+        BlockFilter filter(BlockFilterType::BASIC, block, block_undo);
+        header = filter.ComputeHeader(header);
+        fileout << filter.GetBlockHash() << filter.GetEncodedFilter();
+        fileout.clear();
+    }
+}
+
+static void BlockFilterIndexBuild413567(benchmark::State &state) {
+    BlockFilterIndexBuild(benchmark::data::block413567, state);
+}
+
+static void BlockFilterIndexBuild556034(benchmark::State &state) {
+    BlockFilterIndexBuild(benchmark::data::block556034, state);
+}
+
+BENCHMARK(BlockFilterIndexBuild413567, 100);
+BENCHMARK(BlockFilterIndexBuild556034, 100);
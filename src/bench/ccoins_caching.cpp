@@ -4,9 +4,15 @@
 
 #include <bench/bench.h>
 #include <coins.h>
+#include <memusage.h>
 #include <policy/policy.h>
+#include <random.h>
+#include <tinyformat.h>
 #include <wallet/crypter.h>
 
+#include <algorithm>
+#include <iostream>
+#include <unordered_map>
 #include <vector>
 
 // FIXME: Dedup with SetupDummyInputs in test/transaction_tests.cpp.
@@ -89,3 +95,86 @@ static void CCoinsCaching(benchmark::State &state) {
 }
 
 BENCHMARK(CCoinsCaching, 170 * 1000);
+
+// Compare CCoinsMap with the std::unordered_map it used to be, when filling a
+// map with coins and when looking them up. The memory used per coin by each
+// is reported on stderr, as it is not a timing.
+typedef std::unordered_map<COutPoint, CCoinsCacheEntry, SaltedOutpointHasher>
+    CCoinsUnorderedMap;
+
+static const size_t COINS_MAP_SIZE = 100000;
+
+static std::vector<COutPoint> RandomOutPoints(size_t n) {
+    FastRandomContext insecure_rand(true);
+    std::vector<COutPoint> outpoints;
+    outpoints.reserve(n);
+    for (size_t i = 0; i < n; i++) {
+        outpoints.emplace_back(TxId(insecure_rand.rand256()),
+                               insecure_rand.randrange(4));
+    }
+    return outpoints;
+}
+
+template <typename Map>
+static void FillCoinsMap(Map &map, const std::vector<COutPoint> &outpoints) {
+    for (const COutPoint &outpoint : outpoints) {
+        map.emplace(std::piecewise_construct, std::forward_as_tuple(outpoint),
+                    std::forward_as_tuple(Coin(
+                        CTxOut(COIN, CScript() << OP_DUP << OP_HASH160
+                                               << std::vector<uint8_t>(20)
+                                               << OP_EQUALVERIFY
+                                               << OP_CHECKSIG),
+                        1, false)));
+    }
+}
+
+template <typename Map>
+static void CoinsMapInsert(benchmark::State &state, const char *name) {
+    const std::vector<COutPoint> outpoints = RandomOutPoints(COINS_MAP_SIZE);
+    bool reported = false;
+    while (state.KeepRunning()) {
+        Map map;
+        FillCoinsMap(map, outpoints);
+        if (!reported) {
+            tfm::format(std::cerr, "%s: %.1f bytes per coin\n", name,
+                        double(memusage::DynamicUsage(map)) / map.size());
+            reported = true;
+        }
+    }
+}
+
+template <typename Map> static void CoinsMapLookup(benchmark::State &state) {
+    const std::vector<COutPoint> outpoints = RandomOutPoints(COINS_MAP_SIZE);
+    Map map;
+    FillCoinsMap(map, outpoints);
+    // Look up as many absent outpoints as present ones.
+    std::vector<COutPoint> lookups = RandomOutPoints(2 * COINS_MAP_SIZE);
+    std::copy(outpoints.begin(), outpoints.end(), lookups.begin());
+    Shuffle(lookups.begin(), lookups.end(), FastRandomContext(true));
+
+    while (state.KeepRunning()) {
+        size_t found = 0;
+        for (const COutPoint &outpoint : lookups) {
+            found += map.count(outpoint);
+        }
+        assert(found == COINS_MAP_SIZE);
+    }
+}
+
+static void CCoinsMapInsert(benchmark::State &state) {
+    CoinsMapInsert<CCoinsMap>(state, "CCoinsMap");
+}
+static void CCoinsUnorderedMapInsert(benchmark::State &state) {
+    CoinsMapInsert<CCoinsUnorderedMap>(state, "std::unordered_map");
+}
+static void CCoinsMapLookup(benchmark::State &state) {
+    CoinsMapLookup<CCoinsMap>(state);
+}
+static void CCoinsUnorderedMapLookup(benchmark::State &state) {
+    CoinsMapLookup<CCoinsUnorderedMap>(state);
+}
+
+BENCHMARK(CCoinsMapInsert, 20);
+BENCHMARK(CCoinsUnorderedMapInsert, 20);
+BENCHMARK(CCoinsMapLookup, 20);
+BENCHMARK(CCoinsUnorderedMapLookup, 20);
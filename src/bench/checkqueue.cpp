@@ -7,10 +7,12 @@
 #include <prevector.h>
 #include <random.h>
 #include <util/system.h>
+#include <tinyformat.h>
 #include <validation.h>
 
 #include <boost/thread/thread.hpp>
 
+#include <string>
 #include <vector>
 
 static const int MIN_CORES = 2;
@@ -19,22 +21,28 @@ static const size_t BATCH_SIZE = 30;
 static const int PREVECTOR_SIZE = 28;
 static const size_t QUEUE_BATCH_SIZE = 128;
 
+struct PrevectorJob {
+    prevector<PREVECTOR_SIZE, uint8_t> p;
+    PrevectorJob() {}
+    explicit PrevectorJob(FastRandomContext &insecure_rand) {
+        p.resize(insecure_rand.randrange(PREVECTOR_SIZE * 2));
+    }
+    bool operator()() { return true; }
+    void swap(PrevectorJob &x) { p.swap(x.p); };
+};
+
 // This Benchmark tests the CheckQueue with a slightly realistic workload, where
 // checks all contain a prevector that is indirect 50% of the time and there is
-// a little bit of work done between calls to Add.
-static void CCheckQueueSpeedPrevectorJob(benchmark::State &state) {
-    struct PrevectorJob {
-        prevector<PREVECTOR_SIZE, uint8_t> p;
-        PrevectorJob() {}
-        explicit PrevectorJob(FastRandomContext &insecure_rand) {
-            p.resize(insecure_rand.randrange(PREVECTOR_SIZE * 2));
-        }
-        bool operator()() { return true; }
-        void swap(PrevectorJob &x) { p.swap(x.p); };
-    };
+// a little bit of work done between calls to Add. nWorkers threads help the
+// master thread.
+static void CheckQueuePrevectorJobs(benchmark::State &state, int nWorkers,
+                                    bool fWorkStealing) {
     CCheckQueue<PrevectorJob> queue{QUEUE_BATCH_SIZE};
+    if (fWorkStealing) {
+        queue.EnableWorkStealing(nWorkers);
+    }
     boost::thread_group tg;
-    for (auto x = 0; x < std::max(MIN_CORES, GetNumCores()); ++x) {
+    for (auto x = 0; x < nWorkers; ++x) {
         tg.create_thread([&] { queue.Thread(); });
     }
     while (state.KeepRunning()) {
@@ -56,4 +64,42 @@ static void CCheckQueueSpeedPrevectorJob(benchmark::State &state) {
     tg.interrupt_all();
     tg.join_all();
 }
+
+static void CCheckQueueSpeedPrevectorJob(benchmark::State &state) {
+    CheckQueuePrevectorJobs(state, std::max(MIN_CORES, GetNumCores()), false);
+}
 BENCHMARK(CCheckQueueSpeedPrevectorJob, 1400);
+
+static void CCheckQueueSpeedPrevectorJobWorkStealing(benchmark::State &state) {
+    CheckQueuePrevectorJobs(state, std::max(MIN_CORES, GetNumCores()), true);
+}
+BENCHMARK(CCheckQueueSpeedPrevectorJobWorkStealing, 1400);
+
+// Scaling curves: the same workload for 1, 2, 4, ... threads in total (the
+// master included), up to the number of cores, with a single shared queue and
+// with work stealing.
+static bool RegisterScalingBenchmarks() {
+    const int nMaxThreads = std::max(MIN_CORES, GetNumCores());
+    std::vector<int> vThreads;
+    for (int nThreads = 1; nThreads < nMaxThreads; nThreads *= 2) {
+        vThreads.push_back(nThreads);
+    }
+    vThreads.push_back(nMaxThreads);
+
+    for (const bool fWorkStealing : {false, true}) {
+        for (const int nThreads : vThreads) {
+            const std::string name =
+                strprintf("CCheckQueueScaling%s_%02d",
+                          fWorkStealing ? "WorkStealing" : "Shared", nThreads);
+            benchmark::BenchRunner(
+                name,
+                [nThreads, fWorkStealing](benchmark::State &state) {
+                    CheckQueuePrevectorJobs(state, nThreads - 1,
+                                            fWorkStealing);
+                },
+                1400);
+        }
+    }
+    return true;
+}
+static const bool fScalingBenchmarksRegistered = RegisterScalingBenchmarks();
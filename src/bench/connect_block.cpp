@@ -0,0 +1,185 @@
+// Copyright (c) 2020 The Bitcoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/bench.h>
+#include <bench/data.h>
+
+#include <chain.h>
+#include <checkqueue.h>
+#include <coins.h>
+#include <consensus/tx_verify.h>
+#include <consensus/validation.h>
+#include <script/script_flags.h>
+#include <streams.h>
+#include <undo.h>
+#include <validation.h>
+
+#include <set>
+#include <vector>
+
+#include <boost/thread/thread.hpp>
+
+// These benchmarks measure the part of ConnectBlock which validates and spends
+// the inputs of the transactions of a block, serially and with
+// -parallelinputchecks. The coins spent by the block are not available, so
+// they are replaced by OP_TRUE outputs, which makes the script checks cheap
+// and mimics connecting a block whose signatures are already cached.
+
+static const int BENCH_HEIGHT = 1000;
+static const uint32_t BENCH_SCRIPT_FLAGS = SCRIPT_VERIFY_P2SH |
+                                           SCRIPT_VERIFY_STRICTENC |
+                                           SCRIPT_ENABLE_SIGHASH_FORKID;
+
+static CBlock LoadBlock(const std::vector<uint8_t> &data) {
+    CDataStream stream(data, SER_NETWORK, PROTOCOL_VERSION);
+    CBlock block;
+    stream >> block;
+    return block;
+}
+
+/**
+ * Fill coins with the coins spent by the block and not created by it. Each of
+ * them gets a share of the spending transaction's output value, so that the
+ * amounts balance.
+ */
+static void AddSpentCoins(const CBlock &block, CCoinsViewCache &coins) {
+    std::set<TxId> blockTxIds;
+    for (const auto &tx : block.vtx) {
+        blockTxIds.insert(tx->GetId());
+    }
+
+    for (const auto &tx : block.vtx) {
+        if (tx->IsCoinBase()) {
+            continue;
+        }
+
+        const Amount value =
+            tx->GetValueOut() / int64_t(tx->vin.size()) + FIXOSHI;
+        for (const CTxIn &in : tx->vin) {
+            if (blockTxIds.count(in.prevout.GetTxId())) {
+                continue;
+            }
+            coins.AddCoin(in.prevout,
+                          Coin(CTxOut(value, CScript() << OP_TRUE), 1, false),
+                          false);
+        }
+    }
+}
+
+/** Mirror of the serial input loop in ConnectBlock. */
+static bool SerialConnect(const CBlock &block, CValidationState &state,
+                          CCoinsViewCache &view, const CBlockIndex &index,
+                          CCheckQueue<CScriptCheck> &queue,
+                          CBlockUndo &blockundo, Amount &nFees) {
+    LOCK(cs_main);
+    CheckInputsLimiter nSigChecksBlockLimiter(
+        GetMaxBlockSigChecksCount(DEFAULT_EXCESSIVE_BLOCK_SIZE));
+    std::vector<TxSigCheckLimiter> nSigChecksTxLimiters(block.vtx.size() - 1);
+    blockundo.vtxundo.resize(block.vtx.size() - 1);
+
+    CCheckQueueControl<CScriptCheck> control(&queue);
+    std::vector<int> prevheights;
+    for (size_t i = 1; i < block.vtx.size(); i++) {
+        const CTransaction &tx = *block.vtx[i];
+        Amount txfee = Amount::zero();
+        if (!Consensus::CheckTxInputs(tx, state, view, index.nHeight, txfee)) {
+            return false;
+        }
+        nFees += txfee;
+
+        prevheights.resize(tx.vin.size());
+        for (size_t j = 0; j < tx.vin.size(); j++) {
+            prevheights[j] = view.AccessCoin(tx.vin[j].prevout).GetHeight();
+        }
+        if (!SequenceLocks(tx, 0, &prevheights, index)) {
+            return false;
+        }
+
+        std::vector<CScriptCheck> vChecks;
+        int nSigChecksRet;
+        if (!CheckInputs(tx, state, view, true, BENCH_SCRIPT_FLAGS, false,
+                         false, PrecomputedTransactionData(tx), nSigChecksRet,
+                         nSigChecksTxLimiters[i - 1], &nSigChecksBlockLimiter,
+                         &vChecks)) {
+            return false;
+        }
+        control.Add(vChecks);
+
+        SpendCoins(view, tx, blockundo.vtxundo[i - 1], index.nHeight);
+    }
+
+    return control.Wait();
+}
+
+static bool ParallelConnect(const CBlock &block, CValidationState &state,
+                            CCoinsViewCache &view, const CBlockIndex &index,
+                            CBlockUndo &blockundo, Amount &nFees) {
+    LOCK(cs_main);
+    CheckInputsLimiter nSigChecksBlockLimiter(
+        GetMaxBlockSigChecksCount(DEFAULT_EXCESSIVE_BLOCK_SIZE));
+    return ConnectBlockInputsParallel(block, state, view, index,
+                                      BENCH_SCRIPT_FLAGS, 0, true, false,
+                                      nSigChecksBlockLimiter, blockundo, nFees);
+}
+
+static void ConnectBlockInputsTest(const std::vector<uint8_t> &data,
+                                   bool fParallel, benchmark::State &state) {
+    const CBlock block = LoadBlock(data);
+
+    CCoinsView coinsDummy;
+    CCoinsViewCache coinsBase(&coinsDummy);
+    AddSpentCoins(block, coinsBase);
+
+    CBlockIndex indexPrev;
+    indexPrev.nHeight = BENCH_HEIGHT - 1;
+    CBlockIndex index;
+    index.nHeight = BENCH_HEIGHT;
+    index.pprev = &indexPrev;
+
+    // The serial variant uses its own script check queue, with the same number
+    // of workers as the input check queue in the testing setup.
+    CCheckQueue<CScriptCheck> scriptcheckqueue(128);
+    boost::thread_group tg;
+    for (int i = 0; i < nScriptCheckThreads - 1; i++) {
+        tg.create_thread([&] { scriptcheckqueue.Thread(); });
+    }
+
+    while (state.KeepRunning()) {
+        CCoinsViewCache view(&coinsBase);
+        for (const auto &tx : block.vtx) {
+            AddCoins(view, *tx, BENCH_HEIGHT);
+        }
+
+        CValidationState validationState;
+        CBlockUndo blockundo;
+        Amount nFees = Amount::zero();
+        bool connected =
+            fParallel ? ParallelConnect(block, validationState, view, index,
+                                        blockundo, nFees)
+                      : SerialConnect(block, validationState, view, index,
+                                      scriptcheckqueue, blockundo, nFees);
+        assert(connected);
+    }
+
+    tg.interrupt_all();
+    tg.join_all();
+}
+
+static void ConnectBlockInputsSerial_1MB(benchmark::State &state) {
+    ConnectBlockInputsTest(benchmark::data::block413567, false, state);
+}
+static void ConnectBlockInputsParallel_1MB(benchmark::State &state) {
+    ConnectBlockInputsTest(benchmark::data::block413567, true, state);
+}
+static void ConnectBlockInputsSerial_32MB(benchmark::State &state) {
+    ConnectBlockInputsTest(benchmark::data::block556034, false, state);
+}
+static void ConnectBlockInputsParallel_32MB(benchmark::State &state) {
+    ConnectBlockInputsTest(benchmark::data::block556034, true, state);
+}
+
+BENCHMARK(ConnectBlockInputsSerial_1MB, 30);
+BENCHMARK(ConnectBlockInputsParallel_1MB, 30);
+BENCHMARK(ConnectBlockInputsSerial_32MB, 1);
+BENCHMARK(ConnectBlockInputsParallel_32MB, 1);
@@ -0,0 +1,114 @@
+// Copyright (c) 2020 The Bitcoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/bench.h>
+
+#include <amount.h>
+#include <coins.h>
+#include <config.h>
+#include <consensus/validation.h>
+#include <key.h>
+#include <primitives/transaction.h>
+#include <random.h>
+#include <script/interpreter.h>
+#include <script/script.h>
+#include <script/sighashtype.h>
+#include <txmempool.h>
+#include <validation.h>
+
+#include <algorithm>
+#include <cassert>
+#include <vector>
+
+// These benchmarks accept to the mempool a stream of transactions spending
+// P2PK outputs with Schnorr signatures, received in rounds of one transaction
+// from each of several peers, as done by the message handler. The transactions
+// of a round are either accepted one at a time, or checked in parallel first.
+
+static constexpr int NUM_TXS = 512;
+static constexpr int NUM_PEERS = 16;
+static constexpr Amount SPENT_AMOUNT = COIN;
+
+static CTransactionRef SpendP2PK(const CKey &key, const CScript &scriptPubKey,
+                                 const COutPoint &outpoint, const Amount fee) {
+    const SigHashType sigHashType = SigHashType().withForkId();
+    CMutableTransaction tx;
+    tx.vin.emplace_back(outpoint);
+    tx.vout.emplace_back(SPENT_AMOUNT - fee, scriptPubKey);
+    const uint256 hash =
+        SignatureHash(scriptPubKey, tx, 0, sigHashType, SPENT_AMOUNT);
+    std::vector<uint8_t> sig;
+    key.SignSchnorr(hash, sig);
+    sig.push_back(uint8_t(sigHashType.getRawSigHashType()));
+    tx.vin[0].scriptSig = CScript() << sig;
+    return MakeTransactionRef(std::move(tx));
+}
+
+static void MempoolAccept(benchmark::State &state, bool fPreCheck) {
+    const Config &config = GetConfig();
+    CKey key;
+    key.MakeNewKey(true);
+    const CScript scriptPubKey = CScript() << ToByteVector(key.GetPubKey())
+                                           << OP_CHECKSIG;
+
+    std::vector<COutPoint> outpoints;
+    {
+        LOCK(cs_main);
+        for (int i = 0; i < NUM_TXS; i++) {
+            outpoints.emplace_back(TxId(GetRandHash()), 0);
+            pcoinsTip->AddCoin(outpoints.back(),
+                               Coin(CTxOut(SPENT_AMOUNT, scriptPubKey), 1,
+                                    false),
+                               false);
+        }
+    }
+
+    // The signatures of a stream are only missing from the signature cache
+    // the first time it is accepted, so every iteration gets its own, paying a
+    // different fee.
+    std::vector<std::vector<CTransactionRef>> streams(state.m_num_evals *
+                                                      state.m_num_iters);
+    for (size_t s = 0; s < streams.size(); s++) {
+        for (const COutPoint &outpoint : outpoints) {
+            streams[s].push_back(SpendP2PK(key, scriptPubKey, outpoint,
+                                           int64_t(10000 + s) * FIXOSHI));
+        }
+    }
+
+    size_t nStream = 0;
+    while (state.KeepRunning()) {
+        const std::vector<CTransactionRef> &txs =
+            streams[nStream++ % streams.size()];
+        for (size_t begin = 0; begin < txs.size(); begin += NUM_PEERS) {
+            const std::vector<CTransactionRef> round(
+                txs.begin() + begin,
+                txs.begin() + std::min<size_t>(begin + NUM_PEERS, txs.size()));
+            if (fPreCheck) {
+                PreCheckTransactions(config, g_mempool, round);
+            }
+
+            LOCK(cs_main);
+            for (const CTransactionRef &tx : round) {
+                CValidationState vstate;
+                bool ret = AcceptToMemoryPool(
+                    config, g_mempool, vstate, tx,
+                    nullptr /* pfMissingInputs */, false /* bypass_limits */,
+                    Amount::zero() /* nAbsurdFee */);
+                assert(ret);
+            }
+        }
+        g_mempool.clear();
+    }
+}
+
+static void MempoolAcceptSerial(benchmark::State &state) {
+    MempoolAccept(state, false);
+}
+
+static void MempoolAcceptPreChecked(benchmark::State &state) {
+    MempoolAccept(state, true);
+}
+
+BENCHMARK(MempoolAcceptSerial, 2);
+BENCHMARK(MempoolAcceptPreChecked, 2);
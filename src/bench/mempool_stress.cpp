@@ -0,0 +1,77 @@
+// Copyright (c) 2020 The Bitcoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/bench.h>
+#include <policy/mempool.h>
+#include <policy/policy.h>
+#include <txmempool.h>
+
+#include <cassert>
+#include <vector>
+
+static constexpr size_t NUM_CHAINS = 40;
+static constexpr size_t CHAIN_DEPTH = 25;
+
+// Build chains of transactions where each one spends an output of each of the
+// two transactions before it, so that ancestor and descendant walks reach most
+// entries by several paths.
+static std::vector<CTransactionRef> CreateChains() {
+    std::vector<CTransactionRef> txs;
+    txs.reserve(NUM_CHAINS * CHAIN_DEPTH);
+    for (size_t chain = 0; chain < NUM_CHAINS; chain++) {
+        for (size_t depth = 0; depth < CHAIN_DEPTH; depth++) {
+            CMutableTransaction tx;
+            if (depth == 0) {
+                tx.vin.emplace_back(COutPoint(TxId(uint256()), chain));
+            } else {
+                tx.vin.emplace_back(COutPoint(txs.back()->GetId(), 0));
+            }
+            if (depth >= 2) {
+                tx.vin.emplace_back(COutPoint(txs[txs.size() - 2]->GetId(), 1));
+            }
+            for (CTxIn &in : tx.vin) {
+                in.scriptSig = CScript() << OP_1;
+            }
+            tx.vout.resize(2);
+            for (CTxOut &out : tx.vout) {
+                out.scriptPubKey = CScript() << OP_1 << OP_EQUAL;
+                out.nValue = 10 * COIN;
+            }
+            txs.push_back(MakeTransactionRef(tx));
+        }
+    }
+    return txs;
+}
+
+// Accept chained transactions the way AcceptToMemoryPool does once they are
+// validated, checking the package limits before adding each entry, and then
+// evict them all.
+static void MempoolChainedAccept(benchmark::State &state) {
+    const std::vector<CTransactionRef> txs = CreateChains();
+    const uint64_t limitAncestorCount = DEFAULT_ANCESTOR_LIMIT;
+    const uint64_t limitAncestorSize = DEFAULT_ANCESTOR_SIZE_LIMIT * 1000;
+    const uint64_t limitDescendantCount = DEFAULT_DESCENDANT_LIMIT;
+    const uint64_t limitDescendantSize = DEFAULT_DESCENDANT_SIZE_LIMIT * 1000;
+
+    CTxMemPool pool;
+    LOCK2(cs_main, pool.cs);
+    while (state.KeepRunning()) {
+        for (size_t i = 0; i < txs.size(); i++) {
+            const CTxMemPoolEntry entry(txs[i], int64_t(i % 100) * FIXOSHI,
+                                        /* time */ 0, /* height */ 1,
+                                        /* spendsCoinbase */ false,
+                                        /* sigOpCount */ 1, LockPoints());
+            CTxMemPool::setEntries ancestors;
+            std::string errString;
+            bool ok = pool.CalculateMemPoolAncestors(
+                entry, ancestors, limitAncestorCount, limitAncestorSize,
+                limitDescendantCount, limitDescendantSize, errString);
+            assert(ok);
+            pool.addUnchecked(entry, ancestors);
+        }
+        pool.TrimToSize(0);
+    }
+}
+
+BENCHMARK(MempoolChainedAccept, 20);
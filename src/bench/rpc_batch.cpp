@@ -0,0 +1,160 @@
+// Copyright (c) 2020 The Bitcoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/bench.h>
+
+#include <chainparams.h>
+#include <config.h>
+#include <crypto/sha256.h>
+#include <rpc/command.h>
+#include <rpc/jsonrpcrequest.h>
+#include <rpc/server.h>
+#include <sync.h>
+
+#include <univalue.h>
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <vector>
+
+// These benchmarks execute JSON-RPC batches of various sizes, one request
+// after the other on the calling thread, or shared with idle worker threads as
+// done by the HTTP server. Each request hashes a few kilobytes, standing for a
+// cheap lookup such as getrawtransaction.
+
+static constexpr int NUM_WORKERS = 4;
+static constexpr size_t REQUEST_WORK = 4096;
+
+class HashTestRPCCommand : public RPCCommandWithArgsContext {
+public:
+    HashTestRPCCommand() : RPCCommandWithArgsContext("hash") {}
+
+    UniValue Execute(const UniValue &args) const override {
+        const std::vector<uint8_t> data(REQUEST_WORK, args[0].get_int());
+        uint8_t hash[CSHA256::OUTPUT_SIZE];
+        CSHA256().Write(data.data(), data.size()).Finalize(hash);
+        return int(hash[0]);
+    }
+};
+
+/** Worker threads running the tasks handed to them while they are idle */
+class IdleWorkers {
+private:
+    Mutex cs;
+    std::condition_variable cond;
+    std::deque<std::function<void()>> tasks GUARDED_BY(cs);
+    size_t numIdle GUARDED_BY(cs) = 0;
+    bool running GUARDED_BY(cs) = true;
+    std::vector<std::thread> threads;
+
+    void Run() {
+        while (true) {
+            std::function<void()> task;
+            {
+                WAIT_LOCK(cs, lock);
+                numIdle++;
+                cond.wait(lock, [this]() EXCLUSIVE_LOCKS_REQUIRED(cs) {
+                    return !running || !tasks.empty();
+                });
+                numIdle--;
+                if (!running) {
+                    return;
+                }
+                task = std::move(tasks.front());
+                tasks.pop_front();
+            }
+            task();
+        }
+    }
+
+public:
+    IdleWorkers() {
+        for (int i = 0; i < NUM_WORKERS; i++) {
+            threads.emplace_back([this] { Run(); });
+        }
+    }
+
+    ~IdleWorkers() {
+        {
+            LOCK(cs);
+            running = false;
+            cond.notify_all();
+        }
+        for (std::thread &thread : threads) {
+            thread.join();
+        }
+    }
+
+    bool Dispatch(std::function<void()> task) {
+        LOCK(cs);
+        if (tasks.size() >= numIdle) {
+            return false;
+        }
+        tasks.push_back(std::move(task));
+        cond.notify_one();
+        return true;
+    }
+};
+
+static void RPCBatch(benchmark::State &state, int size, bool parallel) {
+    DummyConfig config;
+    RPCServer rpcServer;
+    rpcServer.RegisterCommand(std::make_unique<HashTestRPCCommand>());
+    IdleWorkers workers;
+    const RPCBatchDispatcher dispatch =
+        [&workers](std::function<void()> task) {
+            return workers.Dispatch(std::move(task));
+        };
+
+    UniValue::Array batch;
+    for (int i = 0; i < size; i++) {
+        UniValue::Array params;
+        params.emplace_back(i);
+        UniValue::Object req;
+        req.emplace_back("method", "hash");
+        req.emplace_back("params", std::move(params));
+        req.emplace_back("id", i);
+        batch.emplace_back(std::move(req));
+    }
+
+    JSONRPCRequest jreq;
+    while (state.KeepRunning()) {
+        UniValue::Array vReq(batch);
+        if (parallel) {
+            JSONRPCExecBatch(config, rpcServer, jreq, std::move(vReq),
+                             dispatch, NUM_WORKERS + 1);
+        } else {
+            JSONRPCExecBatch(config, rpcServer, jreq, std::move(vReq));
+        }
+    }
+}
+
+static void RPCBatch10Serial(benchmark::State &state) {
+    RPCBatch(state, 10, false);
+}
+static void RPCBatch10Parallel(benchmark::State &state) {
+    RPCBatch(state, 10, true);
+}
+static void RPCBatch100Serial(benchmark::State &state) {
+    RPCBatch(state, 100, false);
+}
+static void RPCBatch100Parallel(benchmark::State &state) {
+    RPCBatch(state, 100, true);
+}
+static void RPCBatch500Serial(benchmark::State &state) {
+    RPCBatch(state, 500, false);
+}
+static void RPCBatch500Parallel(benchmark::State &state) {
+    RPCBatch(state, 500, true);
+}
+
+BENCHMARK(RPCBatch10Serial, 500);
+BENCHMARK(RPCBatch10Parallel, 500);
+BENCHMARK(RPCBatch100Serial, 50);
+BENCHMARK(RPCBatch100Parallel, 50);
+BENCHMARK(RPCBatch500Serial, 10);
+BENCHMARK(RPCBatch500Parallel, 10);
@@ -13,10 +13,12 @@
 #include <streams.h>
 #include <consensus/validation.h>
 #include <rpc/blockchain.h>
+#include <util/jsonwriter.h>
 
 #include <univalue.h>
 
-static void RPCBlockVerbose(const std::vector<uint8_t> &data, benchmark::State &state) {
+static void RPCBlockVerbose(const std::vector<uint8_t> &data, benchmark::State &state, bool stringify = false,
+                            bool writer = false) {
     SelectParams(CBaseChainParams::MAIN);
 
     CDataStream stream(data, SER_NETWORK, PROTOCOL_VERSION);
@@ -32,7 +34,16 @@ static void RPCBlockVerbose(const std::vector<uint8_t> &data, benchmark::State &
     blockindex.nBits = block.nBits;
 
     while (state.KeepRunning()) {
-        (void)blockToJSON(GetConfig(), block, &blockindex, &blockindex, /*verbose*/ true);
+        if (writer) {
+            // The JSON text of getblock with verbosity 2, written as we go
+            std::string json;
+            JSONWriter jsonWriter(json);
+            WriteBlockJSON(jsonWriter, GetConfig(), block, &blockindex, &blockindex, /*verbose*/ true);
+        } else if (stringify) {
+            (void)UniValue::stringify(blockToJSON(GetConfig(), block, &blockindex, &blockindex, /*verbose*/ true));
+        } else {
+            (void)blockToJSON(GetConfig(), block, &blockindex, &blockindex, /*verbose*/ true);
+        }
     }
 }
 
@@ -43,5 +54,22 @@ static void RPCBlockVerbose_32MB(benchmark::State &state) {
     RPCBlockVerbose(benchmark::data::block556034, state);
 }
 
+static void RPCBlockVerboseStringify_1MB(benchmark::State &state) {
+    RPCBlockVerbose(benchmark::data::block413567, state, true);
+}
+static void RPCBlockVerboseStringify_32MB(benchmark::State &state) {
+    RPCBlockVerbose(benchmark::data::block556034, state, true);
+}
+static void RPCBlockVerboseWriter_1MB(benchmark::State &state) {
+    RPCBlockVerbose(benchmark::data::block413567, state, false, true);
+}
+static void RPCBlockVerboseWriter_32MB(benchmark::State &state) {
+    RPCBlockVerbose(benchmark::data::block556034, state, false, true);
+}
+
 BENCHMARK(RPCBlockVerbose_1MB, 23);
 BENCHMARK(RPCBlockVerbose_32MB, 1);
+BENCHMARK(RPCBlockVerboseStringify_1MB, 23);
+BENCHMARK(RPCBlockVerboseStringify_32MB, 1);
+BENCHMARK(RPCBlockVerboseWriter_1MB, 23);
+BENCHMARK(RPCBlockVerboseWriter_32MB, 1);
@@ -0,0 +1,163 @@
+// Copyright (c) 2020 The Bitcoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/bench.h>
+
+#include <amount.h>
+#include <checkqueue.h>
+#include <key.h>
+#include <primitives/transaction.h>
+#include <pubkey.h>
+#include <random.h>
+#include <script/interpreter.h>
+#include <script/script.h>
+#include <script/script_flags.h>
+#include <validation.h>
+
+#include <vector>
+
+#include <boost/thread/thread.hpp>
+
+// These benchmarks verify the scripts of a block full of transactions spending
+// P2PK outputs with Schnorr signatures, on the script check queue, with the
+// signatures verified one by one or in batches. The signatures are not in the
+// signature cache, as when connecting a block relayed before its transactions.
+
+static constexpr int NUM_TXS = 1000;
+static constexpr int INPUTS_PER_TX = 2;
+static constexpr Amount SPENT_AMOUNT = 1000 * FIXOSHI;
+static constexpr uint32_t BENCH_SCRIPT_FLAGS =
+    SCRIPT_VERIFY_P2SH | SCRIPT_VERIFY_STRICTENC |
+    SCRIPT_ENABLE_SIGHASH_FORKID | SCRIPT_VERIFY_LOW_S |
+    SCRIPT_VERIFY_NULLFAIL | SCRIPT_ENABLE_SCHNORR_MULTISIG;
+
+struct SchnorrBlock {
+    std::vector<CScript> scriptPubKeys;
+    std::vector<CTransactionRef> txs;
+    std::vector<PrecomputedTransactionData> txdata;
+
+    SchnorrBlock() {
+        const SigHashType sigHashType = SigHashType().withForkId();
+        std::vector<CKey> keys(NUM_TXS * INPUTS_PER_TX);
+        for (CKey &key : keys) {
+            key.MakeNewKey(true);
+            scriptPubKeys.push_back(CScript() << ToByteVector(key.GetPubKey())
+                                              << OP_CHECKSIG);
+        }
+
+        for (int i = 0; i < NUM_TXS; i++) {
+            CMutableTransaction mtx;
+            for (int j = 0; j < INPUTS_PER_TX; j++) {
+                mtx.vin.emplace_back(COutPoint(TxId(GetRandHash()), j));
+            }
+            mtx.vout.emplace_back(INPUTS_PER_TX * SPENT_AMOUNT - FIXOSHI,
+                                  CScript() << OP_TRUE);
+            for (int j = 0; j < INPUTS_PER_TX; j++) {
+                const size_t k = i * INPUTS_PER_TX + j;
+                const uint256 hash =
+                    SignatureHash(scriptPubKeys[k], mtx, j, sigHashType,
+                                  SPENT_AMOUNT);
+                std::vector<uint8_t> sig;
+                keys[k].SignSchnorr(hash, sig);
+                sig.push_back(uint8_t(sigHashType.getRawSigHashType()));
+                mtx.vin[j].scriptSig = CScript() << sig;
+            }
+            txs.push_back(MakeTransactionRef(std::move(mtx)));
+        }
+        for (const auto &tx : txs) {
+            txdata.emplace_back(*tx);
+        }
+    }
+};
+
+static void SchnorrBlockScriptChecks(benchmark::State &state, bool fBatch) {
+    const SchnorrBlock block;
+
+    // Same number of workers as the script check queue in the testing setup.
+    CCheckQueue<CScriptCheck> scriptcheckqueue(128);
+    boost::thread_group tg;
+    for (int i = 0; i < nScriptCheckThreads - 1; i++) {
+        tg.create_thread([&] { scriptcheckqueue.Thread(); });
+    }
+
+    fBatchSchnorrChecks = fBatch;
+    while (state.KeepRunning()) {
+        CCheckQueueControl<CScriptCheck> control(&scriptcheckqueue);
+        for (size_t i = 0; i < block.txs.size(); i++) {
+            std::vector<CScriptCheck> vChecks;
+            for (int j = 0; j < INPUTS_PER_TX; j++) {
+                vChecks.emplace_back(
+                    block.scriptPubKeys[i * INPUTS_PER_TX + j], SPENT_AMOUNT,
+                    *block.txs[i], j, BENCH_SCRIPT_FLAGS, false,
+                    block.txdata[i]);
+            }
+            control.Add(vChecks);
+        }
+        bool fOk = control.Wait();
+        assert(fOk);
+    }
+    fBatchSchnorrChecks = DEFAULT_BATCH_SCHNORR_CHECKS;
+
+    tg.interrupt_all();
+    tg.join_all();
+}
+
+static void SchnorrBlockScriptChecksSingle(benchmark::State &state) {
+    SchnorrBlockScriptChecks(state, false);
+}
+
+static void SchnorrBlockScriptChecksBatched(benchmark::State &state) {
+    SchnorrBlockScriptChecks(state, true);
+}
+
+// Verification of the signatures alone, on a single thread.
+
+static constexpr int NUM_SIGS = 128;
+
+static void SchnorrSigs(std::vector<CPubKey> &pubkeys,
+                        std::vector<uint256> &hashes,
+                        std::vector<std::vector<uint8_t>> &sigs) {
+    for (int i = 0; i < NUM_SIGS; i++) {
+        CKey key;
+        key.MakeNewKey(true);
+        pubkeys.push_back(key.GetPubKey());
+        hashes.push_back(GetRandHash());
+        sigs.emplace_back();
+        key.SignSchnorr(hashes.back(), sigs.back());
+    }
+}
+
+static void SchnorrVerify128(benchmark::State &state) {
+    std::vector<CPubKey> pubkeys;
+    std::vector<uint256> hashes;
+    std::vector<std::vector<uint8_t>> sigs;
+    SchnorrSigs(pubkeys, hashes, sigs);
+    while (state.KeepRunning()) {
+        for (int i = 0; i < NUM_SIGS; i++) {
+            bool fOk = pubkeys[i].VerifySchnorr(hashes[i], sigs[i]);
+            assert(fOk);
+        }
+    }
+}
+
+static void SchnorrBatchVerify128(benchmark::State &state) {
+    std::vector<CPubKey> pubkeys;
+    std::vector<uint256> hashes;
+    std::vector<std::vector<uint8_t>> sigs;
+    SchnorrSigs(pubkeys, hashes, sigs);
+    SchnorrBatchVerifier batch;
+    while (state.KeepRunning()) {
+        batch.clear();
+        for (int i = 0; i < NUM_SIGS; i++) {
+            batch.Add(pubkeys[i], hashes[i], sigs[i]);
+        }
+        bool fOk = batch.Verify();
+        assert(fOk);
+    }
+}
+
+BENCHMARK(SchnorrBlockScriptChecksSingle, 2);
+BENCHMARK(SchnorrBlockScriptChecksBatched, 2);
+BENCHMARK(SchnorrVerify128, 20);
+BENCHMARK(SchnorrBatchVerify128, 20);
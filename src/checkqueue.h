@@ -8,6 +8,9 @@
 #include <sync.h>
 
 #include <algorithm>
+#include <atomic>
+#include <deque>
+#include <memory>
 #include <vector>
 
 #include <boost/thread/condition_variable.hpp>
@@ -15,6 +18,18 @@
 
 template <typename T> class CCheckQueueControl;
 
+/**
+ * Work shared by the verifications a thread takes from the queue at once, for
+ * verifications of type T which can complete part of their work faster for
+ * many of them together. The thread creates one before running its batch of
+ * verifications, and passes their combined result to Finish once they ran,
+ * which may still turn it into a failure. Nothing is shared by default.
+ */
+template <typename T> class CCheckQueueBatch {
+public:
+    bool Finish(bool fOk) { return fOk; }
+};
+
 /**
  * Queue for verifications that have to be performed.
  * The verifications are represented by a type T, which must provide an
@@ -24,6 +39,12 @@ template <typename T> class CCheckQueueControl;
  * queue, where they are processed by N-1 worker threads. When the master is
  * done adding work, it temporarily joins the worker pool as an N'th worker,
  * until all jobs are done.
+ *
+ * By default all the threads share a single queue of verifications. With work
+ * stealing enabled, the master instead spreads the verifications over one
+ * queue per thread. Each thread works from its own queue and only touches the
+ * queue of another thread to steal work once its own queue is empty, so the
+ * threads rarely contend for the same lock.
  */
 template <typename T> class CCheckQueue {
 private:
@@ -59,6 +80,30 @@ private:
     //! The maximum number of elements to be processed in one batch
     unsigned int nBatchSize;
 
+    /** The queue of verifications owned by one thread, in work stealing mode. */
+    struct WorkerQueue {
+        boost::mutex mutex;
+        std::deque<T> checks;
+    };
+
+    //! The per thread queues, empty unless work stealing is enabled. The master
+    //! owns the first one.
+    std::vector<std::unique_ptr<WorkerQueue>> workerQueues;
+
+    //! Number of worker threads which picked one of workerQueues.
+    std::atomic<unsigned int> nWorkerThreads{0};
+
+    //! Queue in which the next call to Add starts spreading verifications.
+    unsigned int nNextQueue{0};
+
+    //! Number of verifications sitting in workerQueues. This may briefly go
+    //! negative, as checks can be taken before Add accounts for them.
+    std::atomic<int> nQueued{0};
+
+    //! Work stealing counterparts of nTodo and fAllOk.
+    std::atomic<unsigned int> nPending{0};
+    std::atomic<bool> fAllOkStealing{true};
+
     /** Internal function that does bulk of the verification work. */
     bool Loop(bool fMaster = false) {
         boost::condition_variable &cond = fMaster ? condMaster : condWorker;
@@ -120,15 +165,101 @@ private:
                 fOk = fAllOk;
             }
             // execute work
+            CCheckQueueBatch<T> batch;
             for (T &check : vChecks) {
                 if (fOk) {
                     fOk = check();
                 }
             }
+            fOk = batch.Finish(fOk);
             vChecks.clear();
         } while (true);
     }
 
+    /**
+     * Move a batch of verifications from the back of our own queue, or, when
+     * stealing, from the front of another thread's queue, into vChecks.
+     */
+    void Take(WorkerQueue &from, std::vector<T> &vChecks, bool fSteal) {
+        boost::unique_lock<boost::mutex> lock(from.mutex);
+        const size_t nAvailable = from.checks.size();
+        if (nAvailable == 0) {
+            return;
+        }
+        // Take half of what is left, so that the remaining work stays spread
+        // between the threads until the very end.
+        const size_t nNow = std::max<size_t>(
+            1, std::min<size_t>(nBatchSize, (nAvailable + 1) / 2));
+        vChecks.resize(nNow);
+        for (size_t i = 0; i < nNow; i++) {
+            if (fSteal) {
+                vChecks[i].swap(from.checks.front());
+                from.checks.pop_front();
+            } else {
+                vChecks[i].swap(from.checks.back());
+                from.checks.pop_back();
+            }
+        }
+        nQueued -= int(nNow);
+    }
+
+    /** Work stealing counterpart of Loop. */
+    bool StealingLoop(size_t nOwnQueue, bool fMaster = false) {
+        std::vector<T> vChecks;
+        vChecks.reserve(nBatchSize);
+        while (true) {
+            Take(*workerQueues[nOwnQueue], vChecks, false);
+            for (size_t i = 1; vChecks.empty() && i < workerQueues.size();
+                 i++) {
+                Take(*workerQueues[(nOwnQueue + i) % workerQueues.size()],
+                     vChecks, true);
+            }
+
+            if (vChecks.empty()) {
+                boost::unique_lock<boost::mutex> lock(mutex);
+                if (fMaster) {
+                    while (nPending > 0 && nQueued <= 0) {
+                        condMaster.wait(lock);
+                    }
+                    if (nPending == 0) {
+                        // reset the status for new work later
+                        return fAllOkStealing.exchange(true);
+                    }
+                } else {
+                    while (nQueued <= 0) {
+                        condWorker.wait(lock);
+                    }
+                }
+                continue;
+            }
+
+            // Once a verification failed, the remaining ones are only
+            // discarded.
+            bool fOk = fAllOkStealing;
+            CCheckQueueBatch<T> batch;
+            for (T &check : vChecks) {
+                if (fOk) {
+                    fOk = check();
+                }
+            }
+            fOk = batch.Finish(fOk);
+            if (!fOk) {
+                fAllOkStealing = false;
+            }
+
+            // Destroy the verifications before reporting them as done, the
+            // master must not return while they are being cleaned up.
+            const unsigned int nNow = vChecks.size();
+            vChecks.clear();
+            if ((nPending -= nNow) == 0 && !fMaster) {
+                // We processed the last element; inform the master it can
+                // exit and return the result
+                boost::unique_lock<boost::mutex> lock(mutex);
+                condMaster.notify_one();
+            }
+        }
+    }
+
 public:
     //! Mutex to ensure only one concurrent CCheckQueueControl
     boost::mutex ControlMutex;
@@ -138,15 +269,44 @@ public:
         : nIdle(0), nTotal(0), fAllOk(true), nTodo(0),
           nBatchSize(nBatchSizeIn) {}
 
+    /**
+     * Switch to work stealing, with one queue of verifications for the master
+     * and one for each of nWorkers worker threads. This must be called before
+     * any thread starts working on the queue. Additional worker threads share
+     * the queues of the first ones.
+     */
+    void EnableWorkStealing(unsigned int nWorkers) {
+        workerQueues.clear();
+        for (unsigned int i = 0; i < nWorkers + 1; i++) {
+            workerQueues.push_back(std::make_unique<WorkerQueue>());
+        }
+    }
+
+    bool IsWorkStealing() const { return !workerQueues.empty(); }
+
     //! Worker thread
-    void Thread() { Loop(); }
+    void Thread() {
+        if (!IsWorkStealing()) {
+            Loop();
+            return;
+        }
+        const size_t nOwnQueue =
+            workerQueues.size() == 1
+                ? 0
+                : 1 + nWorkerThreads++ % (workerQueues.size() - 1);
+        StealingLoop(nOwnQueue);
+    }
 
     //! Wait until execution finishes, and return whether all evaluations were
     //! successful.
-    bool Wait() { return Loop(true); }
+    bool Wait() { return IsWorkStealing() ? StealingLoop(0, true) : Loop(true); }
 
     //! Add a batch of checks to the queue
     void Add(std::vector<T> &vChecks) {
+        if (IsWorkStealing()) {
+            AddStealing(vChecks);
+            return;
+        }
         boost::unique_lock<boost::mutex> lock(mutex);
         for (T &check : vChecks) {
             queue.push_back(T());
@@ -161,6 +321,38 @@ public:
     }
 
     ~CCheckQueue() {}
+
+private:
+    /**
+     * Spread the checks over the per thread queues, in contiguous chunks, so
+     * that every thread starts with some local work.
+     */
+    void AddStealing(std::vector<T> &vChecks) {
+        if (vChecks.empty()) {
+            return;
+        }
+        const size_t nQueues = std::min(workerQueues.size(), vChecks.size());
+        nPending += vChecks.size();
+        size_t nDone = 0;
+        for (size_t i = 0; i < nQueues; i++) {
+            const size_t nEnd = vChecks.size() * (i + 1) / nQueues;
+            WorkerQueue &to = *workerQueues[nNextQueue];
+            nNextQueue = (nNextQueue + 1) % workerQueues.size();
+            boost::unique_lock<boost::mutex> lock(to.mutex);
+            for (; nDone < nEnd; nDone++) {
+                to.checks.emplace_back();
+                vChecks[nDone].swap(to.checks.back());
+            }
+        }
+
+        boost::unique_lock<boost::mutex> lock(mutex);
+        nQueued += int(vChecks.size());
+        if (vChecks.size() == 1) {
+            condWorker.notify_one();
+        } else {
+            condWorker.notify_all();
+        }
+    }
 };
 
 /**
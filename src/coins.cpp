@@ -7,6 +7,7 @@
 #include <consensus/consensus.h>
 #include <memusage.h>
 #include <random.h>
+#include <streams.h>
 #include <version.h>
 
 #include <cassert>
@@ -30,6 +31,15 @@ bool CCoinsView::HaveCoin(const COutPoint &outpoint) const {
     Coin coin;
     return GetCoin(outpoint, coin);
 }
+void CCoinsView::GetCoins(const std::vector<COutPoint> &outpoints,
+                          std::vector<Coin> &coins) const {
+    coins.resize(outpoints.size());
+    for (size_t i = 0; i < outpoints.size(); i++) {
+        if (!GetCoin(outpoints[i], coins[i])) {
+            coins[i].Clear();
+        }
+    }
+}
 
 CCoinsViewBacked::CCoinsViewBacked(CCoinsView *viewIn) : base(viewIn) {}
 bool CCoinsViewBacked::GetCoin(const COutPoint &outpoint, Coin &coin) const {
@@ -58,6 +68,49 @@ size_t CCoinsViewBacked::EstimateSize() const {
     return base->EstimateSize();
 }
 
+uint64_t GetBogoSize(const CScript &scriptPubKey) {
+    return 32 /* txid */ + 4 /* vout index */ + 4 /* height + coinbase */ +
+           8 /* amount */ + 2 /* scriptPubKey len */ +
+           scriptPubKey.size() /* scriptPubKey */;
+}
+
+/**
+ * Serialize a coin as an element of the multiset: its outpoint, followed by its
+ * height and coinbase flag, and its output.
+ */
+static std::vector<uint8_t> SerializeCoin(const COutPoint &outpoint,
+                                          const Coin &coin) {
+    std::vector<uint8_t> data;
+    const uint32_t nHeightAndIsCoinBase =
+        (coin.GetHeight() << 1) | coin.IsCoinBase();
+    CVectorWriter(SER_NETWORK, PROTOCOL_VERSION, data, 0, outpoint,
+                  nHeightAndIsCoinBase, coin.GetTxOut());
+    return data;
+}
+
+void CCoinsCommitment::AddCoin(const COutPoint &outpoint, const Coin &coin) {
+    multiset.Insert(SerializeCoin(outpoint, coin));
+    nTransactionOutputs++;
+    nTotalAmount += coin.GetTxOut().nValue;
+    nBogoSize += ::GetBogoSize(coin.GetTxOut().scriptPubKey);
+}
+
+void CCoinsCommitment::RemoveCoin(const COutPoint &outpoint,
+                                  const Coin &coin) {
+    multiset.Remove(SerializeCoin(outpoint, coin));
+    nTransactionOutputs--;
+    nTotalAmount -= coin.GetTxOut().nValue;
+    nBogoSize -= ::GetBogoSize(coin.GetTxOut().scriptPubKey);
+}
+
+CCoinsCommitment &CCoinsCommitment::operator+=(const CCoinsCommitment &other) {
+    multiset += other.multiset;
+    nTransactionOutputs += other.nTransactionOutputs;
+    nTotalAmount += other.nTotalAmount;
+    nBogoSize += other.nBogoSize;
+    return *this;
+}
+
 SaltedOutpointHasher::SaltedOutpointHasher()
     : k0(GetRand(std::numeric_limits<uint64_t>::max())),
       k1(GetRand(std::numeric_limits<uint64_t>::max())) {}
@@ -73,8 +126,10 @@ CCoinsMap::iterator
 CCoinsViewCache::FetchCoin(const COutPoint &outpoint) const {
     CCoinsMap::iterator it = cacheCoins.find(outpoint);
     if (it != cacheCoins.end()) {
+        stats.nHits++;
         return it;
     }
+    stats.nMisses++;
     Coin tmp;
     if (!base->GetCoin(outpoint, tmp)) {
         return cacheCoins.end();
@@ -102,12 +157,54 @@ bool CCoinsViewCache::GetCoin(const COutPoint &outpoint, Coin &coin) const {
     return !coin.IsSpent();
 }
 
+void CCoinsViewCache::GetCoins(const std::vector<COutPoint> &outpoints,
+                               std::vector<Coin> &coins) const {
+    PrefetchCoins(outpoints);
+    CCoinsView::GetCoins(outpoints, coins);
+}
+
+void CCoinsViewCache::PrefetchCoins(
+    const std::vector<COutPoint> &outpoints) const {
+    std::vector<COutPoint> missing;
+    for (const COutPoint &outpoint : outpoints) {
+        if (cacheCoins.count(outpoint) == 0) {
+            missing.push_back(outpoint);
+        }
+    }
+    stats.nPrefetchHits += outpoints.size() - missing.size();
+    stats.nPrefetchMisses += missing.size();
+    if (missing.empty()) {
+        return;
+    }
+
+    std::vector<Coin> coins;
+    base->GetCoins(missing, coins);
+    for (size_t i = 0; i < missing.size(); i++) {
+        if (coins[i].IsSpent()) {
+            continue;
+        }
+        CCoinsMap::iterator it;
+        bool inserted;
+        std::tie(it, inserted) = cacheCoins.emplace(
+            std::piecewise_construct, std::forward_as_tuple(missing[i]),
+            std::forward_as_tuple(std::move(coins[i])));
+        if (inserted) {
+            cachedCoinsUsage += it->second.coin.DynamicMemoryUsage();
+        }
+    }
+}
+
 void CCoinsViewCache::AddCoin(const COutPoint &outpoint, Coin coin,
                               bool possible_overwrite) {
     assert(!coin.IsSpent());
     if (coin.GetTxOut().scriptPubKey.IsUnspendable()) {
         return;
     }
+    if (pcommitment && possible_overwrite) {
+        // Make sure the coin being overwritten, if any, is loaded so that it
+        // can be removed from the commitment.
+        FetchCoin(outpoint);
+    }
     CCoinsMap::iterator it;
     bool inserted;
     std::tie(it, inserted) =
@@ -124,6 +221,12 @@ void CCoinsViewCache::AddCoin(const COutPoint &outpoint, Coin coin,
         }
         fresh = !(it->second.flags & CCoinsCacheEntry::DIRTY);
     }
+    if (pcommitment) {
+        if (!it->second.coin.IsSpent()) {
+            pcommitment->RemoveCoin(outpoint, it->second.coin);
+        }
+        pcommitment->AddCoin(outpoint, coin);
+    }
     it->second.coin = std::move(coin);
     it->second.flags |=
         CCoinsCacheEntry::DIRTY | (fresh ? CCoinsCacheEntry::FRESH : 0);
@@ -151,6 +254,9 @@ bool CCoinsViewCache::SpendCoin(const COutPoint &outpoint, Coin *moveout) {
         return false;
     }
     cachedCoinsUsage -= it->second.coin.DynamicMemoryUsage();
+    if (pcommitment && !it->second.coin.IsSpent()) {
+        pcommitment->RemoveCoin(outpoint, it->second.coin);
+    }
     if (moveout) {
         *moveout = std::move(it->second.coin);
     }
@@ -6,15 +6,17 @@
 #ifndef BITCOIN_COINS_H
 #define BITCOIN_COINS_H
 
+#include <amount.h>
 #include <compressor.h>
 #include <crypto/siphash.h>
+#include <ecmultiset.h>
+#include <flathashmap.h>
 #include <memusage.h>
 #include <primitives/blockhash.h>
 #include <serialize.h>
 
 #include <cassert>
 #include <cstdint>
-#include <unordered_map>
 
 /**
  * A UTXO entry.
@@ -71,7 +73,7 @@ public:
 class SaltedOutpointHasher {
 private:
     /** Salt */
-    const uint64_t k0, k1;
+    uint64_t k0, k1;
 
 public:
     SaltedOutpointHasher();
@@ -111,7 +113,7 @@ struct CCoinsCacheEntry {
         : coin(std::move(coinIn)), flags(0) {}
 };
 
-typedef std::unordered_map<COutPoint, CCoinsCacheEntry, SaltedOutpointHasher>
+typedef FlatHashMap<COutPoint, CCoinsCacheEntry, SaltedOutpointHasher>
     CCoinsMap;
 
 /** Cursor for iterating over CoinsView state */
@@ -147,6 +149,15 @@ public:
     //! Just check whether a given outpoint is unspent.
     virtual bool HaveCoin(const COutPoint &outpoint) const;
 
+    /**
+     * Retrieve the Coins for several outpoints at once, as GetCoin would.
+     * coins is resized to match outpoints, and coins[i] is left spent when no
+     * unspent coin was found for outpoints[i]. Views which are able to look
+     * the coins up concurrently override this.
+     */
+    virtual void GetCoins(const std::vector<COutPoint> &outpoints,
+                          std::vector<Coin> &coins) const;
+
     //! Retrieve the block hash whose state this CCoinsView currently represents
     virtual BlockHash GetBestBlock() const;
 
@@ -188,6 +199,57 @@ public:
     size_t EstimateSize() const override;
 };
 
+/** Counters of the lookups done through a CCoinsViewCache. */
+struct CCoinsCacheStats {
+    //! Lookups answered from the cache.
+    uint64_t nHits = 0;
+    //! Lookups that had to be forwarded to the backing view.
+    uint64_t nMisses = 0;
+    //! Outpoints passed to PrefetchCoins which were already cached.
+    uint64_t nPrefetchHits = 0;
+    //! Outpoints which PrefetchCoins looked up in the backing view.
+    uint64_t nPrefetchMisses = 0;
+};
+
+//! Size of a coin as counted by the database-independent bogosize metric.
+uint64_t GetBogoSize(const CScript &scriptPubKey);
+
+/**
+ * Commitment to a set of coins: an EC multiset hash of the coins along with
+ * their number, total amount and bogosize. It is updated as coins are added to
+ * and spent from the set, and the commitments to two sets of changes can be
+ * combined, so that it never needs to be recomputed from the whole set.
+ */
+class CCoinsCommitment {
+private:
+    ECMultiSet multiset;
+    //! Signed, as a set of changes may spend more coins than it adds.
+    int64_t nTransactionOutputs = 0;
+    Amount nTotalAmount = Amount::zero();
+    int64_t nBogoSize = 0;
+
+public:
+    void AddCoin(const COutPoint &outpoint, const Coin &coin);
+    void RemoveCoin(const COutPoint &outpoint, const Coin &coin);
+
+    CCoinsCommitment &operator+=(const CCoinsCommitment &other);
+
+    uint256 GetHash() const { return multiset.GetHash(); }
+    int64_t GetTransactionOutputs() const { return nTransactionOutputs; }
+    Amount GetTotalAmount() const { return nTotalAmount; }
+    int64_t GetBogoSize() const { return nBogoSize; }
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream &s, Operation ser_action) {
+        READWRITE(multiset);
+        READWRITE(nTransactionOutputs);
+        READWRITE(nTotalAmount);
+        READWRITE(nBogoSize);
+    }
+};
+
 /**
  * CCoinsView that adds a memory cache for transactions to another CCoinsView
  */
@@ -203,6 +265,11 @@ protected:
     /* Cached dynamic memory usage for the inner Coin objects. */
     mutable size_t cachedCoinsUsage;
 
+    mutable CCoinsCacheStats stats;
+
+    /* Commitment recording the coins added to and spent from this cache. */
+    CCoinsCommitment *pcommitment = nullptr;
+
 public:
     CCoinsViewCache(CCoinsView *baseIn);
 
@@ -215,6 +282,8 @@ public:
     // Standard CCoinsView methods
     bool GetCoin(const COutPoint &outpoint, Coin &coin) const override;
     bool HaveCoin(const COutPoint &outpoint) const override;
+    void GetCoins(const std::vector<COutPoint> &outpoints,
+                  std::vector<Coin> &coins) const override;
     BlockHash GetBestBlock() const override;
     void SetBestBlock(const BlockHash &hashBlock);
     bool BatchWrite(CCoinsMap &mapCoins, const BlockHash &hashBlock) override;
@@ -230,6 +299,13 @@ public:
      */
     bool HaveCoinInCache(const COutPoint &outpoint) const;
 
+    /**
+     * Load the coins of the given outpoints into the cache, with a single
+     * GetCoins call on the backing view for those which are not cached yet.
+     * Outpoints without an unspent coin are ignored.
+     */
+    void PrefetchCoins(const std::vector<COutPoint> &outpoints) const;
+
     /**
      * Return a reference to Coin in the cache, or a pruned one if not found.
      * This is more efficient than GetCoin.
@@ -256,6 +332,14 @@ public:
      */
     bool SpendCoin(const COutPoint &outpoint, Coin *moveto = nullptr);
 
+    /**
+     * Record the coins added to and spent from this cache, from now on, in the
+     * given commitment. Pass nullptr to stop recording them.
+     */
+    void TrackChanges(CCoinsCommitment *pcommitmentIn) {
+        pcommitment = pcommitmentIn;
+    }
+
     /**
      * Push the modifications applied to this cache to its base.
      * Failure to call this method before destruction will cause the changes to
@@ -273,6 +357,9 @@ public:
     //! Calculate the size of the cache (in number of transaction outputs)
     unsigned int GetCacheSize() const;
 
+    //! Get the lookup counters of this cache
+    const CCoinsCacheStats &GetStats() const { return stats; }
+
     //! Calculate the size of the cache (in bytes)
     size_t DynamicMemoryUsage() const;
 
@@ -82,6 +82,18 @@ typedef void *sockopt_arg_type;
 typedef char *sockopt_arg_type;
 #endif
 
+// poll() waits on single sockets without the FD_SETSIZE limit of select(). It
+// is only used where it is known to behave; WIN32 and macOS poll() are not.
+#if defined(__linux__)
+#define USE_POLL
+#endif
+
+// epoll lets the socket handler track thousands of peers, see -socketevents.
+#if defined(__linux__) && defined(HAVE_SYS_EPOLL_H)
+#define USE_EPOLL
+#endif
+
+/** Whether the socket can be added to an fd_set and waited on by select(). */
 static bool inline IsSelectableSocket(const SOCKET &s) {
 #ifdef WIN32
     return true;
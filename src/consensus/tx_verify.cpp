@@ -153,20 +153,13 @@ bool SequenceLocks(const CTransaction &tx, int flags,
 }
 
 namespace Consensus {
-bool CheckTxInputs(const CTransaction &tx, CValidationState &state,
-                   const CCoinsViewCache &inputs, int nSpendHeight,
-                   Amount &txfee) {
-    // are the actual inputs available?
-    if (!inputs.HaveInputs(tx)) {
-        return state.DoS(100, false, REJECT_INVALID,
-                         "bad-txns-inputs-missingorspent", false,
-                         strprintf("%s: inputs missing/spent", __func__));
-    }
-
+template <typename CoinAccessor>
+static bool CheckTxInputCoins(const CTransaction &tx, CValidationState &state,
+                              const CoinAccessor &getCoin, int nSpendHeight,
+                              Amount &txfee) {
     Amount nValueIn = Amount::zero();
-    for (const auto &in : tx.vin) {
-        const COutPoint &prevout = in.prevout;
-        const Coin &coin = inputs.AccessCoin(prevout);
+    for (size_t i = 0; i < tx.vin.size(); i++) {
+        const Coin &coin = getCoin(i);
         assert(!coin.IsSpent());
 
         // If prev is coinbase, check that it's matured
@@ -203,4 +196,31 @@ bool CheckTxInputs(const CTransaction &tx, CValidationState &state,
     txfee = txfee_aux;
     return true;
 }
+
+bool CheckTxInputs(const CTransaction &tx, CValidationState &state,
+                   const CCoinsViewCache &inputs, int nSpendHeight,
+                   Amount &txfee) {
+    // are the actual inputs available?
+    if (!inputs.HaveInputs(tx)) {
+        return state.DoS(100, false, REJECT_INVALID,
+                         "bad-txns-inputs-missingorspent", false,
+                         strprintf("%s: inputs missing/spent", __func__));
+    }
+
+    return CheckTxInputCoins(
+        tx, state,
+        [&](size_t i) -> const Coin & {
+            return inputs.AccessCoin(tx.vin[i].prevout);
+        },
+        nSpendHeight, txfee);
+}
+
+bool CheckTxInputs(const CTransaction &tx, CValidationState &state,
+                   const std::vector<Coin> &spentCoins, int nSpendHeight,
+                   Amount &txfee) {
+    assert(spentCoins.size() == tx.vin.size());
+    return CheckTxInputCoins(
+        tx, state, [&](size_t i) -> const Coin & { return spentCoins[i]; },
+        nSpendHeight, txfee);
+}
 } // namespace Consensus
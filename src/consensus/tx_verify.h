@@ -11,6 +11,7 @@
 struct Amount;
 class CBlockIndex;
 class CCoinsViewCache;
+class Coin;
 class CTransaction;
 class CValidationState;
 
@@ -28,6 +29,16 @@ bool CheckTxInputs(const CTransaction &tx, CValidationState &state,
                    const CCoinsViewCache &inputs, int nSpendHeight,
                    Amount &txfee);
 
+/**
+ * Same as above, but checks the inputs against the coins they spend, as
+ * recorded in the undo data of the transaction, rather than against a view.
+ * spentCoins[i] must be the coin spent by tx.vin[i].
+ * Preconditions: tx.IsCoinBase() is false.
+ */
+bool CheckTxInputs(const CTransaction &tx, CValidationState &state,
+                   const std::vector<Coin> &spentCoins, int nSpendHeight,
+                   Amount &txfee);
+
 } // namespace Consensus
 
 /**
@@ -20,6 +20,7 @@ class CMutableTransaction;
 class Config;
 class CScript;
 class CTransaction;
+class JSONWriter;
 struct PartiallySignedTransaction;
 class uint160;
 class uint256;
@@ -64,5 +65,8 @@ UniValue::Object ScriptPubKeyToUniv(const Config &config, const CScript &scriptP
 UniValue::Object ScriptToUniv(const Config &config, const CScript &script, bool include_address);
 UniValue::Object TxToUniv(const Config &config, const CTransaction &tx, const uint256 &hashBlock, bool include_hex = true,
                           int serialize_flags = 0);
+/** Write the same JSON as TxToUniv, without building the UniValue objects */
+void WriteTxJSON(JSONWriter &writer, const Config &config, const CTransaction &tx, const uint256 &hashBlock,
+                 bool include_hex = true, int serialize_flags = 0);
 
 #endif // BITCOIN_CORE_IO_H
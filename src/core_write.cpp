@@ -13,6 +13,7 @@
 #include <script/standard.h>
 #include <serialize.h>
 #include <streams.h>
+#include <util/jsonwriter.h>
 #include <util/moneystr.h>
 #include <util/strencodings.h>
 #include <util/system.h>
@@ -288,3 +289,54 @@ UniValue::Object TxToUniv(const Config &config, const CTransaction &tx, const ui
 
     return entry;
 }
+
+void WriteTxJSON(JSONWriter &writer, const Config &config, const CTransaction &tx, const uint256 &hashBlock,
+                 bool include_hex, int serialize_flags) {
+    writer.BeginObject();
+    writer.KeyValue("txid", tx.GetId().GetHex());
+    writer.KeyValue("hash", tx.GetHash().GetHex());
+    writer.KeyValue("version", tx.nVersion);
+    writer.KeyValue("size", ::GetSerializeSize(tx, PROTOCOL_VERSION));
+    writer.KeyValue("locktime", tx.nLockTime);
+
+    writer.Key("vin");
+    writer.BeginArray();
+    for (const CTxIn &txin : tx.vin) {
+        writer.BeginObject();
+        if (tx.IsCoinBase()) {
+            writer.KeyValue("coinbase", HexStr(txin.scriptSig.begin(), txin.scriptSig.end()));
+        } else {
+            writer.KeyValue("txid", txin.prevout.GetTxId().GetHex());
+            writer.KeyValue("vout", txin.prevout.GetN());
+            writer.Key("scriptSig");
+            writer.BeginObject();
+            writer.KeyValue("asm", ScriptToAsmStr(txin.scriptSig, true));
+            writer.KeyValue("hex", HexStr(txin.scriptSig.begin(), txin.scriptSig.end()));
+            writer.EndObject();
+        }
+        writer.KeyValue("sequence", txin.nSequence);
+        writer.EndObject();
+    }
+    writer.EndArray();
+
+    writer.Key("vout");
+    writer.BeginArray();
+    for (size_t i = 0; i < tx.vout.size(); i++) {
+        const CTxOut &txout = tx.vout[i];
+        writer.BeginObject();
+        writer.KeyValue("value", ValueFromAmount(txout.nValue));
+        writer.KeyValue("n", i);
+        writer.KeyValue("scriptPubKey", ScriptPubKeyToUniv(config, txout.scriptPubKey, true));
+        writer.EndObject();
+    }
+    writer.EndArray();
+
+    if (!hashBlock.IsNull()) {
+        writer.KeyValue("blockhash", hashBlock.GetHex());
+    }
+
+    if (include_hex) {
+        writer.KeyValue("hex", EncodeHexTx(tx, serialize_flags));
+    }
+    writer.EndObject();
+}
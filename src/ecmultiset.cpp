@@ -0,0 +1,54 @@
+// Copyright (c) 2020 The Bitcoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <ecmultiset.h>
+
+#include <secp256k1.h>
+
+#include <algorithm>
+#include <cassert>
+
+// The multiset operations only use the context to report illegal arguments,
+// so no precomputed tables are needed.
+
+ECMultiSet::ECMultiSet() {
+    int ret = secp256k1_multiset_init(secp256k1_context_no_precomp, &m_set);
+    assert(ret);
+}
+
+ECMultiSet &ECMultiSet::Insert(const std::vector<uint8_t> &data) {
+    int ret = secp256k1_multiset_add(secp256k1_context_no_precomp, &m_set,
+                                     data.data(), data.size());
+    assert(ret);
+    return *this;
+}
+
+ECMultiSet &ECMultiSet::Remove(const std::vector<uint8_t> &data) {
+    int ret = secp256k1_multiset_remove(secp256k1_context_no_precomp, &m_set,
+                                        data.data(), data.size());
+    assert(ret);
+    return *this;
+}
+
+ECMultiSet &ECMultiSet::operator+=(const ECMultiSet &other) {
+    int ret = secp256k1_multiset_combine(secp256k1_context_no_precomp, &m_set,
+                                         &other.m_set);
+    assert(ret);
+    return *this;
+}
+
+bool ECMultiSet::IsEmpty() const {
+    // The empty multiset is the point at infinity, which is stored with a null
+    // Z coordinate.
+    return std::all_of(m_set.d + 64, m_set.d + 96,
+                       [](uint8_t b) { return b == 0; });
+}
+
+uint256 ECMultiSet::GetHash() const {
+    uint256 hash;
+    int ret = secp256k1_multiset_finalize(secp256k1_context_no_precomp,
+                                          hash.begin(), &m_set);
+    assert(ret);
+    return hash;
+}
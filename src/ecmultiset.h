@@ -0,0 +1,56 @@
+// Copyright (c) 2020 The Bitcoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_ECMULTISET_H
+#define BITCOIN_ECMULTISET_H
+
+#include <serialize.h>
+#include <uint256.h>
+
+#include <secp256k1_multiset.h>
+
+#include <cstdint>
+#include <vector>
+
+/**
+ * Elliptic curve multiset hash (ECMH), as implemented by the multiset module
+ * of libsecp256k1.
+ *
+ * Each element is hashed to a point of the curve, and the set is represented
+ * by the sum of these points. Elements can therefore be added and removed in
+ * any order, and two sets can be combined, without recomputing the hash of
+ * the whole set.
+ */
+class ECMultiSet {
+private:
+    secp256k1_multiset m_set;
+
+public:
+    /** Construct the multiset of no element. */
+    ECMultiSet();
+
+    /** Add an element to the multiset. */
+    ECMultiSet &Insert(const std::vector<uint8_t> &data);
+
+    /** Remove an element from the multiset. */
+    ECMultiSet &Remove(const std::vector<uint8_t> &data);
+
+    /** Add all the elements of another multiset to this one. */
+    ECMultiSet &operator+=(const ECMultiSet &other);
+
+    /** Whether the multiset has no element. */
+    bool IsEmpty() const;
+
+    /** The hash of the multiset, which is null for the empty multiset. */
+    uint256 GetHash() const;
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream &s, Operation ser_action) {
+        READWRITE(m_set.d);
+    }
+};
+
+#endif // BITCOIN_ECMULTISET_H
@@ -5,10 +5,98 @@
 
 #include <flatfile.h>
 #include <logging.h>
+#include <sync.h>
 #include <tinyformat.h>
 #include <util/system.h>
 
+#include <list>
 #include <stdexcept>
+#include <utility>
+
+#ifndef WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+/**
+ * The files mapped by FlatFileSeq::Map, most recently used first. Sequences
+ * are created on the fly, so mappings are shared by all of them and keyed by
+ * path.
+ */
+class MappedFileCache {
+private:
+    using Entry = std::pair<std::string, std::shared_ptr<const MappedFile>>;
+
+    Mutex m_mutex;
+    std::list<Entry> m_files GUARDED_BY(m_mutex);
+    size_t m_max_files GUARDED_BY(m_mutex) = DEFAULT_MAX_MAPPED_FILES;
+
+public:
+    std::shared_ptr<const MappedFile> Get(const std::string &path,
+                                          size_t min_size) {
+        LOCK(m_mutex);
+        for (auto it = m_files.begin(); it != m_files.end(); ++it) {
+            if (it->first != path) {
+                continue;
+            }
+            if (it->second->Data().size() < min_size) {
+                // The file grew since it was mapped
+                m_files.erase(it);
+                return nullptr;
+            }
+            m_files.splice(m_files.begin(), m_files, it);
+            return it->second;
+        }
+        return nullptr;
+    }
+
+    void Insert(const std::string &path,
+                std::shared_ptr<const MappedFile> file) {
+        LOCK(m_mutex);
+        for (auto it = m_files.begin(); it != m_files.end(); ++it) {
+            if (it->first == path) {
+                m_files.erase(it);
+                break;
+            }
+        }
+        m_files.emplace_front(path, std::move(file));
+        while (m_files.size() > m_max_files) {
+            // Readers still holding the mapping keep it alive
+            m_files.pop_back();
+        }
+    }
+
+    void Erase(const std::string &path) {
+        LOCK(m_mutex);
+        m_files.remove_if(
+            [&path](const Entry &entry) { return entry.first == path; });
+    }
+
+    size_t GetMaxFiles() {
+        LOCK(m_mutex);
+        return m_max_files;
+    }
+
+    void SetMaxFiles(size_t max_files) {
+        LOCK(m_mutex);
+        m_max_files = max_files;
+        while (m_files.size() > m_max_files) {
+            m_files.pop_back();
+        }
+    }
+};
+
+MappedFileCache g_mapped_files;
+} // namespace
+
+MappedFile::~MappedFile() {
+#ifndef WIN32
+    munmap(const_cast<uint8_t *>(m_data), m_size);
+#endif
+}
 
 FlatFileSeq::FlatFileSeq(fs::path dir, const char *prefix, size_t chunk_size)
     : m_dir(std::move(dir)), m_prefix(prefix), m_chunk_size(chunk_size) {
@@ -88,6 +176,10 @@ bool FlatFileSeq::Flush(const FlatFilePos &pos, bool finalize) {
         fclose(file);
         return error("%s: failed to truncate file %d", __func__, pos.nFile);
     }
+    if (finalize) {
+        // Never read past the new end through an older mapping
+        Unmap(pos);
+    }
     if (!FileCommit(file)) {
         fclose(file);
         return error("%s: failed to commit file %d", __func__, pos.nFile);
@@ -96,3 +188,48 @@ bool FlatFileSeq::Flush(const FlatFilePos &pos, bool finalize) {
     fclose(file);
     return true;
 }
+
+std::shared_ptr<const MappedFile> FlatFileSeq::Map(const FlatFilePos &pos,
+                                                   size_t size) {
+#ifdef WIN32
+    return nullptr;
+#else
+    if (pos.IsNull() || g_mapped_files.GetMaxFiles() == 0) {
+        return nullptr;
+    }
+    const size_t end = size_t(pos.nPos) + size;
+    const std::string path = FileName(pos).string();
+    std::shared_ptr<const MappedFile> file = g_mapped_files.Get(path, end);
+    if (file) {
+        return file;
+    }
+
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd == -1) {
+        return nullptr;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size <= 0 || size_t(st.st_size) < end) {
+        close(fd);
+        return nullptr;
+    }
+    void *data = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        LogPrintf("Unable to map file %s\n", path);
+        return nullptr;
+    }
+    file = std::make_shared<const MappedFile>(static_cast<uint8_t *>(data),
+                                              st.st_size);
+    g_mapped_files.Insert(path, file);
+    return file;
+#endif
+}
+
+void FlatFileSeq::Unmap(const FlatFilePos &pos) {
+    g_mapped_files.Erase(FileName(pos).string());
+}
+
+void FlatFileSeq::SetMaxMappedFiles(size_t max_files) {
+    g_mapped_files.SetMaxFiles(max_files);
+}
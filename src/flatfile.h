@@ -8,7 +8,10 @@
 
 #include <fs.h>
 #include <serialize.h>
+#include <span.h>
 
+#include <cstdint>
+#include <memory>
 #include <string>
 
 struct FlatFilePos {
@@ -45,6 +48,29 @@ struct FlatFilePos {
     std::string ToString() const;
 };
 
+/**
+ * Default number of files mapped by FlatFileSeq::Map at once, only mapped on
+ * 64 bit systems where address space is plentiful.
+ */
+static constexpr size_t DEFAULT_MAX_MAPPED_FILES = sizeof(void *) >= 8 ? 64 : 0;
+
+/** A read-only memory mapping of a whole file, unmapped on destruction. */
+class MappedFile {
+private:
+    const uint8_t *m_data;
+    size_t m_size;
+
+public:
+    MappedFile(const uint8_t *data, size_t size)
+        : m_data(data), m_size(size) {}
+    ~MappedFile();
+
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    Span<const uint8_t> Data() const { return {m_data, m_size}; }
+};
+
 /**
  * FlatFileSeq represents a sequence of numbered files storing raw data. This
  * class facilitates access to and efficient management of these files.
@@ -72,6 +98,24 @@ public:
     /** Open a handle to the file at the given position. */
     FILE *Open(const FlatFilePos &pos, bool read_only = false);
 
+    /**
+     * Map the file at the given position read-only, to read size bytes from
+     * the position without any system call once mapped. Mappings are kept in
+     * a cache shared by all sequences, bounded by SetMaxMappedFiles, and
+     * remapped when the file grew past them.
+     *
+     * @return The mapping of the whole file, or nullptr if the range is not
+     * in the file or files are not mapped, in which case Open should be used.
+     */
+    std::shared_ptr<const MappedFile> Map(const FlatFilePos &pos, size_t size);
+
+    /** Drop the mapping of the file at the given position, before removing
+     * it. */
+    void Unmap(const FlatFilePos &pos);
+
+    /** Set how many files may be mapped at once, 0 disables mapping. */
+    static void SetMaxMappedFiles(size_t max_files);
+
     /**
      * Allocate additional space in a file after the given starting position.
      * The amount allocated will be the minimum multiple of the sequence chunk
@@ -0,0 +1,378 @@
+// Copyright (c) 2020 The Bitcoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_FLATHASHMAP_H
+#define BITCOIN_FLATHASHMAP_H
+
+#include <crypto/common.h>
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <new>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+/**
+ * Hash map using open addressing, as a replacement for std::unordered_map on
+ * large maps of small entries.
+ *
+ * Lookups linearly probe a flat table of 8 byte slots, each holding a 32 bit
+ * tag derived from the hash of the key and the index of the entry, so that
+ * mismatching keys are mostly skipped without touching the entry. The entries
+ * themselves live in a pool of chunks, which grow geometrically up to a fixed
+ * size, replacing the per entry allocation of std::unordered_map. Entries never
+ * move: pointers and references to them stay valid until they are erased, as
+ * with std::unordered_map. Iterators are invalidated by insertions, but not by
+ * the erasure of other entries.
+ *
+ * Only the subset of the std::unordered_map interface needed by its users is
+ * provided.
+ */
+template <typename K, typename T, typename Hash = std::hash<K>,
+          typename KeyEqual = std::equal_to<K>>
+class FlatHashMap {
+public:
+    typedef K key_type;
+    typedef T mapped_type;
+    typedef std::pair<const K, T> value_type;
+    typedef size_t size_type;
+
+private:
+    //! Slot values which do not refer to an entry. Slots referring to entry id
+    //! store id + 2 in their low 32 bits.
+    static constexpr uint64_t EMPTY = 0;
+    static constexpr uint64_t DELETED = 1;
+    //! No free entry.
+    static constexpr uint32_t NO_ENTRY = std::numeric_limits<uint32_t>::max();
+    //! Number of entries in each of the first two chunks. The following ones
+    //! double in size, up to MAX_CHUNK_SIZE entries.
+    static constexpr size_t FIRST_CHUNK_SIZE = 16;
+    static constexpr size_t MAX_CHUNK_SIZE = 1024;
+    //! Index of the first chunk of MAX_CHUNK_SIZE entries. The chunks before
+    //! it hold MAX_CHUNK_SIZE entries in total.
+    static constexpr size_t FIRST_FULL_CHUNK = 7;
+    static_assert(FIRST_CHUNK_SIZE << (FIRST_FULL_CHUNK - 1) == MAX_CHUNK_SIZE,
+                  "chunk sizes must double up to MAX_CHUNK_SIZE");
+
+    typedef typename std::aligned_storage<sizeof(value_type),
+                                          alignof(value_type)>::type Storage;
+    static_assert(sizeof(Storage) >= sizeof(uint32_t),
+                  "freed entries must be able to hold a free list link");
+
+    //! The open addressing table, its size is zero or a power of two.
+    std::vector<uint64_t> table;
+    //! The pool of entries, the entry ids growing across chunks.
+    std::vector<std::unique_ptr<Storage[]>> chunks;
+    //! Whether each entry id holds a value.
+    std::vector<bool> live;
+    //! First entry of the list of erased entries, linked through their storage.
+    uint32_t freeHead = NO_ENTRY;
+    //! Number of entries.
+    size_t nSize = 0;
+    //! Number of slots which are not EMPTY, including DELETED ones.
+    size_t nUsedSlots = 0;
+
+    Hash hasher;
+    KeyEqual keyEqual;
+
+    static uint32_t Tag(size_t hash) {
+        return uint32_t((uint64_t(hash) * 0x9e3779b97f4a7c15ULL) >> 32);
+    }
+    static uint64_t MakeSlot(uint32_t tag, uint32_t id) {
+        return (uint64_t(tag) << 32) | (uint64_t(id) + 2);
+    }
+    static uint32_t SlotId(uint64_t slot) { return uint32_t(slot) - 2; }
+
+    static size_t ChunkOf(uint32_t id) {
+        if (id >= MAX_CHUNK_SIZE) {
+            return FIRST_FULL_CHUNK - 1 + id / MAX_CHUNK_SIZE;
+        }
+        return id < FIRST_CHUNK_SIZE ? 0 : CountBits(id / FIRST_CHUNK_SIZE);
+    }
+    static size_t ChunkStart(size_t chunk) {
+        if (chunk >= FIRST_FULL_CHUNK) {
+            return (chunk + 1 - FIRST_FULL_CHUNK) * MAX_CHUNK_SIZE;
+        }
+        return chunk == 0 ? 0 : FIRST_CHUNK_SIZE << (chunk - 1);
+    }
+
+    Storage *RawEntry(uint32_t id) const {
+        const size_t chunk = ChunkOf(id);
+        return &chunks[chunk][id - ChunkStart(chunk)];
+    }
+    value_type *Entry(uint32_t id) const {
+        return std::launder(reinterpret_cast<value_type *>(RawEntry(id)));
+    }
+    uint32_t &FreeLink(uint32_t id) const {
+        return *reinterpret_cast<uint32_t *>(RawEntry(id));
+    }
+
+    uint32_t NextLive(uint32_t id) const {
+        while (id < live.size() && !live[id]) {
+            id++;
+        }
+        return id;
+    }
+
+    //! Get storage for a new entry, reusing erased entries first.
+    uint32_t AllocateEntry() {
+        if (freeHead != NO_ENTRY) {
+            const uint32_t id = freeHead;
+            freeHead = FreeLink(id);
+            return id;
+        }
+        assert(live.size() < NO_ENTRY - 2);
+        const uint32_t id = live.size();
+        if (id == ChunkStart(chunks.size())) {
+            chunks.emplace_back(new Storage[chunk_size(chunks.size())]);
+        }
+        live.push_back(false);
+        return id;
+    }
+    void FreeEntry(uint32_t id) {
+        FreeLink(id) = freeHead;
+        freeHead = id;
+    }
+
+    /**
+     * Look key up. Return whether it was found, with pos set to its slot, or
+     * to the slot where it should be inserted otherwise. The table must not be
+     * empty.
+     */
+    bool Lookup(const K &key, size_t hash, size_t &pos) const {
+        const size_t mask = table.size() - 1;
+        const uint32_t tag = Tag(hash);
+        size_t insertPos = table.size();
+        for (size_t i = hash & mask;; i = (i + 1) & mask) {
+            const uint64_t slot = table[i];
+            if (slot == EMPTY) {
+                pos = insertPos < table.size() ? insertPos : i;
+                return false;
+            }
+            if (slot == DELETED) {
+                if (insertPos == table.size()) {
+                    insertPos = i;
+                }
+            } else if (uint32_t(slot >> 32) == tag &&
+                       keyEqual(Entry(SlotId(slot))->first, key)) {
+                pos = i;
+                return true;
+            }
+        }
+    }
+
+    //! Rebuild the table with nSlots slots, dropping DELETED ones.
+    void Rehash(size_t nSlots) {
+        std::vector<uint64_t>(nSlots, EMPTY).swap(table);
+        const size_t mask = nSlots - 1;
+        for (uint32_t id = NextLive(0); id < live.size();
+             id = NextLive(id + 1)) {
+            const size_t hash = hasher(Entry(id)->first);
+            size_t i = hash & mask;
+            while (table[i] != EMPTY) {
+                i = (i + 1) & mask;
+            }
+            table[i] = MakeSlot(Tag(hash), id);
+        }
+        nUsedSlots = nSize;
+    }
+
+    //! Make room for one more slot, keeping the table at most 3/4 used.
+    void Reserve() {
+        if ((nUsedSlots + 1) * 4 <= table.size() * 3) {
+            return;
+        }
+        size_t nSlots = std::max<size_t>(table.size(), FIRST_CHUNK_SIZE);
+        while ((nSize + 1) * 2 > nSlots) {
+            nSlots *= 2;
+        }
+        Rehash(nSlots);
+    }
+
+    template <bool Const> class Iterator {
+    private:
+        typedef typename std::conditional<Const, const FlatHashMap,
+                                          FlatHashMap>::type Map;
+        Map *map;
+        uint32_t id;
+
+        Iterator(Map *mapIn, uint32_t idIn) : map(mapIn), id(idIn) {}
+
+        friend class FlatHashMap;
+        friend class Iterator<!Const>;
+
+    public:
+        typedef std::forward_iterator_tag iterator_category;
+        typedef typename std::conditional<
+            Const, const typename FlatHashMap::value_type,
+            typename FlatHashMap::value_type>::type value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef value_type *pointer;
+        typedef value_type &reference;
+
+        Iterator() : map(nullptr), id(0) {}
+        template <bool C = Const, typename = std::enable_if_t<C>>
+        Iterator(const Iterator<false> &other)
+            : map(other.map), id(other.id) {}
+
+        reference operator*() const { return *map->Entry(id); }
+        pointer operator->() const { return map->Entry(id); }
+        Iterator &operator++() {
+            id = map->NextLive(id + 1);
+            return *this;
+        }
+        Iterator operator++(int) {
+            Iterator ret = *this;
+            ++*this;
+            return ret;
+        }
+        friend bool operator==(const Iterator &a, const Iterator &b) {
+            return a.id == b.id;
+        }
+        friend bool operator!=(const Iterator &a, const Iterator &b) {
+            return a.id != b.id;
+        }
+    };
+
+public:
+    typedef Iterator<false> iterator;
+    typedef Iterator<true> const_iterator;
+
+    FlatHashMap() {}
+    FlatHashMap(const FlatHashMap &) = delete;
+    FlatHashMap &operator=(const FlatHashMap &) = delete;
+    ~FlatHashMap() { clear(); }
+
+    iterator begin() { return iterator(this, NextLive(0)); }
+    const_iterator begin() const { return const_iterator(this, NextLive(0)); }
+    iterator end() { return iterator(this, live.size()); }
+    const_iterator end() const { return const_iterator(this, live.size()); }
+
+    size_t size() const { return nSize; }
+    bool empty() const { return nSize == 0; }
+
+    iterator find(const K &key) {
+        size_t pos;
+        if (table.empty() || !Lookup(key, hasher(key), pos)) {
+            return end();
+        }
+        return iterator(this, SlotId(table[pos]));
+    }
+    const_iterator find(const K &key) const {
+        size_t pos;
+        if (table.empty() || !Lookup(key, hasher(key), pos)) {
+            return end();
+        }
+        return const_iterator(this, SlotId(table[pos]));
+    }
+    size_t count(const K &key) const { return find(key) != end(); }
+
+    /**
+     * Construct an entry from args, and insert it unless an entry with the
+     * same key is already present.
+     */
+    template <typename... Args>
+    std::pair<iterator, bool> emplace(Args &&... args) {
+        Reserve();
+        const uint32_t id = AllocateEntry();
+        value_type *value;
+        try {
+            value = new (RawEntry(id)) value_type(std::forward<Args>(args)...);
+        } catch (...) {
+            FreeEntry(id);
+            throw;
+        }
+
+        const size_t hash = hasher(value->first);
+        size_t pos;
+        if (Lookup(value->first, hash, pos)) {
+            value->~value_type();
+            FreeEntry(id);
+            return std::make_pair(iterator(this, SlotId(table[pos])), false);
+        }
+        if (table[pos] == EMPTY) {
+            nUsedSlots++;
+        }
+        table[pos] = MakeSlot(Tag(hash), id);
+        live[id] = true;
+        nSize++;
+        return std::make_pair(iterator(this, id), true);
+    }
+
+    T &operator[](const K &key) {
+        iterator it = find(key);
+        if (it == end()) {
+            it = emplace(std::piecewise_construct, std::forward_as_tuple(key),
+                         std::tuple<>())
+                     .first;
+        }
+        return it->second;
+    }
+
+    //! Erase the entry it points to, and return an iterator to the next one.
+    iterator erase(const_iterator it) {
+        const uint32_t id = it.id;
+        const size_t mask = table.size() - 1;
+        size_t i = hasher(Entry(id)->first) & mask;
+        while (table[i] == DELETED || SlotId(table[i]) != id) {
+            i = (i + 1) & mask;
+        }
+        table[i] = DELETED;
+        Entry(id)->~value_type();
+        live[id] = false;
+        FreeEntry(id);
+        nSize--;
+        return iterator(this, NextLive(id + 1));
+    }
+
+    //! Erase all entries, and release the memory held by the map.
+    void clear() {
+        for (uint32_t id = NextLive(0); id < live.size();
+             id = NextLive(id + 1)) {
+            Entry(id)->~value_type();
+        }
+        std::vector<uint64_t>().swap(table);
+        std::vector<std::unique_ptr<Storage[]>>().swap(chunks);
+        std::vector<bool>().swap(live);
+        freeHead = NO_ENTRY;
+        nSize = 0;
+        nUsedSlots = 0;
+    }
+
+    //! Exchange the contents of two maps. Entries do not move, but iterators
+    //! are invalidated.
+    void swap(FlatHashMap &other) {
+        table.swap(other.table);
+        chunks.swap(other.chunks);
+        live.swap(other.live);
+        std::swap(freeHead, other.freeHead);
+        std::swap(nSize, other.nSize);
+        std::swap(nUsedSlots, other.nUsedSlots);
+        std::swap(hasher, other.hasher);
+        std::swap(keyEqual, other.keyEqual);
+    }
+
+    //! Number of slots of the open addressing table.
+    size_t bucket_count() const { return table.size(); }
+    //! Number of chunks of entries allocated.
+    size_t chunk_count() const { return chunks.size(); }
+    //! Number of entries held by the given chunk.
+    static size_t chunk_size(size_t chunk) {
+        if (chunk >= FIRST_FULL_CHUNK) {
+            return MAX_CHUNK_SIZE;
+        }
+        return chunk == 0 ? FIRST_CHUNK_SIZE : ChunkStart(chunk);
+    }
+    //! Number of entries which have been allocated, erased ones included.
+    size_t entry_count() const { return live.size(); }
+};
+
+#endif // BITCOIN_FLATHASHMAP_H
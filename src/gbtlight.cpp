@@ -3,13 +3,21 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include <gbtlight.h>
+#include <crypto/common.h>
 #include <logging.h>
 #include <scheduler.h>
+#include <streams.h>
+#include <sync.h>
 #include <util/strencodings.h>
 #include <util/system.h>
+#include <version.h>
 
 #include <atomic>
+#include <condition_variable>
+#include <deque>
 #include <limits>
+#include <thread>
+#include <unordered_set>
 
 namespace gbtl {
 
@@ -18,18 +26,41 @@ const int DEFAULT_JOB_CACHE_SIZE = 10;
 const int64_t DEFAULT_JOB_DATA_EXPIRY_SECS = 3600; // 1 hour
 static_assert(DEFAULT_JOB_CACHE_SIZE > 0, "DEFAULT_JOB_CACHE_SIZE must be >0");
 const std::string tmpExt = ".tmp";
+const std::string kJobFileMagic = "GBJ";
+const std::string kLegacyJobFileMagic = "GBT";
 
 namespace {
 /// Config data based on args cached for performance (since calling gArgs.GetArg() is slow).
 /// This should be initialized before RPC server startup via GBTLight::Initialize().
 struct Config {
-    fs::path storeDir, trashDir;
+    fs::path storeDir, trashDir, txDir;
     int64_t jobDataExpirySecs{};
     int cacheSize{};
 };
 Config config;
 std::atomic_uint initCt;
 void CleanJobDataDir();
+
+/// The thread writing the job data files in the background, and the writes queued for it.
+struct Writer {
+    Mutex mut;
+    std::condition_variable cond;
+    std::deque<std::function<void()>> queue GUARDED_BY(mut);
+    /// Number of writes queued so far, and how many of them are done
+    uint64_t nQueued GUARDED_BY(mut) = 0, nDone GUARDED_BY(mut) = 0;
+    /// Whether the thread takes new writes, and whether it should exit once done with the queued ones
+    bool running GUARDED_BY(mut) = false, stop GUARDED_BY(mut) = false;
+    std::thread thread;
+};
+Writer writer;
+void ThreadWriteJobData();
+
+struct TxIdHasher {
+    std::size_t operator()(const TxId &txid) const noexcept { return ReadLE64(txid.begin()); }
+};
+using TxIdSet = std::unordered_set<TxId, TxIdHasher>;
+/// Txids known to be in the tx data dir. Only accessed by the writes, which run one at a time.
+TxIdSet storedTxs;
 } // namespace
 
 void Initialize(CScheduler &scheduler) {
@@ -51,6 +82,8 @@ void Initialize(CScheduler &scheduler) {
     TryCreateDirectories(config.storeDir); // may throw
     config.trashDir = config.storeDir / "trash";
     TryCreateDirectories(config.trashDir); // may throw
+    config.txDir = config.storeDir / "tx";
+    TryCreateDirectories(config.txDir); // may throw
     // parse -gbtstoretime
     config.jobDataExpirySecs = gArgs.GetArg("-gbtstoretime", DEFAULT_JOB_DATA_EXPIRY_SECS);
     if (config.jobDataExpirySecs < 0) {
@@ -73,7 +106,7 @@ void Initialize(CScheduler &scheduler) {
                             // time.
                             return false;
                         }
-                        CleanJobDataDir();
+                        QueueJobDataWrite(CleanJobDataDir);
                         return true;
                     },
                     // Task interval in milliseconds. This will always be at least 500ms, default is 1,800,000 (30 mins)
@@ -82,15 +115,194 @@ void Initialize(CScheduler &scheduler) {
         // We run the cleanup task once "soon" if this is the first time Initialize() was called, to clean any stale
         // files immediately at startup.
         if (invocationId == 1 && config.jobDataExpirySecs > 2)
-            scheduler.scheduleFromNow([]{CleanJobDataDir();}, 100);
+            scheduler.scheduleFromNow([]{ QueueJobDataWrite(CleanJobDataDir); }, 100);
+    }
+    // start the background writer thread, unless a previous Initialize() already did
+    {
+        LOCK(writer.mut);
+        if (writer.running)
+            return;
+    }
+    if (writer.thread.joinable())
+        writer.thread.join();
+    storedTxs.clear(); // the store dir may have changed
+    {
+        LOCK(writer.mut);
+        writer.running = true;
+        writer.stop = false;
+    }
+    writer.thread = std::thread(&TraceThread<void (*)()>, "gbtlwrite", &ThreadWriteJobData);
+}
+
+void Shutdown() {
+    {
+        LOCK(writer.mut);
+        writer.stop = true;
+        writer.cond.notify_all();
+    }
+    if (writer.thread.joinable())
+        writer.thread.join();
+}
+
+void QueueJobDataWrite(std::function<void()> write) {
+    {
+        LOCK(writer.mut);
+        if (writer.running) {
+            writer.queue.push_back(std::move(write));
+            ++writer.nQueued;
+            writer.cond.notify_all();
+            return;
+        }
     }
+    write();
+}
+
+void SyncJobDataWrites() {
+    WAIT_LOCK(writer.mut, lock);
+    const uint64_t nQueued = writer.nQueued;
+    writer.cond.wait(lock, [nQueued]{ return writer.nDone >= nQueued; });
 }
 
 const fs::path &GetJobDataDir() { return config.storeDir; }
 const fs::path &GetJobDataTrashDir() { return config.trashDir; }
+const fs::path &GetTxDataDir() { return config.txDir; }
 size_t GetJobCacheSize() { return size_t(config.cacheSize); }
 int64_t GetJobDataExpiry() { return config.jobDataExpirySecs; }
 
+namespace {
+void ThreadWriteJobData() {
+    WAIT_LOCK(writer.mut, lock);
+    while (true) {
+        writer.cond.wait(lock, []{ return writer.stop || !writer.queue.empty(); });
+        if (writer.queue.empty()) {
+            // stopping, and done with all the writes. Any later write runs from the thread queueing it.
+            writer.running = false;
+            return;
+        }
+        const auto write = std::move(writer.queue.front());
+        writer.queue.pop_front();
+        lock.unlock();
+        try {
+            write();
+        } catch (const std::exception &e) {
+            LogPrintf("WARNING: GBTLight job data write failed: %s\n", e.what());
+        }
+        lock.lock();
+        ++writer.nDone;
+        writer.cond.notify_all();
+    }
+}
+
+/// Writes magic + data + magic to path, through a temporary file which is then moved in place.
+bool WriteDataFile(const fs::path &path, const std::string &magic, const CDataStream &data) {
+    auto tmpOut = path;
+    tmpOut += tmpExt; // += ".tmp"
+    bool ok{};
+    {
+        fs::ofstream ofile(tmpOut, std::ios_base::binary|std::ios_base::out|std::ios_base::trunc);
+        if ((ok = ofile.is_open())) {
+            using std::streamsize;
+            ofile.write(magic.data(), streamsize(magic.size()));
+            if (ofile)
+                ofile.write(data.data(), streamsize(data.size()));
+            if (ofile)
+                ofile.write(magic.data(), streamsize(magic.size()));
+            ok = bool(ofile);
+        }
+    } // file is closed
+    if (!ok) {
+        LogPrintf("WARNING: GBTLight cannot write data to %s\n", tmpOut.string());
+        try { fs::remove(tmpOut); } catch (...) {}
+        return false;
+    }
+    // now, atomically move it in place.
+    fs::rename(tmpOut, path); // may throw (unlikely)
+    return true;
+}
+
+/// Adds the txids listed by the job data file at path to txids. Returns false if it is not a job data file, or was
+/// written by an older version.
+bool ReadJobTxIds(const fs::path &path, TxIdSet &txids) {
+    CAutoFile file(fsbridge::fopen(path, "rb"), SER_NETWORK, PROTOCOL_VERSION);
+    if (file.IsNull())
+        return false;
+    try {
+        std::string magic(kJobFileMagic.size(), '\0');
+        file.read(&magic[0], magic.size());
+        if (magic != kJobFileMagic)
+            return false;
+        uint32_t nTx = 0;
+        file >> nTx;
+        for (uint32_t i = 0; i < nTx; ++i) {
+            TxId txid;
+            file >> txid;
+            txids.insert(txid);
+        }
+    } catch (const std::exception &) {
+        return false;
+    }
+    return true;
+}
+} // namespace
+
+bool WriteJobData(const JobId &jobId, const std::vector<CTransactionRef> &txs) {
+    try {
+        const auto t0 = GetTimeMicros(); // for perf. logging iff BCLog::RPC is enabled
+        const fs::path jobFile = GetJobDataDir() / jobId.GetHex();
+        if (fs::exists(jobFile))
+            return true;
+        // Store the txs first, so that a job data file never refers to a missing tx. Consecutive jobs share most of
+        // their txs, so most of them are already there.
+        unsigned nNewTxs = 0;
+        for (const auto &tx : txs) {
+            const TxId &txid = tx->GetId();
+            if (storedTxs.count(txid))
+                continue;
+            const fs::path txFile = GetTxDataDir() / txid.GetHex();
+            if (!fs::exists(txFile)) {
+                CDataStream datastream(SER_NETWORK, PROTOCOL_VERSION);
+                datastream << *tx;
+                if (!WriteDataFile(txFile, "", datastream))
+                    return false;
+                ++nNewTxs;
+            }
+            storedTxs.insert(txid);
+        }
+        CDataStream datastream(SER_NETWORK, PROTOCOL_VERSION);
+        const uint32_t nTx = uint32_t(txs.size());
+        datastream.reserve(sizeof(nTx) + nTx * sizeof(TxId));
+        datastream << nTx; // first write the size
+        for (const auto &tx : txs)
+            datastream << tx->GetId();
+        if (!WriteDataFile(jobFile, kJobFileMagic, datastream))
+            return false;
+        LogPrint(BCLog::RPC, "GBTLight: job_id %s with %d txs (%d new) written in %f secs\n", jobId.GetHex(),
+                 txs.size(), nNewTxs, (GetTimeMicros() - t0) / 1e6);
+        return true;
+    } catch (const std::exception &e) {
+        // filesystem errors
+        LogPrintf("WARNING: GBTLight cannot write job_id %s: %s\n", jobId.GetHex(), e.what());
+        return false;
+    }
+}
+
+CTransactionRef ReadStoredTx(const TxId &txid) {
+    CAutoFile file(fsbridge::fopen(GetTxDataDir() / txid.GetHex(), "rb"), SER_NETWORK, PROTOCOL_VERSION);
+    if (file.IsNull())
+        return nullptr;
+    try {
+        CMutableTransaction mutableTx;
+        file >> mutableTx;
+        CTransactionRef tx = MakeTransactionRef(std::move(mutableTx));
+        // the txid is the content address of the file, check it
+        if (tx->GetId() == txid)
+            return tx;
+    } catch (const std::exception &) {
+    }
+    LogPrintf("WARNING: GBTLight data for tx %s is invalid\n", txid.GetHex());
+    return nullptr;
+}
+
 namespace {
 void CleanJobDataDir() {
     // this is intended to run as a background task off the scheduler on the order of once every 60 minutes
@@ -160,6 +372,32 @@ void CleanJobDataDir() {
         // newer than absolute cutoff, older than trash cutoff -- move to trash for "purgatory"
         MV(path, trashDir / path.filename());
     }
+    // process gbt/tx/ dir: delete the txs no remaining job data file refers to. This runs on the writer thread, so
+    // no job is being written meanwhile.
+    TxIdSet referenced;
+    for (const auto &dir : {jobDir, trashDir}) {
+        for (const auto &entry : fs::directory_iterator(dir)) {
+            if (fs::is_regular_file(entry.path()) && !entry.path().has_extension())
+                ReadJobTxIds(entry.path(), referenced);
+        }
+    }
+    for (const auto &entry : fs::directory_iterator(GetTxDataDir())) {
+        const auto &path = entry.path();
+        const auto basename = path.filename().stem().string();
+        if (!fs::is_regular_file(path) || basename.size() != TxId::size()*2 || !IsHex(basename))
+            continue;
+        ++total;
+        if (path.extension() == tmpExt) {
+            // left over from an interrupted write
+            RM(path);
+            continue;
+        }
+        const TxId txid(uint256S(basename));
+        if (!referenced.count(txid)) {
+            RM(path);
+            storedTxs.erase(txid);
+        }
+    }
     if (count) {
         LogPrint(BCLog::RPC, "%s cleaned or moved %u out of %u item(s) in %f secs\n", pfx, count, total,
                  (GetTimeMicros()-t0)/1e6);
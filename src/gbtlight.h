@@ -6,10 +6,13 @@
 #define BITCOIN_GBTLIGHT_H
 
 #include <fs.h>
+#include <primitives/transaction.h>
 #include <uint256.h>
 
 #include <cstdint>
+#include <functional>
 #include <string>
+#include <vector>
 
 class CScheduler;
 
@@ -28,15 +31,39 @@ void Initialize(CScheduler &scheduler);
 const fs::path &GetJobDataDir();
 /// Returns the "gbt trash" directory path. This is always GetJobDataDir() / "trash".
 const fs::path &GetJobDataTrashDir();
+/// Returns the directory where the transactions of all jobs are stored, one file per txid. This is always
+/// GetJobDataDir() / "tx".
+const fs::path &GetTxDataDir();
 /// Returns the size of the in-memory jobId cache we should use. From arg -gbtcachesize=<n>
 size_t GetJobCacheSize();
 /// Returns the job data dir file expiry time in seconds.  From arg -gbtstoretime=<n>
 int64_t GetJobDataExpiry();
 
+/// Called once at app shutdown, after the RPC server is stopped. Waits for the queued job data writes and stops the
+/// background writer thread.
+void Shutdown();
+
+/// Queues `write` for the background thread that writes the job data files. Writes run one at a time, in the order
+/// they were queued. If the writer thread is not running, `write` is run immediately instead.
+void QueueJobDataWrite(std::function<void()> write);
+/// Waits until the job data writes queued so far are done.
+void SyncJobDataWrites();
+
+/// Writes the job data file for jobId, which lists the txids of txs, and writes those of txs which are not yet in
+/// GetTxDataDir(). Does nothing if the job data file already exists. Returns false on failure.
+/// This is meant to run on the writer thread, see QueueJobDataWrite().
+bool WriteJobData(const JobId &jobId, const std::vector<CTransactionRef> &txs);
+/// Reads a transaction from GetTxDataDir(). Returns nullptr if it is not there or its data is invalid.
+CTransactionRef ReadStoredTx(const TxId &txid);
+
 extern const int DEFAULT_JOB_CACHE_SIZE; /**< = 10 */
 extern const char * const DEFAULT_JOB_DATA_SUBDIR; /**< = "gbt" */
 extern const int64_t DEFAULT_JOB_DATA_EXPIRY_SECS; /**< = 3600 */
 extern const std::string tmpExt; /** = ".tmp" */
+/// Bytes used as header and footer for the job data files, which list the txids of the job.
+extern const std::string kJobFileMagic; /**< = "GBJ" */
+/// Bytes used as header and footer for the job data files written by older versions, which hold the txs of the job.
+extern const std::string kLegacyJobFileMagic; /**< = "GBT" */
 }
 
 #endif // BITCOIN_GBTLIGHT_H
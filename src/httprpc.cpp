@@ -15,12 +15,14 @@
 #include <rpc/server.h>
 #include <sync.h>
 #include <ui_interface.h>
+#include <util/jsonwriter.h>
 #include <util/strencodings.h>
 #include <util/system.h>
 #include <walletinitinterface.h>
 
 #include <boost/algorithm/string.hpp> // boost::trim
 
+#include <algorithm>
 #include <cstdio>
 #include <memory>
 
@@ -68,6 +70,8 @@ private:
 static std::string strRPCUserColonPass;
 /* Pre-base64-encoded authentication token */
 static std::string strRPCCORSDomain;
+/* Maximum number of requests of a batch executed at the same time */
+static int nRPCBatchConcurrency = DEFAULT_RPC_BATCH_CONCURRENCY;
 /* Stored RPC timer interface (for unregistration) */
 static std::unique_ptr<HTTPRPCTimerInterface> httpRPCTimerInterface;
 
@@ -87,6 +91,28 @@ static void JSONErrorReply(HTTPRequest* req, JSONRPCError&& error, UniValue&& id
     req->WriteReply(nStatus, strReply);
 }
 
+/**
+ * Send the reply to a single JSON-RPC request, the same text as JSONRPCReply()
+ * gives, in chunks if the result is large.
+ */
+static void JSONRPCWriteReply(HTTPRequest *req, const UniValue &result,
+                              const UniValue &id) {
+    req->WriteHeader("Content-Type", "application/json");
+    HTTPChunkedReply reply(req, HTTP_OK);
+    std::string strReply;
+    JSONWriter writer(
+        strReply,
+        [&reply](std::string &chunk) { reply.Write(std::move(chunk)); },
+        HTTP_REPLY_CHUNK_SIZE);
+    writer.BeginObject();
+    writer.KeyValue("result", result);
+    writer.KeyValue("error", UniValue());
+    writer.KeyValue("id", id);
+    writer.EndObject();
+    strReply += '\n';
+    reply.End(std::move(strReply));
+}
+
 /*
  * This function checks username and password against -rpcauth entries from
  * config file.
@@ -327,23 +353,23 @@ bool HTTPRPCRequestProcessor::ProcessHTTPRequest(HTTPRequest *req) {
         // Set the URI
         jreq.URI = req->GetURI();
 
-        std::string strReply;
         // singleton request
         if (valRequest.isObject()) {
             jreq.parse(std::move(valRequest));
 
             // Send reply
-            // (id is copied rather than moved, so it's still there for exception handlers below)
-            strReply = JSONRPCReply(rpcServer.ExecuteCommand(config, jreq), UniValue(), UniValue(jreq.id));
+            // (id is still there for exception handlers below)
+            const UniValue result = rpcServer.ExecuteCommand(config, jreq);
+            JSONRPCWriteReply(req, result, jreq.id);
         } else if (valRequest.isArray()) {
             // array of requests
-            strReply = JSONRPCExecBatch(config, rpcServer, jreq, std::move(valRequest.get_array()));
+            std::string strReply = JSONRPCExecBatch(config, rpcServer, jreq, std::move(valRequest.get_array()),
+                                                    HTTPDispatchIfIdle, nRPCBatchConcurrency);
+            req->WriteHeader("Content-Type", "application/json");
+            req->WriteReply(HTTP_OK, strReply);
         } else {
             throw JSONRPCError(RPC_PARSE_ERROR, "Top-level object parse error");
         }
-
-        req->WriteHeader("Content-Type", "application/json");
-        req->WriteReply(HTTP_OK, strReply);
     } catch (JSONRPCError &error) {
         JSONErrorReply(req, std::move(error), std::move(jreq.id));
         return false;
@@ -392,6 +418,11 @@ bool StartHTTPRPC(HTTPRPCRequestProcessor &httpRPCRequestProcessor) {
         &rpcFunction =
             std::bind(&HTTPRPCRequestProcessor::DelegateHTTPRequest,
                       &httpRPCRequestProcessor, std::placeholders::_2);
+    nRPCBatchConcurrency =
+        std::max<int64_t>(gArgs.GetArg("-rpcbatchconcurrency",
+                                       DEFAULT_RPC_BATCH_CONCURRENCY),
+                          1);
+
     RegisterHTTPHandler("/", true, rpcFunction);
     if (g_wallet_init_interface.HasWalletSupport()) {
         RegisterHTTPHandler("/wallet/", false, rpcFunction);
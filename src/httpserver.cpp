@@ -36,6 +36,7 @@
 #include <sys/stat.h>
 #include <sys/types.h>
 
+#include <condition_variable>
 #include <csignal>
 #include <cstdio>
 #include <cstdlib>
@@ -52,6 +53,12 @@ static const size_t MAX_HEADERS_SIZE = 8192;
  */
 static const size_t MIN_SUPPORTED_BODY_SIZE = 0x02000000;
 
+/**
+ * Maximum size of the body of a chunked reply that may wait to be written out
+ * to the client, before the thread producing it is made to wait.
+ */
+static const size_t MAX_REPLY_PENDING_SIZE = 16 * HTTP_REPLY_CHUNK_SIZE;
+
 /** HTTP request work item */
 class HTTPWorkItem final : public HTTPClosure {
 public:
@@ -69,6 +76,18 @@ private:
     Config *config;
 };
 
+/** Work item running a task handed over by another thread */
+class HTTPTaskItem final : public HTTPClosure {
+public:
+    explicit HTTPTaskItem(std::function<void()> _task)
+        : task(std::move(_task)) {}
+
+    void operator()() override { task(); }
+
+private:
+    std::function<void()> task;
+};
+
 /**
  * Simple work queue for distributing work over multiple threads.
  * Work items are simply callable objects.
@@ -81,6 +100,8 @@ private:
     std::deque<std::unique_ptr<WorkItem>> queue;
     bool running;
     size_t maxDepth;
+    //! Number of threads waiting for work
+    size_t numIdle = 0;
 
 public:
     explicit WorkQueue(size_t _maxDepth) : running(true), maxDepth(_maxDepth) {}
@@ -100,15 +121,31 @@ public:
         return true;
     }
 
+    /**
+     * Enqueue a work item only if a thread is waiting to run it right away,
+     * so that it never delays nor displaces other work.
+     */
+    bool EnqueueIfIdle(WorkItem *item) {
+        LOCK(cs);
+        if (!running || queue.size() >= numIdle) {
+            return false;
+        }
+        queue.emplace_back(std::unique_ptr<WorkItem>(item));
+        cond.notify_one();
+        return true;
+    }
+
     /** Thread function */
     void Run() {
         while (true) {
             std::unique_ptr<WorkItem> i;
             {
                 WAIT_LOCK(cs, lock);
+                numIdle++;
                 while (running && queue.empty()) {
                     cond.wait(lock);
                 }
+                numIdle--;
                 if (!running) {
                     break;
                 }
@@ -294,6 +331,19 @@ static void http_request_cb(struct evhttp_request *req, void *arg) {
     }
 }
 
+bool HTTPDispatchIfIdle(std::function<void()> task) {
+    if (!workQueue) {
+        return false;
+    }
+    std::unique_ptr<HTTPTaskItem> item(new HTTPTaskItem(std::move(task)));
+    if (workQueue->EnqueueIfIdle(item.get())) {
+        /* if true, queue took ownership */
+        item.release();
+        return true;
+    }
+    return false;
+}
+
 /** Callback to reject HTTP requests after shutdown. */
 static void http_reject_request_cb(struct evhttp_request *req, void *) {
     LogPrint(BCLog::HTTP, "Rejecting request while shutting down\n");
@@ -544,13 +594,56 @@ void HTTPEvent::trigger(struct timeval *tv) {
         evtimer_add(ev, tv);
     }
 }
+/**
+ * State of a chunked reply, shared by the worker thread producing the body and
+ * the main http thread sending it.
+ */
+struct HTTPReplyStream {
+    Mutex cs;
+    std::condition_variable cond;
+    //! Size of the body handed over to the main thread
+    uint64_t nQueued GUARDED_BY(cs) = 0;
+    //! Size of the body written out to the client
+    uint64_t nWritten GUARDED_BY(cs) = 0;
+    //! Whether the connection was closed before the end of the reply
+    bool fClosed GUARDED_BY(cs) = false;
+
+    //! Size of the body handed over to libevent. Only used by the main thread.
+    uint64_t nSent = 0;
+
+    /** Whether the worker thread must wait before handing over more data */
+    bool IsFull() const EXCLUSIVE_LOCKS_REQUIRED(cs) {
+        return !fClosed && nQueued - nWritten > MAX_REPLY_PENDING_SIZE;
+    }
+};
+
+/** Called by libevent once the output buffer of a chunked reply is empty */
+static void http_reply_written_cb(struct evhttp_connection *, void *arg) {
+    HTTPReplyStream *stream = static_cast<HTTPReplyStream *>(arg);
+    LOCK(stream->cs);
+    stream->nWritten = stream->nSent;
+    stream->cond.notify_all();
+}
+
+/** Called by libevent if the connection closes during a chunked reply */
+static void http_reply_closed_cb(struct evhttp_connection *, void *arg) {
+    HTTPReplyStream *stream = static_cast<HTTPReplyStream *>(arg);
+    LOCK(stream->cs);
+    stream->fClosed = true;
+    stream->cond.notify_all();
+}
+
 HTTPRequest::HTTPRequest(struct evhttp_request *_req)
     : req(_req), replySent(false) {}
 HTTPRequest::~HTTPRequest() {
     if (!replySent) {
         // Keep track of whether reply was sent to avoid request leaks
         LogPrintf("%s: Unhandled request\n", __func__);
-        WriteReply(HTTP_INTERNAL, "Unhandled request");
+        if (replyStream) {
+            EndReply();
+        } else {
+            WriteReply(HTTP_INTERNAL, "Unhandled request");
+        }
     }
     // evhttpd cleans up the request, as long as a reply was sent.
 }
@@ -573,21 +666,14 @@ std::string HTTPRequest::ReadBody() {
         return "";
     }
     size_t size = evbuffer_get_length(buf);
-    /**
-     * Trivial implementation: if this is ever a performance bottleneck,
-     * internal copying can be avoided in multi-segment buffers by using
-     * evbuffer_peek and an awkward loop. Though in that case, it'd be even
-     * better to not copy into an intermediate string but use a stream
-     * abstraction to consume the evbuffer on the fly in the parsing algorithm.
-     */
-    const char *data = (const char *)evbuffer_pullup(buf, size);
-
-    // returns nullptr in case of empty buffer.
-    if (!data) {
+    if (size == 0) {
         return "";
     }
-    std::string rv(data, size);
-    evbuffer_drain(buf, size);
+    // Copy the segments of the buffer straight into the string, as they are
+    // drained, rather than making them contiguous inside the buffer first.
+    std::string rv(size, '\0');
+    const int nRemoved = evbuffer_remove(buf, &rv[0], size);
+    assert(nRemoved >= 0 && size_t(nRemoved) == size);
     return rv;
 }
 
@@ -604,7 +690,7 @@ void HTTPRequest::WriteHeader(const std::string &hdr,
  * done from worker threads.
  */
 void HTTPRequest::WriteReply(int nStatus, const std::string &strReply) {
-    assert(!replySent && req);
+    assert(!replySent && !replyStream && req);
     if (ShutdownRequested()) {
         WriteHeader("Connection", "close");
     }
@@ -634,6 +720,96 @@ void HTTPRequest::WriteReply(int nStatus, const std::string &strReply) {
     req = nullptr;
 }
 
+/**
+ * The pieces of a chunked reply are handed over to the main http thread the
+ * same way, in the order they were written, with the shared state of the reply
+ * kept alive until its end.
+ */
+void HTTPRequest::BeginReply(int nStatus) {
+    assert(!replySent && !replyStream && req);
+    if (ShutdownRequested()) {
+        WriteHeader("Connection", "close");
+    }
+    replyStream = std::make_shared<HTTPReplyStream>();
+    auto req_copy = req;
+    auto stream = replyStream;
+    HTTPEvent *ev = new HTTPEvent(eventBase, true, [req_copy, stream, nStatus] {
+        evhttp_connection *conn = evhttp_request_get_connection(req_copy);
+        if (conn) {
+            evhttp_connection_set_closecb(conn, http_reply_closed_cb,
+                                          stream.get());
+        }
+        evhttp_send_reply_start(req_copy, nStatus, nullptr);
+    });
+    ev->trigger(nullptr);
+}
+
+bool HTTPRequest::WriteReplyChunk(std::string &&chunk) {
+    assert(!replySent && replyStream && req);
+    {
+        WAIT_LOCK(replyStream->cs, lock);
+        while (replyStream->IsFull()) {
+            replyStream->cond.wait(lock);
+        }
+        if (replyStream->fClosed) {
+            return false;
+        }
+        replyStream->nQueued += chunk.size();
+    }
+    if (chunk.empty()) {
+        // An empty chunk would end the reply
+        return true;
+    }
+    auto req_copy = req;
+    auto stream = replyStream;
+    HTTPEvent *ev = new HTTPEvent(
+        eventBase, true, [req_copy, stream, data = std::move(chunk)] {
+            {
+                LOCK(stream->cs);
+                if (stream->fClosed) {
+                    return;
+                }
+            }
+            struct evbuffer *evb = evbuffer_new();
+            assert(evb);
+            evbuffer_add(evb, data.data(), data.size());
+            stream->nSent += data.size();
+            evhttp_send_reply_chunk_with_cb(req_copy, evb,
+                                            http_reply_written_cb,
+                                            stream.get());
+            evbuffer_free(evb);
+        });
+    ev->trigger(nullptr);
+    return true;
+}
+
+void HTTPRequest::EndReply() {
+    assert(!replySent && replyStream && req);
+    auto req_copy = req;
+    auto stream = replyStream;
+    HTTPEvent *ev = new HTTPEvent(eventBase, true, [req_copy, stream] {
+        // The callbacks must not outlive the shared state of the reply.
+        evhttp_connection *conn = evhttp_request_get_connection(req_copy);
+        if (conn) {
+            evhttp_connection_set_closecb(conn, nullptr, nullptr);
+        }
+        evhttp_send_reply_end(req_copy);
+        // Re-enable reading from the socket, as in WriteReply.
+        if (conn && event_get_version_number() >= 0x02010600 &&
+            event_get_version_number() < 0x02010900) {
+            bufferevent *bev = evhttp_connection_get_bufferevent(conn);
+            if (bev) {
+                bufferevent_enable(bev, EV_READ | EV_WRITE);
+            }
+        }
+    });
+    ev->trigger(nullptr);
+    replySent = true;
+    replyStream.reset();
+    // transferred back to main thread.
+    req = nullptr;
+}
+
 CService HTTPRequest::GetPeer() const {
     evhttp_connection *con = evhttp_request_get_connection(req);
     CService peer;
@@ -668,6 +844,23 @@ HTTPRequest::RequestMethod HTTPRequest::GetRequestMethod() const {
     }
 }
 
+bool HTTPChunkedReply::Write(std::string &&chunk) {
+    if (!fStarted) {
+        req->BeginReply(nStatus);
+        fStarted = true;
+    }
+    return req->WriteReplyChunk(std::move(chunk));
+}
+
+void HTTPChunkedReply::End(std::string &&rest) {
+    if (!fStarted) {
+        req->WriteReply(nStatus, rest);
+        return;
+    }
+    req->WriteReplyChunk(std::move(rest));
+    req->EndReply();
+}
+
 void RegisterHTTPHandler(const std::string &prefix, bool exactMatch,
                          const HTTPRequestHandler &handler) {
     LogPrint(BCLog::HTTP, "Registering HTTP handler for %s (exactmatch %d)\n",
@@ -8,18 +8,23 @@
 
 #include <cstdint>
 #include <functional>
+#include <memory>
 #include <string>
 
 static const int DEFAULT_HTTP_THREADS = 4;
 static const int DEFAULT_HTTP_WORKQUEUE = 16;
 static const int DEFAULT_HTTP_SERVER_TIMEOUT = 30;
 
+/** Size of the chunks in which large HTTP replies are written */
+static const size_t HTTP_REPLY_CHUNK_SIZE = 64 * 1024;
+
 struct evhttp_request;
 struct event_base;
 
 class Config;
 class CService;
 class HTTPRequest;
+struct HTTPReplyStream;
 
 /**
  * Initialize HTTP server.
@@ -62,6 +67,12 @@ void RegisterHTTPHandler(const std::string &prefix, bool exactMatch,
 /** Unregister handler for prefix */
 void UnregisterHTTPHandler(const std::string &prefix, bool exactMatch);
 
+/**
+ * Run a task on an HTTP worker thread, if one is idle.
+ * Return false, without running the task, if all of them are busy.
+ */
+bool HTTPDispatchIfIdle(std::function<void()> task);
+
 /**
  * Return evhttp event base. This can be used by submodules to
  * queue timers or custom events.
@@ -76,6 +87,8 @@ class HTTPRequest {
 private:
     struct evhttp_request *req;
     bool replySent;
+    //! State of a chunked reply, once started
+    std::shared_ptr<HTTPReplyStream> replyStream;
 
 public:
     explicit HTTPRequest(struct evhttp_request *req);
@@ -124,6 +137,60 @@ public:
      * this.
      */
     void WriteReply(int nStatus, const std::string &strReply = "");
+
+    /**
+     * Start a chunked HTTP reply, whose body is then sent piece by piece with
+     * WriteReplyChunk as it is produced, and finished with EndReply.
+     * nStatus is the HTTP status code to send.
+     *
+     * @note Call this instead of WriteReply, after writing the headers.
+     */
+    void BeginReply(int nStatus);
+
+    /**
+     * Send the next piece of the body of a chunked reply.
+     * Block while more than a few chunks of the reply are waiting to be
+     * written out to the client, so that the memory used by the reply stays
+     * bounded when the client reads it slower than it is produced.
+     *
+     * Return false if the client went away, in which case the rest of the
+     * body is dropped and producing it can be cut short. EndReply must be
+     * called anyway.
+     */
+    bool WriteReplyChunk(std::string &&chunk);
+
+    /**
+     * Finish a chunked reply.
+     *
+     * @note As this will give the request back to the main thread, do not
+     * call any other HTTPRequest methods after calling this.
+     */
+    void EndReply();
+};
+
+/**
+ * Reply to an HTTP request with a body produced piece by piece: as a plain
+ * reply if the whole body fits in a chunk, or as a chunked reply as soon as
+ * it grows beyond that.
+ */
+class HTTPChunkedReply {
+public:
+    HTTPChunkedReply(HTTPRequest *reqIn, int nStatusIn)
+        : req(reqIn), nStatus(nStatusIn) {}
+
+    /**
+     * Send a piece of the body, starting a chunked reply if needed.
+     * Return false if the client went away.
+     */
+    bool Write(std::string &&chunk);
+
+    /** Send the rest of the body and finish the reply */
+    void End(std::string &&rest);
+
+private:
+    HTTPRequest *req;
+    int nStatus;
+    bool fStarted = false;
 };
 
 /** Event handler closure */
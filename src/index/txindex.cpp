@@ -6,6 +6,7 @@
 
 #include <chain.h>
 #include <shutdown.h>
+#include <streams.h>
 #include <ui_interface.h>
 #include <util/system.h>
 #include <validation.h>
@@ -273,6 +274,26 @@ bool TxIndex::FindTx(const TxId &txid, BlockHash &block_hash,
         return false;
     }
 
+    std::shared_ptr<const MappedFile> mapping;
+    const Span<const uint8_t> data = MapBlockFile(postx, mapping);
+    if (!data.empty()) {
+        // Deserialize in place from the mapped file
+        CBlockHeader header;
+        try {
+            SpanReader reader(SER_DISK, CLIENT_VERSION, data);
+            reader >> header;
+            reader.ignore(postx.nTxOffset);
+            reader >> tx;
+        } catch (const std::exception &e) {
+            return error("%s: Deserialize error - %s", __func__, e.what());
+        }
+        if (tx->GetId() != txid) {
+            return error("%s: txid mismatch", __func__);
+        }
+        block_hash = header.GetHash();
+        return true;
+    }
+
     CAutoFile file(OpenBlockFile(postx, true), SER_DISK, CLIENT_VERSION);
     if (file.IsNull()) {
         return error("%s: OpenBlockFile failed", __func__);
@@ -25,6 +25,7 @@
 #include <gbtlight.h>
 #include <httprpc.h>
 #include <httpserver.h>
+#include <index/blockfilterindex.h>
 #include <index/txindex.h>
 #include <interfaces/chain.h>
 #include <key.h>
@@ -35,6 +36,7 @@
 #include <netbase.h>
 #include <policy/mempool.h>
 #include <policy/policy.h>
+#include <rawblockcache.h>
 #include <rpc/blockchain.h>
 #include <rpc/register.h>
 #include <rpc/server.h>
@@ -77,6 +79,7 @@
 #include <cstdint>
 #include <cstdio>
 #include <memory>
+#include <set>
 
 /** Default for -proxyrandomize */
 static constexpr bool DEFAULT_PROXYRANDOMIZE = true;
@@ -162,23 +165,37 @@ public:
         try {
             return CCoinsViewBacked::GetCoin(outpoint, coin);
         } catch (const std::runtime_error &e) {
-            uiInterface.ThreadSafeMessageBox(
-                _("Error reading from database, shutting down."), "",
-                CClientUIInterface::MSG_ERROR);
-            LogPrintf("Error reading from database: %s\n", e.what());
-            // Starting the shutdown sequence and returning false to the caller
-            // would be interpreted as 'entry not found' (as opposed to unable
-            // to read data), and could lead to invalid interpretation. Just
-            // exit immediately, as we can't continue anyway, and all writes
-            // should be atomic.
-            abort();
+            ReadError(e);
+        }
+    }
+    void GetCoins(const std::vector<COutPoint> &outpoints,
+                  std::vector<Coin> &coins) const override {
+        try {
+            base->GetCoins(outpoints, coins);
+        } catch (const std::runtime_error &e) {
+            ReadError(e);
         }
     }
     // Writes do not need similar protection, as failure to write is handled by
     // the caller.
+
+private:
+    [[noreturn]] static void ReadError(const std::runtime_error &e) {
+        uiInterface.ThreadSafeMessageBox(
+            _("Error reading from database, shutting down."), "",
+            CClientUIInterface::MSG_ERROR);
+        LogPrintf("Error reading from database: %s\n", e.what());
+        // Starting the shutdown sequence and returning false to the caller
+        // would be interpreted as 'entry not found' (as opposed to unable to
+        // read data), and could lead to invalid interpretation. Just exit
+        // immediately, as we can't continue anyway, and all writes should be
+        // atomic.
+        abort();
+    }
 };
 
 static std::unique_ptr<CCoinsViewErrorCatcher> pcoinscatcher;
+static std::set<BlockFilterType> g_enabled_filter_types;
 static std::unique_ptr<ECCVerifyHandle> globalVerifyHandle;
 
 static boost::thread_group threadGroup;
@@ -197,6 +214,7 @@ void Interrupt() {
     if (g_txindex) {
         g_txindex->Interrupt();
     }
+    ForEachBlockFilterIndex([](BlockFilterIndex &index) { index.Interrupt(); });
 }
 
 void Shutdown(InitInterfaces &interfaces) {
@@ -218,6 +236,7 @@ void Shutdown(InitInterfaces &interfaces) {
     StopREST();
     StopRPC();
     StopHTTPServer();
+    gbtl::Shutdown();
     for (const auto &client : interfaces.chain_clients) {
         client->flush();
     }
@@ -234,6 +253,7 @@ void Shutdown(InitInterfaces &interfaces) {
     if (g_txindex) {
         g_txindex->Stop();
     }
+    ForEachBlockFilterIndex([](BlockFilterIndex &index) { index.Stop(); });
 
     StopTorControl();
 
@@ -248,6 +268,7 @@ void Shutdown(InitInterfaces &interfaces) {
     g_connman.reset();
     g_banman.reset();
     g_txindex.reset();
+    DestroyAllBlockFilterIndexes();
 
     if (::g_mempool.IsLoaded() &&
         gArgs.GetArg("-persistmempool", DEFAULT_PERSIST_MEMPOOL)) {
@@ -276,7 +297,9 @@ void Shutdown(InitInterfaces &interfaces) {
             FlushStateToDisk();
         }
         pcoinsTip.reset();
+        pcoinscommitment.reset();
         pcoinscatcher.reset();
+        pcoinswriter.reset();
         pcoinsdbview.reset();
         pblocktree.reset();
     }
@@ -401,6 +424,12 @@ void SetupServerArgs() {
                            "(default: %d)",
                            DEFAULT_AUTOMATIC_UNPARKING),
                  true, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-batchschnorr",
+                 strprintf("Verify the Schnorr signatures of the transactions "
+                           "of a block in batches rather than one by one, when "
+                           "verifying them on several threads (default: %d)",
+                           DEFAULT_BATCH_SCHNORR_CHECKS),
+                 false, OptionsCategory::OPTIONS);
     gArgs.AddArg("-blocksdir=<dir>",
                  "Specify directory to hold blocks subdirectory for *.dat "
                  "files (default: <datadir>)",
@@ -408,6 +437,13 @@ void SetupServerArgs() {
     gArgs.AddArg("-indexdir=<dir>",
                  "Specify directory to hold leveldb files (default: <datadir>)",
                  false, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-blockfilterindex=<type>",
+                 strprintf("Maintain an index of compact filters by block "
+                           "(default: %s, values: %s).",
+                           DEFAULT_BLOCKFILTERINDEX, ListBlockFilterTypes()) +
+                     " If <type> is not supplied or if <type> = 1, indexes "
+                     "for all known types are enabled.",
+                 false, OptionsCategory::OPTIONS);
     gArgs.AddArg("-blocknotify=<cmd>",
                  "Execute command when the best block changes (%s in cmd is "
                  "replaced by block hash)",
@@ -429,6 +465,12 @@ void SetupServerArgs() {
                  false, OptionsCategory::OPTIONS);
     gArgs.AddArg("-datadir=<dir>", "Specify data directory", false,
                  OptionsCategory::OPTIONS);
+    gArgs.AddArg("-dbbackgroundflush",
+                 strprintf("Write the UTXO cache to the database from a "
+                           "background thread, without stalling validation "
+                           "(default: %d)",
+                           DEFAULT_DB_BACKGROUND_FLUSH),
+                 false, OptionsCategory::OPTIONS);
     gArgs.AddArg(
         "-dbbatchsize=<n>",
         strprintf("Maximum database write batch size in bytes (default: %u)",
@@ -526,6 +568,26 @@ void SetupServerArgs() {
                   MAX_SCRIPTCHECK_THREADS,
                   DEFAULT_SCRIPTCHECK_THREADS),
         false, OptionsCategory::OPTIONS);
+    gArgs.AddArg(
+        "-parallelinputchecks",
+        strprintf("Validate the inputs of the transactions of a block in "
+                  "parallel, using as many threads as -par (default: %d)",
+                  DEFAULT_PARALLEL_INPUT_CHECKS),
+        false, OptionsCategory::OPTIONS);
+    gArgs.AddArg(
+        "-prefetchthreads=<n>",
+        strprintf("Set the number of threads reading the coins spent by a "
+                  "block or transaction from the database ahead of their "
+                  "validation (up to %d, 0 = disable prefetching, default: %d)",
+                  MAX_PREFETCH_THREADS, DEFAULT_PREFETCH_THREADS),
+        false, OptionsCategory::OPTIONS);
+    gArgs.AddArg(
+        "-workstealing",
+        strprintf("Give each script verification thread its own queue of "
+                  "checks, and let idle threads steal from the others, instead "
+                  "of sharing a single queue (default: %d)",
+                  DEFAULT_WORK_STEALING),
+        false, OptionsCategory::OPTIONS);
     gArgs.AddArg("-parkdeepreorg",
                  strprintf("If connecting a new block would require rewinding "
                            "more than one block from the active chain (i.e., "
@@ -584,6 +646,13 @@ void SetupServerArgs() {
         strprintf("Use CashAddr address format for destination encoding instead of the legacy base58 format (default: %d)",
                   DEFAULT_USE_CASHADDR),
         false, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-utxocommitment",
+                 strprintf("Maintain a commitment to the UTXO set as blocks "
+                           "are connected, which lets the gettxoutsetinfo rpc "
+                           "call return without scanning the chainstate "
+                           "(default: %d)",
+                           DEFAULT_UTXO_COMMITMENT),
+                 false, OptionsCategory::OPTIONS);
 
     gArgs.AddArg("-addnode=<ip>",
                  "Add a node to connect to and attempt to keep the connection "
@@ -665,6 +734,12 @@ void SetupServerArgs() {
                   "backward by this amount. (default: %u seconds)",
                   DEFAULT_MAX_TIME_ADJUSTMENT),
         false, OptionsCategory::CONNECTION);
+    gArgs.AddArg("-netthreads=<n>",
+                 strprintf("Number of threads receiving from and sending to "
+                           "peers. Each peer is served by one of them for the "
+                           "lifetime of its connection (%d to %d, default: %d)",
+                           1, MAX_NET_THREADS, DEFAULT_NET_THREADS),
+                 false, OptionsCategory::CONNECTION);
     gArgs.AddArg("-onion=<ip:port>",
                  strprintf("Use separate SOCKS5 proxy to reach peers via Tor "
                            "hidden services (default: %s)",
@@ -694,9 +769,21 @@ void SetupServerArgs() {
                            "This enables Tor stream isolation (default: %d)",
                            DEFAULT_PROXYRANDOMIZE),
                  false, OptionsCategory::CONNECTION);
+    gArgs.AddArg("-rawblockcache=<n>",
+                 strprintf("Keep up to <n> MiB of blocks recently served to "
+                           "peers in memory, 0 to disable (default: %u)",
+                           DEFAULT_RAW_BLOCK_CACHE_SIZE),
+                 false, OptionsCategory::CONNECTION);
     gArgs.AddArg("-seednode=<ip>",
                  "Connect to a node to retrieve peer addresses, and disconnect",
                  false, OptionsCategory::CONNECTION);
+    gArgs.AddArg("-socketevents=<mode>",
+                 strprintf("Socket events mode used to wait on peer "
+                           "connections, one of: %s. Unlike select, epoll is "
+                           "not limited to %d connections (default: %s)",
+                           SupportedSocketEventsModes(), FD_SETSIZE,
+                           SocketEventsModeToString(DEFAULT_SOCKETEVENTS)),
+                 false, OptionsCategory::CONNECTION);
     gArgs.AddArg("-timeout=<n>",
                  strprintf("Specify connection timeout in milliseconds "
                            "(minimum: 1, default: %d)",
@@ -1095,6 +1182,12 @@ void SetupServerArgs() {
         "Domain from which to accept cross origin requests (browser enforced)",
         false, OptionsCategory::RPC);
 
+    gArgs.AddArg("-rpcbatchconcurrency=<n>",
+                 strprintf("Set the maximum number of requests of a JSON-RPC "
+                           "batch executed at the same time, by idle RPC "
+                           "threads (default: %d)",
+                           DEFAULT_RPC_BATCH_CONCURRENCY),
+                 false, OptionsCategory::RPC);
     gArgs.AddArg("-rpcworkqueue=<n>",
                  strprintf("Set the depth of the work queue to service RPC "
                            "calls (default: %d)",
@@ -1548,6 +1641,7 @@ int nUserMaxConnections;
 int nFD;
 ServiceFlags nLocalServices = ServiceFlags(NODE_NETWORK | NODE_NETWORK_LIMITED);
 int64_t peer_connect_timeout;
+SocketEventsMode socket_events_mode = DEFAULT_SOCKETEVENTS;
 
 } // namespace
 
@@ -1640,11 +1734,34 @@ bool AppInitParameterInteraction(Config &config) {
                 strprintf("Error creating index directory: %s", e.what()));
     }
 
+    // parse and validate enabled filter types
+    std::string blockfilterindex_value =
+        gArgs.GetArg("-blockfilterindex", DEFAULT_BLOCKFILTERINDEX);
+    if (blockfilterindex_value == "" || blockfilterindex_value == "1") {
+        g_enabled_filter_types.insert(AllBlockFilterTypes().begin(),
+                                      AllBlockFilterTypes().end());
+    } else if (blockfilterindex_value != "0") {
+        const std::vector<std::string> names =
+            gArgs.GetArgs("-blockfilterindex");
+        for (const auto &name : names) {
+            BlockFilterType filter_type;
+            if (!BlockFilterTypeByName(name, filter_type)) {
+                return InitError(
+                    strprintf(_("Unknown -blockfilterindex value %s."), name));
+            }
+            g_enabled_filter_types.insert(filter_type);
+        }
+    }
+
     // if using block pruning, then disallow txindex
     if (gArgs.GetArg("-prune", 0)) {
         if (gArgs.GetBoolArg("-txindex", DEFAULT_TXINDEX)) {
             return InitError(_("Prune mode is incompatible with -txindex."));
         }
+        if (!g_enabled_filter_types.empty()) {
+            return InitError(
+                _("Prune mode is incompatible with -blockfilterindex."));
+        }
     }
 
     // -bind and -whitebind can't be set when not listening
@@ -1655,6 +1772,15 @@ bool AppInitParameterInteraction(Config &config) {
             "Cannot set -bind or -whitebind together with -listen=0");
     }
 
+    if (gArgs.IsArgSet("-socketevents")) {
+        const std::string mode = gArgs.GetArg("-socketevents", "");
+        if (!SocketEventsModeFromString(mode, socket_events_mode)) {
+            return InitError(strprintf(
+                _("Invalid -socketevents mode '%s', must be one of: %s"), mode,
+                SupportedSocketEventsModes()));
+        }
+    }
+
     // Make sure enough file descriptors are available
     int nBind = std::max(nUserBind, size_t(1));
     nUserMaxConnections =
@@ -1664,11 +1790,13 @@ bool AppInitParameterInteraction(Config &config) {
     // Trim requested connection counts, to fit into system limitations
     // <int> in std::min<int>(...) to work around FreeBSD compilation issue
     // described in #2695
-    nMaxConnections =
-        std::max(std::min<int>(nMaxConnections, FD_SETSIZE - nBind -
-                                                    MIN_CORE_FILEDESCRIPTORS -
-                                                    MAX_ADDNODE_CONNECTIONS),
-                 0);
+    if (socket_events_mode == SocketEventsMode::Select) {
+        nMaxConnections = std::max(
+            std::min<int>(nMaxConnections, FD_SETSIZE - nBind -
+                                               MIN_CORE_FILEDESCRIPTORS -
+                                               MAX_ADDNODE_CONNECTIONS),
+            0);
+    }
     nFD = RaiseFileDescriptorLimit(nMaxConnections + MIN_CORE_FILEDESCRIPTORS +
                                    MAX_ADDNODE_CONNECTIONS);
     if (nFD < MIN_CORE_FILEDESCRIPTORS) {
@@ -1787,6 +1915,14 @@ bool AppInitParameterInteraction(Config &config) {
     } else if (nScriptCheckThreads > MAX_SCRIPTCHECK_THREADS) {
         nScriptCheckThreads = MAX_SCRIPTCHECK_THREADS;
     }
+    fParallelInputChecks = gArgs.GetBoolArg("-parallelinputchecks",
+                                            DEFAULT_PARALLEL_INPUT_CHECKS);
+    fBatchSchnorrChecks =
+        gArgs.GetBoolArg("-batchschnorr", DEFAULT_BATCH_SCHNORR_CHECKS);
+    nPrefetchThreads = std::max<int>(
+        0, std::min<int>(
+               gArgs.GetArg("-prefetchthreads", DEFAULT_PREFETCH_THREADS),
+               MAX_PREFETCH_THREADS));
 
     // Configure excessive block size.
     const uint64_t nProposedExcessiveBlockSize =
@@ -2078,8 +2214,25 @@ bool AppInitMain(Config &config, RPCServer &rpcServer,
     LogPrintf("Using %u threads for script verification\n",
               nScriptCheckThreads);
     if (nScriptCheckThreads) {
+        if (gArgs.GetBoolArg("-workstealing", DEFAULT_WORK_STEALING)) {
+            LogPrintf("Using work stealing script verification queues\n");
+            EnableCheckQueueWorkStealing(nScriptCheckThreads - 1);
+        }
         for (int i = 0; i < nScriptCheckThreads - 1; i++) {
             threadGroup.create_thread([i]() { return ThreadScriptCheck(i); });
+            threadGroup.create_thread([i]() { return ThreadHeaderCheck(i); });
+            threadGroup.create_thread([i]() { return ThreadTxPreCheck(i); });
+            if (fParallelInputChecks) {
+                threadGroup.create_thread(
+                    [i]() { return ThreadTxInputsCheck(i); });
+            }
+        }
+    }
+
+    if (nPrefetchThreads) {
+        LogPrintf("Using %u threads for coin prefetching\n", nPrefetchThreads);
+        for (int i = 0; i < nPrefetchThreads - 1; i++) {
+            threadGroup.create_thread([i]() { return ThreadCoinsRead(i); });
         }
     }
 
@@ -2320,6 +2473,14 @@ bool AppInitMain(Config &config, RPCServer &rpcServer,
                                       ? nMaxTxIndexCache << 20
                                       : 0);
     nTotalCache -= nTxIndexCache;
+    int64_t filter_index_cache = 0;
+    if (!g_enabled_filter_types.empty()) {
+        size_t n_indexes = g_enabled_filter_types.size();
+        int64_t max_cache =
+            std::min(nTotalCache / 8, max_filter_index_cache << 20);
+        filter_index_cache = max_cache / n_indexes;
+        nTotalCache -= filter_index_cache * n_indexes;
+    }
     // use 25%-50% of the remainder for disk cache
     int64_t nCoinDBCache =
         std::min(nTotalCache / 2, (nTotalCache / 4) + (1 << 23));
@@ -2336,6 +2497,11 @@ bool AppInitMain(Config &config, RPCServer &rpcServer,
         LogPrintf("* Using %.1fMiB for transaction index database\n",
                   nTxIndexCache * (1.0 / 1024 / 1024));
     }
+    for (BlockFilterType filter_type : g_enabled_filter_types) {
+        LogPrintf("* Using %.1f MiB for %s block filter index database\n",
+                  filter_index_cache * (1.0 / 1024 / 1024),
+                  BlockFilterTypeName(filter_type));
+    }
     LogPrintf("* Using %.1fMiB for chain state database\n",
               nCoinDBCache * (1.0 / 1024 / 1024));
     LogPrintf("* Using %.1fMiB for in-memory UTXO set (plus up to %.1fMiB of "
@@ -2356,8 +2522,9 @@ bool AppInitMain(Config &config, RPCServer &rpcServer,
                 LOCK(cs_main);
                 UnloadBlockIndex();
                 pcoinsTip.reset();
-                pcoinsdbview.reset();
                 pcoinscatcher.reset();
+                pcoinswriter.reset();
+                pcoinsdbview.reset();
                 // new CBlockTreeDB tries to delete the existing file, which
                 // fails if it's still open from the previous loop. Close it
                 // first:
@@ -2425,8 +2592,16 @@ bool AppInitMain(Config &config, RPCServer &rpcServer,
 
                 pcoinsdbview.reset(new CCoinsViewDB(
                     nCoinDBCache, false, fReset || fReindexChainState));
-                pcoinscatcher.reset(
-                    new CCoinsViewErrorCatcher(pcoinsdbview.get()));
+                if (gArgs.GetBoolArg("-dbbackgroundflush",
+                                     DEFAULT_DB_BACKGROUND_FLUSH)) {
+                    pcoinswriter.reset(
+                        new CCoinsViewBackgroundWriter(*pcoinsdbview));
+                    pcoinscatcher.reset(
+                        new CCoinsViewErrorCatcher(pcoinswriter.get()));
+                } else {
+                    pcoinscatcher.reset(
+                        new CCoinsViewErrorCatcher(pcoinsdbview.get()));
+                }
 
                 // If necessary, upgrade from older database format.
                 // This is a no-op if we cleared the coinsviewdb with -reindex
@@ -2537,6 +2712,18 @@ bool AppInitMain(Config &config, RPCServer &rpcServer,
         LogPrintf(" block index %15dms\n", GetTimeMillis() - nStart);
     }
 
+    if (gArgs.GetBoolArg("-utxocommitment", DEFAULT_UTXO_COMMITMENT)) {
+        uiInterface.InitMessage(_("Loading UTXO set commitment..."));
+        if (!LoadCoinsCommitment()) {
+            if (ShutdownRequested()) {
+                LogPrintf("Shutdown requested. Exiting.\n");
+                return false;
+            }
+            return InitError(
+                _("Unable to compute the commitment to the UTXO set"));
+        }
+    }
+
     // Encoded addresses using cashaddr instead of base58.
     // We do this by default to avoid confusion with BTC addresses.
     config.SetCashAddrEncoding(gArgs.GetBoolArg("-usecashaddr", DEFAULT_USE_CASHADDR));
@@ -2547,6 +2734,11 @@ bool AppInitMain(Config &config, RPCServer &rpcServer,
         g_txindex->Start();
     }
 
+    for (const auto &filter_type : g_enabled_filter_types) {
+        InitBlockFilterIndex(filter_type, filter_index_cache, false, fReindex);
+        GetBlockFilterIndex(filter_type)->Start();
+    }
+
     // Step 9: load wallet
     for (const auto &client : interfaces.chain_clients) {
         if (!client->load(chainparams)) {
@@ -2672,6 +2864,9 @@ bool AppInitMain(Config &config, RPCServer &rpcServer,
     connOptions.nMaxOutboundTimeframe = nMaxOutboundTimeframe;
     connOptions.nMaxOutboundLimit = nMaxOutboundLimit;
     connOptions.m_peer_connect_timeout = peer_connect_timeout;
+    connOptions.m_socket_events_mode = socket_events_mode;
+    connOptions.m_net_threads =
+        gArgs.GetArg("-netthreads", DEFAULT_NET_THREADS);
 
     for (const std::string &strBind : gArgs.GetArgs("-bind")) {
         CService addrBind;
@@ -5,6 +5,7 @@
 #ifndef BITCOIN_MEMUSAGE_H
 #define BITCOIN_MEMUSAGE_H
 
+#include <flathashmap.h>
 #include <indirectmap.h>
 #include <prevector.h>
 
@@ -179,6 +180,18 @@ static inline size_t DynamicUsage(const std::unordered_map<X, Y, Z> &m) {
                m.size() +
            MallocUsage(sizeof(void *) * m.bucket_count());
 }
+
+template <typename X, typename Y, typename Z>
+static inline size_t DynamicUsage(const FlatHashMap<X, Y, Z> &m) {
+    size_t usage = MallocUsage(sizeof(uint64_t) * m.bucket_count()) +
+                   MallocUsage(sizeof(void *) * m.chunk_count()) +
+                   MallocUsage((m.entry_count() + 7) / 8);
+    for (size_t i = 0; i < m.chunk_count(); i++) {
+        usage += MallocUsage(sizeof(std::pair<const X, Y>) *
+                             FlatHashMap<X, Y, Z>::chunk_size(i));
+    }
+    return usage;
+}
 } // namespace memusage
 
 #endif // BITCOIN_MEMUSAGE_H
@@ -29,6 +29,8 @@
 #include <validationinterface.h>
 #include <pow.h>
 #include <algorithm>
+#include <functional>
+#include <iterator>
 #include <queue>
 #include <utility>
 
@@ -63,16 +65,50 @@ uint64_t CTxMemPoolModifiedEntry::GetVirtualSizeWithAncestors() const {
                                      nSigOpCountWithAncestors);
 }
 
+BlockTemplateCandidate::BlockTemplateCandidate(CTxMemPool &pool) {
+    m_connNotifyEntryAdded = pool.NotifyEntryAdded.connect(
+        std::bind(&BlockTemplateCandidate::TransactionAdded, this,
+                  std::placeholders::_1));
+    m_connNotifyEntryRemoved = pool.NotifyEntryRemoved.connect(
+        std::bind(&BlockTemplateCandidate::TransactionRemoved, this,
+                  std::placeholders::_1, std::placeholders::_2));
+}
+
+void BlockTemplateCandidate::TransactionAdded(CTransactionRef tx) {
+    if (fValid) {
+        vAddedTxIds.push_back(tx->GetId());
+    }
+}
+
+void BlockTemplateCandidate::TransactionRemoved(CTransactionRef tx,
+                                                MemPoolRemovalReason reason) {
+    // The selection may refer to the transaction, and the packages of its
+    // descendants change.
+    if (fValid) {
+        Invalidate();
+    }
+}
+
+void BlockTemplateCandidate::Invalidate() {
+    fValid = false;
+    pindexPrev = nullptr;
+    vAddedTxIds.clear();
+    entries.clear();
+    inBlock.clear();
+}
+
 BlockAssembler::Options::Options()
     : nExcessiveBlockSize(DEFAULT_EXCESSIVE_BLOCK_SIZE),
       nMaxGeneratedBlockSize(DEFAULT_MAX_GENERATED_BLOCK_SIZE),
-      blockMinFeeRate(DEFAULT_BLOCK_MIN_TX_FEE_PER_KB) {}
+      blockMinFeeRate(DEFAULT_BLOCK_MIN_TX_FEE_PER_KB),
+      fTestBlockValidity(true) {}
 
 BlockAssembler::BlockAssembler(const CChainParams &params,
                                const CTxMemPool &_mempool,
                                const Options &options)
     : chainparams(params), mempool(&_mempool) {
     blockMinFeeRate = options.blockMinFeeRate;
+    fTestBlockValidity = options.fTestBlockValidity;
     // Limit size to between 1K and options.nExcessiveBlockSize -1K for sanity:
     nMaxGeneratedBlockSize = std::max<uint64_t>(
         1000, std::min<uint64_t>(options.nExcessiveBlockSize - 1000,
@@ -124,10 +160,77 @@ void BlockAssembler::resetBlock() {
     // These counters do not include coinbase tx.
     nBlockTx = 0;
     nFees = Amount::zero();
+
+    fCapacityLimited = false;
+    nResumedEntries = 0;
+}
+
+bool BlockAssembler::ResumeFrom(BlockTemplateCandidate &candidate,
+                                const CBlockIndex *pindexPrev,
+                                std::vector<CTxMemPool::txiter> &newTxs) {
+    // Transactions only ever enter the mempool after their parents, so the
+    // selection is still valid, and the packages it rejected are unchanged,
+    // if nothing but additions updated the mempool since. If a package was
+    // left out for lack of room, the new ones could compete with the
+    // selected ones, so it has to be made again.
+    if (!candidate.fValid || candidate.pindexPrev != pindexPrev ||
+        candidate.nMaxGeneratedBlockSize != nMaxGeneratedBlockSize ||
+        candidate.nMaxGeneratedBlockSigChecks != nMaxGeneratedBlockSigChecks ||
+        candidate.blockMinFeeRate != blockMinFeeRate ||
+        mempool->GetTransactionsUpdated() !=
+            candidate.nTransactionsUpdated + candidate.vAddedTxIds.size()) {
+        candidate.Invalidate();
+        return false;
+    }
+
+    newTxs.reserve(candidate.vAddedTxIds.size());
+    for (const TxId &txid : candidate.vAddedTxIds) {
+        CTxMemPool::txiter it = mempool->mapTx.find(txid);
+        assert(it != mempool->mapTx.end());
+        newTxs.push_back(it);
+    }
+
+    nResumedEntries = candidate.entries.size();
+    pblocktemplate->entries.insert(
+        pblocktemplate->entries.end(),
+        std::make_move_iterator(candidate.entries.begin()),
+        std::make_move_iterator(candidate.entries.end()));
+    inBlock = std::move(candidate.inBlock);
+    nBlockSize = candidate.nBlockSize;
+    nBlockTx = candidate.nBlockTx;
+    nBlockSigOps = candidate.nBlockSigOps;
+    nFees = candidate.nFees;
+
+    // The state is stored again once the new template is made.
+    candidate.Invalidate();
+    return true;
+}
+
+void BlockAssembler::SaveTo(BlockTemplateCandidate &candidate,
+                            const CBlockIndex *pindexPrev) {
+    candidate.Invalidate();
+    if (fCapacityLimited) {
+        return;
+    }
+
+    candidate.pindexPrev = pindexPrev;
+    candidate.nMaxGeneratedBlockSize = nMaxGeneratedBlockSize;
+    candidate.nMaxGeneratedBlockSigChecks = nMaxGeneratedBlockSigChecks;
+    candidate.blockMinFeeRate = blockMinFeeRate;
+    candidate.nTransactionsUpdated = mempool->GetTransactionsUpdated();
+    candidate.entries.assign(pblocktemplate->entries.begin() + 1,
+                             pblocktemplate->entries.end());
+    candidate.inBlock = std::move(inBlock);
+    candidate.nBlockSize = nBlockSize;
+    candidate.nBlockTx = nBlockTx;
+    candidate.nBlockSigOps = nBlockSigOps;
+    candidate.nFees = nFees;
+    candidate.fValid = true;
 }
 
 std::unique_ptr<CBlockTemplate>
-BlockAssembler::CreateNewBlock(const CScript &scriptPubKeyIn) {
+BlockAssembler::CreateNewBlock(const CScript &scriptPubKeyIn,
+                               BlockTemplateCandidate *pcandidate) {
     int64_t nTimeStart = GetTimeMicros();
 
     resetBlock();
@@ -163,15 +266,26 @@ BlockAssembler::CreateNewBlock(const CScript &scriptPubKeyIn) {
 
     int nPackagesSelected = 0;
     int nDescendantsUpdated = 0;
-    addPackageTxs(nPackagesSelected, nDescendantsUpdated);
+    std::vector<CTxMemPool::txiter> newTxs;
+    if (pcandidate && ResumeFrom(*pcandidate, pindexPrev, newTxs)) {
+        addPackageTxs(nPackagesSelected, nDescendantsUpdated, &newTxs);
+    } else {
+        addPackageTxs(nPackagesSelected, nDescendantsUpdated);
+    }
 
     if (IsMagneticAnomalyEnabled(consensusParams, pindexPrev)) {
         // If magnetic anomaly is enabled, we make sure transaction are
-        // canonically ordered.
-        std::sort(std::begin(pblocktemplate->entries) + 1,
-                  std::end(pblocktemplate->entries),
-                  [](const CBlockTemplateEntry &a, const CBlockTemplateEntry &b)
-                      -> bool { return a.tx->GetId() < b.tx->GetId(); });
+        // canonically ordered. Resumed entries already are, so only the new
+        // ones need to be sorted and merged with them.
+        auto compare = [](const CBlockTemplateEntry &a,
+                          const CBlockTemplateEntry &b) -> bool {
+            return a.tx->GetId() < b.tx->GetId();
+        };
+        auto first = std::begin(pblocktemplate->entries) + 1;
+        auto middle = first + nResumedEntries;
+        std::sort(middle, std::end(pblocktemplate->entries), compare);
+        std::inplace_merge(first, middle, std::end(pblocktemplate->entries),
+                           compare);
     }
 
     // Copy all the transactions refs into the block
@@ -221,7 +335,8 @@ BlockAssembler::CreateNewBlock(const CScript &scriptPubKeyIn) {
     pblocktemplate->entries[0].sigOpCount = 0;
 
     CValidationState state;
-    if (!TestBlockValidity(state, chainparams, *pblock, pindexPrev,
+    if (fTestBlockValidity &&
+        !TestBlockValidity(state, chainparams, *pblock, pindexPrev,
                            BlockValidationOptions(GetConfig())
                                .withCheckPoW(false)
                                .withCheckMerkleRoot(false))) {
@@ -233,11 +348,16 @@ BlockAssembler::CreateNewBlock(const CScript &scriptPubKeyIn) {
 
     LogPrint(BCLog::BENCH,
              "CreateNewBlock() packages: %.2fms (%d packages, %d updated "
-             "descendants), validity: %.2fms (total %.2fms)\n",
+             "descendants, %u resumed txs), validity: %.2fms (total "
+             "%.2fms)\n",
              0.001 * (nTime1 - nTimeStart), nPackagesSelected,
-             nDescendantsUpdated, 0.001 * (nTime2 - nTime1),
+             nDescendantsUpdated, nResumedEntries, 0.001 * (nTime2 - nTime1),
              0.001 * (nTime2 - nTimeStart));
 
+    if (pcandidate) {
+        SaveTo(*pcandidate, pindexPrev);
+    }
+
     return std::move(pblocktemplate);
 }
 
@@ -313,22 +433,48 @@ void BlockAssembler::AddToBlock(CTxMemPool::txiter iter) {
     }
 }
 
+CTxMemPoolModifiedEntry
+BlockAssembler::ModifiedEntryFor(CTxMemPool::txiter it) const {
+    CTxMemPoolModifiedEntry modEntry(it);
+    CTxMemPool::setEntries ancestors;
+    uint64_t nNoLimit = std::numeric_limits<uint64_t>::max();
+    std::string dummy;
+    mempool->CalculateMemPoolAncestors(*it, ancestors, nNoLimit, nNoLimit,
+                                       nNoLimit, nNoLimit, dummy, false);
+    for (CTxMemPool::txiter ancestor : ancestors) {
+        if (inBlock.count(ancestor)) {
+            modEntry.nSizeWithAncestors -= ancestor->GetTxSize();
+            modEntry.nModFeesWithAncestors -= ancestor->GetModifiedFee();
+            modEntry.nSigOpCountWithAncestors -= ancestor->GetSigOpCount();
+        }
+    }
+    return modEntry;
+}
+
 int BlockAssembler::UpdatePackagesForAdded(
     const CTxMemPool::setEntries &alreadyAdded,
-    indexed_modified_transaction_set &mapModifiedTx) {
+    indexed_modified_transaction_set &mapModifiedTx, bool fResumed) {
     int nDescendantsUpdated = 0;
+    // Descendants entered in the modified set with all their ancestors in the
+    // block accounted for, which must not be updated again.
+    CTxMemPool::setEntries updatedForAll;
     for (CTxMemPool::txiter it : alreadyAdded) {
         CTxMemPool::setEntries descendants;
         mempool->CalculateDescendants(it, descendants);
         // Insert all descendants (not yet in block) into the modified set.
         for (CTxMemPool::txiter desc : descendants) {
-            if (alreadyAdded.count(desc)) {
+            if (alreadyAdded.count(desc) || updatedForAll.count(desc)) {
                 continue;
             }
 
             ++nDescendantsUpdated;
             modtxiter mit = mapModifiedTx.find(desc);
-            if (mit == mapModifiedTx.end()) {
+            if (mit == mapModifiedTx.end() && fResumed) {
+                // The descendant may also have ancestors selected in a
+                // previous template, which were never accounted for.
+                mapModifiedTx.insert(ModifiedEntryFor(desc));
+                updatedForAll.insert(desc);
+            } else if (mit == mapModifiedTx.end()) {
                 CTxMemPoolModifiedEntry modEntry(desc);
                 modEntry.nSizeWithAncestors -= it->GetTxSize();
                 modEntry.nModFeesWithAncestors -= it->GetModifiedFee();
@@ -377,8 +523,9 @@ void BlockAssembler::SortForBlock(
  * @param[out] nPackagesSelected    How many packages were selected
  * @param[out] nDescendantsUpdated  Number of descendant transactions updated
  */
-void BlockAssembler::addPackageTxs(int &nPackagesSelected,
-                                   int &nDescendantsUpdated) {
+void BlockAssembler::addPackageTxs(
+    int &nPackagesSelected, int &nDescendantsUpdated,
+    const std::vector<CTxMemPool::txiter> *pnewTxs) {
     // selection algorithm orders the mempool based on feerate of a
     // transaction including all unconfirmed ancestors. Since we don't remove
     // transactions from the mempool as we select them for block inclusion, we
@@ -396,14 +543,26 @@ void BlockAssembler::addPackageTxs(int &nPackagesSelected,
     // Keep track of entries that failed inclusion, to avoid duplicate work.
     CTxMemPool::setEntries failedTx;
 
-    // Start by adding all descendants of previously added txs to mapModifiedTx
-    // and modifying them for their already included ancestors.
-    UpdatePackagesForAdded(inBlock, mapModifiedTx);
-
     CTxMemPool::indexed_transaction_set::index<ancestor_score>::type::iterator
         mi = mempool->mapTx.get<ancestor_score>().begin();
     CTxMemPool::txiter iter;
 
+    if (pnewTxs) {
+        // The packages of the other transactions were already evaluated for
+        // the resumed selection, so mapTx isn't walked: the new transactions
+        // are only considered from mapModifiedTx, along with the descendants
+        // of what gets selected.
+        for (CTxMemPool::txiter it : *pnewTxs) {
+            mapModifiedTx.insert(ModifiedEntryFor(it));
+        }
+        mi = mempool->mapTx.get<ancestor_score>().end();
+    } else {
+        // Start by adding all descendants of previously added txs to
+        // mapModifiedTx and modifying them for their already included
+        // ancestors.
+        UpdatePackagesForAdded(inBlock, mapModifiedTx);
+    }
+
     // Limit the number of attempts to add transactions to the block when it is
     // close to full; this is just a simple heuristic to finish quickly if the
     // mempool has a lot of entries.
@@ -477,6 +636,7 @@ void BlockAssembler::addPackageTxs(int &nPackagesSelected,
         // having an accurate call to
         // GetMaxBlockSigOpsCount(blockSizeWithPackage).
         if (!TestPackage(packageSize, packageSigOps)) {
+            fCapacityLimited = true;
             if (fUsingModified) {
                 // Since we always look at the best entry in mapModifiedTx, we
                 // must erase failed entries so that we can consider the next
@@ -531,7 +691,8 @@ void BlockAssembler::addPackageTxs(int &nPackagesSelected,
         ++nPackagesSelected;
 
         // Update transactions that depend on each of these
-        nDescendantsUpdated += UpdatePackagesForAdded(ancestors, mapModifiedTx);
+        nDescendantsUpdated += UpdatePackagesForAdded(ancestors, mapModifiedTx,
+                                                      pnewTxs != nullptr);
     }
 }
 
@@ -128,6 +128,60 @@ struct update_for_parent_inclusion {
     CTxMemPool::txiter iter;
 };
 
+/**
+ * The package selection of the last block template, kept along with the
+ * transactions added to the mempool since it was made.
+ *
+ * When the tip didn't change, no transaction left the mempool and the last
+ * template had room for every package paying enough fees, BlockAssembler
+ * resumes the selection from this state: only the new transactions, and the
+ * packages they change, are considered instead of the whole mempool. In any
+ * other case the next template is assembled from scratch.
+ *
+ * The state is only accessed with the mempool lock held, under which the
+ * mempool notifies the transactions it adds and removes.
+ */
+class BlockTemplateCandidate {
+public:
+    explicit BlockTemplateCandidate(CTxMemPool &pool);
+
+    /**
+     * Whether a selection is stored, and no transaction left the mempool
+     * since it was made.
+     */
+    bool IsValid() const { return fValid; }
+
+private:
+    void TransactionAdded(CTransactionRef tx);
+    void TransactionRemoved(CTransactionRef tx, MemPoolRemovalReason reason);
+    void Invalidate();
+
+    boost::signals2::scoped_connection m_connNotifyEntryAdded;
+    boost::signals2::scoped_connection m_connNotifyEntryRemoved;
+
+    bool fValid = false;
+
+    // What the selection was made for
+    const CBlockIndex *pindexPrev = nullptr;
+    uint64_t nMaxGeneratedBlockSize = 0;
+    uint64_t nMaxGeneratedBlockSigChecks = 0;
+    CFeeRate blockMinFeeRate;
+    unsigned int nTransactionsUpdated = 0;
+
+    // Transactions added to the mempool since
+    std::vector<TxId> vAddedTxIds;
+
+    // The selected transactions, without the coinbase
+    std::vector<CBlockTemplateEntry> entries;
+    CTxMemPool::setEntries inBlock;
+    uint64_t nBlockSize = 0;
+    uint64_t nBlockTx = 0;
+    uint64_t nBlockSigOps = 0;
+    Amount nFees;
+
+    friend class BlockAssembler;
+};
+
 /** Generate a new block, without valid proof-of-work */
 class BlockAssembler {
 private:
@@ -140,6 +194,7 @@ private:
     uint64_t nMaxGeneratedBlockSize;
     uint64_t nMaxGeneratedBlockSigChecks;
     CFeeRate blockMinFeeRate;
+    bool fTestBlockValidity;
 
     // Information on the current status of the block
     uint64_t nBlockSize;
@@ -147,6 +202,10 @@ private:
     uint64_t nBlockSigOps;
     Amount nFees;
     CTxMemPool::setEntries inBlock;
+    // Whether a package was left out for lack of room in the block
+    bool fCapacityLimited;
+    // Number of entries, after the coinbase, taken from a candidate template
+    size_t nResumedEntries;
 
     // Chain context for the block
     int nHeight;
@@ -162,15 +221,21 @@ public:
         uint64_t nExcessiveBlockSize;
         uint64_t nMaxGeneratedBlockSize;
         CFeeRate blockMinFeeRate;
+        bool fTestBlockValidity;
     };
 
     BlockAssembler(const Config &config, const CTxMemPool &_mempool);
     BlockAssembler(const CChainParams &params, const CTxMemPool &_mempool,
                    const Options &options);
 
-    /** Construct a new block template with coinbase to scriptPubKeyIn */
+    /**
+     * Construct a new block template with coinbase to scriptPubKeyIn. If
+     * pcandidate is not null, the selection of the transactions is resumed
+     * from it when possible, and it is updated with the new selection.
+     */
     std::unique_ptr<CBlockTemplate>
-    CreateNewBlock(const CScript &scriptPubKeyIn);
+    CreateNewBlock(const CScript &scriptPubKeyIn,
+                   BlockTemplateCandidate *pcandidate = nullptr);
 
     uint64_t GetMaxGeneratedBlockSize() const { return nMaxGeneratedBlockSize; }
 
@@ -180,14 +245,31 @@ private:
     void resetBlock();
     /** Add a tx to the block */
     void AddToBlock(CTxMemPool::txiter iter);
+    /**
+     * Restore the selection of the candidate if it can be resumed, and return
+     * the transactions added to the mempool since.
+     */
+    bool ResumeFrom(BlockTemplateCandidate &candidate,
+                    const CBlockIndex *pindexPrev,
+                    std::vector<CTxMemPool::txiter> &newTxs)
+        EXCLUSIVE_LOCKS_REQUIRED(mempool->cs);
+    /** Store the selection of the block in the candidate */
+    void SaveTo(BlockTemplateCandidate &candidate,
+                const CBlockIndex *pindexPrev)
+        EXCLUSIVE_LOCKS_REQUIRED(mempool->cs);
 
     // Methods for how to add transactions to a block.
     /**
      * Add transactions based on feerate including unconfirmed ancestors.
      * Increments nPackagesSelected / nDescendantsUpdated with corresponding
-     * statistics from the package selection (for logging statistics).
+     * statistics from the package selection (for logging statistics). If
+     * pnewTxs is not null, the block holds a resumed selection and only the
+     * packages of these transactions, added to the mempool since, are
+     * considered.
      */
-    void addPackageTxs(int &nPackagesSelected, int &nDescendantsUpdated)
+    void addPackageTxs(
+        int &nPackagesSelected, int &nDescendantsUpdated,
+        const std::vector<CTxMemPool::txiter> *pnewTxs = nullptr)
         EXCLUSIVE_LOCKS_REQUIRED(mempool->cs);
 
     // helper functions for addPackageTxs()
@@ -210,16 +292,24 @@ private:
                         indexed_modified_transaction_set &mapModifiedTx,
                         CTxMemPool::setEntries &failedTx)
         EXCLUSIVE_LOCKS_REQUIRED(mempool->cs);
+    /**
+     * The ancestor state of a transaction, updated for all its ancestors
+     * already in the block.
+     */
+    CTxMemPoolModifiedEntry ModifiedEntryFor(CTxMemPool::txiter it) const
+        EXCLUSIVE_LOCKS_REQUIRED(mempool->cs);
     /** Sort the package in an order that is valid to appear in a block */
     void SortForBlock(const CTxMemPool::setEntries &package,
                       std::vector<CTxMemPool::txiter> &sortedEntries);
     /**
      * Add descendants of given transactions to mapModifiedTx with ancestor
      * state updated assuming given transactions are inBlock. Returns number of
-     * updated descendants.
+     * updated descendants. If fResumed, the block also holds transactions
+     * whose descendants were never added to mapModifiedTx.
      */
     int UpdatePackagesForAdded(const CTxMemPool::setEntries &alreadyAdded,
-                               indexed_modified_transaction_set &mapModifiedTx)
+                               indexed_modified_transaction_set &mapModifiedTx,
+                               bool fResumed = false)
         EXCLUSIVE_LOCKS_REQUIRED(mempool->cs);
 };
 
@@ -30,6 +30,10 @@
 #include <fcntl.h>
 #endif
 
+#ifdef USE_EPOLL
+#include <sys/epoll.h>
+#endif
+
 #ifdef USE_UPNP
 #include <miniupnpc/miniupnpc.h>
 #include <miniupnpc/miniwget.h>
@@ -37,7 +41,9 @@
 #include <miniupnpc/upnperrors.h>
 #endif
 
+#include <array>
 #include <cmath>
+#include <unordered_map>
 
 // Dump addresses to peers.dat every 15 minutes (900s)
 static constexpr int DUMP_PEERS_INTERVAL = 15 * 60;
@@ -622,6 +628,9 @@ bool CNode::ReceiveMsgBytes(const Config &config, const char *pch,
             i->second += msg.hdr.nMessageSize + CMessageHeader::HEADER_SIZE;
 
             msg.nTime = nTimeMicros;
+            // Finish the checksum on the network thread of the peer, so the
+            // message handler only has to compare it.
+            msg.GetMessageHash();
             complete = true;
         }
     }
@@ -1025,7 +1034,8 @@ void CConnman::AcceptConnection(const ListenSocket &hListenSocket) {
         return;
     }
 
-    if (!IsSelectableSocket(hSocket)) {
+    if (m_socket_events_mode == SocketEventsMode::Select &&
+        !IsSelectableSocket(hSocket)) {
         LogPrintf("connection from %s dropped: non-selectable socket\n",
                   addr.ToString());
         CloseSocket(hSocket);
@@ -1200,33 +1210,59 @@ void CConnman::InactivityCheck(CNode *pnode) {
     }
 }
 
-void CConnman::SocketHandler() {
-    //
-    // Find which sockets have data to receive
-    //
-    struct timeval timeout;
-    timeout.tv_sec = 0;
-    // Frequency to poll pnode->vSend
-    timeout.tv_usec = 50000;
+bool SocketEventsModeFromString(const std::string &str,
+                                SocketEventsMode &mode) {
+    if (str == "select") {
+        mode = SocketEventsMode::Select;
+        return true;
+    }
+#ifdef USE_EPOLL
+    if (str == "epoll") {
+        mode = SocketEventsMode::EPoll;
+        return true;
+    }
+#endif
+    return false;
+}
 
-    fd_set fdsetRecv;
-    fd_set fdsetSend;
-    fd_set fdsetError;
-    FD_ZERO(&fdsetRecv);
-    FD_ZERO(&fdsetSend);
-    FD_ZERO(&fdsetError);
-    SOCKET hSocketMax = 0;
-    bool have_fds = false;
+std::string SocketEventsModeToString(SocketEventsMode mode) {
+    switch (mode) {
+        case SocketEventsMode::Select:
+            return "select";
+        case SocketEventsMode::EPoll:
+            return "epoll";
+    }
+    assert(false);
+}
 
-    for (const ListenSocket &hListenSocket : vhListenSocket) {
-        FD_SET(hListenSocket.socket, &fdsetRecv);
-        hSocketMax = std::max(hSocketMax, hListenSocket.socket);
-        have_fds = true;
+std::string SupportedSocketEventsModes() {
+#ifdef USE_EPOLL
+    return "select, epoll";
+#else
+    return "select";
+#endif
+}
+
+int CConnman::GetNetThread(const CNode *pnode) const {
+    return int(pnode->GetId() % m_net_threads);
+}
+
+void CConnman::SocketEventsSelect(int thread_index, std::set<SOCKET> &recv_set,
+                                  std::set<SOCKET> &send_set,
+                                  std::set<SOCKET> &error_set) {
+    if (thread_index == 0) {
+        for (const ListenSocket &hListenSocket : vhListenSocket) {
+            recv_set.insert(hListenSocket.socket);
+        }
     }
 
     {
         LOCK(cs_vNodes);
         for (CNode *pnode : vNodes) {
+            if (GetNetThread(pnode) != thread_index) {
+                continue;
+            }
+
             // Implement the following logic:
             // * If there is data to send, select() for sending data. As this
             //   only happens when optimistic write failed, we choose to first
@@ -1251,20 +1287,58 @@ void CConnman::SocketHandler() {
                 continue;
             }
 
-            FD_SET(pnode->hSocket, &fdsetError);
-            hSocketMax = std::max(hSocketMax, pnode->hSocket);
-            have_fds = true;
+            // Outbound sockets are only checked against FD_SETSIZE by
+            // netbase when it waits with select() itself.
+            if (!IsSelectableSocket(pnode->hSocket)) {
+                LogPrint(BCLog::NET,
+                         "non-selectable socket for peer=%d, disconnecting\n",
+                         pnode->GetId());
+                pnode->fDisconnect = true;
+                continue;
+            }
 
+            error_set.insert(pnode->hSocket);
             if (select_send) {
-                FD_SET(pnode->hSocket, &fdsetSend);
+                send_set.insert(pnode->hSocket);
                 continue;
             }
             if (select_recv) {
-                FD_SET(pnode->hSocket, &fdsetRecv);
+                recv_set.insert(pnode->hSocket);
             }
         }
     }
 
+    //
+    // Find which sockets have data to receive
+    //
+    struct timeval timeout;
+    timeout.tv_sec = 0;
+    // Frequency to poll pnode->vSend
+    timeout.tv_usec = 50000;
+
+    fd_set fdsetRecv;
+    fd_set fdsetSend;
+    fd_set fdsetError;
+    FD_ZERO(&fdsetRecv);
+    FD_ZERO(&fdsetSend);
+    FD_ZERO(&fdsetError);
+    SOCKET hSocketMax = 0;
+
+    for (SOCKET hSocket : recv_set) {
+        FD_SET(hSocket, &fdsetRecv);
+        hSocketMax = std::max(hSocketMax, hSocket);
+    }
+    for (SOCKET hSocket : send_set) {
+        FD_SET(hSocket, &fdsetSend);
+        hSocketMax = std::max(hSocketMax, hSocket);
+    }
+    for (SOCKET hSocket : error_set) {
+        FD_SET(hSocket, &fdsetError);
+        hSocketMax = std::max(hSocketMax, hSocket);
+    }
+    const bool have_fds =
+        !recv_set.empty() || !send_set.empty() || !error_set.empty();
+
     int nSelect = select(have_fds ? hSocketMax + 1 : 0, &fdsetRecv, &fdsetSend,
                          &fdsetError, &timeout);
     if (interruptNet) {
@@ -1275,24 +1349,214 @@ void CConnman::SocketHandler() {
         if (have_fds) {
             int nErr = WSAGetLastError();
             LogPrintf("socket select error %s\n", NetworkErrorString(nErr));
-            for (unsigned int i = 0; i <= hSocketMax; i++) {
-                FD_SET(i, &fdsetRecv);
+            // Try to receive from every socket, the error will surface there.
+            recv_set.insert(send_set.begin(), send_set.end());
+            recv_set.insert(error_set.begin(), error_set.end());
+        }
+        send_set.clear();
+        error_set.clear();
+        interruptNet.sleep_for(
+            std::chrono::milliseconds(timeout.tv_usec / 1000));
+        return;
+    }
+
+    auto erase_unset = [](std::set<SOCKET> &set, fd_set &fdset) {
+        for (auto it = set.begin(); it != set.end();) {
+            if (FD_ISSET(*it, &fdset)) {
+                ++it;
+            } else {
+                it = set.erase(it);
             }
         }
-        FD_ZERO(&fdsetSend);
-        FD_ZERO(&fdsetError);
-        if (!interruptNet.sleep_for(
-                std::chrono::milliseconds(timeout.tv_usec / 1000))) {
-            return;
+    };
+    erase_unset(recv_set, fdsetRecv);
+    erase_unset(send_set, fdsetSend);
+    erase_unset(error_set, fdsetError);
+}
+
+#ifdef USE_EPOLL
+/** Most readiness events taken from the kernel per epoll_wait() call */
+static constexpr int EPOLL_MAX_EVENTS = 1024;
+
+bool CConnman::InitSocketEventsEPoll() {
+    auto close_all = [this]() {
+        for (int epoll_fd : m_epoll_fds) {
+            close(epoll_fd);
+        }
+        m_epoll_fds.clear();
+    };
+
+    for (int i = 0; i < m_net_threads; i++) {
+        int epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+        if (epoll_fd == -1) {
+            LogPrintf("epoll_create1 failed: %s\n",
+                      NetworkErrorString(WSAGetLastError()));
+            close_all();
+            return false;
+        }
+        m_epoll_fds.push_back(epoll_fd);
+    }
+
+    // Listening sockets belong to thread 0 and are level-triggered: one
+    // connection is accepted per iteration, as with select(), and the rest
+    // stay reported.
+    for (const ListenSocket &hListenSocket : vhListenSocket) {
+        struct epoll_event event = {};
+        event.events = EPOLLIN;
+        event.data.fd = hListenSocket.socket;
+        if (epoll_ctl(m_epoll_fds[0], EPOLL_CTL_ADD, hListenSocket.socket,
+                      &event) != 0) {
+            LogPrintf("epoll_ctl failed for listening socket: %s\n",
+                      NetworkErrorString(WSAGetLastError()));
+            close_all();
+            return false;
         }
     }
+    return true;
+}
+
+/**
+ * Readiness remembered from earlier epoll events that can be acted on now,
+ * following the same send-before-receive policy as the select() path.
+ */
+static void GetPendingSocketEvents(CNode *pnode, bool &recv, bool &send) {
+    bool has_send;
+    {
+        LOCK(pnode->cs_vSend);
+        has_send = !pnode->vSendMsg.empty();
+    }
+    send = has_send && pnode->m_socket_writable;
+    recv = !has_send && !pnode->fPauseRecv && pnode->m_socket_readable;
+}
+
+void CConnman::SocketEventsEPoll(int thread_index, std::set<SOCKET> &recv_set,
+                                 std::set<SOCKET> &send_set,
+                                 std::set<SOCKET> &error_set) {
+    const int epoll_fd = m_epoll_fds[thread_index];
+
+    // Register new peers with the epoll instance. Sockets leave it on their
+    // own when they are closed. Don't block if some peer still has work to do
+    // from readiness that was reported earlier.
+    bool have_pending = false;
+    {
+        LOCK(cs_vNodes);
+        for (CNode *pnode : vNodes) {
+            if (GetNetThread(pnode) != thread_index) {
+                continue;
+            }
+            if (!pnode->m_epoll_registered) {
+                LOCK(pnode->cs_hSocket);
+                if (pnode->hSocket == INVALID_SOCKET) {
+                    continue;
+                }
+                struct epoll_event event = {};
+                event.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+                event.data.fd = pnode->hSocket;
+                if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, pnode->hSocket,
+                              &event) != 0) {
+                    LogPrintf("epoll_ctl failed for peer=%d: %s\n",
+                              pnode->GetId(),
+                              NetworkErrorString(WSAGetLastError()));
+                    pnode->fDisconnect = true;
+                    continue;
+                }
+                pnode->m_epoll_registered = true;
+            }
+            bool recv, send;
+            GetPendingSocketEvents(pnode, recv, send);
+            have_pending |= recv || send;
+        }
+    }
+
+    // Frequency to poll pnode->vSend
+    const int timeout_ms = have_pending ? 0 : 50;
+    std::array<struct epoll_event, EPOLL_MAX_EVENTS> events;
+    int nEvents =
+        epoll_wait(epoll_fd, events.data(), events.size(), timeout_ms);
+    if (interruptNet) {
+        return;
+    }
+    if (nEvents < 0) {
+        int nErr = WSAGetLastError();
+        if (nErr != WSAEINTR) {
+            LogPrintf("epoll_wait error %s\n", NetworkErrorString(nErr));
+            interruptNet.sleep_for(std::chrono::milliseconds(timeout_ms));
+        }
+        return;
+    }
+
+    std::unordered_map<SOCKET, uint32_t> socket_events;
+    socket_events.reserve(nEvents);
+    for (int i = 0; i < nEvents; i++) {
+        const SOCKET hSocket = events[i].data.fd;
+        const uint32_t flags = events[i].events;
+        socket_events.emplace(hSocket, flags);
+    }
+    for (const ListenSocket &hListenSocket : vhListenSocket) {
+        if (socket_events.erase(hListenSocket.socket)) {
+            recv_set.insert(hListenSocket.socket);
+        }
+    }
+
+    LOCK(cs_vNodes);
+    for (CNode *pnode : vNodes) {
+        if (GetNetThread(pnode) != thread_index) {
+            continue;
+        }
+        SOCKET hSocket;
+        {
+            LOCK(pnode->cs_hSocket);
+            hSocket = pnode->hSocket;
+        }
+        if (hSocket == INVALID_SOCKET || !pnode->m_epoll_registered) {
+            continue;
+        }
+
+        auto it = socket_events.find(hSocket);
+        if (it != socket_events.end()) {
+            if (it->second & (EPOLLIN | EPOLLRDHUP)) {
+                pnode->m_socket_readable = true;
+            }
+            if (it->second & EPOLLOUT) {
+                pnode->m_socket_writable = true;
+            }
+            if (it->second & (EPOLLERR | EPOLLHUP)) {
+                error_set.insert(hSocket);
+            }
+        }
+
+        bool recv, send;
+        GetPendingSocketEvents(pnode, recv, send);
+        if (recv) {
+            recv_set.insert(hSocket);
+        }
+        if (send) {
+            send_set.insert(hSocket);
+        }
+    }
+}
+#endif
+
+void CConnman::SocketHandler(int thread_index) {
+    std::set<SOCKET> recv_set, send_set, error_set;
+#ifdef USE_EPOLL
+    if (m_socket_events_mode == SocketEventsMode::EPoll) {
+        SocketEventsEPoll(thread_index, recv_set, send_set, error_set);
+    } else
+#endif
+    {
+        SocketEventsSelect(thread_index, recv_set, send_set, error_set);
+    }
+    if (interruptNet) {
+        return;
+    }
 
     //
     // Accept new connections
     //
     for (const ListenSocket &hListenSocket : vhListenSocket) {
         if (hListenSocket.socket != INVALID_SOCKET &&
-            FD_ISSET(hListenSocket.socket, &fdsetRecv)) {
+            recv_set.count(hListenSocket.socket) > 0) {
             AcceptConnection(hListenSocket);
         }
     }
@@ -1303,9 +1567,10 @@ void CConnman::SocketHandler() {
     std::vector<CNode *> vNodesCopy;
     {
         LOCK(cs_vNodes);
-        vNodesCopy = vNodes;
-        for (CNode *pnode : vNodesCopy) {
-            pnode->AddRef();
+        for (CNode *pnode : vNodes) {
+            if (GetNetThread(pnode) == thread_index) {
+                vNodesCopy.push_back(pnode->AddRef());
+            }
         }
     }
     for (CNode *pnode : vNodesCopy) {
@@ -1324,9 +1589,9 @@ void CConnman::SocketHandler() {
             if (pnode->hSocket == INVALID_SOCKET) {
                 continue;
             }
-            recvSet = FD_ISSET(pnode->hSocket, &fdsetRecv);
-            sendSet = FD_ISSET(pnode->hSocket, &fdsetSend);
-            errorSet = FD_ISSET(pnode->hSocket, &fdsetError);
+            recvSet = recv_set.count(pnode->hSocket) > 0;
+            sendSet = send_set.count(pnode->hSocket) > 0;
+            errorSet = error_set.count(pnode->hSocket) > 0;
         }
         if (recvSet || errorSet) {
             // typical socket buffer is 8K-64K
@@ -1341,6 +1606,10 @@ void CConnman::SocketHandler() {
                     recv(pnode->hSocket, pchBuf, sizeof(pchBuf), MSG_DONTWAIT);
             }
             if (nBytes > 0) {
+                // A short read means the socket buffer has been drained.
+                if (size_t(nBytes) < sizeof(pchBuf)) {
+                    pnode->m_socket_readable = false;
+                }
                 bool notify = false;
                 if (!pnode->ReceiveMsgBytes(*config, pchBuf, nBytes, notify)) {
                     pnode->CloseSocketDisconnect();
@@ -1376,6 +1645,9 @@ void CConnman::SocketHandler() {
             } else if (nBytes < 0) {
                 // error
                 int nErr = WSAGetLastError();
+                if (nErr == WSAEWOULDBLOCK) {
+                    pnode->m_socket_readable = false;
+                }
                 if (nErr != WSAEWOULDBLOCK && nErr != WSAEMSGSIZE &&
                     nErr != WSAEINTR && nErr != WSAEINPROGRESS) {
                     if (!pnode->fDisconnect) {
@@ -1396,6 +1668,10 @@ void CConnman::SocketHandler() {
             if (nBytes) {
                 RecordBytesSent(nBytes);
             }
+            // Data left over means the socket buffer is full.
+            if (!pnode->vSendMsg.empty()) {
+                pnode->m_socket_writable = false;
+            }
         }
 
         InactivityCheck(pnode);
@@ -1412,7 +1688,14 @@ void CConnman::ThreadSocketHandler() {
     while (!interruptNet) {
         DisconnectNodes();
         NotifyNumConnectionsChanged();
-        SocketHandler();
+        SocketHandler(0);
+    }
+}
+
+void CConnman::ThreadNetIO(int thread_index) {
+    util::ThreadRename(strprintf("net.%i", thread_index));
+    while (!interruptNet) {
+        SocketHandler(thread_index);
     }
 }
 
@@ -2047,6 +2330,11 @@ void CConnman::ThreadMessageHandler() {
             }
         }
 
+        m_msgproc->ProcessDeferredMessages(*config, flagInterruptMsgProc);
+        if (flagInterruptMsgProc) {
+            return;
+        }
+
         {
             LOCK(cs_vNodes);
             for (CNode *pnode : vNodesCopy) {
@@ -2334,10 +2622,24 @@ bool CConnman::Start(CScheduler &scheduler, const Options &connOptions) {
         fMsgProcWake = false;
     }
 
+#ifdef USE_EPOLL
+    if (m_socket_events_mode == SocketEventsMode::EPoll &&
+        !InitSocketEventsEPoll()) {
+        LogPrintf("Falling back to select() for socket events\n");
+        m_socket_events_mode = SocketEventsMode::Select;
+    }
+#endif
+    LogPrintf("Using %s for socket events on %d network threads\n",
+              SocketEventsModeToString(m_socket_events_mode), m_net_threads);
+
     // Send and receive from sockets, accept connections
     threadSocketHandler = std::thread(
         &TraceThread<std::function<void()>>, "net",
         std::function<void()>(std::bind(&CConnman::ThreadSocketHandler, this)));
+    // Send and receive from the sockets of the other shards of peers
+    for (int i = 1; i < m_net_threads; i++) {
+        threadNetIO.emplace_back(&CConnman::ThreadNetIO, this, i);
+    }
 
     if (!gArgs.GetBoolArg("-dnsseed", true)) {
         LogPrintf("DNS seeding disabled\n");
@@ -2441,6 +2743,10 @@ void CConnman::Stop() {
     if (threadSocketHandler.joinable()) {
         threadSocketHandler.join();
     }
+    for (std::thread &thread : threadNetIO) {
+        thread.join();
+    }
+    threadNetIO.clear();
 
     if (fAddressesInitialized) {
         DumpAddresses();
@@ -2470,6 +2776,12 @@ void CConnman::Stop() {
     vNodes.clear();
     vNodesDisconnected.clear();
     vhListenSocket.clear();
+#ifdef USE_EPOLL
+    for (int epoll_fd : m_epoll_fds) {
+        close(epoll_fd);
+    }
+    m_epoll_fds.clear();
+#endif
     semOutbound.reset();
     semAddnode.reset();
 }
@@ -2751,15 +3063,21 @@ bool CConnman::NodeFullyConnected(const CNode *pnode) {
     return pnode && pnode->fSuccessfullyConnected && !pnode->fDisconnect;
 }
 
+CSharedNetPayload::CSharedNetPayload(std::vector<uint8_t> &&dataIn)
+    : data(std::move(dataIn)), hash(Hash(data.data(), data.data() + data.size())) {}
+
 void CConnman::PushMessage(CNode *pnode, CSerializedNetMsg &&msg) {
-    size_t nMessageSize = msg.data.size();
+    size_t nMessageSize =
+        msg.shared_data ? msg.shared_data->data.size() : msg.data.size();
     size_t nTotalSize = nMessageSize + CMessageHeader::HEADER_SIZE;
     LogPrint(BCLog::NET, "sending %s (%d bytes) peer=%d\n",
              SanitizeString(msg.command.c_str()), nMessageSize, pnode->GetId());
 
     std::vector<uint8_t> serializedHeader;
     serializedHeader.reserve(CMessageHeader::HEADER_SIZE);
-    uint256 hash = Hash(msg.data.data(), msg.data.data() + nMessageSize);
+    uint256 hash = msg.shared_data
+                       ? msg.shared_data->hash
+                       : Hash(msg.data.data(), msg.data.data() + nMessageSize);
     CMessageHeader hdr(config->GetChainParams().NetMagic(), msg.command.c_str(),
                        nMessageSize);
     memcpy(hdr.pchChecksum, hash.begin(), CMessageHeader::CHECKSUM_SIZE);
@@ -2778,9 +3096,13 @@ void CConnman::PushMessage(CNode *pnode, CSerializedNetMsg &&msg) {
         if (pnode->nSendSize > nSendBufferMaxSize) {
             pnode->fPauseSend = true;
         }
-        pnode->vSendMsg.push_back(std::move(serializedHeader));
-        if (nMessageSize) {
-            pnode->vSendMsg.push_back(std::move(msg.data));
+        pnode->vSendMsg.emplace_back(std::move(serializedHeader));
+        if (msg.shared_data) {
+            if (nMessageSize) {
+                pnode->vSendMsg.emplace_back(std::move(msg.shared_data));
+            }
+        } else if (nMessageSize) {
+            pnode->vSendMsg.emplace_back(std::move(msg.data));
         }
 
         // If write queue empty, attempt "optimistic write"
@@ -31,6 +31,8 @@
 #include <cstdint>
 #include <deque>
 #include <memory>
+#include <set>
+#include <string>
 #include <thread>
 
 #ifndef WIN32
@@ -92,6 +94,33 @@ static const bool DEFAULT_FORCEDNSSEED = false;
 static const size_t DEFAULT_MAXRECEIVEBUFFER = 5 * 1000;
 static const size_t DEFAULT_MAXSENDBUFFER = 1 * 1000;
 
+/** How the socket handler thread waits for socket readiness (-socketevents) */
+enum class SocketEventsMode {
+    //! select() on fd_sets rebuilt every iteration, limited to FD_SETSIZE
+    Select,
+    //! Edge-triggered epoll with sockets registered once per peer
+    EPoll,
+};
+#ifdef USE_EPOLL
+static const SocketEventsMode DEFAULT_SOCKETEVENTS = SocketEventsMode::EPoll;
+#else
+static const SocketEventsMode DEFAULT_SOCKETEVENTS = SocketEventsMode::Select;
+#endif
+
+/** Default number of threads doing socket I/O for the peers (-netthreads) */
+static const int DEFAULT_NET_THREADS = 1;
+/** Maximum number of threads doing socket I/O for the peers */
+static const int MAX_NET_THREADS = 64;
+
+/**
+ * Parse a -socketevents value. Returns false if the mode is unknown or not
+ * supported by this build.
+ */
+bool SocketEventsModeFromString(const std::string &str, SocketEventsMode &mode);
+std::string SocketEventsModeToString(SocketEventsMode mode);
+/** Comma separated list of the -socketevents modes supported by this build */
+std::string SupportedSocketEventsModes();
+
 typedef int64_t NodeId;
 
 struct AddedNodeInfo {
@@ -104,6 +133,18 @@ struct AddedNodeInfo {
 struct CNodeStats;
 class CClientUIInterface;
 
+/**
+ * A message payload serialized once and queued for any number of peers without
+ * being copied, such as a block served as it is stored on disk.
+ */
+struct CSharedNetPayload {
+    explicit CSharedNetPayload(std::vector<uint8_t> &&dataIn);
+
+    const std::vector<uint8_t> data;
+    //! Double SHA256 of data, the message checksum is taken from it
+    const uint256 hash;
+};
+
 struct CSerializedNetMsg {
     CSerializedNetMsg() = default;
     CSerializedNetMsg(CSerializedNetMsg &&) = default;
@@ -114,6 +155,29 @@ struct CSerializedNetMsg {
 
     std::vector<uint8_t> data;
     std::string command;
+    //! Sent instead of data when set
+    std::shared_ptr<const CSharedNetPayload> shared_data;
+};
+
+/**
+ * Data queued for sending to a peer, either owned by the queue or a payload
+ * shared with the queues of other peers.
+ */
+class CSendChunk {
+public:
+    explicit CSendChunk(std::vector<uint8_t> &&dataIn)
+        : owned(std::move(dataIn)) {}
+    explicit CSendChunk(std::shared_ptr<const CSharedNetPayload> sharedIn)
+        : shared(std::move(sharedIn)) {}
+
+    const uint8_t *data() const {
+        return shared ? shared->data.data() : owned.data();
+    }
+    size_t size() const { return shared ? shared->data.size() : owned.size(); }
+
+private:
+    std::vector<uint8_t> owned;
+    std::shared_ptr<const CSharedNetPayload> shared;
 };
 
 class NetEventsInterface;
@@ -141,6 +205,8 @@ public:
         uint64_t nMaxOutboundTimeframe = 0;
         uint64_t nMaxOutboundLimit = 0;
         int64_t m_peer_connect_timeout = DEFAULT_PEER_CONNECT_TIMEOUT;
+        SocketEventsMode m_socket_events_mode = DEFAULT_SOCKETEVENTS;
+        int m_net_threads = DEFAULT_NET_THREADS;
         std::vector<std::string> vSeedNodes;
         std::vector<NetWhitelistPermissions> vWhitelistedRange;
         std::vector<NetWhitebindPermissions> vWhiteBinds;
@@ -165,6 +231,9 @@ public:
         nSendBufferMaxSize = connOptions.nSendBufferMaxSize;
         nReceiveFloodSize = connOptions.nReceiveFloodSize;
         m_peer_connect_timeout = connOptions.m_peer_connect_timeout;
+        m_socket_events_mode = connOptions.m_socket_events_mode;
+        m_net_threads =
+            std::max(1, std::min(connOptions.m_net_threads, MAX_NET_THREADS));
         {
             LOCK(cs_totalBytesSent);
             nMaxOutboundTimeframe = connOptions.nMaxOutboundTimeframe;
@@ -355,8 +424,29 @@ private:
     void DisconnectNodes();
     void NotifyNumConnectionsChanged();
     void InactivityCheck(CNode *pnode);
-    void SocketHandler();
+    /**
+     * Network thread serving the socket of a peer. Peers are spread over the
+     * -netthreads threads by id, and stay on the same thread while connected.
+     */
+    int GetNetThread(const CNode *pnode) const;
+    /**
+     * Wait for socket readiness and fill the sets of listening and peer
+     * sockets that can be received from, sent to, or have errors. Only the
+     * peers of the given network thread are considered, and only thread 0
+     * listens.
+     */
+    void SocketEventsSelect(int thread_index, std::set<SOCKET> &recv_set,
+                            std::set<SOCKET> &send_set,
+                            std::set<SOCKET> &error_set);
+#ifdef USE_EPOLL
+    bool InitSocketEventsEPoll();
+    void SocketEventsEPoll(int thread_index, std::set<SOCKET> &recv_set,
+                           std::set<SOCKET> &send_set,
+                           std::set<SOCKET> &error_set);
+#endif
+    void SocketHandler(int thread_index);
     void ThreadSocketHandler();
+    void ThreadNetIO(int thread_index);
     void ThreadDNSAddressSeed();
 
     uint64_t CalculateKeyedNetGroup(const CAddress &ad) const;
@@ -403,6 +493,14 @@ private:
     // P2P timeout in seconds
     int64_t m_peer_connect_timeout;
 
+    SocketEventsMode m_socket_events_mode{DEFAULT_SOCKETEVENTS};
+    //! Number of threads doing socket I/O, see -netthreads
+    int m_net_threads{DEFAULT_NET_THREADS};
+#ifdef USE_EPOLL
+    //! epoll instance of each network thread, empty when using select()
+    std::vector<int> m_epoll_fds;
+#endif
+
     // Whitelisted ranges. Any node connecting from these is automatically
     // whitelisted (as well as those connecting to whitelisted binds).
     std::vector<NetWhitelistPermissions> vWhitelistedRange;
@@ -453,6 +551,8 @@ private:
 
     std::thread threadDNSAddressSeed;
     std::thread threadSocketHandler;
+    //! Network threads besides threadSocketHandler, see -netthreads
+    std::vector<std::thread> threadNetIO;
     std::thread threadOpenAddedConnections;
     std::thread threadOpenConnections;
     std::thread threadMessageHandler;
@@ -486,6 +586,12 @@ public:
                                  std::atomic<bool> &interrupt) = 0;
     virtual bool SendMessages(const Config &config, CNode *pnode,
                               std::atomic<bool> &interrupt) = 0;
+    /**
+     * Process the work ProcessMessages deferred during a round over all the
+     * nodes. The nodes of the round are still referenced when it is called.
+     */
+    virtual void ProcessDeferredMessages(const Config &config,
+                                         std::atomic<bool> &interrupt) = 0;
     virtual void InitializeNode(const Config &config, CNode *pnode) = 0;
     virtual void FinalizeNode(const Config &config, NodeId id,
                               bool &update_connection_time) = 0;
@@ -654,7 +760,7 @@ public:
     // Offset inside the first vSendMsg already sent.
     size_t nSendOffset{0};
     uint64_t nSendBytes GUARDED_BY(cs_vSend){0};
-    std::deque<std::vector<uint8_t>> vSendMsg GUARDED_BY(cs_vSend);
+    std::deque<CSendChunk> vSendMsg GUARDED_BY(cs_vSend);
     mutable RecursiveMutex cs_vSend;
     RecursiveMutex cs_hSocket;
     RecursiveMutex cs_vRecv;
@@ -719,6 +825,13 @@ public:
     std::atomic_bool fPauseRecv{false};
     std::atomic_bool fPauseSend{false};
 
+    // Used only by the network thread of the node. Edge-triggered epoll only
+    // reports readiness when it changes, so it is remembered here until a recv
+    // or send shows that the socket buffer has been drained or filled.
+    bool m_epoll_registered{false};
+    bool m_socket_readable{false};
+    bool m_socket_writable{false};
+
     /* ExtVersion support */
     Mutex cs_extversion;
     //! Stores the peer's extversion message. This member is only valid if extversionEnabled is true.
@@ -799,7 +912,7 @@ private:
     const int nMyStartingHeight;
     int nSendVersion{0};
     NetPermissionFlags m_permissionFlags{PF_NONE};
-    // Used only by SocketHandler thread
+    // Used only by the network thread of the node
     std::list<CNetMessage> vRecvMsg;
 
     mutable RecursiveMutex cs_addrName;
@@ -25,6 +25,7 @@
 #include <primitives/block.h>
 #include <primitives/transaction.h>
 #include <random.h>
+#include <rawblockcache.h>
 #include <reverse_iterator.h>
 #include <scheduler.h>
 #include <tinyformat.h>
@@ -178,6 +179,9 @@ std::map<uint256, std::pair<NodeId, bool>> mapBlockSource GUARDED_BY(cs_main);
 std::unique_ptr<CRollingBloomFilter> recentRejects GUARDED_BY(cs_main);
 uint256 hashRecentRejectsChainTip GUARDED_BY(cs_main);
 
+/** Blocks recently served from disk, the size is set from -rawblockcache */
+static RawBlockCache g_raw_block_cache(DEFAULT_RAW_BLOCK_CACHE_SIZE << 20);
+
 /**
  * Blocks that are in flight, and that are in the queue to be downloaded.
  */
@@ -208,8 +212,19 @@ int g_outbound_peers_with_protect_from_disconnect GUARDED_BY(cs_main) = 0;
 /** When our tip was last updated. */
 std::atomic<int64_t> g_last_tip_update(0);
 
+/**
+ * A transaction announced to our peers, along with its serialization, made the
+ * first time it is requested and then sent to every peer requesting it.
+ */
+struct RelayedTx {
+    explicit RelayedTx(CTransactionRef &&txIn) : tx(std::move(txIn)) {}
+
+    CTransactionRef tx;
+    std::shared_ptr<const CSharedNetPayload> payload;
+};
+
 /** Relay map. */
-typedef std::map<uint256, CTransactionRef> MapRelay;
+typedef std::map<uint256, RelayedTx> MapRelay;
 MapRelay mapRelay GUARDED_BY(cs_main);
 /**
  * Expiration-time ordered list of (expire time, relay map entry) pairs,
@@ -1186,6 +1201,10 @@ PeerLogicValidation::PeerLogicValidation(CConnman *connmanIn, BanMan *banman,
       m_enable_bip61(enable_bip61) {
     // Initialize global variables that cannot be constructed at startup.
     recentRejects.reset(new CRollingBloomFilter(120000, 0.000001));
+    g_raw_block_cache.SetMaxBytes(
+        std::max<int64_t>(0, gArgs.GetArg("-rawblockcache",
+                                          DEFAULT_RAW_BLOCK_CACHE_SIZE))
+        << 20);
 
     const Consensus::Params &consensusParams = Params().GetConsensus();
     // Stale tip checking and peer eviction are on two different timers, but we
@@ -1581,10 +1600,37 @@ static void ProcessGetBlockData(const Config &config, CNode *pfrom,
     // Pruned nodes may have deleted the block, so check whether it's available
     // before trying to send.
     if (send && pindex->nStatus.hasData()) {
+        // Peers asking for old blocks with MSG_CMPCT_BLOCK get the full block
+        // too, see below.
+        const bool send_full_block =
+            inv.type == MSG_BLOCK ||
+            (inv.type == MSG_CMPCT_BLOCK &&
+             !(CanDirectFetch(consensusParams) &&
+               pindex->nHeight >=
+                   ::ChainActive().Height() - MAX_CMPCTBLOCK_DEPTH));
         std::shared_ptr<const CBlock> pblock;
         if (a_recent_block &&
             a_recent_block->GetHash() == pindex->GetBlockHash()) {
             pblock = a_recent_block;
+        } else if (send_full_block) {
+            // Send the block as it is stored on disk, without deserializing
+            // it, and keep it around for the other peers requesting it.
+            std::shared_ptr<const CSharedNetPayload> raw_block =
+                g_raw_block_cache.Get(pindex->GetBlockHash());
+            if (!raw_block) {
+                std::vector<uint8_t> data;
+                if (!ReadRawBlockFromDisk(data, pindex,
+                                          config.GetChainParams().DiskMagic())) {
+                    assert(!"cannot load block from disk");
+                }
+                raw_block = std::make_shared<const CSharedNetPayload>(
+                    std::move(data));
+                g_raw_block_cache.Insert(pindex->GetBlockHash(), raw_block);
+            }
+            CSerializedNetMsg msg;
+            msg.command = NetMsgType::BLOCK;
+            msg.shared_data = std::move(raw_block);
+            connman->PushMessage(pfrom, std::move(msg));
         } else {
             // Send block from disk
             std::shared_ptr<CBlock> pblockRead = std::make_shared<CBlock>();
@@ -1593,7 +1639,9 @@ static void ProcessGetBlockData(const Config &config, CNode *pfrom,
             }
             pblock = pblockRead;
         }
-        if (inv.type == MSG_BLOCK) {
+        if (!pblock) {
+            // Already sent from disk
+        } else if (inv.type == MSG_BLOCK) {
             connman->PushMessage(pfrom,
                                  msgMaker.Make(NetMsgType::BLOCK, *pblock));
         } else if (inv.type == MSG_FILTERED_BLOCK) {
@@ -1633,9 +1681,7 @@ static void ProcessGetBlockData(const Config &config, CNode *pfrom,
             // we don't feel like constructing the object for them, so instead
             // we respond with the full, non-compact block.
             int nSendFlags = 0;
-            if (CanDirectFetch(consensusParams) &&
-                pindex->nHeight >=
-                    ::ChainActive().Height() - MAX_CMPCTBLOCK_DEPTH) {
+            if (!send_full_block) {
                 CBlockHeaderAndShortTxIDs cmpctblock(*pblock);
                 connman->PushMessage(
                     pfrom, msgMaker.Make(nSendFlags, NetMsgType::CMPCTBLOCK,
@@ -1691,9 +1737,19 @@ static void ProcessGetData(const Config &config, CNode *pfrom,
             auto mi = mapRelay.find(inv.hash);
             int nSendFlags = 0;
             if (mi != mapRelay.end()) {
-                connman->PushMessage(
-                    pfrom,
-                    msgMaker.Make(nSendFlags, NetMsgType::TX, *mi->second));
+                RelayedTx &relayed = mi->second;
+                if (!relayed.payload) {
+                    std::vector<uint8_t> data;
+                    CVectorWriter(SER_NETWORK, PROTOCOL_VERSION, data, 0,
+                                  *relayed.tx);
+                    relayed.payload =
+                        std::make_shared<const CSharedNetPayload>(
+                            std::move(data));
+                }
+                CSerializedNetMsg msg;
+                msg.command = NetMsgType::TX;
+                msg.shared_data = relayed.payload;
+                connman->PushMessage(pfrom, std::move(msg));
                 push = true;
             } else if (pfrom->timeLastMempoolReq) {
                 auto txinfo = g_mempool.info(TxId(inv.hash));
@@ -2054,11 +2110,248 @@ static void PushGetAddrOnceIfAfterVerAck(CConnman *connman, CNode *pfrom) {
     }
 }
 
+/**
+ * Accept a transaction received from a peer to the mempool, along with the
+ * orphans waiting for it, relay it and answer the peer.
+ */
+static void ProcessTransaction(const Config &config, CNode *pfrom,
+                               const CTransactionRef &ptx, CConnman *connman,
+                               bool enable_bip61) {
+    const CNetMsgMaker msgMaker(pfrom->GetSendVersion());
+    std::deque<COutPoint> vWorkQueue;
+    std::vector<TxId> vEraseQueue;
+    const CTransaction &tx = *ptx;
+    const TxId &txid = tx.GetId();
+    const CInv inv(MSG_TX, txid);
+
+    LOCK2(cs_main, internal::g_cs_orphans);
+
+    bool fMissingInputs = false;
+    CValidationState state;
+
+    CNodeState *nodestate = State(pfrom->GetId());
+    nodestate->m_tx_download.m_tx_announced.erase(txid);
+    nodestate->m_tx_download.m_tx_in_flight.erase(txid);
+    EraseTxRequest(txid);
+
+    if (!AlreadyHave(inv) &&
+        AcceptToMemoryPool(config, g_mempool, state, ptx, &fMissingInputs,
+                           false /* bypass_limits */,
+                           Amount::zero() /* nAbsurdFee */)) {
+        g_mempool.check(pcoinsTip.get());
+        RelayTransaction(tx, connman);
+        for (size_t i = 0; i < tx.vout.size(); i++) {
+            vWorkQueue.emplace_back(txid, i);
+        }
+
+        pfrom->nLastTXTime = GetTime();
+
+        LogPrint(BCLog::MEMPOOL,
+                 "AcceptToMemoryPool: peer=%d: accepted %s "
+                 "(poolsz %u txn, %u kB)\n",
+                 pfrom->GetId(), tx.GetId().ToString(), g_mempool.size(),
+                 g_mempool.DynamicMemoryUsage() / 1000);
+
+        // Recursively process any orphan transactions that depended on this
+        // one
+        std::unordered_map<NodeId, uint32_t> rejectCountPerNode;
+        while (!vWorkQueue.empty()) {
+            auto itByPrev =
+                mapOrphanTransactionsByPrev.find(vWorkQueue.front());
+            vWorkQueue.pop_front();
+            if (itByPrev == mapOrphanTransactionsByPrev.end()) {
+                continue;
+            }
+            for (auto mi = itByPrev->second.begin();
+                 mi != itByPrev->second.end(); ++mi) {
+                const CTransactionRef &porphanTx = (*mi)->second.tx;
+                const CTransaction &orphanTx = *porphanTx;
+                const TxId &orphanId = orphanTx.GetId();
+                NodeId fromPeer = (*mi)->second.fromPeer;
+                bool fMissingInputs2 = false;
+                // Use a dummy CValidationState so someone can't setup nodes
+                // to counter-DoS based on orphan resolution (that is,
+                // feeding people an invalid transaction based on LegitTxX
+                // in order to get anyone relaying LegitTxX banned)
+                CValidationState stateDummy;
+
+                auto it = rejectCountPerNode.find(fromPeer);
+                if (it != rejectCountPerNode.end() &&
+                    it->second > MAX_NON_STANDARD_ORPHAN_PER_NODE) {
+                    continue;
+                }
+
+                if (AcceptToMemoryPool(config, g_mempool, stateDummy,
+                                       porphanTx, &fMissingInputs2,
+                                       false /* bypass_limits */,
+                                       Amount::zero() /* nAbsurdFee */)) {
+                    LogPrint(BCLog::MEMPOOL, "   accepted orphan tx %s\n",
+                             orphanId.ToString());
+                    RelayTransaction(orphanTx, connman);
+                    for (size_t i = 0; i < orphanTx.vout.size(); i++) {
+                        vWorkQueue.emplace_back(orphanId, i);
+                    }
+                    vEraseQueue.push_back(orphanId);
+                } else if (!fMissingInputs2) {
+                    int nDos = 0;
+                    if (stateDummy.IsInvalid(nDos)) {
+                        rejectCountPerNode[fromPeer]++;
+                        if (nDos > 0) {
+                            // Punish peer that gave us an invalid orphan tx
+                            Misbehaving(fromPeer, nDos,
+                                        "invalid-orphan-tx");
+                            LogPrint(BCLog::MEMPOOL,
+                                     "   invalid orphan tx %s\n",
+                                     orphanId.ToString());
+                        }
+                    }
+                    // Has inputs but not accepted to mempool
+                    // Probably non-standard or insufficient fee
+                    LogPrint(BCLog::MEMPOOL, "   removed orphan tx %s\n",
+                             orphanId.ToString());
+                    vEraseQueue.push_back(orphanId);
+                    if (!stateDummy.CorruptionPossible()) {
+                        // Do not use rejection cache for witness
+                        // transactions or witness-stripped transactions, as
+                        // they can have been malleated. See
+                        // https://github.com/bitcoin/bitcoin/issues/8279
+                        // for details.
+                        assert(recentRejects);
+                        recentRejects->insert(orphanId);
+                    }
+                }
+                g_mempool.check(pcoinsTip.get());
+            }
+        }
+
+        for (const TxId &idOfOrphanTxToErase : vEraseQueue) {
+            EraseOrphanTx(idOfOrphanTxToErase);
+        }
+    } else if (fMissingInputs) {
+        // It may be the case that the orphans parents have all been
+        // rejected.
+        bool fRejectedParents = false;
+        for (const CTxIn &txin : tx.vin) {
+            if (recentRejects->contains(txin.prevout.GetTxId())) {
+                fRejectedParents = true;
+                break;
+            }
+        }
+        if (!fRejectedParents) {
+            int64_t nNow = GetTimeMicros();
+
+            for (const CTxIn &txin : tx.vin) {
+                // FIXME: MSG_TX should use a TxHash, not a TxId.
+                const TxId _txid = txin.prevout.GetTxId();
+                CInv _inv(MSG_TX, _txid);
+                pfrom->AddInventoryKnown(_inv);
+                if (!AlreadyHave(_inv)) {
+                    RequestTx(State(pfrom->GetId()), _txid, nNow);
+                }
+            }
+            internal::AddOrphanTx(ptx, pfrom->GetId());
+
+            // DoS prevention: do not allow mapOrphanTransactions to grow
+            // unbounded
+            unsigned int nMaxOrphanTx = (unsigned int)std::max(
+                int64_t(0), gArgs.GetArg("-maxorphantx",
+                                         DEFAULT_MAX_ORPHAN_TRANSACTIONS));
+            unsigned int nEvicted = internal::LimitOrphanTxSize(nMaxOrphanTx);
+            if (nEvicted > 0) {
+                LogPrint(BCLog::MEMPOOL,
+                         "mapOrphan overflow, removed %u tx\n", nEvicted);
+            }
+        } else {
+            LogPrint(BCLog::MEMPOOL,
+                     "not keeping orphan with rejected parents %s\n",
+                     tx.GetId().ToString());
+            // We will continue to reject this tx since it has rejected
+            // parents so avoid re-requesting it from other peers.
+            recentRejects->insert(tx.GetId());
+        }
+    } else {
+        if (!state.CorruptionPossible()) {
+            // Do not use rejection cache for witness transactions or
+            // witness-stripped transactions, as they can have been
+            // malleated. See https://github.com/bitcoin/bitcoin/issues/8279
+            // for details.
+            assert(recentRejects);
+            recentRejects->insert(tx.GetId());
+            if (RecursiveDynamicUsage(*ptx) < 100000) {
+                AddToCompactExtraTransactions(ptx);
+            }
+        }
+
+        if (pfrom->HasPermission(PF_FORCERELAY)) {
+            // Always relay transactions received from whitelisted peers,
+            // even if they were already in the mempool or rejected from it
+            // due to policy, allowing the node to function as a gateway for
+            // nodes hidden behind it.
+            //
+            // Never relay transactions that we would assign a non-zero DoS
+            // score for, as we expect peers to do the same with us in that
+            // case.
+            int nDoS = 0;
+            if (!state.IsInvalid(nDoS) || nDoS == 0) {
+                LogPrintf("Force relaying tx %s from whitelisted peer=%d\n",
+                          tx.GetId().ToString(), pfrom->GetId());
+                RelayTransaction(tx, connman);
+            } else {
+                LogPrintf("Not relaying invalid transaction %s from "
+                          "whitelisted peer=%d (%s)\n",
+                          tx.GetId().ToString(), pfrom->GetId(),
+                          FormatStateMessage(state));
+            }
+        }
+    }
+
+    // If a tx has been detected by recentRejects, we will have reached
+    // this point and the tx will have been ignored. Because we haven't run
+    // the tx through AcceptToMemoryPool, we won't have computed a DoS
+    // score for it or determined exactly why we consider it invalid.
+    //
+    // This means we won't penalize any peer subsequently relaying a DoSy
+    // tx (even if we penalized the first peer who gave it to us) because
+    // we have to account for recentRejects showing false positives. In
+    // other words, we shouldn't penalize a peer if we aren't *sure* they
+    // submitted a DoSy tx.
+    //
+    // Note that recentRejects doesn't just record DoSy or invalid
+    // transactions, but any tx not accepted by the mempool, which may be
+    // due to node policy (vs. consensus). So we can't blanket penalize a
+    // peer simply for relaying a tx that our recentRejects has caught,
+    // regardless of false positives.
+
+    int nDoS = 0;
+    if (state.IsInvalid(nDoS)) {
+        LogPrint(BCLog::MEMPOOLREJ,
+                 "%s from peer=%d was not accepted: %s\n",
+                 tx.GetHash().ToString(), pfrom->GetId(),
+                 FormatStateMessage(state));
+        // Never send AcceptToMemoryPool's internal codes over P2P.
+        if (enable_bip61 && state.GetRejectCode() > 0 &&
+            state.GetRejectCode() < REJECT_INTERNAL) {
+            connman->PushMessage(
+                pfrom, msgMaker.Make(NetMsgType::REJECT,
+                                     std::string(NetMsgType::TX),
+                                     uint8_t(state.GetRejectCode()),
+                                     state.GetRejectReason().substr(
+                                         0, MAX_REJECT_MESSAGE_LENGTH),
+                                     inv.hash));
+        }
+        if (nDoS > 0) {
+            Misbehaving(pfrom, nDoS, state.GetRejectReason());
+        }
+    }
+}
+
 static bool ProcessMessage(const Config &config, CNode *pfrom,
                            const std::string &strCommand, CDataStream &vRecv,
                            int64_t nTimeReceived, CConnman *connman,
                            const std::atomic<bool> &interruptMsgProc,
-                           bool enable_bip61) {
+                           bool enable_bip61,
+                           std::vector<std::pair<CNode *, CTransactionRef>>
+                               &pendingTxs) {
     const CChainParams &chainparams = config.GetChainParams();
     LogPrint(BCLog::NET, "received: %s (%u bytes) peer=%d\n",
              SanitizeString(strCommand), vRecv.size(), pfrom->GetId());
@@ -2808,234 +3101,13 @@ static bool ProcessMessage(const Config &config, CNode *pfrom,
             return true;
         }
 
-        std::deque<COutPoint> vWorkQueue;
-        std::vector<TxId> vEraseQueue;
         CTransactionRef ptx;
         vRecv >> ptx;
-        const CTransaction &tx = *ptx;
-        const TxId &txid = tx.GetId();
-
-        CInv inv(MSG_TX, txid);
-        pfrom->AddInventoryKnown(inv);
-
-        LOCK2(cs_main, internal::g_cs_orphans);
-
-        bool fMissingInputs = false;
-        CValidationState state;
-
-        CNodeState *nodestate = State(pfrom->GetId());
-        nodestate->m_tx_download.m_tx_announced.erase(txid);
-        nodestate->m_tx_download.m_tx_in_flight.erase(txid);
-        EraseTxRequest(txid);
-
-        if (!AlreadyHave(inv) &&
-            AcceptToMemoryPool(config, g_mempool, state, ptx, &fMissingInputs,
-                               false /* bypass_limits */,
-                               Amount::zero() /* nAbsurdFee */)) {
-            g_mempool.check(pcoinsTip.get());
-            RelayTransaction(tx, connman);
-            for (size_t i = 0; i < tx.vout.size(); i++) {
-                vWorkQueue.emplace_back(txid, i);
-            }
+        pfrom->AddInventoryKnown(CInv(MSG_TX, ptx->GetId()));
 
-            pfrom->nLastTXTime = GetTime();
-
-            LogPrint(BCLog::MEMPOOL,
-                     "AcceptToMemoryPool: peer=%d: accepted %s "
-                     "(poolsz %u txn, %u kB)\n",
-                     pfrom->GetId(), tx.GetId().ToString(), g_mempool.size(),
-                     g_mempool.DynamicMemoryUsage() / 1000);
-
-            // Recursively process any orphan transactions that depended on this
-            // one
-            std::unordered_map<NodeId, uint32_t> rejectCountPerNode;
-            while (!vWorkQueue.empty()) {
-                auto itByPrev =
-                    mapOrphanTransactionsByPrev.find(vWorkQueue.front());
-                vWorkQueue.pop_front();
-                if (itByPrev == mapOrphanTransactionsByPrev.end()) {
-                    continue;
-                }
-                for (auto mi = itByPrev->second.begin();
-                     mi != itByPrev->second.end(); ++mi) {
-                    const CTransactionRef &porphanTx = (*mi)->second.tx;
-                    const CTransaction &orphanTx = *porphanTx;
-                    const TxId &orphanId = orphanTx.GetId();
-                    NodeId fromPeer = (*mi)->second.fromPeer;
-                    bool fMissingInputs2 = false;
-                    // Use a dummy CValidationState so someone can't setup nodes
-                    // to counter-DoS based on orphan resolution (that is,
-                    // feeding people an invalid transaction based on LegitTxX
-                    // in order to get anyone relaying LegitTxX banned)
-                    CValidationState stateDummy;
-
-                    auto it = rejectCountPerNode.find(fromPeer);
-                    if (it != rejectCountPerNode.end() &&
-                        it->second > MAX_NON_STANDARD_ORPHAN_PER_NODE) {
-                        continue;
-                    }
-
-                    if (AcceptToMemoryPool(config, g_mempool, stateDummy,
-                                           porphanTx, &fMissingInputs2,
-                                           false /* bypass_limits */,
-                                           Amount::zero() /* nAbsurdFee */)) {
-                        LogPrint(BCLog::MEMPOOL, "   accepted orphan tx %s\n",
-                                 orphanId.ToString());
-                        RelayTransaction(orphanTx, connman);
-                        for (size_t i = 0; i < orphanTx.vout.size(); i++) {
-                            vWorkQueue.emplace_back(orphanId, i);
-                        }
-                        vEraseQueue.push_back(orphanId);
-                    } else if (!fMissingInputs2) {
-                        int nDos = 0;
-                        if (stateDummy.IsInvalid(nDos)) {
-                            rejectCountPerNode[fromPeer]++;
-                            if (nDos > 0) {
-                                // Punish peer that gave us an invalid orphan tx
-                                Misbehaving(fromPeer, nDos,
-                                            "invalid-orphan-tx");
-                                LogPrint(BCLog::MEMPOOL,
-                                         "   invalid orphan tx %s\n",
-                                         orphanId.ToString());
-                            }
-                        }
-                        // Has inputs but not accepted to mempool
-                        // Probably non-standard or insufficient fee
-                        LogPrint(BCLog::MEMPOOL, "   removed orphan tx %s\n",
-                                 orphanId.ToString());
-                        vEraseQueue.push_back(orphanId);
-                        if (!stateDummy.CorruptionPossible()) {
-                            // Do not use rejection cache for witness
-                            // transactions or witness-stripped transactions, as
-                            // they can have been malleated. See
-                            // https://github.com/bitcoin/bitcoin/issues/8279
-                            // for details.
-                            assert(recentRejects);
-                            recentRejects->insert(orphanId);
-                        }
-                    }
-                    g_mempool.check(pcoinsTip.get());
-                }
-            }
-
-            for (const TxId &idOfOrphanTxToErase : vEraseQueue) {
-                EraseOrphanTx(idOfOrphanTxToErase);
-            }
-        } else if (fMissingInputs) {
-            // It may be the case that the orphans parents have all been
-            // rejected.
-            bool fRejectedParents = false;
-            for (const CTxIn &txin : tx.vin) {
-                if (recentRejects->contains(txin.prevout.GetTxId())) {
-                    fRejectedParents = true;
-                    break;
-                }
-            }
-            if (!fRejectedParents) {
-                int64_t nNow = GetTimeMicros();
-
-                for (const CTxIn &txin : tx.vin) {
-                    // FIXME: MSG_TX should use a TxHash, not a TxId.
-                    const TxId _txid = txin.prevout.GetTxId();
-                    CInv _inv(MSG_TX, _txid);
-                    pfrom->AddInventoryKnown(_inv);
-                    if (!AlreadyHave(_inv)) {
-                        RequestTx(State(pfrom->GetId()), _txid, nNow);
-                    }
-                }
-                internal::AddOrphanTx(ptx, pfrom->GetId());
-
-                // DoS prevention: do not allow mapOrphanTransactions to grow
-                // unbounded
-                unsigned int nMaxOrphanTx = (unsigned int)std::max(
-                    int64_t(0), gArgs.GetArg("-maxorphantx",
-                                             DEFAULT_MAX_ORPHAN_TRANSACTIONS));
-                unsigned int nEvicted = internal::LimitOrphanTxSize(nMaxOrphanTx);
-                if (nEvicted > 0) {
-                    LogPrint(BCLog::MEMPOOL,
-                             "mapOrphan overflow, removed %u tx\n", nEvicted);
-                }
-            } else {
-                LogPrint(BCLog::MEMPOOL,
-                         "not keeping orphan with rejected parents %s\n",
-                         tx.GetId().ToString());
-                // We will continue to reject this tx since it has rejected
-                // parents so avoid re-requesting it from other peers.
-                recentRejects->insert(tx.GetId());
-            }
-        } else {
-            if (!state.CorruptionPossible()) {
-                // Do not use rejection cache for witness transactions or
-                // witness-stripped transactions, as they can have been
-                // malleated. See https://github.com/bitcoin/bitcoin/issues/8279
-                // for details.
-                assert(recentRejects);
-                recentRejects->insert(tx.GetId());
-                if (RecursiveDynamicUsage(*ptx) < 100000) {
-                    AddToCompactExtraTransactions(ptx);
-                }
-            }
-
-            if (pfrom->HasPermission(PF_FORCERELAY)) {
-                // Always relay transactions received from whitelisted peers,
-                // even if they were already in the mempool or rejected from it
-                // due to policy, allowing the node to function as a gateway for
-                // nodes hidden behind it.
-                //
-                // Never relay transactions that we would assign a non-zero DoS
-                // score for, as we expect peers to do the same with us in that
-                // case.
-                int nDoS = 0;
-                if (!state.IsInvalid(nDoS) || nDoS == 0) {
-                    LogPrintf("Force relaying tx %s from whitelisted peer=%d\n",
-                              tx.GetId().ToString(), pfrom->GetId());
-                    RelayTransaction(tx, connman);
-                } else {
-                    LogPrintf("Not relaying invalid transaction %s from "
-                              "whitelisted peer=%d (%s)\n",
-                              tx.GetId().ToString(), pfrom->GetId(),
-                              FormatStateMessage(state));
-                }
-            }
-        }
-
-        // If a tx has been detected by recentRejects, we will have reached
-        // this point and the tx will have been ignored. Because we haven't run
-        // the tx through AcceptToMemoryPool, we won't have computed a DoS
-        // score for it or determined exactly why we consider it invalid.
-        //
-        // This means we won't penalize any peer subsequently relaying a DoSy
-        // tx (even if we penalized the first peer who gave it to us) because
-        // we have to account for recentRejects showing false positives. In
-        // other words, we shouldn't penalize a peer if we aren't *sure* they
-        // submitted a DoSy tx.
-        //
-        // Note that recentRejects doesn't just record DoSy or invalid
-        // transactions, but any tx not accepted by the mempool, which may be
-        // due to node policy (vs. consensus). So we can't blanket penalize a
-        // peer simply for relaying a tx that our recentRejects has caught,
-        // regardless of false positives.
-
-        int nDoS = 0;
-        if (state.IsInvalid(nDoS)) {
-            LogPrint(BCLog::MEMPOOLREJ,
-                     "%s from peer=%d was not accepted: %s\n",
-                     tx.GetHash().ToString(), pfrom->GetId(),
-                     FormatStateMessage(state));
-            // Never send AcceptToMemoryPool's internal codes over P2P.
-            if (enable_bip61 && state.GetRejectCode() > 0 &&
-                state.GetRejectCode() < REJECT_INTERNAL) {
-                connman->PushMessage(
-                    pfrom, msgMaker.Make(NetMsgType::REJECT, strCommand,
-                                         uint8_t(state.GetRejectCode()),
-                                         state.GetRejectReason().substr(
-                                             0, MAX_REJECT_MESSAGE_LENGTH),
-                                         inv.hash));
-            }
-            if (nDoS > 0) {
-                Misbehaving(pfrom, nDoS, state.GetRejectReason());
-            }
-        }
+        // Accepted at the end of the round, along with the transactions
+        // received from the other peers.
+        pendingTxs.emplace_back(pfrom, std::move(ptx));
         return true;
     }
 
@@ -3266,7 +3338,7 @@ static bool ProcessMessage(const Config &config, CNode *pfrom,
         if (fProcessBLOCKTXN) {
             return ProcessMessage(config, pfrom, NetMsgType::BLOCKTXN,
                                   blockTxnMsg, nTimeReceived, connman,
-                                  interruptMsgProc, enable_bip61);
+                                  interruptMsgProc, enable_bip61, pendingTxs);
         }
 
         if (fRevertToHeaderProcessing) {
@@ -3897,7 +3969,8 @@ bool PeerLogicValidation::ProcessMessages(const Config &config, CNode *pfrom,
     bool fRet = false;
     try {
         fRet = ProcessMessage(config, pfrom, strCommand, vRecv, msg.nTime,
-                              connman, interruptMsgProc, m_enable_bip61);
+                              connman, interruptMsgProc, m_enable_bip61,
+                              m_pending_txs);
         if (interruptMsgProc) {
             return false;
         }
@@ -3955,6 +4028,49 @@ bool PeerLogicValidation::ProcessMessages(const Config &config, CNode *pfrom,
     return fMoreWork;
 }
 
+void PeerLogicValidation::ProcessDeferredMessages(
+    const Config &config, std::atomic<bool> &interruptMsgProc) {
+    if (m_pending_txs.empty()) {
+        return;
+    }
+
+    std::vector<std::pair<CNode *, CTransactionRef>> pendingTxs;
+    pendingTxs.swap(m_pending_txs);
+
+    // Fill the signature cache for the whole batch in parallel, so that
+    // accepting the transactions one at a time under cs_main is cheap.
+    std::vector<CTransactionRef> txs;
+    txs.reserve(pendingTxs.size());
+    for (const auto &pending : pendingTxs) {
+        txs.push_back(pending.second);
+    }
+    PreCheckTransactions(config, g_mempool, txs);
+
+    // Accept them in the order they were received, as if each had been
+    // processed along with its message.
+    for (const auto &pending : pendingTxs) {
+        CNode *pfrom = pending.first;
+        if (interruptMsgProc) {
+            return;
+        }
+        if (pfrom->fDisconnect) {
+            continue;
+        }
+
+        try {
+            ProcessTransaction(config, pfrom, pending.second, connman,
+                               m_enable_bip61);
+        } catch (const std::exception &e) {
+            PrintExceptionContinue(&e, "ProcessDeferredMessages()");
+        } catch (...) {
+            PrintExceptionContinue(nullptr, "ProcessDeferredMessages()");
+        }
+
+        LOCK(cs_main);
+        SendRejectsAndCheckIfShouldDiscourage(pfrom, m_enable_bip61);
+    }
+}
+
 void PeerLogicValidation::ConsiderEviction(CNode *pto,
                                            int64_t time_in_seconds) {
     AssertLockHeld(cs_main);
@@ -4611,8 +4727,8 @@ bool PeerLogicValidation::SendMessages(const Config &config, CNode *pto,
                         vRelayExpiration.pop_front();
                     }
 
-                    auto ret = mapRelay.insert(
-                        std::make_pair(txid, std::move(txinfo.tx)));
+                    auto ret =
+                        mapRelay.emplace(txid, RelayedTx(std::move(txinfo.tx)));
                     if (ret.second) {
                         vRelayExpiration.emplace_back(
                             nNow + 15 * 60 * 1000000, ret.first);
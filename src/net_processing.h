@@ -12,6 +12,8 @@
 #include <validationinterface.h>
 
 #include <map>
+#include <utility>
+#include <vector>
 
 extern RecursiveMutex cs_main;
 
@@ -96,6 +98,12 @@ public:
      */
     bool ProcessMessages(const Config &config, CNode *pfrom,
                          std::atomic<bool> &interrupt) override;
+    /**
+     * Accept the transactions received during the round to the mempool, after
+     * checking their scripts in parallel.
+     */
+    void ProcessDeferredMessages(const Config &config,
+                                 std::atomic<bool> &interrupt) override;
     /**
      * Send queued protocol messages to be sent to a give node.
      *
@@ -132,6 +140,12 @@ private:
 
     /** Enable BIP61 (sending reject messages) */
     const bool m_enable_bip61;
+
+    /**
+     * Transactions received during the current round of message processing,
+     * with the node they came from. Only used by the message handler thread.
+     */
+    std::vector<std::pair<CNode *, CTransactionRef>> m_pending_txs;
 };
 
 struct CNodeStateStats {
@@ -17,11 +17,16 @@
 #include <atomic>
 
 static std::atomic<const CBlockIndex *> cachedAnchor{nullptr};
+static std::atomic<const CBlockIndex *> cachedEMAAnchor{nullptr};
 
 void ResetASERTAnchorBlockCache() noexcept {
     cachedAnchor = nullptr;
 }
 
+void ResetEMAAnchorBlockCache() noexcept {
+    cachedEMAAnchor = nullptr;
+}
+
 const CBlockIndex *GetASERTAnchorBlockCache() noexcept {
     return cachedAnchor.load();
 }
@@ -88,6 +93,42 @@ static const CBlockIndex *GetASERTAnchorBlock(const CBlockIndex *const pindex,
     return anchor;
 }
 
+const CBlockIndex *GetEMAAnchorBlock(const CBlockIndex *const pindex,
+                                     const Consensus::Params &params) {
+    assert(pindex);
+
+    // As for ASERT, a cached anchor that is an ancestor of pindex is the
+    // anchor of pindex too, as the median time past never decreases.
+    const CBlockIndex *lastCached = cachedEMAAnchor.load();
+    if (lastCached && pindex->GetAncestor(lastCached->nHeight) == lastCached) {
+        return lastCached;
+    }
+
+    if (!IsEMAEnabled(params, pindex)) {
+        return nullptr;
+    }
+
+    // Slow path: walk back until we find the first ancestor for which
+    // IsEMAEnabled() == true.
+    const CBlockIndex *anchor = pindex;
+    while (anchor->pprev) {
+        // The below code leverages CBlockIndex::pskip to walk back efficiently.
+        if (IsEMAEnabled(params, anchor->pskip)) {
+            anchor = anchor->pskip;
+            continue;
+        }
+        // cannot skip here, walk back by 1
+        if (!IsEMAEnabled(params, anchor->pprev)) {
+            break;
+        }
+        anchor = anchor->pprev;
+    }
+
+    cachedEMAAnchor = anchor;
+
+    return anchor;
+}
+
 
 /**
  * Compute the next required proof of work using an absolutely scheduled
@@ -683,11 +724,11 @@ uint32_t GetNextExpWorkRequired(const CBlockIndex *pindexPrev,
     if (pindexPrev->nHeight<4) {
         return 0x1a04b500; //should be about right for two s9
     }
-    arith_uint256 nextTarget=ComputeExpTarget(pindexPrev , params);
-    if(! IsEMAEnabled(params, pindexPrev)) {
+    arith_uint256 nextTarget;
+    const CBlockIndex *emaAnchor = GetEMAAnchorBlock(pindexPrev, params);
+    if (!emaAnchor) {
         nextTarget=ComputeExpTarget(pindexPrev , params);
-    } else if (IsEMAEnabled(params, pindexPrev)
-               && !IsEMAEnabled(params, pindexPrev->pprev)) {
+    } else if (emaAnchor == pindexPrev) {
         // Due to attack on Jun 24 2022 the difficulty was driven to powLimit,
         // we need to jumpstart it back on the fork.
         return 0x1a04b500;
@@ -66,6 +66,19 @@ void ResetASERTAnchorBlockCache() noexcept;
  */
 const CBlockIndex *GetASERTAnchorBlockCache() noexcept;
 
+/**
+ * Returns the first block of the chain of pindex for which IsEMAEnabled()
+ * returns true, which may be pindex itself, or nullptr if it returns false for
+ * pindex. The last result is cached like the ASERT anchor block.
+ */
+const CBlockIndex *GetEMAAnchorBlock(const CBlockIndex *pindex,
+                                     const Consensus::Params &params);
+
+/**
+ * Clear the EMA anchor block cache, see ResetASERTAnchorBlockCache().
+ */
+void ResetEMAAnchorBlockCache() noexcept;
+
 uint32_t GetNextExpWorkRequired(const CBlockIndex *pindex,
                         const CBlockHeader *pblock,
                         const Consensus::Params &params) ;
@@ -9,9 +9,18 @@
 #include <secp256k1_recovery.h>
 #include <secp256k1_schnorr.h>
 
+#include <algorithm>
+#include <cassert>
+
 namespace {
 /* Global secp256k1_context object used for verification. */
 secp256k1_context *secp256k1_context_verify = nullptr;
+
+/**
+ * Scratch space for the multi-multiplication of a batch of Schnorr
+ * signatures, enough for the faster algorithms up to a few hundred of them.
+ */
+constexpr size_t SCHNORR_BATCH_SCRATCH_SIZE = 1 << 20;
 } // namespace
 
 /**
@@ -215,6 +224,67 @@ bool CPubKey::VerifySchnorr(const uint256 &hash,
                                     hash.begin(), &pubkey);
 }
 
+void SchnorrBatchVerifier::Add(const CPubKey &pubkey, const uint256 &hash,
+                               const std::vector<uint8_t> &vchSig) {
+    assert(vchSig.size() == 64);
+    entries.emplace_back();
+    Entry &entry = entries.back();
+    entry.pubkey = pubkey;
+    entry.hash = hash;
+    std::copy(vchSig.begin(), vchSig.end(), entry.sig.begin());
+}
+
+bool SchnorrBatchVerifier::Verify(std::vector<size_t> *invalid) const {
+    if (invalid) {
+        invalid->clear();
+    }
+
+    // A lone signature is faster to verify on its own
+    bool fBatchOk = entries.size() > 1;
+    if (fBatchOk) {
+        std::vector<secp256k1_pubkey> pubkeys(entries.size());
+        std::vector<const secp256k1_pubkey *> pubkey_ptrs(entries.size());
+        std::vector<const uint8_t *> sig_ptrs(entries.size());
+        std::vector<const uint8_t *> msg_ptrs(entries.size());
+        for (size_t i = 0; fBatchOk && i < entries.size(); i++) {
+            const Entry &entry = entries[i];
+            fBatchOk = entry.pubkey.IsValid() &&
+                       secp256k1_ec_pubkey_parse(secp256k1_context_verify,
+                                                 &pubkeys[i], &entry.pubkey[0],
+                                                 entry.pubkey.size());
+            pubkey_ptrs[i] = &pubkeys[i];
+            sig_ptrs[i] = entry.sig.data();
+            msg_ptrs[i] = entry.hash.begin();
+        }
+        if (fBatchOk) {
+            secp256k1_scratch_space *scratch = secp256k1_scratch_space_create(
+                secp256k1_context_verify, SCHNORR_BATCH_SCRATCH_SIZE);
+            fBatchOk = secp256k1_schnorr_verify_batch(
+                secp256k1_context_verify, scratch, sig_ptrs.data(),
+                msg_ptrs.data(), pubkey_ptrs.data(), entries.size());
+            secp256k1_scratch_space_destroy(secp256k1_context_verify, scratch);
+        }
+        if (fBatchOk) {
+            return true;
+        }
+    }
+
+    bool fAllOk = true;
+    std::vector<uint8_t> vchSig;
+    for (size_t i = 0; i < entries.size(); i++) {
+        const Entry &entry = entries[i];
+        vchSig.assign(entry.sig.begin(), entry.sig.end());
+        if (!entry.pubkey.VerifySchnorr(entry.hash, vchSig)) {
+            fAllOk = false;
+            if (!invalid) {
+                break;
+            }
+            invalid->push_back(i);
+        }
+    }
+    return fAllOk;
+}
+
 bool CPubKey::RecoverCompact(const uint256 &hash,
                              const std::vector<uint8_t> &vchSig) {
     if (vchSig.size() != COMPACT_SIGNATURE_SIZE) {
@@ -13,6 +13,7 @@
 
 #include <boost/range/adaptor/sliced.hpp>
 
+#include <array>
 #include <stdexcept>
 #include <vector>
 
@@ -187,6 +188,44 @@ public:
                 const ChainCode &cc) const;
 };
 
+/**
+ * Verifies Schnorr signatures (=64 bytes) in batches, which is faster than
+ * verifying them one by one. Signatures are collected as they are met and all
+ * verified at once by Verify.
+ */
+class SchnorrBatchVerifier {
+private:
+    struct Entry {
+        CPubKey pubkey;
+        uint256 hash;
+        std::array<uint8_t, 64> sig;
+    };
+
+    std::vector<Entry> entries;
+
+public:
+    /**
+     * Add a signature to the batch. It is not verified before Verify is
+     * called.
+     */
+    void Add(const CPubKey &pubkey, const uint256 &hash,
+             const std::vector<uint8_t> &vchSig);
+
+    size_t size() const { return entries.size(); }
+    bool empty() const { return entries.empty(); }
+    void clear() { entries.clear(); }
+
+    /**
+     * Verify all the signatures of the batch. When the batch is invalid, its
+     * signatures are verified one by one to find out which are.
+     *
+     * @param[out] invalid The indexes of the invalid signatures, in the order
+     *                     they were added (can be nullptr).
+     * @return Whether all the signatures are valid.
+     */
+    bool Verify(std::vector<size_t> *invalid = nullptr) const;
+};
+
 struct CExtPubKey {
     uint8_t nDepth;
     uint8_t vchFingerprint[4];
@@ -0,0 +1,62 @@
+// Copyright (c) 2020 The Bitcoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <rawblockcache.h>
+
+#include <net.h>
+
+std::shared_ptr<const CSharedNetPayload>
+RawBlockCache::Get(const BlockHash &hash) {
+    LOCK(m_mutex);
+    auto it = m_index.find(hash);
+    if (it == m_index.end()) {
+        return nullptr;
+    }
+    m_entries.splice(m_entries.begin(), m_entries, it->second);
+    return it->second->second;
+}
+
+void RawBlockCache::Insert(const BlockHash &hash,
+                           std::shared_ptr<const CSharedNetPayload> block) {
+    const size_t size = block->data.size();
+
+    LOCK(m_mutex);
+    if (m_max_bytes == 0 || size > m_max_bytes || m_index.count(hash)) {
+        return;
+    }
+    Evict(m_max_bytes - size);
+    m_entries.emplace_front(hash, std::move(block));
+    m_index.emplace(hash, m_entries.begin());
+    m_bytes += size;
+}
+
+void RawBlockCache::SetMaxBytes(size_t max_bytes) {
+    LOCK(m_mutex);
+    m_max_bytes = max_bytes;
+    Evict(max_bytes);
+}
+
+size_t RawBlockCache::GetMaxBytes() const {
+    LOCK(m_mutex);
+    return m_max_bytes;
+}
+
+size_t RawBlockCache::GetBytes() const {
+    LOCK(m_mutex);
+    return m_bytes;
+}
+
+size_t RawBlockCache::GetCount() const {
+    LOCK(m_mutex);
+    return m_entries.size();
+}
+
+void RawBlockCache::Evict(size_t max_bytes) {
+    while (m_bytes > max_bytes) {
+        const Entry &oldest = m_entries.back();
+        m_bytes -= oldest.second->data.size();
+        m_index.erase(oldest.first);
+        m_entries.pop_back();
+    }
+}
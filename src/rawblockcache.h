@@ -0,0 +1,64 @@
+// Copyright (c) 2020 The Bitcoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_RAWBLOCKCACHE_H
+#define BITCOIN_RAWBLOCKCACHE_H
+
+#include <chain.h>
+#include <primitives/blockhash.h>
+#include <sync.h>
+
+#include <cstddef>
+#include <list>
+#include <memory>
+#include <unordered_map>
+#include <utility>
+
+struct CSharedNetPayload;
+
+/** Default for -rawblockcache, in MiB */
+static constexpr size_t DEFAULT_RAW_BLOCK_CACHE_SIZE = 32;
+
+/**
+ * Least recently used cache of blocks as they are serialized on disk, shared
+ * by all peers so that a block requested by many of them is read only once.
+ *
+ * The cache holds at most the configured number of bytes of block data. Blocks
+ * larger than that are never cached, and a limit of 0 disables the cache.
+ */
+class RawBlockCache {
+public:
+    explicit RawBlockCache(size_t max_bytes) : m_max_bytes(max_bytes) {}
+
+    /** Return the cached block, or nullptr, and mark it as recently used. */
+    std::shared_ptr<const CSharedNetPayload> Get(const BlockHash &hash);
+
+    /** Add a block, evicting the least recently used ones to make room. */
+    void Insert(const BlockHash &hash,
+                std::shared_ptr<const CSharedNetPayload> block);
+
+    /** Change the limit, evicting blocks if it shrinks. */
+    void SetMaxBytes(size_t max_bytes);
+
+    size_t GetMaxBytes() const;
+    size_t GetBytes() const;
+    size_t GetCount() const;
+
+private:
+    using Entry =
+        std::pair<BlockHash, std::shared_ptr<const CSharedNetPayload>>;
+    using EntryList = std::list<Entry>;
+
+    void Evict(size_t max_bytes) EXCLUSIVE_LOCKS_REQUIRED(m_mutex);
+
+    mutable Mutex m_mutex;
+    size_t m_max_bytes GUARDED_BY(m_mutex);
+    size_t m_bytes GUARDED_BY(m_mutex) = 0;
+    //! Most recently used first
+    EntryList m_entries GUARDED_BY(m_mutex);
+    std::unordered_map<BlockHash, EntryList::iterator, BlockHasher>
+        m_index GUARDED_BY(m_mutex);
+};
+
+#endif // BITCOIN_RAWBLOCKCACHE_H
@@ -18,6 +18,7 @@
 #include <streams.h>
 #include <sync.h>
 #include <txmempool.h>
+#include <util/jsonwriter.h>
 #include <util/strencodings.h>
 #include <validation.h>
 #include <version.h>
@@ -121,6 +122,49 @@ static bool CheckWarmup(HTTPRequest *req) {
     return true;
 }
 
+/**
+ * Reply with serialized data, as is or in hex, in chunks if it is large, so
+ * that no complete copy of it is made.
+ */
+static void WriteDataReply(HTTPRequest *req, const CDataStream &ss,
+                           bool fHex) {
+    req->WriteHeader("Content-Type",
+                     fHex ? "text/plain" : "application/octet-stream");
+    HTTPChunkedReply reply(req, HTTP_OK);
+    const size_t nChunkSize =
+        fHex ? HTTP_REPLY_CHUNK_SIZE / 2 : HTTP_REPLY_CHUNK_SIZE;
+    auto it = ss.begin();
+    while (size_t(ss.end() - it) > nChunkSize) {
+        std::string chunk = fHex ? HexStr(it, it + nChunkSize)
+                                 : std::string(it, it + nChunkSize);
+        if (!reply.Write(std::move(chunk))) {
+            // The client went away
+            it = ss.end();
+            break;
+        }
+        it += nChunkSize;
+    }
+    reply.End(fHex ? HexStr(it, ss.end()) + "\n" : std::string(it, ss.end()));
+}
+
+/**
+ * Reply with the JSON text written by write, in chunks if it is large, so
+ * that the text is sent out as it is written.
+ */
+static void WriteJSONReply(HTTPRequest *req,
+                           const std::function<void(JSONWriter &)> &write) {
+    req->WriteHeader("Content-Type", "application/json");
+    HTTPChunkedReply reply(req, HTTP_OK);
+    std::string strJSON;
+    JSONWriter writer(
+        strJSON,
+        [&reply](std::string &chunk) { reply.Write(std::move(chunk)); },
+        HTTP_REPLY_CHUNK_SIZE);
+    write(writer);
+    strJSON += "\n";
+    reply.End(std::move(strJSON));
+}
+
 static bool rest_headers(Config &config, HTTPRequest *req,
                          const std::string &strURIPart) {
     if (!CheckWarmup(req)) {
@@ -194,14 +238,13 @@ static bool rest_headers(Config &config, HTTPRequest *req,
             return true;
         }
         case RetFormat::JSON: {
-            UniValue::Array jsonHeaders;
-            jsonHeaders.reserve(headers.size());
-            for (const CBlockIndex *pindex : headers) {
-                jsonHeaders.emplace_back(blockheaderToJSON(tip, pindex));
-            }
-            std::string strJSON = UniValue::stringify(jsonHeaders) + "\n";
-            req->WriteHeader("Content-Type", "application/json");
-            req->WriteReply(HTTP_OK, strJSON);
+            WriteJSONReply(req, [&](JSONWriter &writer) {
+                writer.BeginArray();
+                for (const CBlockIndex *pindex : headers) {
+                    writer.Value(blockheaderToJSON(tip, pindex));
+                }
+                writer.EndArray();
+            });
             return true;
         }
         default: {
@@ -250,31 +293,20 @@ static bool rest_block(const Config &config, HTTPRequest *req,
     }
 
     switch (rf) {
-        case RetFormat::BINARY: {
-            CDataStream ssBlock(SER_NETWORK,
-                                PROTOCOL_VERSION | RPCSerializationFlags());
-            ssBlock << block;
-            std::string binaryBlock = ssBlock.str();
-            req->WriteHeader("Content-Type", "application/octet-stream");
-            req->WriteReply(HTTP_OK, binaryBlock);
-            return true;
-        }
-
+        case RetFormat::BINARY:
         case RetFormat::HEX: {
             CDataStream ssBlock(SER_NETWORK,
                                 PROTOCOL_VERSION | RPCSerializationFlags());
             ssBlock << block;
-            std::string strHex = HexStr(ssBlock.begin(), ssBlock.end()) + "\n";
-            req->WriteHeader("Content-Type", "text/plain");
-            req->WriteReply(HTTP_OK, strHex);
+            WriteDataReply(req, ssBlock, rf == RetFormat::HEX);
             return true;
         }
 
         case RetFormat::JSON: {
-            UniValue::Object objBlock = blockToJSON(config, block, tip, pblockindex, showTxDetails);
-            std::string strJSON = UniValue::stringify(objBlock) + "\n";
-            req->WriteHeader("Content-Type", "application/json");
-            req->WriteReply(HTTP_OK, strJSON);
+            WriteJSONReply(req, [&](JSONWriter &writer) {
+                WriteBlockJSON(writer, config, block, tip, pblockindex,
+                               showTxDetails);
+            });
             return true;
         }
 
@@ -360,9 +392,9 @@ static bool rest_mempool_contents(Config &config, HTTPRequest *req,
         case RetFormat::JSON: {
             UniValue mempoolObject = MempoolToJSON(::g_mempool, true);
 
-            std::string strJSON = UniValue::stringify(mempoolObject) + "\n";
-            req->WriteHeader("Content-Type", "application/json");
-            req->WriteReply(HTTP_OK, strJSON);
+            WriteJSONReply(req, [&mempoolObject](JSONWriter &writer) {
+                writer.Value(mempoolObject);
+            });
             return true;
         }
         default: {
@@ -7,6 +7,7 @@
 #include <rpc/blockchain.h>
 
 #include <amount.h>
+#include <blockfilter.h>
 #include <chain.h>
 #include <chainparams.h>
 #include <checkpoints.h>
@@ -15,6 +16,7 @@
 #include <consensus/validation.h>
 #include <core_io.h>
 #include <hash.h>
+#include <index/blockfilterindex.h>
 #include <index/txindex.h>
 #include <key_io.h>
 #include <policy/policy.h>
@@ -27,6 +29,7 @@
 #include <txdb.h>
 #include <txmempool.h>
 #include <undo.h>
+#include <util/jsonwriter.h>
 #include <util/strencodings.h>
 #include <util/system.h>
 #include <validation.h>
@@ -35,11 +38,14 @@
 
 #include <boost/thread/thread.hpp> // boost::thread::interrupt
 
+#include <algorithm>
 #include <cassert>
 #include <condition_variable>
 #include <cstdint>
+#include <functional>
 #include <memory>
 #include <mutex>
+#include <thread>
 
 struct CUpdatedBlock {
     uint256 hash;
@@ -151,6 +157,44 @@ UniValue::Object blockToJSON(const Config &config, const CBlock &block, const CB
     return result;
 }
 
+void WriteBlockJSON(JSONWriter &writer, const Config &config, const CBlock &block, const CBlockIndex *tip,
+                    const CBlockIndex *blockindex, bool txDetails) {
+    const CBlockIndex *pnext;
+    int confirmations = ComputeNextBlockAndDepth(tip, blockindex, pnext);
+    writer.BeginObject();
+    writer.KeyValue("hash", blockindex->GetBlockHash().GetHex());
+    writer.KeyValue("confirmations", confirmations);
+    writer.KeyValue("size", ::GetSerializeSize(block, PROTOCOL_VERSION));
+    writer.KeyValue("height", blockindex->nHeight);
+    writer.KeyValue("version", block.nVersion);
+    writer.KeyValue("versionHex", strprintf("%08x", block.nVersion));
+    writer.KeyValue("merkleroot", block.hashMerkleRoot.GetHex());
+    writer.Key("tx");
+    writer.BeginArray();
+    for (const auto &tx : block.vtx) {
+        if (txDetails) {
+            WriteTxJSON(writer, config, *tx, uint256(), true, RPCSerializationFlags());
+        } else {
+            writer.Value(tx->GetId().GetHex());
+        }
+    }
+    writer.EndArray();
+    writer.KeyValue("time", block.GetBlockTime());
+    writer.KeyValue("mediantime", blockindex->GetMedianTimePast());
+    writer.KeyValue("nonce", block.nNonce);
+    writer.KeyValue("bits", strprintf("%08x", block.nBits));
+    writer.KeyValue("difficulty", GetDifficulty(blockindex));
+    writer.KeyValue("chainwork", blockindex->nChainWork.GetHex());
+    writer.KeyValue("nTx", blockindex->nTx);
+    if (blockindex->pprev) {
+        writer.KeyValue("previousblockhash", blockindex->pprev->GetBlockHash().GetHex());
+    }
+    if (pnext) {
+        writer.KeyValue("nextblockhash", pnext->GetBlockHash().GetHex());
+    }
+    writer.EndObject();
+}
+
 static UniValue getblockcount(const Config &config,
                               const JSONRPCRequest &request) {
     if (request.fHelp || request.params.size() != 0) {
@@ -512,10 +556,15 @@ static UniValue::Object entryToJSON(const CTxMemPool &pool, const CTxMemPoolEntr
 
     UniValue::Array spent;
     const CTxMemPool::txiter &it = pool.mapTx.find(tx.GetId());
-    const CTxMemPool::setEntries &setChildren = pool.GetMemPoolChildren(it);
-    spent.reserve(setChildren.size());
-    for (CTxMemPool::txiter childiter : setChildren) {
-        spent.emplace_back(childiter->GetTx().GetId().ToString());
+    // List the children by txid, as they are not kept in any order.
+    std::vector<TxId> children;
+    for (const CTxMemPoolEntry *child : pool.GetMemPoolChildren(it)) {
+        children.push_back(child->GetTx().GetId());
+    }
+    std::sort(children.begin(), children.end());
+    spent.reserve(children.size());
+    for (const TxId &childid : children) {
+        spent.emplace_back(childid.ToString());
     }
     info.emplace_back("spentby", std::move(spent));
 
@@ -1010,7 +1059,16 @@ static UniValue getblock(const Config &config, const JSONRPCRequest &request) {
         return strHex;
     }
 
-    return blockToJSON(config, block, ::ChainActive().Tip(), pblockindex, verbosity >= 2);
+    if (verbosity == 1) {
+        return blockToJSON(config, block, ::ChainActive().Tip(), pblockindex);
+    }
+
+    // The details of all the transactions of a large block make a huge tree of
+    // UniValue objects, so write its JSON as we go instead.
+    std::string json;
+    JSONWriter writer(json);
+    WriteBlockJSON(writer, config, block, ::ChainActive().Tip(), pblockindex, true);
+    return UniValue::fromSerializedJSON(std::move(json));
 }
 
 struct CCoinsStats {
@@ -1028,7 +1086,108 @@ struct CCoinsStats {
           nDiskSize(0), nTotalAmount() {}
 };
 
-static void ApplyStats(CCoinsStats &stats, CHashWriter &ss, const uint256 &hash,
+/**
+ * Number of shards the UTXO set is split into when it is scanned in parallel.
+ * There are enough of them to balance the work between the threads even
+ * though the coins are not evenly spread over the shards.
+ */
+static constexpr size_t UTXO_SCAN_SHARDS = 256;
+
+/**
+ * Scan the shards of the UTXO set in parallel, and merge their results in
+ * order on the calling thread.
+ *
+ * scan_shard is called from the worker threads, at most once per shard, and
+ * returns false if the scan must stop. merge_shard is called on the calling
+ * thread for every shard in order, once it has been scanned. Workers don't
+ * run too far ahead of the merge, so that at most a few shards worth of
+ * results are held in memory at any time.
+ */
+static bool ScanCoinsParallel(
+    std::vector<std::unique_ptr<CCoinsViewCursor>> &cursors,
+    const std::function<bool(size_t, CCoinsViewCursor &)> &scan_shard,
+    const std::function<void(size_t)> &merge_shard) {
+    const size_t nShards = cursors.size();
+    const size_t nThreads =
+        std::min<size_t>(std::max(GetNumCores(), 1), nShards);
+    const size_t nMaxAhead = 2 * nThreads;
+
+    Mutex mutex;
+    std::condition_variable cond;
+    std::vector<bool> vDone(nShards, false);
+    size_t nNext = 0;
+    size_t nMerged = 0;
+    bool fFailed = false;
+
+    auto worker = [&]() {
+        WAIT_LOCK(mutex, lock);
+        while (true) {
+            cond.wait(lock, [&] {
+                return fFailed || nNext == nShards ||
+                       nNext < nMerged + nMaxAhead;
+            });
+            if (fFailed || nNext == nShards) {
+                return;
+            }
+            const size_t i = nNext++;
+            lock.unlock();
+            bool fOk;
+            try {
+                fOk = scan_shard(i, *cursors[i]);
+            } catch (const std::exception &e) {
+                fOk = error("%s: %s", __func__, e.what());
+            }
+            lock.lock();
+            if (!fOk) {
+                fFailed = true;
+            }
+            vDone[i] = true;
+            cond.notify_all();
+        }
+    };
+
+    std::vector<std::thread> threads;
+    threads.reserve(nThreads);
+    for (size_t t = 0; t < nThreads; t++) {
+        threads.emplace_back(worker);
+    }
+
+    try {
+        for (size_t i = 0; i < nShards; i++) {
+            {
+                WAIT_LOCK(mutex, lock);
+                cond.wait(lock, [&] { return fFailed || vDone[i]; });
+                if (fFailed) {
+                    break;
+                }
+            }
+            merge_shard(i);
+            {
+                LOCK(mutex);
+                nMerged = i + 1;
+            }
+            cond.notify_all();
+        }
+    } catch (...) {
+        {
+            LOCK(mutex);
+            fFailed = true;
+        }
+        cond.notify_all();
+        for (std::thread &thread : threads) {
+            thread.join();
+        }
+        throw;
+    }
+
+    for (std::thread &thread : threads) {
+        thread.join();
+    }
+    return !fFailed;
+}
+
+template <typename Stream>
+static void ApplyStats(CCoinsStats &stats, Stream &ss, const uint256 &hash,
                        const std::map<uint32_t, Coin> &outputs) {
     assert(!outputs.empty());
     ss << hash;
@@ -1042,46 +1201,68 @@ static void ApplyStats(CCoinsStats &stats, CHashWriter &ss, const uint256 &hash,
                      VarIntMode::NONNEGATIVE_SIGNED);
         stats.nTransactionOutputs++;
         stats.nTotalAmount += output.second.GetTxOut().nValue;
-        stats.nBogoSize +=
-            32 /* txid */ + 4 /* vout index */ + 4 /* height + coinbase */ +
-            8 /* amount */ + 2 /* scriptPubKey len */ +
-            output.second.GetTxOut().scriptPubKey.size() /* scriptPubKey */;
+        stats.nBogoSize += GetBogoSize(output.second.GetTxOut().scriptPubKey);
     }
     ss << VARINT(0u);
 }
 
 //! Calculate statistics about the unspent transaction output set
-static bool GetUTXOStats(CCoinsView *view, CCoinsStats &stats) {
-    std::unique_ptr<CCoinsViewCursor> pcursor(view->Cursor());
-    assert(pcursor);
-
-    CHashWriter ss(SER_GETHASH, PROTOCOL_VERSION);
-    stats.hashBlock = pcursor->GetBestBlock();
+static bool GetUTXOStats(CCoinsViewDB *view, CCoinsStats &stats) {
+    std::vector<std::unique_ptr<CCoinsViewCursor>> cursors;
     {
         LOCK(cs_main);
+        // Write the cache out, and create all the cursors before anything
+        // else can be written to the database, so that they all see the same
+        // UTXO set.
+        FlushStateToDisk();
+        cursors = view->Cursors(UTXO_SCAN_SHARDS);
+        stats.hashBlock = cursors.front()->GetBestBlock();
         stats.nHeight = LookupBlockIndex(stats.hashBlock)->nHeight;
     }
-    ss << stats.hashBlock;
-    uint256 prevkey;
-    std::map<uint32_t, Coin> outputs;
-    while (pcursor->Valid()) {
-        boost::this_thread::interruption_point();
-        COutPoint key;
-        Coin coin;
-        if (pcursor->GetKey(key) && pcursor->GetValue(coin)) {
+
+    // Shards only hold whole transactions, because the coins are sorted by
+    // txid, so the serialization of each shard can be computed separately and
+    // hashed in order.
+    std::vector<CCoinsStats> shard_stats(cursors.size());
+    std::vector<std::vector<uint8_t>> shard_data(cursors.size());
+    auto scan_shard = [&](size_t i, CCoinsViewCursor &cursor) {
+        CVectorWriter ss(SER_GETHASH, PROTOCOL_VERSION, shard_data[i], 0);
+        uint256 prevkey;
+        std::map<uint32_t, Coin> outputs;
+        for (; cursor.Valid(); cursor.Next()) {
+            COutPoint key;
+            Coin coin;
+            if (!cursor.GetKey(key) || !cursor.GetValue(coin)) {
+                return error("%s: unable to read value", __func__);
+            }
             if (!outputs.empty() && key.GetTxId() != prevkey) {
-                ApplyStats(stats, ss, prevkey, outputs);
+                ApplyStats(shard_stats[i], ss, prevkey, outputs);
                 outputs.clear();
             }
             prevkey = key.GetTxId();
             outputs[key.GetN()] = std::move(coin);
-        } else {
-            return error("%s: unable to read value", __func__);
         }
-        pcursor->Next();
-    }
-    if (!outputs.empty()) {
-        ApplyStats(stats, ss, prevkey, outputs);
+        if (!outputs.empty()) {
+            ApplyStats(shard_stats[i], ss, prevkey, outputs);
+        }
+        return true;
+    };
+
+    CHashWriter ss(SER_GETHASH, PROTOCOL_VERSION);
+    ss << stats.hashBlock;
+    auto merge_shard = [&](size_t i) {
+        boost::this_thread::interruption_point();
+        ss.write(reinterpret_cast<const char *>(shard_data[i].data()),
+                 shard_data[i].size());
+        stats.nTransactions += shard_stats[i].nTransactions;
+        stats.nTransactionOutputs += shard_stats[i].nTransactionOutputs;
+        stats.nBogoSize += shard_stats[i].nBogoSize;
+        stats.nTotalAmount += shard_stats[i].nTotalAmount;
+        std::vector<uint8_t>().swap(shard_data[i]);
+    };
+
+    if (!ScanCoinsParallel(cursors, scan_shard, merge_shard)) {
+        return false;
     }
     stats.hashSerialized = ss.GetHash();
     stats.nDiskSize = view->EstimateSize();
@@ -1154,39 +1335,77 @@ static UniValue pruneblockchain(const Config &config,
 
 static UniValue gettxoutsetinfo(const Config &config,
                                 const JSONRPCRequest &request) {
-    if (request.fHelp || request.params.size() != 0) {
+    if (request.fHelp || request.params.size() > 1) {
         throw std::runtime_error(
             RPCHelpMan{"gettxoutsetinfo",
                 "\nReturns statistics about the unspent transaction output set.\n"
-                "Note this call may take some time.\n",
-                {}}
+                "Note this call may take some time, unless hash_type is ecmh.\n",
+                {
+                    {"hash_type", RPCArg::Type::STR, /* opt */ true, /* default_val */ "hash_serialized", "Which UTXO set hash should be calculated. Options: 'hash_serialized' (scans the whole set), 'ecmh' (the commitment maintained with -utxocommitment)."},
+                }}
                 .ToString() +
             "\nResult:\n"
             "{\n"
             "  \"height\":n,     (numeric) The current block height (index)\n"
             "  \"bestblock\": \"hex\",   (string) the best block hash hex\n"
-            "  \"transactions\": n,      (numeric) The number of transactions\n"
+            "  \"transactions\": n,      (numeric) The number of "
+            "transactions, not returned with ecmh\n"
             "  \"txouts\": n,            (numeric) The number of output "
             "transactions\n"
             "  \"bogosize\": n,          (numeric) A database-independent "
             "metric for UTXO set size\n"
-            "  \"hash_serialized\": \"hash\",   (string) The serialized hash\n"
+            "  \"hash_serialized\": \"hash\",   (string) The serialized "
+            "hash, only returned with hash_serialized\n"
+            "  \"utxo_commitment\": \"hash\",   (string) The EC multiset "
+            "hash of the UTXO set, only returned with ecmh\n"
             "  \"disk_size\": n,         (numeric) The estimated size of the "
             "chainstate on disk\n"
             "  \"total_amount\": x.xxx          (numeric) The total amount\n"
             "}\n"
             "\nExamples:\n" +
             HelpExampleCli("gettxoutsetinfo", "") +
-            HelpExampleRpc("gettxoutsetinfo", ""));
+            HelpExampleCli("gettxoutsetinfo", "\"ecmh\"") +
+            HelpExampleRpc("gettxoutsetinfo", "") +
+            HelpExampleRpc("gettxoutsetinfo", "\"ecmh\""));
+    }
+
+    const std::string hash_type = request.params[0].isNull()
+                                      ? "hash_serialized"
+                                      : request.params[0].get_str();
+
+    UniValue::Object ret;
+    if (hash_type == "ecmh") {
+        LOCK(cs_main);
+        if (!pcoinscommitment) {
+            throw JSONRPCError(RPC_MISC_ERROR,
+                               "The UTXO set commitment is not enabled "
+                               "(start with -utxocommitment)");
+        }
+
+        const BlockHash hashBlock = pcoinsTip->GetBestBlock();
+        ret.reserve(7);
+        ret.emplace_back("height", LookupBlockIndex(hashBlock)->nHeight);
+        ret.emplace_back("bestblock", hashBlock.GetHex());
+        ret.emplace_back("txouts", pcoinscommitment->GetTransactionOutputs());
+        ret.emplace_back("bogosize", pcoinscommitment->GetBogoSize());
+        ret.emplace_back("utxo_commitment",
+                         pcoinscommitment->GetHash().GetHex());
+        ret.emplace_back("disk_size", pcoinsdbview->EstimateSize());
+        ret.emplace_back("total_amount",
+                         ValueFromAmount(pcoinscommitment->GetTotalAmount()));
+        return ret;
+    }
+
+    if (hash_type != "hash_serialized") {
+        throw JSONRPCError(RPC_INVALID_PARAMETER,
+                           strprintf("%s is not a valid hash_type", hash_type));
     }
 
     CCoinsStats stats;
-    FlushStateToDisk();
     if (!GetUTXOStats(pcoinsdbview.get(), stats)) {
         throw JSONRPCError(RPC_INTERNAL_ERROR, "Unable to read UTXO set");
     }
 
-    UniValue::Object ret;
     ret.reserve(8);
     ret.emplace_back("height", stats.nHeight);
     ret.emplace_back("bestblock", stats.hashBlock.GetHex());
@@ -1199,6 +1418,48 @@ static UniValue gettxoutsetinfo(const Config &config,
     return ret;
 }
 
+static UniValue getcoinscacheinfo(const Config &config,
+                                  const JSONRPCRequest &request) {
+    if (request.fHelp || request.params.size() != 0) {
+        throw std::runtime_error(
+            RPCHelpMan{"getcoinscacheinfo",
+                "\nReturns statistics about the in-memory cache of the unspent transaction output set.\n",
+                {}}
+                .ToString() +
+            "\nResult:\n"
+            "{\n"
+            "  \"entries\": n,           (numeric) The number of cached "
+            "coins\n"
+            "  \"usage\": n,             (numeric) The memory usage of the "
+            "cache\n"
+            "  \"hits\": n,              (numeric) The number of lookups "
+            "answered from the cache\n"
+            "  \"misses\": n,            (numeric) The number of lookups "
+            "which had to read the database\n"
+            "  \"prefetch_hits\": n,     (numeric) The number of coins asked "
+            "to be prefetched which were already cached\n"
+            "  \"prefetch_misses\": n    (numeric) The number of coins "
+            "prefetched from the database\n"
+            "}\n"
+            "\nExamples:\n" +
+            HelpExampleCli("getcoinscacheinfo", "") +
+            HelpExampleRpc("getcoinscacheinfo", ""));
+    }
+
+    LOCK(cs_main);
+    const CCoinsCacheStats &stats = pcoinsTip->GetStats();
+
+    UniValue::Object ret;
+    ret.reserve(6);
+    ret.emplace_back("entries", pcoinsTip->GetCacheSize());
+    ret.emplace_back("usage", pcoinsTip->DynamicMemoryUsage());
+    ret.emplace_back("hits", stats.nHits);
+    ret.emplace_back("misses", stats.nMisses);
+    ret.emplace_back("prefetch_hits", stats.nPrefetchHits);
+    ret.emplace_back("prefetch_misses", stats.nPrefetchMisses);
+    return ret;
+}
+
 UniValue gettxout(const Config &config, const JSONRPCRequest &request) {
     if (request.fHelp || request.params.size() < 2 ||
         request.params.size() > 3) {
@@ -2319,36 +2580,42 @@ static UniValue savemempool(const Config &config,
 }
 
 //! Search for a given set of pubkey scripts
-static bool FindScriptPubKey(std::atomic<int> &scan_progress,
-                             const std::atomic<bool> &should_abort,
-                             int64_t &count, CCoinsViewCursor *cursor,
-                             const std::set<CScript> &needles,
-                             std::map<COutPoint, Coin> &out_results) {
+static bool FindScriptPubKey(
+    std::atomic<int> &scan_progress, const std::atomic<bool> &should_abort,
+    int64_t &count, std::vector<std::unique_ptr<CCoinsViewCursor>> &cursors,
+    const std::set<CScript> &needles,
+    std::map<COutPoint, Coin> &out_results) {
     scan_progress = 0;
     count = 0;
-    while (cursor->Valid()) {
-        COutPoint key;
-        Coin coin;
-        if (!cursor->GetKey(key) || !cursor->GetValue(coin)) {
-            return false;
-        }
-        if (++count % 8192 == 0) {
-            boost::this_thread::interruption_point();
-            if (should_abort) {
+    std::vector<int64_t> shard_counts(cursors.size(), 0);
+    std::vector<std::map<COutPoint, Coin>> shard_results(cursors.size());
+    auto scan_shard = [&](size_t i, CCoinsViewCursor &cursor) {
+        for (; cursor.Valid(); cursor.Next()) {
+            COutPoint key;
+            Coin coin;
+            if (!cursor.GetKey(key) || !cursor.GetValue(coin)) {
+                return false;
+            }
+            if (++shard_counts[i] % 8192 == 0 && should_abort) {
                 // allow to abort the scan via the abort reference
                 return false;
             }
+            if (needles.count(coin.GetTxOut().scriptPubKey)) {
+                shard_results[i].emplace(key, coin);
+            }
         }
-        if (count % 256 == 0) {
-            // update progress reference every 256 item
-            const TxId &txid = key.GetTxId();
-            uint32_t high = 0x100 * *txid.begin() + *(txid.begin() + 1);
-            scan_progress = int(high * 100.0 / 65536.0 + 0.5);
-        }
-        if (needles.count(coin.GetTxOut().scriptPubKey)) {
-            out_results.emplace(key, coin);
-        }
-        cursor->Next();
+        return true;
+    };
+    auto merge_shard = [&](size_t i) {
+        boost::this_thread::interruption_point();
+        count += shard_counts[i];
+        out_results.insert(shard_results[i].begin(), shard_results[i].end());
+        shard_results[i].clear();
+        scan_progress = int((i + 1) * 100.0 / cursors.size() + 0.5);
+    };
+
+    if (!ScanCoinsParallel(cursors, scan_shard, merge_shard)) {
+        return false;
     }
     scan_progress = 100;
     return true;
@@ -2537,15 +2804,14 @@ static UniValue scantxoutset(const Config &config,
         g_should_abort_scan = false;
         g_scan_progress = 0;
         int64_t count = 0;
-        std::unique_ptr<CCoinsViewCursor> pcursor;
+        std::vector<std::unique_ptr<CCoinsViewCursor>> cursors;
         {
             LOCK(cs_main);
             FlushStateToDisk();
-            pcursor = std::unique_ptr<CCoinsViewCursor>(pcoinsdbview->Cursor());
-            assert(pcursor);
+            cursors = pcoinsdbview->Cursors(UTXO_SCAN_SHARDS);
         }
         bool res = FindScriptPubKey(g_scan_progress, g_should_abort_scan, count,
-                                    pcursor.get(), needles, coins);
+                                    cursors, needles, coins);
         UniValue::Object result;
         result.reserve(4);
         result.emplace_back("success", res);
@@ -2578,6 +2844,93 @@ static UniValue scantxoutset(const Config &config,
     throw JSONRPCError(RPC_INVALID_PARAMETER, "Invalid command");
 }
 
+static UniValue getblockfilter(const Config &config,
+                               const JSONRPCRequest &request) {
+    if (request.fHelp || request.params.size() < 1 ||
+        request.params.size() > 2) {
+        throw std::runtime_error(
+            RPCHelpMan{"getblockfilter",
+                "\nRetrieve a BIP 157 content filter for a particular block.\n",
+                {
+                    {"blockhash", RPCArg::Type::STR_HEX, /* opt */ false, /* default_val */ "", "The hash of the block"},
+                    {"filtertype", RPCArg::Type::STR, /* opt */ true, /* default_val */ "basic", "The type name of the filter"},
+                }}
+                .ToString() +
+            "\nResult:\n"
+            "{\n"
+            "  \"filter\" : (string) the hex-encoded filter data\n"
+            "  \"header\" : (string) the hex-encoded filter header\n"
+            "}\n"
+            "\nExamples:\n" +
+            HelpExampleCli("getblockfilter",
+                           "\"00000000c937983704a73af28acdec37b049d214adbda81d7"
+                           "e2a3dd146f6ed09\" \"basic\"") +
+            HelpExampleRpc("getblockfilter",
+                           "\"00000000c937983704a73af28acdec37b049d214adbda81d7"
+                           "e2a3dd146f6ed09\", \"basic\""));
+    }
+
+    const BlockHash block_hash(ParseHashV(request.params[0], "blockhash"));
+    std::string filtertype_name = "basic";
+    if (!request.params[1].isNull()) {
+        filtertype_name = request.params[1].get_str();
+    }
+
+    BlockFilterType filtertype;
+    if (!BlockFilterTypeByName(filtertype_name, filtertype)) {
+        throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Unknown filtertype");
+    }
+
+    BlockFilterIndex *index = GetBlockFilterIndex(filtertype);
+    if (!index) {
+        throw JSONRPCError(RPC_MISC_ERROR,
+                           "Index is not enabled for filtertype " +
+                               filtertype_name);
+    }
+
+    const CBlockIndex *block_index;
+    bool block_was_connected;
+    {
+        LOCK(cs_main);
+        block_index = LookupBlockIndex(block_hash);
+        if (!block_index) {
+            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Block not found");
+        }
+        block_was_connected = block_index->IsValid(BlockValidity::SCRIPTS);
+    }
+
+    bool index_ready = index->BlockUntilSyncedToCurrentChain();
+
+    BlockFilter filter;
+    uint256 filter_header;
+    if (!index->LookupFilter(block_index, filter) ||
+        !index->LookupFilterHeader(block_index, filter_header)) {
+        RPCErrorCode err_code;
+        std::string errmsg = "Filter not found.";
+
+        if (!block_was_connected) {
+            err_code = RPC_INVALID_ADDRESS_OR_KEY;
+            errmsg += " Block was not connected to active chain.";
+        } else if (!index_ready) {
+            err_code = RPC_MISC_ERROR;
+            errmsg += " Block filters are still in the process of being "
+                      "indexed.";
+        } else {
+            err_code = RPC_INTERNAL_ERROR;
+            errmsg += " This error is unexpected and indicates index "
+                      "corruption.";
+        }
+
+        throw JSONRPCError(err_code, errmsg);
+    }
+
+    UniValue::Object ret;
+    ret.reserve(2);
+    ret.emplace_back("filter", HexStr(filter.GetEncodedFilter()));
+    ret.emplace_back("header", filter_header.GetHex());
+    return ret;
+}
+
 // clang-format off
 static const ContextFreeRPCCommand commands[] = {
     //  category            name                      actor (function)        argNames
@@ -2588,10 +2941,12 @@ static const ContextFreeRPCCommand commands[] = {
     { "blockchain",         "getblockchaininfo",      getblockchaininfo,      {} },
     { "blockchain",         "getblockcount",          getblockcount,          {} },
     { "blockchain",         "getblockhash",           getblockhash,           {"height"} },
+    { "blockchain",         "getblockfilter",         getblockfilter,         {"blockhash","filtertype"} },
     { "blockchain",         "getblockheader",         getblockheader,         {"blockhash|hash_or_height","verbose"} },
     { "blockchain",         "getblockstats",          getblockstats,          {"hash_or_height","stats"} },
     { "blockchain",         "getchaintips",           getchaintips,           {} },
     { "blockchain",         "getchaintxstats",        getchaintxstats,        {"nblocks", "blockhash"} },
+    { "blockchain",         "getcoinscacheinfo",      getcoinscacheinfo,      {} },
     { "blockchain",         "getdifficulty",          getdifficulty,          {} },
     { "blockchain",         "getfinalizedblockhash",  getfinalizedblockhash,  {} },
     { "blockchain",         "getmempoolancestors",    getmempoolancestors,    {"txid","verbose"} },
@@ -2600,7 +2955,7 @@ static const ContextFreeRPCCommand commands[] = {
     { "blockchain",         "getmempoolinfo",         getmempoolinfo,         {} },
     { "blockchain",         "getrawmempool",          getrawmempool,          {"verbose"} },
     { "blockchain",         "gettxout",               gettxout,               {"txid","n","include_mempool"} },
-    { "blockchain",         "gettxoutsetinfo",        gettxoutsetinfo,        {} },
+    { "blockchain",         "gettxoutsetinfo",        gettxoutsetinfo,        {"hash_type"} },
     { "blockchain",         "invalidateblock",        invalidateblock,        {"blockhash"} },
     { "blockchain",         "parkblock",              parkblock,              {"blockhash"} },
     { "blockchain",         "preciousblock",          preciousblock,          {"blockhash"} },
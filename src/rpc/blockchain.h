@@ -15,6 +15,7 @@ class CBlockIndex;
 class Config;
 class CTxMemPool;
 class JSONRPCRequest;
+class JSONWriter;
 
 UniValue getblockchaininfo(const Config &config, const JSONRPCRequest &request);
 
@@ -34,6 +35,13 @@ void RPCNotifyBlockChange(bool ibd, const CBlockIndex *pindex);
 /** Block description to JSON */
 UniValue::Object blockToJSON(const Config &config, const CBlock &block, const CBlockIndex *tip, const CBlockIndex *blockindex, bool txDetails = false);
 
+/**
+ * Write the same JSON as blockToJSON, one transaction after the other, without
+ * building the UniValue objects.
+ */
+void WriteBlockJSON(JSONWriter &writer, const Config &config, const CBlock &block, const CBlockIndex *tip,
+                    const CBlockIndex *blockindex, bool txDetails = false);
+
 /** Mempool information to JSON */
 UniValue::Object MempoolInfoToJSON(const Config &config, const CTxMemPool &pool);
 
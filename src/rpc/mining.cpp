@@ -35,6 +35,7 @@
 
 #include <univalue.h>
 
+#include <atomic>
 #include <cmath>
 #include <cstdint>
 #include <cstring>
@@ -348,15 +349,17 @@ struct TrivialJobIdHasher {
         return ret;
     }
 };
-/// Lock for the below two data structures
+/// Lock for the below three data structures
 Mutex gJobIdMut;
-/// Cache of transactions for block templates returned from getblocktemplatelight, used by submitblocklight
-std::unordered_map<JobId, std::vector<CTransactionRef>, TrivialJobIdHasher> gJobIdTxCache GUARDED_BY(gJobIdMut);
+/// Cache of the txids of block templates returned from getblocktemplatelight, used by submitblocklight
+std::unordered_map<JobId, std::vector<TxId>, TrivialJobIdHasher> gJobIdTxCache GUARDED_BY(gJobIdMut);
 /// This list allows us to implement an LRU cache. We remove items when this grows too large.
 std::list<JobId> gJobIdList GUARDED_BY(gJobIdMut);
-
-/// Bytes used as header and footer for the getblocktemplatelight data files we write out.
-const std::string kDataFileMagic = "GBT";
+/// The transactions of the jobs in gJobIdTxCache, each kept once along with the number of times these jobs refer to
+/// it. Consecutive templates share most of their transactions, which are also shared with the mempool.
+std::unordered_map<TxId, std::pair<CTransactionRef, size_t>, SaltedTxidHasher> gJobTxs GUARDED_BY(gJobIdMut);
+/// Set when the background writer fails to save a job, reported by the next getblocktemplatelight call
+std::atomic_bool gJobDataWriteFailed{false};
 } // namespace
 } // namespace gbtl
 
@@ -619,6 +622,9 @@ static UniValue getblocktemplatecommon(bool fLight, const Config &config, const
     static CBlockIndex *pindexPrev;
     static int64_t nStart;
     static std::unique_ptr<CBlockTemplate> pblocktemplate;
+    // Selection of the transactions of pblocktemplate, which the next one
+    // resumes from when only transactions were added to the mempool since
+    static BlockTemplateCandidate candidate(g_mempool);
     static std::unique_ptr<LightResult> plightresult; // fLight mode only, cached result associated with pblocktemplate
     if (pindexPrev != ::ChainActive().Tip() ||
         (g_mempool.GetTransactionsUpdated() != nTransactionsUpdatedLast &&
@@ -634,8 +640,8 @@ static UniValue getblocktemplatecommon(bool fLight, const Config &config, const
 
         // Create new block
         CScript scriptDummy = CScript() << OP_TRUE;
-        pblocktemplate =
-            BlockAssembler(config, g_mempool).CreateNewBlock(scriptDummy);
+        pblocktemplate = BlockAssembler(config, g_mempool)
+                             .CreateNewBlock(scriptDummy, &candidate);
         plightresult.reset();
         if (!pblocktemplate) {
             throw JSONRPCError(RPC_OUT_OF_MEMORY, "Out of memory");
@@ -817,7 +823,6 @@ static UniValue getblocktemplatecommon(bool fLight, const Config &config, const
     result.emplace_back("height", pindexPrev->nHeight + 1);
 
     if (fLight) {
-        // Note: this must be called with cs_main held (which is the case here)
         gbtl::CacheAndSaveTxsToFile(jobId, pvtx);
     }
 
@@ -1089,13 +1094,31 @@ bool GetTxsFromCache(const JobId &jobId, CBlock &block) {
     const auto it = gJobIdTxCache.find(jobId);
     if (it != gJobIdTxCache.end()) {
         // found!  Add to block
-        const auto & vtx = it->second;
-        block.vtx.insert(block.vtx.end(), vtx.begin(), vtx.end());
+        const auto & txids = it->second;
+        block.vtx.reserve(block.vtx.size() + txids.size());
+        for (const auto &txid : txids)
+            block.vtx.push_back(gJobTxs.at(txid).first);
         return true;
     }
     return false;
 }
 
+namespace {
+/// Returns the tx from the in-memory job cache, or else from the mempool, or else from the tx data dir. Returns
+/// nullptr if it is in none of them.
+CTransactionRef FindJobTx(const TxId &txid) {
+    {
+        LOCK(gJobIdMut);
+        const auto it = gJobTxs.find(txid);
+        if (it != gJobTxs.end())
+            return it->second.first;
+    }
+    if (auto tx = g_mempool.get(txid))
+        return tx;
+    return ReadStoredTx(txid);
+}
+} // namespace
+
 void LoadTxsFromFile(const JobId &jobId, CBlock &block) {
     const char *const errNoData = "job_id data not available";
     const char *const errDataEmpty = "job_id data is empty";
@@ -1103,6 +1126,10 @@ void LoadTxsFromFile(const JobId &jobId, CBlock &block) {
 
     const auto jobIdStr = jobId.GetHex();
     fs::path filename = GetJobDataDir() / jobIdStr;
+    if (!fs::exists(filename)) {
+        // the file may not be written yet
+        SyncJobDataWrites();
+    }
     if (!fs::exists(filename)) {
         LogPrintf("WARNING: SubmitBlockLight cannot find file for job_id %s, searching trash dir\n", jobIdStr);
         filename = GetJobDataTrashDir() / jobIdStr;
@@ -1113,8 +1140,9 @@ void LoadTxsFromFile(const JobId &jobId, CBlock &block) {
     }
     LogPrint(BCLog::RPC, "SubmitBlockLight job_id %s found in %s\n", jobIdStr, filename.string());
     try {
-        const auto magicLen = kDataFileMagic.size(); // 3 for "GBT"
+        const auto magicLen = kJobFileMagic.size(); // 3 for "GBJ"
         std::vector<uint8_t> dataBuf;
+        bool legacy{};
         {
             fs::ifstream file(filename);
 
@@ -1132,28 +1160,43 @@ void LoadTxsFromFile(const JobId &jobId, CBlock &block) {
             dataBuf.resize(size_t(fileSize));
             char * const charDataBuf = reinterpret_cast<char *>(dataBuf.data());
             file.read(charDataBuf, fileSize);
+            // files written by older versions hold the txs themselves, between "GBT" magic bytes
+            legacy = !file.fail() && 0 == std::memcmp(charDataBuf, kLegacyJobFileMagic.data(), magicLen);
+            const std::string &magic = legacy ? kLegacyJobFileMagic : kJobFileMagic;
             // check read was good and that header and footer match
             if (file.fail()
-                    // header must match "GBT"
-                    || 0 != std::memcmp(charDataBuf, kDataFileMagic.data(), magicLen)
-                    // footer must match "GBT"
-                    || 0 != std::memcmp(charDataBuf + fileSize - magicLen, kDataFileMagic.data(), magicLen)) {
+                    // header must match "GBJ" or "GBT"
+                    || 0 != std::memcmp(charDataBuf, magic.data(), magicLen)
+                    // footer must match the header
+                    || 0 != std::memcmp(charDataBuf + fileSize - magicLen, magic.data(), magicLen)) {
                 LogPrintf("WARNING: SubmitBlockLight job_id %s appears to be corrupt\n", jobIdStr);
                 throw JSONRPCError(RPC_DESERIALIZATION_ERROR, errDataBad);
             }
             // everything's ok, proceed
         }
-        // deserialize the vector directly, starting at pos 3 (after "GBT" header)
+        // deserialize the vector directly, starting at pos 3 (after the header)
         VectorReader vr(SER_NETWORK, PROTOCOL_VERSION, dataBuf, magicLen /* start pos */);
         uint32_t txCount = 0;
         vr >> txCount;
         for (uint32_t i = 0; i < txCount; ++i) {
-            CMutableTransaction mutableTx;
-            vr >> mutableTx;
-            block.vtx.push_back(MakeTransactionRef(std::move(mutableTx)));
+            if (legacy) {
+                CMutableTransaction mutableTx;
+                vr >> mutableTx;
+                block.vtx.push_back(MakeTransactionRef(std::move(mutableTx)));
+                continue;
+            }
+            TxId txid;
+            vr >> txid;
+            CTransactionRef tx = FindJobTx(txid);
+            if (!tx) {
+                LogPrintf("WARNING: SubmitBlockLight job_id %s refers to tx %s which is not available\n", jobIdStr,
+                          txid.GetHex());
+                throw JSONRPCError(RPC_INVALID_PARAMETER, errNoData);
+            }
+            block.vtx.push_back(std::move(tx));
         }
     } catch (const std::exception & e) {
-        // Note: JSONRPCError() above throws a UniValue so it will not be caught here (but it will
+        // Note: JSONRPCError is not a std::exception, so it will not be caught here (but it will
         // propagate out anyway to the client). This clause is for low-level std::ios_base::failure
         // and potentially even std::bad_alloc.
         LogPrintf("WARNING: SubmitBlockLight job_id %s failed to deserialize: %s\n", jobIdStr, e.what());
@@ -1162,88 +1205,57 @@ void LoadTxsFromFile(const JobId &jobId, CBlock &block) {
 }
 
 void CacheAndSaveTxsToFile(const JobId &jobId, const std::vector<CTransactionRef> *pvtx) {
+    if (gJobDataWriteFailed.exchange(false)) {
+        // Clients should be alerted that there is a misconfiguration with bitcoind (even though we could
+        // theoretically continue and rely on in-memory cache, we are better off doing this).
+        throw JSONRPCError(RPC_INTERNAL_ERROR, "failed to save job tx data to disk");
+    }
     std::vector<CTransactionRef> storeTxs;
-    bool didSetupStoreTxs = false;
-    const auto setupStoreTxs = [&storeTxs, &didSetupStoreTxs, pvtx] {
-        if (didSetupStoreTxs)
-            return;
-        if (!pvtx->empty()) {
-            // we store all but the first tx (all but coinbase)
-            auto start = pvtx->front()->IsCoinBase() ? std::next(pvtx->begin()) : pvtx->begin();
-            storeTxs.insert(storeTxs.end(), start, pvtx->end());
-        }
-        didSetupStoreTxs = true;
-    };
-    // first, write to file if file does not already exist
-    {
-        const auto jobIdStr = jobId.GetHex();
-        fs::path outputFile = GetJobDataDir() / jobIdStr;
-        // There is no race condition here because this function is called from getblocktemplatecommon,
-        // with the cs_main lock held.
-        AssertLockHeld(cs_main);
-        if (!fs::exists(outputFile)) {
-            setupStoreTxs();
-            CDataStream datastream(SER_NETWORK, PROTOCOL_VERSION);
-            const uint32_t nTx = uint32_t(storeTxs.size());
-            datastream.reserve(256 * nTx + sizeof(nTx)); // assume avg 256 byte tx size. This doesn't have to be exact, this is just to avoid redundant allocations as we serialize.
-            datastream << nTx; // first write the size
-            for (const auto &txRef : storeTxs)
-                datastream << *txRef;
-
-            const auto t0 = GetTimeMicros(); // for perf. logging iff BCLog::RPC is enabled
-            auto tmpOut = outputFile;
-            tmpOut += gbtl::tmpExt; // += ".tmp"
-            bool ok{};
-            {
-                fs::ofstream ofile(tmpOut, std::ios_base::binary|std::ios_base::out|std::ios_base::trunc);
-                if ((ok = ofile.is_open())) {
-                    // "GBT" magic bytes at front
-                    using std::streamsize;
-                    ofile.write(kDataFileMagic.data(), streamsize(kDataFileMagic.size()));
-                    if (ofile)
-                        ofile.write(datastream.data(), streamsize(datastream.size()));
-                    if (ofile)
-                        // "GBT" magic bytes at end
-                        ofile.write(kDataFileMagic.data(), streamsize(kDataFileMagic.size()));
-                    ok = bool(ofile);
-                }
-            } // file is closed
-            if (ok) {
-                // now, atomically move it in place.
-                fs::rename(tmpOut, outputFile); // may throw (unlikely) iff another prog. created outputFile just now
-                LogPrint(BCLog::RPC, "getblocktemplatelight: %d txs written to %s in %f secs\n", storeTxs.size(),
-                         outputFile.string(), (GetTimeMicros() - t0) / 1e6);
-            } else {
-                LogPrintf("getblocktemplatelight: cannot write tx data to %s\n", tmpOut.string());
-                try { fs::remove(tmpOut); } catch (...) {}
-                // We must throw here. Clients should be alerted that there is a misconfiguration with bitcoind (even
-                // though we could theoretically continue and rely on in-memory cache, we are better off doing this).
-                throw JSONRPCError(RPC_INTERNAL_ERROR, "failed to save job tx data to disk");
-            }
-        }
+    if (!pvtx->empty()) {
+        // we store all but the first tx (all but coinbase)
+        auto start = pvtx->front()->IsCoinBase() ? std::next(pvtx->begin()) : pvtx->begin();
+        storeTxs.assign(start, pvtx->end());
     }
-    // lastly, store cache if not already in cache
+    // first, store cache if not already in cache
     {
-        // we must hold this lock here since this data is shared with submitblocklight which doesn't hold cs_main
+        // we must hold this lock here since this data is shared with submitblocklight
         LOCK(gJobIdMut);
         if (gJobIdTxCache.find(jobId) == gJobIdTxCache.end()) {
-            setupStoreTxs();
             // put in cache, but first check size to limit cache size
             if (gJobIdTxCache.size() >= GetJobCacheSize() && !gJobIdList.empty()) {
-                // remove the oldest jobId
+                // remove the oldest jobId, and the txs no other cached job refers to
                 const auto & oldJobId = gJobIdList.front();
                 LogPrint(BCLog::RPC, "getblocktemplatelight: in-memory cache full, old job_id %s removed\n",
                          oldJobId.GetHex());
+                for (const auto &txid : gJobIdTxCache.at(oldJobId)) {
+                    const auto it = gJobTxs.find(txid);
+                    if (--it->second.second == 0)
+                        gJobTxs.erase(it);
+                }
                 gJobIdTxCache.erase(oldJobId);
                 gJobIdList.pop_front();
             }
-            // we insert using emplace and forward_as_tuple for minimal overhead
-            gJobIdTxCache.emplace(std::piecewise_construct,
-                                  std::forward_as_tuple(jobId), std::forward_as_tuple(std::move(storeTxs)));
-            // NB: at this point storeTxs is empty (moved)
+            std::vector<TxId> txids;
+            txids.reserve(storeTxs.size());
+            for (const auto &tx : storeTxs) {
+                txids.push_back(tx->GetId());
+                auto &entry = gJobTxs[tx->GetId()];
+                if (!entry.first)
+                    entry.first = tx;
+                ++entry.second;
+            }
+            gJobIdTxCache.emplace(jobId, std::move(txids));
             gJobIdList.push_back(jobId);
         }
     }
+    // lastly, have the background writer write the job data file, if it does not already exist, and store the txs
+    // it does not have yet. This happens off cs_main; a failure is reported by the next call.
+    QueueJobDataWrite([jobId, txs = std::move(storeTxs)] {
+        if (!WriteJobData(jobId, txs)) {
+            LogPrintf("getblocktemplatelight: cannot write tx data for job_id %s\n", jobId.GetHex());
+            gJobDataWriteFailed = true;
+        }
+    });
 }
 
 } // namespace gbtl
@@ -32,16 +32,17 @@ std::vector<uint256> MakeMerkleBranch(std::vector<uint256> vtxHashes);
  *                 On false return, `block` is not modified.
  *                 The merkle root for `block` is never modified by this function in either case.   */
 bool GetTxsFromCache(const JobId &jobId, CBlock &block);
-/** Used by submitblocklight.  Throws JSONRPCError on error, otherwise puts the tx data read from the jobId file into
- *  the specified block.
+/** Used by submitblocklight.  Throws JSONRPCError on error, otherwise puts the txs listed by the jobId file into
+ *  the specified block.  The txs are taken from the in-memory cache or the mempool when they are still there, and
+ *  read from GetTxDataDir() otherwise.  Waits for the pending job data writes if the jobId file is not there yet.
  *  Precondition: `block` should contain a single coinbase tx.
  *  Postcondition: If no exception is thrown, `block` contains its coinbase tx + the txs associated with jobId in
  *                 consensus order.  The merkle root for `block` is not modified by this function.   */
 void LoadTxsFromFile(const JobId &jobId, CBlock &block);
-/** Saves the tx's from pvtx (stripping the coinbase, if any) for jobId to the gJobIdTxCache and also to a disk file
- *  in GetJobDataDir().  submitblocklight will use these cached tx's later to reconstruct the transactions for a block.
- *  IMPORTANT: This function must be called with the cs_main lock held.  Test code should take cs_main before
- *             calling this function.   */
+/** Saves the tx's from pvtx (stripping the coinbase, if any) for jobId to the gJobIdTxCache and queues the write of
+ *  the jobId file listing their txids in GetJobDataDir(), along with the txs not yet in GetTxDataDir().
+ *  submitblocklight will use these cached tx's later to reconstruct the transactions for a block.
+ *  The files are written by the background writer thread; call SyncJobDataWrites() to wait for them.   */
 void CacheAndSaveTxsToFile(const JobId &jobId, const std::vector<CTransactionRef> *pvtx);
 }
 #endif // BITCOIN_RPC_MINING_H
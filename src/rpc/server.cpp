@@ -24,9 +24,13 @@
 #include <boost/algorithm/string/split.hpp>
 #include <boost/signals2/signal.hpp>
 
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
 #include <memory> // for unique_ptr
 #include <set>
 #include <unordered_map>
+#include <vector>
 
 static RecursiveMutex cs_rpcWarmup;
 static std::atomic<bool> g_rpc_running{false};
@@ -495,14 +499,72 @@ static UniValue::Object JSONRPCExecOne(Config &config, RPCServer &rpcServer, JSO
     }
 }
 
-std::string JSONRPCExecBatch(Config &config, RPCServer &rpcServer, const JSONRPCRequest &jreq, UniValue::Array &&vReq) {
-    UniValue::Array ret;
-    ret.reserve(vReq.size());
-    for (UniValue& req: vReq) {
-        ret.emplace_back(JSONRPCExecOne(config, rpcServer, jreq, std::move(req)));
+namespace {
+/**
+ * The requests of a batch, executed by whichever thread claims them first.
+ * Shared with the helper threads, so that a helper starting after every
+ * request was claimed finds nothing left to do.
+ */
+class RPCBatch {
+public:
+    RPCBatch(Config &configIn, RPCServer &rpcServerIn, const JSONRPCRequest &jreqIn, UniValue::Array &&vReqIn)
+        : config(configIn), rpcServer(rpcServerIn), jreq(jreqIn), vReq(std::move(vReqIn)), vReply(vReq.size()) {}
+
+    //! Execute requests until none is left to claim
+    void Run() {
+        for (size_t i = nNext++; i < vReq.size(); i = nNext++) {
+            vReply[i] = JSONRPCExecOne(config, rpcServer, jreq, std::move(*(vReq.begin() + i)));
+            LOCK(cs);
+            if (++nDone == vReq.size()) {
+                cond.notify_all();
+            }
+        }
+    }
+
+    //! Wait until every request has been executed and return the replies
+    UniValue::Array Wait() {
+        {
+            WAIT_LOCK(cs, lock);
+            cond.wait(lock, [this]() EXCLUSIVE_LOCKS_REQUIRED(cs) { return nDone == vReq.size(); });
+        }
+        UniValue::Array ret;
+        ret.reserve(vReply.size());
+        for (UniValue::Object &reply : vReply) {
+            ret.emplace_back(std::move(reply));
+        }
+        return ret;
+    }
+
+private:
+    Config &config;
+    RPCServer &rpcServer;
+    const JSONRPCRequest jreq;
+    UniValue::Array vReq;
+    std::vector<UniValue::Object> vReply;
+    std::atomic<size_t> nNext{0};
+
+    Mutex cs;
+    std::condition_variable cond;
+    size_t nDone GUARDED_BY(cs) = 0;
+};
+} // namespace
+
+std::string JSONRPCExecBatch(Config &config, RPCServer &rpcServer, const JSONRPCRequest &jreq, UniValue::Array &&vReq,
+                             const RPCBatchDispatcher &dispatch, int nConcurrency) {
+    // The calling thread executes requests too, helpers only share the rest
+    size_t nHelpers = 0;
+    if (dispatch && vReq.size() > 1) {
+        nHelpers = std::min<size_t>(std::max(nConcurrency, 1) - 1, vReq.size() - 1);
+    }
+    auto batch = std::make_shared<RPCBatch>(config, rpcServer, jreq, std::move(vReq));
+    for (size_t i = 0; i < nHelpers; i++) {
+        if (!dispatch([batch]() { batch->Run(); })) {
+            break;
+        }
     }
+    batch->Run();
 
-    return UniValue::stringify(ret) + '\n';
+    return UniValue::stringify(batch->Wait()) + '\n';
 }
 
 /**
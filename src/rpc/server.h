@@ -25,6 +25,8 @@
 #include <univalue.h>
 
 static const unsigned int DEFAULT_RPC_SERIALIZE_VERSION = 1;
+//! Default for -rpcbatchconcurrency
+static const int DEFAULT_RPC_BATCH_CONCURRENCY = 4;
 
 class ContextFreeRPCCommand;
 
@@ -287,7 +289,20 @@ extern std::string HelpExampleRpc(const std::string &methodname,
 void StartRPC();
 void InterruptRPC();
 void StopRPC();
-std::string JSONRPCExecBatch(Config& config, RPCServer& rpcServer, const JSONRPCRequest& req, UniValue::Array&& vReq);
+
+/**
+ * Hands a task over to another thread to run it right away. Returns false,
+ * without running the task, if no thread is available.
+ */
+typedef std::function<bool(std::function<void()>)> RPCBatchDispatcher;
+
+/**
+ * Execute a batch of requests and return the replies, in the order of the
+ * requests. Up to nConcurrency requests run at the same time: on the calling
+ * thread and on the helper threads dispatch hands the work over to.
+ */
+std::string JSONRPCExecBatch(Config& config, RPCServer& rpcServer, const JSONRPCRequest& req, UniValue::Array&& vReq,
+                             const RPCBatchDispatcher& dispatch = nullptr, int nConcurrency = 1);
 
 /**
  * Retrieves any serialization flags requested in command line argument
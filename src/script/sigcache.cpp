@@ -111,6 +111,10 @@ bool CachingTransactionSignatureChecker::VerifySignature(
     const std::vector<uint8_t> &vchSig, const CPubKey &pubkey,
     const uint256 &sighash) const {
     return RunMemoizedCheck(vchSig, pubkey, sighash, store, [&] {
+        if (batch && vchSig.size() == 64) {
+            batch->Add(pubkey, sighash, vchSig);
+            return true;
+        }
         return TransactionSignatureChecker::VerifySignature(vchSig, pubkey,
                                                             sighash);
     });
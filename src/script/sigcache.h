@@ -18,6 +18,7 @@ static constexpr int64_t DEFAULT_MAX_SIG_CACHE_SIZE = 32;
 static constexpr int64_t MAX_MAX_SIG_CACHE_SIZE = 16384;
 
 class CPubKey;
+class SchnorrBatchVerifier;
 
 /**
  * We're hashing a nonce into the entries themselves, so we don't need extra
@@ -39,9 +40,19 @@ public:
     }
 };
 
+/**
+ * Signature checker which skips the signatures found in the signature cache.
+ *
+ * With a batch, Schnorr signatures which are not cached are only added to it
+ * and reported as valid, to be verified later along with the rest of the
+ * batch. That is only correct when an invalid signature fails the script, as
+ * enforced by SCRIPT_VERIFY_NULLFAIL, and the batch is never used to fill the
+ * cache.
+ */
 class CachingTransactionSignatureChecker : public TransactionSignatureChecker {
 private:
     bool store;
+    SchnorrBatchVerifier *batch;
 
     bool IsCached(const std::vector<uint8_t> &vchSig, const CPubKey &vchPubKey,
                   const uint256 &sighash) const;
@@ -50,9 +61,10 @@ public:
     CachingTransactionSignatureChecker(const CTransaction *txToIn,
                                        unsigned int nInIn,
                                        const Amount amountIn, bool storeIn,
-                                       PrecomputedTransactionData &txdataIn)
+                                       PrecomputedTransactionData &txdataIn,
+                                       SchnorrBatchVerifier *batchIn = nullptr)
         : TransactionSignatureChecker(txToIn, nInIn, amountIn, txdataIn),
-          store(storeIn) {}
+          store(storeIn), batch(storeIn ? nullptr : batchIn) {}
 
     bool VerifySignature(const std::vector<uint8_t> &vchSig,
                          const CPubKey &vchPubKey,
@@ -27,6 +27,136 @@ int secp256k1_schnorr_verify(
     return secp256k1_schnorr_sig_verify(&ctx->ecmult_ctx, sig64, &q, msg32);
 }
 
+typedef struct {
+    const secp256k1_context *ctx;
+    const unsigned char *const *sig64;
+    const unsigned char *const *msg32;
+    const secp256k1_pubkey *const *pubkeys;
+    secp256k1_sha256 seeded;
+} secp256k1_schnorr_verify_batch_data;
+
+/* Computes the random coefficient of the i-th signature, 1 for the first. */
+static void secp256k1_schnorr_verify_batch_coefficient(
+    secp256k1_scalar *a,
+    const secp256k1_sha256 *seeded,
+    size_t i
+) {
+    secp256k1_sha256 sha;
+    unsigned char buf[32];
+    int j;
+
+    if (i == 0) {
+        secp256k1_scalar_set_int(a, 1);
+        return;
+    }
+
+    for (j = 0; j < 8; j++) {
+        buf[j] = (i >> (8 * j)) & 0xFF;
+    }
+    sha = *seeded;
+    secp256k1_sha256_write(&sha, buf, 8);
+    secp256k1_sha256_finalize(&sha, buf);
+    secp256k1_scalar_set_b32(a, buf, NULL);
+}
+
+/* Provides the points R_i with coefficient a_i, and P_i with a_i * e_i. */
+static int secp256k1_schnorr_verify_batch_ecmult_callback(
+    secp256k1_scalar *sc,
+    secp256k1_ge *pt,
+    size_t idx,
+    void *data
+) {
+    const secp256k1_schnorr_verify_batch_data *batch = data;
+    const size_t i = idx / 2;
+    secp256k1_fe rx;
+
+    secp256k1_schnorr_verify_batch_coefficient(sc, &batch->seeded, i);
+    if (idx % 2 == 0) {
+        /* Already checked to be below the field size */
+        secp256k1_fe_set_b32(&rx, batch->sig64[i]);
+        return secp256k1_ge_set_xquad(pt, &rx);
+    } else {
+        secp256k1_scalar e;
+        secp256k1_pubkey_load(batch->ctx, pt, batch->pubkeys[i]);
+        secp256k1_schnorr_compute_e(&e, batch->sig64[i], pt, batch->msg32[i]);
+        secp256k1_scalar_mul(sc, sc, &e);
+        return 1;
+    }
+}
+
+/**
+ * Signature i is valid if R_i + e_i * P_i - s_i * G == 0. With random
+ * coefficients a_i, all of them are valid if
+ * sum(a_i * R_i) + sum(a_i * e_i * P_i) - sum(a_i * s_i) * G == 0,
+ * which is computed with a single multi-multiplication. The coefficients are
+ * derived from a hash of the whole batch, so they cannot be chosen to cancel
+ * out the error of some invalid signature.
+ */
+int secp256k1_schnorr_verify_batch(
+    const secp256k1_context* ctx,
+    secp256k1_scratch_space *scratch,
+    const unsigned char *const *sig64,
+    const unsigned char *const *msg32,
+    const secp256k1_pubkey *const *pubkeys,
+    size_t n
+) {
+    secp256k1_schnorr_verify_batch_data data;
+    secp256k1_scalar s, a, sum;
+    secp256k1_fe rx;
+    secp256k1_gej r;
+    secp256k1_sha256 sha;
+    unsigned char seed[32];
+    int overflow;
+    size_t i;
+
+    VERIFY_CHECK(ctx != NULL);
+    ARG_CHECK(secp256k1_ecmult_context_is_built(&ctx->ecmult_ctx));
+    ARG_CHECK(n == 0 || sig64 != NULL);
+    ARG_CHECK(n == 0 || msg32 != NULL);
+    ARG_CHECK(n == 0 || pubkeys != NULL);
+
+    /* Seed the coefficients with everything that is verified */
+    secp256k1_sha256_initialize(&sha);
+    for (i = 0; i < n; i++) {
+        secp256k1_sha256_write(&sha, sig64[i], 64);
+        secp256k1_sha256_write(&sha, msg32[i], 32);
+        secp256k1_sha256_write(&sha, pubkeys[i]->data, sizeof(pubkeys[i]->data));
+    }
+    secp256k1_sha256_finalize(&sha, seed);
+
+    data.ctx = ctx;
+    data.sig64 = sig64;
+    data.msg32 = msg32;
+    data.pubkeys = pubkeys;
+    secp256k1_sha256_initialize(&data.seeded);
+    secp256k1_sha256_write(&data.seeded, seed, 32);
+
+    secp256k1_scalar_set_int(&sum, 0);
+    for (i = 0; i < n; i++) {
+        /* Extract s */
+        overflow = 0;
+        secp256k1_scalar_set_b32(&s, sig64[i] + 32, &overflow);
+        if (overflow) {
+            return 0;
+        }
+
+        /* Check R.x */
+        if (!secp256k1_fe_set_b32(&rx, sig64[i])) {
+            return 0;
+        }
+
+        secp256k1_schnorr_verify_batch_coefficient(&a, &data.seeded, i);
+        secp256k1_scalar_mul(&s, &s, &a);
+        secp256k1_scalar_add(&sum, &sum, &s);
+    }
+    secp256k1_scalar_negate(&sum, &sum);
+
+    if (!secp256k1_ecmult_multi_var(&ctx->error_callback, &ctx->ecmult_ctx, scratch, &r, &sum, secp256k1_schnorr_verify_batch_ecmult_callback, &data, 2 * n)) {
+        return 0;
+    }
+    return secp256k1_gej_is_infinity(&r);
+}
+
 int secp256k1_schnorr_sign(
     const secp256k1_context *ctx,
     unsigned char *sig64,
@@ -509,6 +509,64 @@ void run_schnorr_compact_test(void) {
     }
 }
 
+#define BATCH_SIG_COUNT 64
+
+void test_schnorr_verify_batch(void) {
+    unsigned char privkey[32];
+    unsigned char msg[BATCH_SIG_COUNT][32];
+    unsigned char sig[BATCH_SIG_COUNT][64];
+    secp256k1_pubkey pubkey[BATCH_SIG_COUNT];
+    const unsigned char *sig_ptr[BATCH_SIG_COUNT];
+    const unsigned char *msg_ptr[BATCH_SIG_COUNT];
+    const secp256k1_pubkey *pubkey_ptr[BATCH_SIG_COUNT];
+    secp256k1_scratch_space *scratch;
+    secp256k1_scalar key;
+    size_t i, n;
+
+    for (i = 0; i < BATCH_SIG_COUNT; i++) {
+        random_scalar_order_test(&key);
+        secp256k1_scalar_get_b32(privkey, &key);
+        secp256k1_rand256_test(msg[i]);
+        CHECK(secp256k1_ec_pubkey_create(ctx, &pubkey[i], privkey) == 1);
+        CHECK(secp256k1_schnorr_sign(ctx, sig[i], msg[i], privkey, NULL, NULL) == 1);
+        sig_ptr[i] = sig[i];
+        msg_ptr[i] = msg[i];
+        pubkey_ptr[i] = &pubkey[i];
+    }
+
+    /* Both with the simple algorithm and with a scratch space. */
+    scratch = secp256k1_scratch_space_create(ctx, 1024 * 1024);
+    for (n = 0; n <= BATCH_SIG_COUNT; n += 1 + n / 4) {
+        CHECK(secp256k1_schnorr_verify_batch(ctx, NULL, sig_ptr, msg_ptr, pubkey_ptr, n) == 1);
+        CHECK(secp256k1_schnorr_verify_batch(ctx, scratch, sig_ptr, msg_ptr, pubkey_ptr, n) == 1);
+    }
+    CHECK(secp256k1_schnorr_verify_batch(ctx, scratch, NULL, NULL, NULL, 0) == 1);
+
+    /* A single incorrect signature fails the whole batch. */
+    i = secp256k1_rand_int(BATCH_SIG_COUNT);
+    sig[i][secp256k1_rand_bits(6)] += 1 + secp256k1_rand_int(255);
+    CHECK(secp256k1_schnorr_verify(ctx, sig[i], msg[i], &pubkey[i]) == 0);
+    CHECK(secp256k1_schnorr_verify_batch(ctx, NULL, sig_ptr, msg_ptr, pubkey_ptr, BATCH_SIG_COUNT) == 0);
+    CHECK(secp256k1_schnorr_verify_batch(ctx, scratch, sig_ptr, msg_ptr, pubkey_ptr, BATCH_SIG_COUNT) == 0);
+    CHECK(secp256k1_schnorr_verify_batch(ctx, scratch, sig_ptr, msg_ptr, pubkey_ptr, i) == 1);
+
+    /* As does a signature for another message or key. */
+    CHECK(secp256k1_schnorr_sign(ctx, sig[i], msg[i], privkey, NULL, NULL) == 1);
+    CHECK(secp256k1_schnorr_verify_batch(ctx, scratch, sig_ptr, msg_ptr, pubkey_ptr, BATCH_SIG_COUNT) == (i == BATCH_SIG_COUNT - 1));
+    msg_ptr[i] = msg[(i + 1) % BATCH_SIG_COUNT];
+    CHECK(secp256k1_schnorr_verify_batch(ctx, scratch, sig_ptr, msg_ptr, pubkey_ptr, BATCH_SIG_COUNT) == 0);
+
+    /* Swapping two signatures does not cancel out. */
+    CHECK(secp256k1_schnorr_sign(ctx, sig[i], msg[i], privkey, NULL, NULL) == 1);
+    msg_ptr[i] = msg[i];
+    pubkey_ptr[i] = &pubkey[BATCH_SIG_COUNT - 1];
+    sig_ptr[0] = sig[1];
+    sig_ptr[1] = sig[0];
+    CHECK(secp256k1_schnorr_verify_batch(ctx, scratch, sig_ptr, msg_ptr, pubkey_ptr, 2) == 0);
+
+    secp256k1_scratch_space_destroy(ctx, scratch);
+}
+
 void run_schnorr_tests(void) {
     int i;
     for (i = 0; i < 32 * count; i++) {
@@ -517,6 +575,9 @@ void run_schnorr_tests(void) {
 
     test_schnorr_sign_verify();
     run_schnorr_compact_test();
+    for (i = 0; i < count; i++) {
+        test_schnorr_verify_batch();
+    }
 }
 
 #endif
@@ -427,6 +427,17 @@ BOOST_AUTO_TEST_CASE(divide) {
     BOOST_CHECK(R2L / MaxL == ZeroL);
     BOOST_CHECK(MaxL / R2L == 1);
     BOOST_CHECK_THROW(R2L / ZeroL, uint_error);
+
+    // Divisors of a single limb take a shortcut
+    for (const uint32_t d : {2U, 3U, 1000U, 100000U, 0x80000001U, 0xffffffffU}) {
+        for (const arith_uint256 &n : {R1L, R2L, MaxL, HalfL, OneL}) {
+            const arith_uint256 q = n / d;
+            BOOST_CHECK(q * d <= n);
+            BOOST_CHECK(n - q * d < d);
+        }
+    }
+    BOOST_CHECK_EQUAL((MaxL / 0xffffffff).ToString(),
+                      "0000000100000001000000010000000100000001000000010000000100000001");
 }
 
 static bool almostEqual(double d1, double d2) {
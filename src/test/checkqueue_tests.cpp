@@ -20,6 +20,41 @@
 #include <random.h>
 #include <unordered_set>
 
+/**
+ * Check which only reports its failure when the batch it ran in finishes, and
+ * records whether it ran within a batch.
+ */
+struct DeferredCheck {
+    static thread_local bool fBatchActive;
+    static thread_local bool fBatchFails;
+    static std::atomic<size_t> nOutsideBatch;
+    bool fails;
+    DeferredCheck(bool _fails) : fails(_fails){};
+    DeferredCheck() : fails(false){};
+    bool operator()() {
+        if (!fBatchActive) {
+            nOutsideBatch++;
+        }
+        fBatchFails |= fails;
+        return true;
+    }
+    void swap(DeferredCheck &x) { std::swap(fails, x.fails); };
+};
+
+template <> class CCheckQueueBatch<DeferredCheck> {
+public:
+    CCheckQueueBatch() {
+        DeferredCheck::fBatchActive = true;
+        DeferredCheck::fBatchFails = false;
+    }
+    ~CCheckQueueBatch() { DeferredCheck::fBatchActive = false; }
+    bool Finish(bool fOk) { return fOk && !DeferredCheck::fBatchFails; }
+};
+
+thread_local bool DeferredCheck::fBatchActive{false};
+thread_local bool DeferredCheck::fBatchFails{false};
+std::atomic<size_t> DeferredCheck::nOutsideBatch{0};
+
 // BasicTestingSetup not sufficient because nScriptCheckThreads is not set
 // otherwise.
 BOOST_FIXTURE_TEST_SUITE(checkqueue_tests, TestingSetup)
@@ -122,12 +157,25 @@ typedef CCheckQueue<FailingCheck> Failing_Queue;
 typedef CCheckQueue<UniqueCheck> Unique_Queue;
 typedef CCheckQueue<MemoryCheck> Memory_Queue;
 typedef CCheckQueue<FrozenCleanupCheck> FrozenCleanup_Queue;
+typedef CCheckQueue<DeferredCheck> Deferred_Queue;
+
+/** Create a queue for nScriptCheckThreads workers, optionally work stealing.
+ */
+template <typename Queue>
+static std::unique_ptr<Queue> MakeQueue(bool fWorkStealing) {
+    auto queue = std::make_unique<Queue>(QUEUE_BATCH_SIZE);
+    if (fWorkStealing) {
+        queue->EnableWorkStealing(nScriptCheckThreads);
+    }
+    return queue;
+}
 
 /** This test case checks that the CCheckQueue works properly
  * with each specified size_t Checks pushed.
  */
-static void Correct_Queue_range(std::vector<size_t> range) {
-    auto small_queue = std::make_unique<Correct_Queue>(QUEUE_BATCH_SIZE);
+static void Correct_Queue_range(std::vector<size_t> range,
+                                bool fWorkStealing = false) {
+    auto small_queue = MakeQueue<Correct_Queue>(fWorkStealing);
     boost::thread_group tg;
     for (auto x = 0; x < nScriptCheckThreads; ++x) {
         tg.create_thread([&] { small_queue->Thread(); });
@@ -175,7 +223,7 @@ BOOST_AUTO_TEST_CASE(test_CheckQueue_Correct_Max) {
 }
 /** Test that random numbers of checks are correct
  */
-BOOST_AUTO_TEST_CASE(test_CheckQueue_Correct_Random) {
+static std::vector<size_t> RandomRange() {
     std::vector<size_t> range;
     range.reserve(100000 / 1000);
     for (size_t i = 2; i < 100000;
@@ -183,12 +231,21 @@ BOOST_AUTO_TEST_CASE(test_CheckQueue_Correct_Random) {
                                       (size_t)1000, ((size_t)100000) - i)))) {
         range.push_back(i);
     }
-    Correct_Queue_range(range);
+    return range;
+}
+BOOST_AUTO_TEST_CASE(test_CheckQueue_Correct_Random) {
+    Correct_Queue_range(RandomRange());
+}
+/** Same, with work stealing, including batches of a single check
+ */
+BOOST_AUTO_TEST_CASE(test_CheckQueue_Correct_Random_WorkStealing) {
+    Correct_Queue_range({0, 1}, true);
+    Correct_Queue_range(RandomRange(), true);
 }
 
 /** Test that failing checks are caught */
-BOOST_AUTO_TEST_CASE(test_CheckQueue_Catches_Failure) {
-    auto fail_queue = std::make_unique<Failing_Queue>(QUEUE_BATCH_SIZE);
+static void Catches_Failure(bool fWorkStealing) {
+    auto fail_queue = MakeQueue<Failing_Queue>(fWorkStealing);
 
     boost::thread_group tg;
     for (auto x = 0; x < nScriptCheckThreads; ++x) {
@@ -218,10 +275,16 @@ BOOST_AUTO_TEST_CASE(test_CheckQueue_Catches_Failure) {
     tg.interrupt_all();
     tg.join_all();
 }
+BOOST_AUTO_TEST_CASE(test_CheckQueue_Catches_Failure) {
+    Catches_Failure(false);
+}
+BOOST_AUTO_TEST_CASE(test_CheckQueue_Catches_Failure_WorkStealing) {
+    Catches_Failure(true);
+}
 // Test that a block validation which fails does not interfere with
 // future blocks, ie, the bad state is cleared.
-BOOST_AUTO_TEST_CASE(test_CheckQueue_Recovers_From_Failure) {
-    auto fail_queue = std::make_unique<Failing_Queue>(QUEUE_BATCH_SIZE);
+static void Recovers_From_Failure(bool fWorkStealing) {
+    auto fail_queue = MakeQueue<Failing_Queue>(fWorkStealing);
     boost::thread_group tg;
     for (auto x = 0; x < nScriptCheckThreads; ++x) {
         tg.create_thread([&] { fail_queue->Thread(); });
@@ -243,12 +306,50 @@ BOOST_AUTO_TEST_CASE(test_CheckQueue_Recovers_From_Failure) {
     tg.interrupt_all();
     tg.join_all();
 }
+BOOST_AUTO_TEST_CASE(test_CheckQueue_Recovers_From_Failure) {
+    Recovers_From_Failure(false);
+}
+BOOST_AUTO_TEST_CASE(test_CheckQueue_Recovers_From_Failure_WorkStealing) {
+    Recovers_From_Failure(true);
+}
+
+// Test that the failures reported once a batch of checks ran are caught, and
+// that every check runs within a batch.
+static void Deferred_Failure(bool fWorkStealing) {
+    auto queue = MakeQueue<Deferred_Queue>(fWorkStealing);
+    boost::thread_group tg;
+    for (auto x = 0; x < nScriptCheckThreads; ++x) {
+        tg.create_thread([&] { queue->Thread(); });
+    }
+
+    for (size_t i = 0; i < 200; ++i) {
+        const size_t nChecks = 1 + InsecureRandRange(500);
+        const bool fFails = i % 2 == 1;
+        CCheckQueueControl<DeferredCheck> control(queue.get());
+        std::vector<DeferredCheck> vChecks(nChecks);
+        if (fFails) {
+            vChecks[InsecureRandRange(nChecks)].fails = true;
+        }
+        control.Add(vChecks);
+        BOOST_REQUIRE(control.Wait() != fFails);
+    }
+    BOOST_CHECK_EQUAL(DeferredCheck::nOutsideBatch, 0);
+    tg.interrupt_all();
+    tg.join_all();
+}
+BOOST_AUTO_TEST_CASE(test_CheckQueue_Deferred_Failure) {
+    Deferred_Failure(false);
+}
+BOOST_AUTO_TEST_CASE(test_CheckQueue_Deferred_Failure_WorkStealing) {
+    Deferred_Failure(true);
+}
 
 // Test that unique checks are actually all called individually, rather than
 // just one check being called repeatedly. Test that checks are not called
 // more than once as well
-BOOST_AUTO_TEST_CASE(test_CheckQueue_UniqueCheck) {
-    auto queue = std::make_unique<Unique_Queue>(QUEUE_BATCH_SIZE);
+static void UniqueChecks(bool fWorkStealing) {
+    UniqueCheck::results.clear();
+    auto queue = MakeQueue<Unique_Queue>(fWorkStealing);
     boost::thread_group tg;
     for (auto x = 0; x < nScriptCheckThreads; ++x) {
         tg.create_thread([&] { queue->Thread(); });
@@ -276,6 +377,12 @@ BOOST_AUTO_TEST_CASE(test_CheckQueue_UniqueCheck) {
     tg.interrupt_all();
     tg.join_all();
 }
+BOOST_AUTO_TEST_CASE(test_CheckQueue_UniqueCheck) {
+    UniqueChecks(false);
+}
+BOOST_AUTO_TEST_CASE(test_CheckQueue_UniqueCheck_WorkStealing) {
+    UniqueChecks(true);
+}
 
 // Test that blocks which might allocate lots of memory free their memory
 // aggressively.
@@ -283,8 +390,8 @@ BOOST_AUTO_TEST_CASE(test_CheckQueue_UniqueCheck) {
 // This test attempts to catch a pathological case where by lazily freeing
 // checks might mean leaving a check un-swapped out, and decreasing by 1 each
 // time could leave the data hanging across a sequence of blocks.
-BOOST_AUTO_TEST_CASE(test_CheckQueue_Memory) {
-    auto queue = std::make_unique<Memory_Queue>(QUEUE_BATCH_SIZE);
+static void Memory(bool fWorkStealing) {
+    auto queue = MakeQueue<Memory_Queue>(fWorkStealing);
     boost::thread_group tg;
     for (auto x = 0; x < nScriptCheckThreads; ++x) {
         tg.create_thread([&] { queue->Thread(); });
@@ -311,11 +418,17 @@ BOOST_AUTO_TEST_CASE(test_CheckQueue_Memory) {
     tg.interrupt_all();
     tg.join_all();
 }
+BOOST_AUTO_TEST_CASE(test_CheckQueue_Memory) {
+    Memory(false);
+}
+BOOST_AUTO_TEST_CASE(test_CheckQueue_Memory_WorkStealing) {
+    Memory(true);
+}
 
 // Test that a new verification cannot occur until all checks
 // have been destructed
-BOOST_AUTO_TEST_CASE(test_CheckQueue_FrozenCleanup) {
-    auto queue = std::make_unique<FrozenCleanup_Queue>(QUEUE_BATCH_SIZE);
+static void FrozenCleanup(bool fWorkStealing) {
+    auto queue = MakeQueue<FrozenCleanup_Queue>(fWorkStealing);
     boost::thread_group tg;
     bool fails = false;
     for (auto x = 0; x < nScriptCheckThreads; ++x) {
@@ -355,6 +468,12 @@ BOOST_AUTO_TEST_CASE(test_CheckQueue_FrozenCleanup) {
     tg.join_all();
     BOOST_REQUIRE(!fails);
 }
+BOOST_AUTO_TEST_CASE(test_CheckQueue_FrozenCleanup) {
+    FrozenCleanup(false);
+}
+BOOST_AUTO_TEST_CASE(test_CheckQueue_FrozenCleanup_WorkStealing) {
+    FrozenCleanup(true);
+}
 
 /** Test that CCheckQueueControl is threadsafe */
 BOOST_AUTO_TEST_CASE(test_CheckQueueControl_Locks) {
@@ -8,6 +8,7 @@
 #include <consensus/validation.h>
 #include <script/standard.h>
 #include <streams.h>
+#include <txdb.h>
 #include <undo.h>
 #include <util/strencodings.h>
 #include <validation.h>
@@ -506,6 +507,278 @@ BOOST_AUTO_TEST_CASE(updatecoins_simulation_test) {
     BOOST_CHECK(spent_a_duplicate_coinbase);
 }
 
+static void CheckPrefetchCoins(CCoinsView &base) {
+    std::vector<COutPoint> outpoints;
+    {
+        CCoinsViewCacheTest writer(&base);
+        for (uint32_t i = 0; i < 4; i++) {
+            outpoints.emplace_back(TxId(InsecureRand256()), i);
+            writer.AddCoin(outpoints.back(),
+                           Coin(CTxOut(int64_t(i + 1) * FIXOSHI,
+                                       CScript() << OP_TRUE),
+                                i, false),
+                           false);
+        }
+        writer.SetBestBlock(BlockHash(InsecureRand256()));
+        BOOST_CHECK(writer.Flush());
+    }
+    const COutPoint absent(TxId(InsecureRand256()), 0);
+
+    // Coins fetched in a batch match the ones fetched one by one.
+    std::vector<COutPoint> lookup = outpoints;
+    lookup.push_back(absent);
+    std::vector<Coin> coins;
+    base.GetCoins(lookup, coins);
+    BOOST_CHECK_EQUAL(coins.size(), lookup.size());
+    for (size_t i = 0; i < outpoints.size(); i++) {
+        Coin coin;
+        BOOST_CHECK(base.GetCoin(outpoints[i], coin));
+        BOOST_CHECK(coins[i] == coin);
+    }
+    BOOST_CHECK(coins.back().IsSpent());
+
+    // Only the coins which are not cached yet are fetched, and absent ones are
+    // not cached.
+    CCoinsViewCacheTest cache1(&base);
+    BOOST_CHECK(!cache1.AccessCoin(outpoints[0]).IsSpent());
+    BOOST_CHECK_EQUAL(cache1.GetStats().nMisses, 1U);
+    cache1.PrefetchCoins(lookup);
+    BOOST_CHECK_EQUAL(cache1.GetStats().nPrefetchHits, 1U);
+    BOOST_CHECK_EQUAL(cache1.GetStats().nPrefetchMisses, 4U);
+    for (const COutPoint &outpoint : outpoints) {
+        BOOST_CHECK(cache1.HaveCoinInCache(outpoint));
+    }
+    BOOST_CHECK(!cache1.HaveCoinInCache(absent));
+    cache1.SelfTest();
+
+    // A cache on top of another one is served from it.
+    CCoinsViewCacheTest cache2(&cache1);
+    cache2.PrefetchCoins(outpoints);
+    BOOST_CHECK_EQUAL(cache2.GetStats().nPrefetchMisses, 4U);
+    BOOST_CHECK_EQUAL(cache1.GetStats().nPrefetchHits, 5U);
+    BOOST_CHECK_EQUAL(cache1.GetStats().nMisses, 1U);
+    BOOST_CHECK_EQUAL(cache2.AccessCoin(outpoints[3]).GetTxOut().nValue,
+                      4 * FIXOSHI);
+    BOOST_CHECK_EQUAL(cache2.GetStats().nHits, 1U);
+    BOOST_CHECK_EQUAL(cache2.GetStats().nMisses, 0U);
+    cache2.SelfTest();
+}
+
+BOOST_AUTO_TEST_CASE(coins_prefetch) {
+    CCoinsViewTest base;
+    CheckPrefetchCoins(base);
+
+    CCoinsViewDB db(1 << 20, true);
+    CheckPrefetchCoins(db);
+
+    // The coins are still being written, or at least held by the writer.
+    CCoinsViewDB db2(1 << 20, true);
+    CCoinsViewBackgroundWriter writer(db2);
+    CheckPrefetchCoins(writer);
+    BOOST_CHECK(writer.Sync());
+}
+
+BOOST_AUTO_TEST_CASE(coins_background_writer) {
+    CCoinsViewDB db(1 << 20, true);
+    CCoinsViewBackgroundWriter writer(db);
+
+    std::vector<COutPoint> outpoints;
+    const BlockHash firstBlock(InsecureRand256());
+    {
+        CCoinsViewCacheTest cache(&writer);
+        for (uint32_t i = 0; i < 100; i++) {
+            outpoints.emplace_back(TxId(InsecureRand256()), i);
+            cache.AddCoin(outpoints.back(),
+                          Coin(CTxOut(int64_t(i + 1) * FIXOSHI,
+                                      CScript() << OP_TRUE),
+                               i, false),
+                          false);
+        }
+        cache.SetBestBlock(firstBlock);
+        BOOST_CHECK(cache.Flush());
+        BOOST_CHECK_EQUAL(cache.GetCacheSize(), 0U);
+    }
+
+    // Whether or not the write completed, the writer reflects the flush.
+    BOOST_CHECK(writer.GetBestBlock() == firstBlock);
+    const BlockHash secondBlock(InsecureRand256());
+    {
+        CCoinsViewCacheTest cache(&writer);
+        for (size_t i = 0; i < outpoints.size(); i++) {
+            BOOST_CHECK(cache.HaveCoin(outpoints[i]));
+            if (i % 2) {
+                BOOST_CHECK(cache.SpendCoin(outpoints[i]));
+            }
+        }
+        cache.SetBestBlock(secondBlock);
+        // This waits for the first write before starting the second one.
+        BOOST_CHECK(cache.Flush());
+    }
+    BOOST_CHECK(writer.GetBestBlock() == secondBlock);
+    for (size_t i = 0; i < outpoints.size(); i++) {
+        BOOST_CHECK_EQUAL(writer.HaveCoin(outpoints[i]), i % 2 == 0);
+    }
+
+    // Once synced, the database holds the state of the last flush and is
+    // consistent, and the writer no longer holds any coin.
+    BOOST_CHECK(writer.Sync());
+    BOOST_CHECK(!writer.IsWriting());
+    BOOST_CHECK_EQUAL(writer.DynamicMemoryUsage(), 0U);
+    BOOST_CHECK(db.GetBestBlock() == secondBlock);
+    BOOST_CHECK(db.GetHeadBlocks().empty());
+    for (size_t i = 0; i < outpoints.size(); i++) {
+        Coin coin;
+        BOOST_CHECK_EQUAL(db.GetCoin(outpoints[i], coin), i % 2 == 0);
+    }
+}
+
+static void CheckCommitment(const CCoinsCommitment &commitment,
+                            const CCoinsView &view) {
+    CCoinsCommitment expected;
+    std::unique_ptr<CCoinsViewCursor> pcursor(view.Cursor());
+    for (; pcursor->Valid(); pcursor->Next()) {
+        COutPoint key;
+        Coin coin;
+        BOOST_CHECK(pcursor->GetKey(key) && pcursor->GetValue(coin));
+        expected.AddCoin(key, coin);
+    }
+
+    BOOST_CHECK_EQUAL(commitment.GetHash(), expected.GetHash());
+    BOOST_CHECK_EQUAL(commitment.GetTransactionOutputs(),
+                      expected.GetTransactionOutputs());
+    BOOST_CHECK_EQUAL(commitment.GetTotalAmount(), expected.GetTotalAmount());
+    BOOST_CHECK_EQUAL(commitment.GetBogoSize(), expected.GetBogoSize());
+}
+
+BOOST_AUTO_TEST_CASE(coins_commitment) {
+    CCoinsViewDB db(1 << 20, true);
+    CCoinsCommitment commitment;
+    BOOST_CHECK(commitment.GetHash().IsNull());
+    CheckCommitment(commitment, db);
+
+    std::vector<COutPoint> outpoints;
+    for (int i = 0; i < 20; i++) {
+        CCoinsViewCacheTest tip(&db);
+        CCoinsCommitment changes;
+        {
+            // The changes are recorded by the cache they are made to, and
+            // only count once it is flushed.
+            CCoinsViewCacheTest cache(&tip);
+            cache.TrackChanges(&changes);
+            for (int j = 0; j < 50; j++) {
+                const Coin coin(CTxOut(int64_t(InsecureRandRange(100) + 1) *
+                                           FIXOSHI,
+                                       CScript() << ToByteVector(
+                                           InsecureRand256())),
+                                i, InsecureRandBool());
+                switch (outpoints.empty() ? 0 : InsecureRandRange(4)) {
+                    case 0:
+                        outpoints.emplace_back(TxId(InsecureRand256()), j);
+                        cache.AddCoin(outpoints.back(), coin, false);
+                        break;
+                    case 1:
+                        // The coin may already be spent.
+                        cache.SpendCoin(outpoints[InsecureRandRange(
+                            outpoints.size())]);
+                        break;
+                    case 2:
+                        cache.AddCoin(
+                            outpoints[InsecureRandRange(outpoints.size())],
+                            coin, true);
+                        break;
+                    default:
+                        // Unspendable coins are not part of the set.
+                        cache.AddCoin(COutPoint(TxId(InsecureRand256()), j),
+                                      Coin(CTxOut(FIXOSHI,
+                                                  CScript() << OP_RETURN),
+                                           i, false),
+                                      false);
+                }
+            }
+            BOOST_CHECK(cache.Flush());
+        }
+        commitment += changes;
+        tip.SetBestBlock(BlockHash(InsecureRand256()));
+        BOOST_CHECK(tip.Flush());
+        CheckCommitment(commitment, db);
+    }
+
+    // The commitment is stored along with the block it commits to.
+    BlockHash hashBlock;
+    CCoinsCommitment stored;
+    BOOST_CHECK(!db.ReadCommitment(hashBlock, stored));
+    BOOST_CHECK(db.WriteCommitment(db.GetBestBlock(), commitment));
+    BOOST_CHECK(db.ReadCommitment(hashBlock, stored));
+    BOOST_CHECK(hashBlock == db.GetBestBlock());
+    CheckCommitment(stored, db);
+}
+
+BOOST_AUTO_TEST_CASE(coins_cursors) {
+    CCoinsViewDB db(1 << 20, true);
+    for (size_t nShards : {1, 3, 256}) {
+        BOOST_CHECK_EQUAL(db.Cursors(nShards).size(), nShards);
+        for (const auto &pcursor : db.Cursors(nShards)) {
+            BOOST_CHECK(!pcursor->Valid());
+        }
+    }
+
+    // Random txids, and the ones at the bounds of the shards.
+    std::vector<TxId> txids;
+    for (int i = 0; i < 500; i++) {
+        txids.emplace_back(InsecureRand256());
+    }
+    for (uint32_t prefix : {0x0000, 0x00ff, 0x0100, 0x5555, 0x5556, 0xaaaa,
+                            0xaaab, 0xffff}) {
+        uint256 txid;
+        *txid.begin() = prefix >> 8;
+        *(txid.begin() + 1) = prefix & 0xff;
+        txids.emplace_back(txid);
+    }
+    {
+        CCoinsViewCacheTest cache(&db);
+        for (const TxId &txid : txids) {
+            for (uint32_t n = 0; n < 3; n++) {
+                cache.AddCoin(COutPoint(txid, n),
+                              Coin(CTxOut(FIXOSHI, CScript() << OP_TRUE), 1,
+                                   false),
+                              false);
+            }
+        }
+        cache.SetBestBlock(BlockHash(InsecureRand256()));
+        BOOST_CHECK(cache.Flush());
+    }
+
+    std::vector<COutPoint> expected;
+    std::unique_ptr<CCoinsViewCursor> pcursor(db.Cursor());
+    for (; pcursor->Valid(); pcursor->Next()) {
+        COutPoint key;
+        BOOST_CHECK(pcursor->GetKey(key));
+        expected.push_back(key);
+    }
+    BOOST_CHECK_EQUAL(expected.size(), 3 * txids.size());
+
+    // Iterating over the shards in order gives the same coins as a single
+    // cursor, and the coins of a transaction are never split between shards.
+    for (size_t nShards : {1, 2, 3, 256, 0x10000}) {
+        std::vector<COutPoint> found;
+        for (const auto &pshard : db.Cursors(nShards)) {
+            BOOST_CHECK(pshard->GetBestBlock() == db.GetBestBlock());
+            std::vector<COutPoint> shard;
+            for (; pshard->Valid(); pshard->Next()) {
+                COutPoint key;
+                BOOST_CHECK(pshard->GetKey(key));
+                shard.push_back(key);
+            }
+            if (!shard.empty()) {
+                BOOST_CHECK_EQUAL(shard.front().GetN(), 0U);
+                BOOST_CHECK_EQUAL(shard.back().GetN(), 2U);
+            }
+            found.insert(found.end(), shard.begin(), shard.end());
+        }
+        BOOST_CHECK(found == expected);
+    }
+}
+
 BOOST_AUTO_TEST_CASE(coin_serialization) {
     // Good example
     CDataStream ss1(
@@ -0,0 +1,97 @@
+// Copyright (c) 2020 The Bitcoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <ecmultiset.h>
+
+#include <streams.h>
+#include <util/strencodings.h>
+#include <version.h>
+
+#include <test/setup_common.h>
+
+#include <boost/test/unit_test.hpp>
+
+#include <vector>
+
+BOOST_FIXTURE_TEST_SUITE(ecmultiset_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(ecmultiset_empty) {
+    ECMultiSet set;
+    BOOST_CHECK(set.IsEmpty());
+    BOOST_CHECK(set.GetHash().IsNull());
+
+    const std::vector<uint8_t> data = ParseHex("0011223344");
+    set.Insert(data);
+    BOOST_CHECK(!set.IsEmpty());
+    BOOST_CHECK(!set.GetHash().IsNull());
+
+    set.Remove(data);
+    BOOST_CHECK(set.IsEmpty());
+    BOOST_CHECK(set.GetHash().IsNull());
+}
+
+BOOST_AUTO_TEST_CASE(ecmultiset_operations) {
+    std::vector<std::vector<uint8_t>> elements;
+    for (int i = 0; i < 8; i++) {
+        uint256 r = InsecureRand256();
+        elements.emplace_back(r.begin(), r.end());
+    }
+
+    // The hash doesn't depend on the order in which elements are inserted.
+    ECMultiSet forward, backward;
+    for (size_t i = 0; i < elements.size(); i++) {
+        forward.Insert(elements[i]);
+        backward.Insert(elements[elements.size() - 1 - i]);
+    }
+    BOOST_CHECK_EQUAL(forward.GetHash(), backward.GetHash());
+
+    // Removing an element undoes its insertion.
+    ECMultiSet partial;
+    for (size_t i = 0; i < elements.size() - 1; i++) {
+        partial.Insert(elements[i]);
+    }
+    BOOST_CHECK(partial.GetHash() != forward.GetHash());
+    forward.Remove(elements.back());
+    BOOST_CHECK_EQUAL(forward.GetHash(), partial.GetHash());
+
+    // Elements may be removed before they are inserted.
+    ECMultiSet removed;
+    removed.Remove(elements.back());
+    removed.Insert(elements.back());
+    BOOST_CHECK(removed.IsEmpty());
+
+    // It is a multiset: inserting an element twice differs from once.
+    ECMultiSet once, twice;
+    once.Insert(elements[0]);
+    twice.Insert(elements[0]).Insert(elements[0]);
+    BOOST_CHECK(once.GetHash() != twice.GetHash());
+
+    // Combining two multisets gives their union.
+    ECMultiSet first, second;
+    for (size_t i = 0; i < elements.size(); i++) {
+        (i % 2 ? first : second).Insert(elements[i]);
+    }
+    first += second;
+    BOOST_CHECK_EQUAL(first.GetHash(), backward.GetHash());
+}
+
+BOOST_AUTO_TEST_CASE(ecmultiset_serialization) {
+    ECMultiSet set;
+    set.Insert(ParseHex("00")).Insert(ParseHex("01"));
+
+    CDataStream ss(SER_DISK, PROTOCOL_VERSION);
+    ss << set;
+    BOOST_CHECK_EQUAL(ss.size(), 96U);
+
+    ECMultiSet set2;
+    ss >> set2;
+    BOOST_CHECK_EQUAL(set2.GetHash(), set.GetHash());
+
+    // The deserialized multiset can still be updated.
+    set.Insert(ParseHex("02"));
+    set2.Insert(ParseHex("02"));
+    BOOST_CHECK_EQUAL(set2.GetHash(), set.GetHash());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
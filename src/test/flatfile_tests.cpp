@@ -130,4 +130,69 @@ BOOST_AUTO_TEST_CASE(flatfile_flush) {
     BOOST_CHECK_EQUAL(fs::file_size(seq.FileName(FlatFilePos(0, 1))), 1);
 }
 
+BOOST_AUTO_TEST_CASE(flatfile_map) {
+    auto data_dir = SetDataDir("flatfile_test");
+    FlatFileSeq seq(data_dir, "a", 100);
+
+    const std::string line1("The proof-of-work chain is the solution.");
+    const std::string line2("Nodes can leave and rejoin the network.");
+    const size_t pos2 = GetSerializeSize(line1, CLIENT_VERSION);
+    {
+        CAutoFile file(seq.Open(FlatFilePos(0, 0)), SER_DISK, CLIENT_VERSION);
+        file << line1;
+    }
+
+    // Missing files and ranges past the end are not mapped.
+    BOOST_CHECK(!seq.Map(FlatFilePos(1, 0), 1));
+    BOOST_CHECK(!seq.Map(FlatFilePos(0, pos2), 1));
+
+    auto mapping = seq.Map(FlatFilePos(0, 0), pos2);
+    BOOST_REQUIRE(mapping);
+    BOOST_CHECK_EQUAL(mapping->Data().size(), pos2);
+    std::string text;
+    SpanReader(SER_DISK, CLIENT_VERSION, mapping->Data()) >> text;
+    BOOST_CHECK_EQUAL(text, line1);
+
+    // The mapping is reused while it covers the range.
+    BOOST_CHECK_EQUAL(seq.Map(FlatFilePos(0, 1), pos2 - 1), mapping);
+
+    // The file is mapped again once it grew.
+    {
+        CAutoFile file(seq.Open(FlatFilePos(0, pos2)), SER_DISK,
+                       CLIENT_VERSION);
+        file << line2;
+    }
+    const size_t size2 = GetSerializeSize(line2, CLIENT_VERSION);
+    auto grown = seq.Map(FlatFilePos(0, pos2), size2);
+    BOOST_REQUIRE(grown);
+    BOOST_CHECK(grown != mapping);
+    SpanReader(SER_DISK, CLIENT_VERSION, grown->Data().subspan(pos2)) >> text;
+    BOOST_CHECK_EQUAL(text, line2);
+
+    // Older mappings stay valid while they are held.
+    SpanReader(SER_DISK, CLIENT_VERSION, mapping->Data()) >> text;
+    BOOST_CHECK_EQUAL(text, line1);
+
+    // Unmapped files are mapped again on the next use.
+    seq.Unmap(FlatFilePos(0, 0));
+    auto remapped = seq.Map(FlatFilePos(0, 0), pos2);
+    BOOST_CHECK(remapped && remapped != grown);
+
+    // Least recently used files are evicted past the limit.
+    {
+        CAutoFile file(seq.Open(FlatFilePos(1, 0)), SER_DISK, CLIENT_VERSION);
+        file << line2;
+    }
+    FlatFileSeq::SetMaxMappedFiles(1);
+    auto other = seq.Map(FlatFilePos(1, 0), size2);
+    BOOST_CHECK(other);
+    BOOST_CHECK_EQUAL(seq.Map(FlatFilePos(1, 0), size2), other);
+    BOOST_CHECK(seq.Map(FlatFilePos(0, 0), pos2) != remapped);
+
+    // Nothing is mapped when disabled.
+    FlatFileSeq::SetMaxMappedFiles(0);
+    BOOST_CHECK(!seq.Map(FlatFilePos(0, 0), pos2));
+    FlatFileSeq::SetMaxMappedFiles(DEFAULT_MAX_MAPPED_FILES);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,132 @@
+// Copyright (c) 2020 The Bitcoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <flathashmap.h>
+
+#include <coins.h>
+#include <memusage.h>
+
+#include <test/setup_common.h>
+
+#include <boost/test/unit_test.hpp>
+
+#include <map>
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+BOOST_FIXTURE_TEST_SUITE(flathashmap_tests, BasicTestingSetup)
+
+namespace {
+/** Hasher with very few distinct values, to exercise long probe sequences. */
+struct CollidingHasher {
+    size_t operator()(uint32_t key) const { return key % 7; }
+};
+
+template <typename Hash> void CheckAgainstStdMap(uint32_t nKeys) {
+    FlatHashMap<uint32_t, std::string, Hash> map;
+    std::map<uint32_t, std::string> expected;
+
+    for (int i = 0; i < 20000; i++) {
+        const uint32_t key = InsecureRandRange(nKeys);
+        switch (InsecureRandRange(4)) {
+            case 0: {
+                const std::string value = std::to_string(InsecureRand32());
+                const bool inserted = map.emplace(key, value).second;
+                BOOST_CHECK_EQUAL(inserted,
+                                  expected.emplace(key, value).second);
+                break;
+            }
+            case 1: {
+                map[key] += "x";
+                expected[key] += "x";
+                break;
+            }
+            case 2: {
+                auto it = map.find(key);
+                BOOST_CHECK_EQUAL(it != map.end(), expected.count(key) == 1);
+                if (it != map.end()) {
+                    BOOST_CHECK_EQUAL(it->first, key);
+                    map.erase(it);
+                    expected.erase(key);
+                }
+                break;
+            }
+            case 3: {
+                const auto &constMap = map;
+                auto it = constMap.find(key);
+                auto expectedIt = expected.find(key);
+                BOOST_CHECK_EQUAL(it != constMap.end(),
+                                  expectedIt != expected.end());
+                if (it != constMap.end()) {
+                    BOOST_CHECK_EQUAL(it->second, expectedIt->second);
+                }
+                break;
+            }
+        }
+        BOOST_CHECK_EQUAL(map.size(), expected.size());
+    }
+
+    // Every entry is visited once by iteration, and erasing while iterating
+    // works.
+    const size_t nEntries = map.size();
+    std::map<uint32_t, std::string> visited;
+    for (auto it = map.begin(); it != map.end();) {
+        BOOST_CHECK(visited.emplace(it->first, it->second).second);
+        if (it->first % 2) {
+            expected.erase(it->first);
+            it = map.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    BOOST_CHECK_EQUAL(visited.size(), nEntries);
+    for (const auto &entry : expected) {
+        BOOST_CHECK_EQUAL(map.count(entry.first), 1U);
+    }
+    BOOST_CHECK_EQUAL(map.size(), expected.size());
+
+    map.clear();
+    BOOST_CHECK(map.empty());
+    BOOST_CHECK(map.begin() == map.end());
+    BOOST_CHECK_EQUAL(memusage::DynamicUsage(map), 0U);
+}
+} // namespace
+
+BOOST_AUTO_TEST_CASE(flathashmap_random) {
+    CheckAgainstStdMap<std::hash<uint32_t>>(100);
+    CheckAgainstStdMap<std::hash<uint32_t>>(10000);
+    CheckAgainstStdMap<CollidingHasher>(300);
+}
+
+BOOST_AUTO_TEST_CASE(flathashmap_stable_references) {
+    FlatHashMap<uint32_t, std::unique_ptr<int>> map;
+    map.emplace(0, std::make_unique<int>(42));
+    const std::unique_ptr<int> *first = &map.find(0)->second;
+    for (uint32_t i = 1; i < 10000; i++) {
+        map.emplace(i, std::make_unique<int>(i));
+        if (i % 3 == 0) {
+            map.erase(map.find(i - 1));
+        }
+    }
+    // The first entry did not move while the map grew.
+    BOOST_CHECK_EQUAL(&map.find(0)->second, first);
+    BOOST_CHECK_EQUAL(**first, 42);
+}
+
+BOOST_AUTO_TEST_CASE(flathashmap_memory_usage) {
+    // A map of coins takes less memory than with std::unordered_map.
+    CCoinsMap map;
+    std::unordered_map<COutPoint, CCoinsCacheEntry, SaltedOutpointHasher>
+        stdMap;
+    for (uint32_t i = 0; i < 10000; i++) {
+        const COutPoint outpoint(TxId(InsecureRand256()), i);
+        map.emplace(outpoint, CCoinsCacheEntry());
+        stdMap.emplace(outpoint, CCoinsCacheEntry());
+    }
+    BOOST_CHECK_LT(memusage::DynamicUsage(map),
+                   memusage::DynamicUsage(stdMap));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
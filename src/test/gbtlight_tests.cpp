@@ -10,6 +10,7 @@
 #include <primitives/block.h>
 #include <primitives/transaction.h>
 #include <rpc/mining.h>
+#include <rpc/protocol.h>
 #include <streams.h>
 #include <util/strencodings.h>
 #include <test/setup_common.h>
@@ -74,6 +75,7 @@ GBTLightSetup::GBTLightSetup() {
 }
 
 GBTLightSetup::~GBTLightSetup() {
+    gbtl::Shutdown();
     gArgs.ClearArg("-gbtstoretime");
     gArgs.ClearArg("-gbtcachesize");
 }
@@ -119,6 +121,7 @@ BOOST_AUTO_TEST_CASE(StoreDir_Cache_Works_Test) {
             // below requires cs_main
             gbtl::CacheAndSaveTxsToFile(jobId, &back);
         }
+        gbtl::SyncJobDataWrites();
         jobs.emplace_back(jobId);
         jobSet.insert(jobId); // ensure uniqueness
         // check that the file was created where we expect
@@ -146,6 +149,52 @@ BOOST_AUTO_TEST_CASE(StoreDir_Cache_Works_Test) {
     BOOST_CHECK_MESSAGE(found == jobs.size(), "All should be found");
 }
 
+/// Check that each tx is stored once on disk however many jobs refer to it, and that jobs which left the in-memory
+/// cache are rebuilt from the stored txs.
+BOOST_AUTO_TEST_CASE(TxStore_Test) {
+    using gbtl::JobId;
+    const auto countFiles = [](const fs::path &dir) {
+        size_t count = 0;
+        for (const auto &entry : fs::directory_iterator(dir))
+            count += fs::is_regular_file(entry.path());
+        return count;
+    };
+    // two jobs with the same txs, the second one listing each of them twice
+    JobId jobId, jobId2;
+    GetRandBytes(jobId.begin(), jobId.size());
+    GetRandBytes(jobId2.begin(), jobId2.size());
+    std::vector<CTransactionRef> txs2 = txs;
+    txs2.insert(txs2.end(), txs.begin(), txs.end());
+    gbtl::CacheAndSaveTxsToFile(jobId, &txs);
+    gbtl::CacheAndSaveTxsToFile(jobId2, &txs2);
+    // push both jobs out of the in-memory cache
+    const std::vector<CTransactionRef> noTxs;
+    for (size_t i = 0; i < gbtl::GetJobCacheSize(); ++i) {
+        JobId otherJobId;
+        GetRandBytes(otherJobId.begin(), otherJobId.size());
+        gbtl::CacheAndSaveTxsToFile(otherJobId, &noTxs);
+    }
+    gbtl::SyncJobDataWrites();
+
+    BOOST_CHECK_EQUAL(countFiles(gbtl::GetTxDataDir()), txs.size());
+    // the job data files only list the txids
+    BOOST_CHECK_EQUAL(fs::file_size(gbtl::GetJobDataDir() / jobId2.GetHex()),
+                      gbtl::kJobFileMagic.size() * 2 + sizeof(uint32_t) + txs2.size() * sizeof(TxId));
+
+    for (const auto &job : {std::make_pair(jobId, &txs), std::make_pair(jobId2, &txs2)}) {
+        CBlock block;
+        BOOST_CHECK(!gbtl::GetTxsFromCache(job.first, block));
+        BOOST_CHECK_NO_THROW(gbtl::LoadTxsFromFile(job.first, block));
+        BOOST_CHECK_MESSAGE(CompareVTX(block.vtx, *job.second), "Loading txs from the tx store should yield identical txs");
+    }
+
+    // a job whose txs are all gone cannot be loaded
+    for (const auto &entry : fs::directory_iterator(gbtl::GetTxDataDir()))
+        fs::remove(entry.path());
+    CBlock block;
+    BOOST_CHECK_THROW(gbtl::LoadTxsFromFile(jobId, block), JSONRPCError);
+}
+
 /// GBTLight in-memory cache tests:
 /// 1. Test the cache works
 /// 2. Test the cache size argument takes effect
@@ -330,4 +330,61 @@ BOOST_AUTO_TEST_CASE(key_signature_tests) {
     BOOST_CHECK(found_small);
 }
 
+BOOST_AUTO_TEST_CASE(schnorr_batch_verifier) {
+    std::vector<CPubKey> pubkeys;
+    std::vector<uint256> hashes;
+    std::vector<std::vector<uint8_t>> sigs;
+    for (int i = 0; i < 50; i++) {
+        CKey key;
+        key.MakeNewKey(i % 2 == 0);
+        pubkeys.push_back(key.GetPubKey());
+        hashes.push_back(InsecureRand256());
+        sigs.emplace_back();
+        BOOST_CHECK(key.SignSchnorr(hashes.back(), sigs.back()));
+    }
+
+    SchnorrBatchVerifier batch;
+    std::vector<size_t> invalid{0};
+    BOOST_CHECK(batch.empty());
+    BOOST_CHECK(batch.Verify(&invalid));
+    BOOST_CHECK(invalid.empty());
+
+    for (size_t i = 0; i < sigs.size(); i++) {
+        batch.Add(pubkeys[i], hashes[i], sigs[i]);
+        BOOST_CHECK_EQUAL(batch.size(), i + 1);
+        BOOST_CHECK(batch.Verify(&invalid));
+        BOOST_CHECK(invalid.empty());
+    }
+
+    // Invalid signatures are all found.
+    batch.clear();
+    for (size_t i = 0; i < sigs.size(); i++) {
+        if (i == 7 || i == 30) {
+            std::vector<uint8_t> sig = sigs[i];
+            sig[InsecureRandBits(6)] ^= 1 << InsecureRandBits(3);
+            batch.Add(pubkeys[i], hashes[i], sig);
+        } else if (i == 41) {
+            batch.Add(pubkeys[i], hashes[i - 1], sigs[i]);
+        } else {
+            batch.Add(pubkeys[i], hashes[i], sigs[i]);
+        }
+    }
+    BOOST_CHECK(!batch.Verify());
+    BOOST_CHECK(!batch.Verify(&invalid));
+    BOOST_CHECK(invalid == std::vector<size_t>({7, 30, 41}));
+
+    // So are invalid public keys.
+    batch.clear();
+    batch.Add(pubkeys[0], hashes[0], sigs[0]);
+    batch.Add(CPubKey(), hashes[1], sigs[1]);
+    BOOST_CHECK(!batch.Verify(&invalid));
+    BOOST_CHECK(invalid == std::vector<size_t>({1}));
+
+    // A lone invalid signature.
+    batch.clear();
+    batch.Add(pubkeys[1], hashes[0], sigs[0]);
+    BOOST_CHECK(!batch.Verify(&invalid));
+    BOOST_CHECK(invalid == std::vector<size_t>({0}));
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -266,6 +266,92 @@ BOOST_AUTO_TEST_CASE(MempoolRemoveTest) {
     BOOST_CHECK_EQUAL(testPool.size(), 0UL);
 }
 
+BOOST_AUTO_TEST_CASE(MempoolLinksTest) {
+    // Test the links between entries and the walks that follow them
+
+    TestMemPoolEntryHelper entry;
+    // Parent transaction with four children, the last of which also spends
+    // the outputs of the three others:
+    CMutableTransaction txParent;
+    txParent.vin.resize(1);
+    txParent.vin[0].scriptSig = CScript() << OP_11;
+    txParent.vout.resize(4);
+    for (int i = 0; i < 4; i++) {
+        txParent.vout[i].scriptPubKey = CScript() << OP_11 << OP_EQUAL;
+        txParent.vout[i].nValue = 33000 * FIXOSHI;
+    }
+    CMutableTransaction txChild[4];
+    for (int i = 0; i < 4; i++) {
+        txChild[i].vin.resize(1);
+        txChild[i].vin[0].scriptSig = CScript() << OP_11;
+        txChild[i].vin[0].prevout = COutPoint(txParent.GetId(), i);
+        if (i == 3) {
+            for (int j = 0; j < 3; j++) {
+                txChild[i].vin.emplace_back(COutPoint(txChild[j].GetId(), 0));
+            }
+        }
+        txChild[i].vout.resize(1);
+        txChild[i].vout[0].scriptPubKey = CScript() << OP_11 << OP_EQUAL;
+        txChild[i].vout[0].nValue = 11000 * FIXOSHI;
+    }
+
+    CTxMemPool testPool;
+    LOCK2(cs_main, testPool.cs);
+    auto addAll = [&]() EXCLUSIVE_LOCKS_REQUIRED(testPool.cs) {
+        testPool.addUnchecked(entry.FromTx(txParent));
+        for (int i = 0; i < 4; i++) {
+            testPool.addUnchecked(entry.FromTx(txChild[i]));
+        }
+    };
+
+    // Fill and empty the pool once, so that only the memory used by the links
+    // may differ afterwards.
+    addAll();
+    testPool.removeRecursive(CTransaction(txParent));
+    BOOST_CHECK_EQUAL(testPool.size(), 0UL);
+    const size_t emptyUsage = testPool.DynamicMemoryUsage();
+
+    addAll();
+
+    const CTxMemPool::txiter parentIt = testPool.mapTx.find(txParent.GetId());
+    const CTxMemPool::txiter lastIt = testPool.mapTx.find(txChild[3].GetId());
+    BOOST_CHECK(testPool.GetMemPoolParents(parentIt).empty());
+    BOOST_CHECK_EQUAL(testPool.GetMemPoolChildren(parentIt).size(), 4UL);
+    BOOST_CHECK_EQUAL(testPool.GetMemPoolParents(lastIt).size(), 4UL);
+    BOOST_CHECK(testPool.GetMemPoolChildren(lastIt).empty());
+
+    // The parent is reached by four paths, but is only counted once.
+    CTxMemPool::setEntries ancestors;
+    uint64_t nNoLimit = std::numeric_limits<uint64_t>::max();
+    std::string dummy;
+    BOOST_CHECK(testPool.CalculateMemPoolAncestors(
+        *lastIt, ancestors, nNoLimit, nNoLimit, nNoLimit, nNoLimit, dummy,
+        false));
+    BOOST_CHECK_EQUAL(ancestors.size(), 4UL);
+    BOOST_CHECK_EQUAL(lastIt->GetCountWithAncestors(), 5UL);
+    BOOST_CHECK_EQUAL(parentIt->GetCountWithDescendants(), 5UL);
+    BOOST_CHECK_EQUAL(testPool.CalculateDescendantMaximum(lastIt), 5UL);
+
+    CTxMemPool::setEntries descendants;
+    testPool.CalculateDescendants(parentIt, descendants);
+    BOOST_CHECK_EQUAL(descendants.size(), 5UL);
+
+    // Removing a child unlinks it from the parent and from the last child.
+    testPool.removeRecursive(CTransaction(txChild[0]));
+    BOOST_CHECK_EQUAL(testPool.size(), 3UL);
+    BOOST_CHECK_EQUAL(testPool.GetMemPoolChildren(parentIt).size(), 2UL);
+    for (const CTxMemPoolEntry *child :
+         testPool.GetMemPoolChildren(parentIt)) {
+        BOOST_CHECK(child->GetMemPoolChildren().empty());
+        BOOST_CHECK_EQUAL(child->GetMemPoolParents().size(), 1UL);
+    }
+
+    // The memory used by the links is accounted for.
+    testPool.removeRecursive(CTransaction(txParent));
+    BOOST_CHECK_EQUAL(testPool.size(), 0UL);
+    BOOST_CHECK_EQUAL(testPool.DynamicMemoryUsage(), emptyUsage);
+}
+
 BOOST_AUTO_TEST_CASE(MempoolClearTest) {
     // Test CTxMemPool::clear functionality
 
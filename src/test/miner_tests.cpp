@@ -111,6 +111,25 @@ static bool TestSequenceLocks(const CTransaction &tx, int flags)
     return CheckSequenceLocks(::g_mempool, tx, flags);
 }
 
+// Check that a template resumed from the candidate holds the same
+// transactions as the one assembled from scratch.
+static void CheckCandidateTemplate(const CChainParams &chainparams,
+                                   const CScript &scriptPubKey,
+                                   BlockTemplateCandidate &candidate,
+                                   const CBlockTemplate &expected)
+    EXCLUSIVE_LOCKS_REQUIRED(cs_main, ::g_mempool.cs) {
+    std::unique_ptr<CBlockTemplate> pblocktemplate =
+        AssemblerForTest(chainparams, g_mempool)
+            .CreateNewBlock(scriptPubKey, &candidate);
+    BOOST_CHECK(candidate.IsValid());
+    const std::vector<CTransactionRef> &vtx = pblocktemplate->block.vtx;
+    BOOST_CHECK_EQUAL(vtx.size(), expected.block.vtx.size());
+    for (size_t i = 1; i < std::min(vtx.size(), expected.block.vtx.size());
+         i++) {
+        BOOST_CHECK(vtx[i]->GetId() == expected.block.vtx[i]->GetId());
+    }
+}
+
 // Test suite for ancestor feerate transaction selection.
 // Implemented as an additional function, rather than a separate test case, to
 // allow reusing the blockchain created in CreateNewBlock_validity.
@@ -120,6 +139,9 @@ static void TestPackageSelection(const CChainParams &chainparams,
     EXCLUSIVE_LOCKS_REQUIRED(cs_main, ::g_mempool.cs) {
     // Test the ancestor feerate transaction selection.
     TestMemPoolEntryHelper entry;
+    // Each template is also made from the selection of the previous one.
+    BlockTemplateCandidate candidate(g_mempool);
+    BOOST_CHECK(!candidate.IsValid());
 
     // Test that a medium fee transaction will be selected after a higher fee
     // rate package with a low fee rate parent.
@@ -158,6 +180,8 @@ static void TestPackageSelection(const CChainParams &chainparams,
 
     std::unique_ptr<CBlockTemplate> pblocktemplate =
         AssemblerForTest(chainparams, g_mempool).CreateNewBlock(scriptPubKey);
+    CheckCandidateTemplate(chainparams, scriptPubKey, candidate,
+                           *pblocktemplate);
     BOOST_CHECK(pblocktemplate->block.vtx[1]->GetId() == parentTxId);
     BOOST_CHECK(pblocktemplate->block.vtx[2]->GetId() == highFeeTxId);
     BOOST_CHECK(pblocktemplate->block.vtx[3]->GetId() == mediumFeeTxId);
@@ -181,6 +205,8 @@ static void TestPackageSelection(const CChainParams &chainparams,
     g_mempool.addUnchecked(entry.Fee(feeToUse).FromTx(tx));
     pblocktemplate =
         AssemblerForTest(chainparams, g_mempool).CreateNewBlock(scriptPubKey);
+    CheckCandidateTemplate(chainparams, scriptPubKey, candidate,
+                           *pblocktemplate);
     // Verify that the free tx and the low fee tx didn't get selected.
     for (const auto &txn : pblocktemplate->block.vtx) {
         BOOST_CHECK(txn->GetId() != freeTxId);
@@ -191,12 +217,15 @@ static void TestPackageSelection(const CChainParams &chainparams,
     // of the transactions is below the min relay fee. Remove the low fee
     // transaction and replace with a higher fee transaction
     g_mempool.removeRecursive(CTransaction(tx));
+    BOOST_CHECK(!candidate.IsValid());
     // Now we should be just over the min relay fee.
     tx.vout[0].nValue -= 2 * FIXOSHI;
     lowFeeTxId = tx.GetId();
     g_mempool.addUnchecked(entry.Fee(feeToUse + 2 * FIXOSHI).FromTx(tx));
     pblocktemplate =
         AssemblerForTest(chainparams, g_mempool).CreateNewBlock(scriptPubKey);
+    CheckCandidateTemplate(chainparams, scriptPubKey, candidate,
+                           *pblocktemplate);
     BOOST_CHECK(pblocktemplate->block.vtx[4]->GetId() == freeTxId);
     BOOST_CHECK(pblocktemplate->block.vtx[5]->GetId() == lowFeeTxId);
 
@@ -222,6 +251,8 @@ static void TestPackageSelection(const CChainParams &chainparams,
         entry.Fee(feeToUse).SpendsCoinbase(false).FromTx(tx));
     pblocktemplate =
         AssemblerForTest(chainparams, g_mempool).CreateNewBlock(scriptPubKey);
+    CheckCandidateTemplate(chainparams, scriptPubKey, candidate,
+                           *pblocktemplate);
 
     // Verify that this tx isn't selected.
     for (const auto &txn : pblocktemplate->block.vtx) {
@@ -237,6 +268,8 @@ static void TestPackageSelection(const CChainParams &chainparams,
     g_mempool.addUnchecked(entry.Fee(10000 * FIXOSHI).FromTx(tx));
     pblocktemplate =
         AssemblerForTest(chainparams, g_mempool).CreateNewBlock(scriptPubKey);
+    CheckCandidateTemplate(chainparams, scriptPubKey, candidate,
+                           *pblocktemplate);
     BOOST_CHECK(pblocktemplate->block.vtx[8]->GetId() == lowFeeTxId2);
 }
 
@@ -908,4 +941,122 @@ BOOST_AUTO_TEST_CASE(TestCBlockTemplateEntry) {
     BOOST_CHECK_EQUAL(txEntry.sigOpCount, 10);
 }
 
+static std::vector<TxId> AssembleTxIds(const CChainParams &chainparams,
+                                       const CTxMemPool &pool,
+                                       const BlockAssembler::Options &options,
+                                       BlockTemplateCandidate *pcandidate) {
+    const CScript scriptPubKey = CScript() << OP_TRUE;
+    std::unique_ptr<CBlockTemplate> pblocktemplate =
+        BlockAssembler(chainparams, pool, options)
+            .CreateNewBlock(scriptPubKey, pcandidate);
+    std::vector<TxId> txids;
+    for (size_t i = 1; i < pblocktemplate->block.vtx.size(); i++) {
+        txids.push_back(pblocktemplate->block.vtx[i]->GetId());
+    }
+    return txids;
+}
+
+BOOST_AUTO_TEST_CASE(BlockTemplateCandidate_resume) {
+    const CChainParams &chainparams = Params();
+    // The transactions don't spend real coins.
+    const CFeeRate minFeeRate(1000 * FIXOSHI);
+    BlockAssembler::Options options;
+    options.blockMinFeeRate = minFeeRate;
+    options.fTestBlockValidity = false;
+
+    CTxMemPool pool;
+    LOCK2(cs_main, pool.cs);
+    BlockTemplateCandidate candidate(pool);
+    TestMemPoolEntryHelper entry;
+
+    CMutableTransaction tx;
+    tx.vin.resize(1);
+    // Large enough for the transactions to meet the minimum size.
+    tx.vin[0].scriptSig = CScript() << std::vector<uint8_t>(100, 0x01);
+    tx.vout.resize(2);
+    tx.vout[0].scriptPubKey = CScript() << OP_TRUE;
+    tx.vout[0].nValue = COIN;
+    tx.vout[1] = tx.vout[0];
+    const size_t txSize = GetSerializeSize(tx, PROTOCOL_VERSION);
+
+    // A transaction paying enough fees, and a free one which can't be mined by
+    // itself.
+    tx.vin[0].prevout = COutPoint(TxId(InsecureRand256()), 0);
+    const CTransactionRef paying = MakeTransactionRef(tx);
+    pool.addUnchecked(
+        entry.Fee(10 * minFeeRate.GetFee(txSize)).FromTx(paying));
+    tx.vin[0].prevout = COutPoint(TxId(InsecureRand256()), 0);
+    const CTransactionRef freeTx = MakeTransactionRef(tx);
+    pool.addUnchecked(entry.Fee(Amount::zero()).FromTx(freeTx));
+
+    // A child of both, which pays enough for itself but not for the free
+    // transaction.
+    tx.vin.resize(2);
+    tx.vin[0].prevout = COutPoint(paying->GetId(), 0);
+    tx.vin[1].prevout = COutPoint(freeTx->GetId(), 0);
+    tx.vin[1].scriptSig = tx.vin[0].scriptSig;
+    const CTransactionRef child = MakeTransactionRef(tx);
+    pool.addUnchecked(
+        entry.Fee(minFeeRate.GetFee(
+                      GetSerializeSize(*child, PROTOCOL_VERSION)))
+            .FromTx(child));
+
+    std::vector<TxId> txids =
+        AssembleTxIds(chainparams, pool, options, &candidate);
+    BOOST_CHECK(candidate.IsValid());
+    BOOST_CHECK(txids == std::vector<TxId>{paying->GetId()});
+    BOOST_CHECK(txids == AssembleTxIds(chainparams, pool, options, nullptr));
+
+    // A new transaction pays for the free one, which lets the child in too.
+    tx.vin.resize(1);
+    tx.vin[0].prevout = COutPoint(freeTx->GetId(), 1);
+    const CTransactionRef bumping = MakeTransactionRef(tx);
+    pool.addUnchecked(
+        entry.Fee(10 * minFeeRate.GetFee(txSize)).FromTx(bumping));
+
+    txids = AssembleTxIds(chainparams, pool, options, &candidate);
+    BOOST_CHECK(candidate.IsValid());
+    BOOST_CHECK_EQUAL(txids.size(), 4U);
+    BOOST_CHECK(txids == AssembleTxIds(chainparams, pool, options, nullptr));
+
+    // New independent transactions, and chains of them, are all selected.
+    for (int i = 0; i < 100; i++) {
+        if (i % 3 == 0) {
+            tx.vin[0].prevout = COutPoint(TxId(InsecureRand256()), 0);
+        } else {
+            tx.vin[0].prevout = COutPoint(tx.GetId(), 0);
+        }
+        pool.addUnchecked(
+            entry.Fee((1 + i % 7) * minFeeRate.GetFee(txSize))
+                .FromTx(tx));
+        if (i % 10 == 9) {
+            txids = AssembleTxIds(chainparams, pool, options, &candidate);
+            BOOST_CHECK(candidate.IsValid());
+            BOOST_CHECK_EQUAL(txids.size(), 5U + i);
+            BOOST_CHECK(txids ==
+                        AssembleTxIds(chainparams, pool, options, nullptr));
+        }
+    }
+
+    // A transaction leaving the mempool invalidates the selection.
+    pool.removeRecursive(*bumping);
+    BOOST_CHECK(!candidate.IsValid());
+    txids = AssembleTxIds(chainparams, pool, options, &candidate);
+    BOOST_CHECK(candidate.IsValid());
+    BOOST_CHECK_EQUAL(txids.size(), 101U);
+    BOOST_CHECK(txids == AssembleTxIds(chainparams, pool, options, nullptr));
+
+    // So do other options.
+    BlockAssembler::Options otherOptions = options;
+    otherOptions.blockMinFeeRate = CFeeRate(Amount::zero());
+    txids = AssembleTxIds(chainparams, pool, otherOptions, &candidate);
+    BOOST_CHECK_EQUAL(txids.size(), 103U);
+
+    // The selection isn't kept when the block has no room for a package.
+    otherOptions.nMaxGeneratedBlockSize = 1000;
+    txids = AssembleTxIds(chainparams, pool, otherOptions, &candidate);
+    BOOST_CHECK(txids.empty());
+    BOOST_CHECK(!candidate.IsValid());
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,122 @@
+// Copyright (c) 2020 The Bitcoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <rawblockcache.h>
+
+#include <chainparams.h>
+#include <net.h>
+#include <streams.h>
+#include <validation.h>
+#include <version.h>
+
+#include <test/setup_common.h>
+
+#include <boost/test/unit_test.hpp>
+
+#include <memory>
+#include <vector>
+
+BOOST_FIXTURE_TEST_SUITE(rawblockcache_tests, BasicTestingSetup)
+
+static BlockHash MakeHash(uint8_t n) {
+    uint256 hash;
+    *hash.begin() = n;
+    return BlockHash(hash);
+}
+
+static std::shared_ptr<const CSharedNetPayload> MakeBlock(size_t size) {
+    return std::make_shared<const CSharedNetPayload>(
+        std::vector<uint8_t>(size, 0x42));
+}
+
+BOOST_AUTO_TEST_CASE(lru_eviction) {
+    RawBlockCache cache(300);
+    auto block1 = MakeBlock(100);
+    auto block2 = MakeBlock(100);
+    auto block3 = MakeBlock(100);
+    cache.Insert(MakeHash(1), block1);
+    cache.Insert(MakeHash(2), block2);
+    cache.Insert(MakeHash(3), block3);
+    BOOST_CHECK_EQUAL(cache.GetCount(), 3U);
+    BOOST_CHECK_EQUAL(cache.GetBytes(), 300U);
+
+    // Using block 1 makes block 2 the least recently used one
+    BOOST_CHECK(cache.Get(MakeHash(1)) == block1);
+    cache.Insert(MakeHash(4), MakeBlock(100));
+    BOOST_CHECK_EQUAL(cache.GetCount(), 3U);
+    BOOST_CHECK(cache.Get(MakeHash(2)) == nullptr);
+    BOOST_CHECK(cache.Get(MakeHash(1)) == block1);
+    BOOST_CHECK(cache.Get(MakeHash(3)) == block3);
+
+    // A larger block evicts as many blocks as needed
+    cache.Insert(MakeHash(5), MakeBlock(250));
+    BOOST_CHECK_EQUAL(cache.GetCount(), 1U);
+    BOOST_CHECK_EQUAL(cache.GetBytes(), 250U);
+    BOOST_CHECK(cache.Get(MakeHash(5)) != nullptr);
+
+    // Inserting a cached block again changes nothing
+    cache.Insert(MakeHash(5), MakeBlock(10));
+    BOOST_CHECK_EQUAL(cache.GetBytes(), 250U);
+
+    // Blocks stay valid for their users after they are evicted
+    BOOST_CHECK_EQUAL(block2->data.size(), 100U);
+}
+
+BOOST_AUTO_TEST_CASE(limits) {
+    RawBlockCache cache(300);
+    cache.Insert(MakeHash(1), MakeBlock(301));
+    BOOST_CHECK_EQUAL(cache.GetCount(), 0U);
+    BOOST_CHECK(cache.Get(MakeHash(1)) == nullptr);
+
+    cache.Insert(MakeHash(1), MakeBlock(100));
+    cache.Insert(MakeHash(2), MakeBlock(100));
+    cache.SetMaxBytes(150);
+    BOOST_CHECK_EQUAL(cache.GetMaxBytes(), 150U);
+    BOOST_CHECK_EQUAL(cache.GetCount(), 1U);
+    BOOST_CHECK(cache.Get(MakeHash(2)) != nullptr);
+
+    // A limit of 0 disables the cache
+    cache.SetMaxBytes(0);
+    BOOST_CHECK_EQUAL(cache.GetCount(), 0U);
+    BOOST_CHECK_EQUAL(cache.GetBytes(), 0U);
+    cache.Insert(MakeHash(3), MakeBlock(0));
+    cache.Insert(MakeHash(4), MakeBlock(1));
+    BOOST_CHECK_EQUAL(cache.GetCount(), 0U);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_FIXTURE_TEST_SUITE(rawblockcache_disk_tests, TestChain100Setup)
+
+BOOST_AUTO_TEST_CASE(read_raw_block) {
+    const CChainParams &params = Params();
+    std::vector<const CBlockIndex *> indexes;
+    {
+        LOCK(cs_main);
+        indexes = {::ChainActive().Genesis(), ::ChainActive()[50],
+                   ::ChainActive().Tip()};
+    }
+
+    for (const CBlockIndex *pindex : indexes) {
+        CBlock block;
+        BOOST_REQUIRE(
+            ReadBlockFromDisk(block, pindex, params.GetConsensus()));
+        CDataStream expected(SER_NETWORK, PROTOCOL_VERSION);
+        expected << block;
+
+        std::vector<uint8_t> raw;
+        BOOST_REQUIRE(ReadRawBlockFromDisk(raw, pindex, params.DiskMagic()));
+        BOOST_CHECK(raw == std::vector<uint8_t>(expected.begin(),
+                                                expected.end()));
+    }
+
+    // The magic in front of the block is checked
+    CMessageHeader::MessageMagic bad_magic = params.DiskMagic();
+    bad_magic[0] ^= 0xff;
+    std::vector<uint8_t> raw;
+    BOOST_CHECK(!ReadRawBlockFromDisk(raw, indexes.back(), bad_magic));
+    BOOST_CHECK(raw.empty());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -9,6 +9,7 @@
 #include <config.h>
 #include <software_outdated.h>
 #include <util/system.h>
+#include <util/time.h>
 
 #include <test/setup_common.h>
 
@@ -16,6 +17,8 @@
 
 #include <functional>
 #include <string>
+#include <thread>
+#include <vector>
 
 BOOST_FIXTURE_TEST_SUITE(rpc_server_tests, TestingSetup)
 
@@ -111,4 +114,80 @@ BOOST_AUTO_TEST_CASE(rpc_server_execute_command_from_request_context) {
     BOOST_CHECK_EQUAL(output.get_str(), "testing2");
 }
 
+class EchoTestRPCCommand : public RPCCommandWithArgsContext {
+public:
+    EchoTestRPCCommand(const std::string &nameIn)
+        : RPCCommandWithArgsContext(nameIn) {}
+
+    UniValue Execute(const UniValue &args) const override {
+        // Give the other threads a chance to pick up requests
+        MilliSleep(1);
+        return UniValue(args["value"]);
+    }
+};
+
+BOOST_AUTO_TEST_CASE(rpc_server_exec_batch) {
+    DummyConfig config;
+    RPCServer rpcServer;
+    rpcServer.RegisterCommand(std::make_unique<EchoTestRPCCommand>("echo"));
+
+    const int NUM_REQUESTS = 50;
+    const auto makeBatch = [&]() {
+        UniValue::Array batch;
+        for (int i = 0; i < NUM_REQUESTS; i++) {
+            UniValue::Object params;
+            params.emplace_back("value", i);
+            UniValue::Object req;
+            req.emplace_back("method", "echo");
+            req.emplace_back("params", std::move(params));
+            req.emplace_back("id", i);
+            batch.emplace_back(std::move(req));
+        }
+        // An invalid request gets its error at its place in the batch
+        batch.emplace_back(UniValue::Object());
+        return batch;
+    };
+    const auto checkReplies = [&](const std::string &reply) {
+        UniValue replies;
+        BOOST_REQUIRE(replies.read(reply));
+        BOOST_REQUIRE_EQUAL(replies.size(), NUM_REQUESTS + 1);
+        for (int i = 0; i < NUM_REQUESTS; i++) {
+            BOOST_CHECK_EQUAL(replies[i]["id"].get_int(), i);
+            BOOST_CHECK_EQUAL(replies[i]["result"].get_int(), i);
+            BOOST_CHECK(replies[i]["error"].isNull());
+        }
+        BOOST_CHECK(replies[NUM_REQUESTS]["result"].isNull());
+        BOOST_CHECK(!replies[NUM_REQUESTS]["error"].isNull());
+    };
+
+    JSONRPCRequest jreq;
+    const std::string serialReply =
+        JSONRPCExecBatch(config, rpcServer, jreq, makeBatch());
+    checkReplies(serialReply);
+
+    // Helpers run on their own threads, as long as there are threads left
+    for (const int nThreads : {0, 2, 8}) {
+        for (const int nConcurrency : {1, 4, 100}) {
+            std::vector<std::thread> threads;
+            int nDispatched = 0;
+            const auto dispatch = [&](std::function<void()> task) {
+                nDispatched++;
+                if (int(threads.size()) >= nThreads) {
+                    return false;
+                }
+                threads.emplace_back(std::move(task));
+                return true;
+            };
+            const std::string reply = JSONRPCExecBatch(
+                config, rpcServer, jreq, makeBatch(), dispatch, nConcurrency);
+            for (std::thread &thread : threads) {
+                thread.join();
+            }
+            BOOST_CHECK_EQUAL(reply, serialReply);
+            BOOST_CHECK(nDispatched <= nConcurrency - 1);
+            BOOST_CHECK(nDispatched <= nThreads + 1);
+        }
+    }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
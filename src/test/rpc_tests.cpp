@@ -7,12 +7,18 @@
 #include <rpc/server.h>
 #include <rpc/util.h>
 
+#include <chain.h>
 #include <config.h>
+#include <consensus/merkle.h>
 #include <core_io.h>
 #include <init.h>
 #include <interfaces/chain.h>
+#include <key.h>
 #include <key_io.h>
 #include <netbase.h>
+#include <primitives/block.h>
+#include <script/standard.h>
+#include <util/jsonwriter.h>
 
 #include <test/setup_common.h>
 
@@ -569,4 +575,158 @@ BOOST_AUTO_TEST_CASE(rpc_getblockstats_calculate_percentiles_by_size)
     }
 }
 
+BOOST_AUTO_TEST_CASE(rpc_json_writer) {
+    std::string json;
+    JSONWriter writer(json);
+    writer.BeginObject();
+    writer.KeyValue("str", std::string("a \"quoted\"\tstring\n\x01"));
+    writer.KeyValue("int", -42);
+    writer.KeyValue("uint64", std::numeric_limits<uint64_t>::max());
+    writer.KeyValue("double", 1.5);
+    writer.KeyValue("bool", true);
+    writer.KeyValue("null", UniValue());
+    writer.Key("empty");
+    writer.BeginArray();
+    writer.EndArray();
+    writer.Key("array");
+    writer.BeginArray();
+    writer.Value("x");
+    writer.BeginObject();
+    writer.EndObject();
+    writer.Value(7);
+    writer.EndArray();
+    writer.EndObject();
+
+    UniValue::Object expected;
+    expected.emplace_back("str", "a \"quoted\"\tstring\n\x01");
+    expected.emplace_back("int", -42);
+    expected.emplace_back("uint64", std::numeric_limits<uint64_t>::max());
+    expected.emplace_back("double", 1.5);
+    expected.emplace_back("bool", true);
+    expected.emplace_back("null", UniValue());
+    expected.emplace_back("empty", UniValue::Array());
+    UniValue::Array array;
+    array.emplace_back("x");
+    array.emplace_back(UniValue::Object());
+    array.emplace_back(7);
+    expected.emplace_back("array", std::move(array));
+    BOOST_CHECK_EQUAL(json, UniValue::stringify(expected));
+
+    // Serialized JSON is embedded as is
+    UniValue::Object wrapper;
+    wrapper.emplace_back("result", UniValue::fromSerializedJSON(std::move(json)));
+    BOOST_CHECK_EQUAL(UniValue::stringify(wrapper),
+                      "{\"result\":" + UniValue::stringify(expected) + "}");
+}
+
+BOOST_AUTO_TEST_CASE(rpc_json_writer_flush) {
+    const size_t nFlushSize = 16;
+    UniValue::Array array;
+    for (int i = 0; i < 20; i++) {
+        array.emplace_back(i);
+    }
+    UniValue::Object object;
+    object.emplace_back("long", std::string(100, '"') + std::string(50, 'x'));
+    object.emplace_back("serialized",
+                        UniValue::fromSerializedJSON("[" + std::string(60, '1') + "]"));
+    object.emplace_back("array", std::move(array));
+    object.emplace_back("null", UniValue());
+    const UniValue value(std::move(object));
+
+    std::string json;
+    std::vector<std::string> chunks;
+    JSONWriter writer(
+        json, [&chunks](std::string &chunk) { chunks.push_back(chunk); },
+        nFlushSize);
+    writer.BeginArray();
+    writer.Value(value);
+    writer.Value("end");
+    writer.EndArray();
+
+    // The text is handed over in pieces, none of them much longer than the
+    // flush size, and the same text as when written at once
+    BOOST_CHECK(chunks.size() > 10);
+    std::string all;
+    for (const std::string &chunk : chunks) {
+        BOOST_CHECK(chunk.size() >= nFlushSize);
+        BOOST_CHECK(chunk.size() <= 3 * nFlushSize);
+        all += chunk;
+    }
+    all += json;
+    BOOST_CHECK(json.size() < nFlushSize);
+
+    UniValue::Array expected;
+    expected.emplace_back(UniValue(value));
+    expected.emplace_back("end");
+    BOOST_CHECK_EQUAL(all, UniValue::stringify(expected));
+}
+
+BOOST_AUTO_TEST_CASE(rpc_write_block_json) {
+    const Config &config = GetConfig();
+    CKey key;
+    key.MakeNewKey(true);
+
+    CBlock block;
+    block.nVersion = 0x20000000;
+    block.nTime = 1234567890;
+    block.nBits = 0x207fffff;
+    block.nNonce = 42;
+
+    CMutableTransaction coinbase;
+    coinbase.vin.resize(1);
+    coinbase.vin[0].scriptSig = CScript() << 100 << OP_0;
+    coinbase.vout.emplace_back(50 * COIN, GetScriptForDestination(
+                                              key.GetPubKey().GetID()));
+    block.vtx.push_back(MakeTransactionRef(coinbase));
+
+    CMutableTransaction tx;
+    tx.nVersion = 2;
+    tx.nLockTime = 99;
+    tx.vin.emplace_back(COutPoint(TxId(InsecureRand256()), 3));
+    tx.vin[0].scriptSig = CScript() << std::vector<uint8_t>(71, 0x30)
+                                    << ToByteVector(key.GetPubKey());
+    tx.vin.emplace_back(COutPoint(TxId(InsecureRand256()), 0));
+    tx.vin[1].nSequence = 5;
+    tx.vout.emplace_back(COIN, GetScriptForMultisig(1, {key.GetPubKey()}));
+    tx.vout.emplace_back(Amount::zero(), CScript() << OP_RETURN << 0x1234);
+    tx.vout.emplace_back(-1 * FIXOSHI, CScript() << OP_INVALIDOPCODE);
+    block.vtx.push_back(MakeTransactionRef(tx));
+    block.hashMerkleRoot = BlockMerkleRoot(block);
+
+    const BlockHash prevHash(InsecureRand256());
+    const BlockHash hash = block.GetHash();
+    CBlockIndex prev;
+    prev.phashBlock = &prevHash;
+    prev.nBits = block.nBits;
+    CBlockIndex blockindex(block);
+    blockindex.phashBlock = &hash;
+    blockindex.pprev = &prev;
+    blockindex.nHeight = 1;
+    blockindex.nTx = block.vtx.size();
+
+    for (const auto &ptx : block.vtx) {
+        for (const uint256 &hashBlock : {uint256(), uint256(hash)}) {
+            for (const bool include_hex : {false, true}) {
+                std::string json;
+                JSONWriter writer(json);
+                WriteTxJSON(writer, config, *ptx, hashBlock, include_hex);
+                BOOST_CHECK_EQUAL(json, UniValue::stringify(TxToUniv(
+                                            config, *ptx, hashBlock,
+                                            include_hex)));
+            }
+        }
+    }
+
+    for (const CBlockIndex *tip : {&prev, &blockindex}) {
+        for (const bool txDetails : {false, true}) {
+            std::string json;
+            JSONWriter writer(json);
+            WriteBlockJSON(writer, config, block, tip, &blockindex, txDetails);
+            BOOST_CHECK_EQUAL(json,
+                              UniValue::stringify(blockToJSON(
+                                  config, block, tip, &blockindex, txDetails)));
+        }
+    }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -124,6 +124,12 @@ TestingSetup::TestingSetup(const std::string &chainName)
     nScriptCheckThreads = 3;
     for (int i = 0; i < nScriptCheckThreads - 1; i++) {
         threadGroup.create_thread([i]() { return ThreadScriptCheck(i); });
+        threadGroup.create_thread([i]() { return ThreadTxInputsCheck(i); });
+        threadGroup.create_thread([i]() { return ThreadHeaderCheck(i); });
+        threadGroup.create_thread([i]() { return ThreadTxPreCheck(i); });
+    }
+    for (int i = 0; i < nPrefetchThreads - 1; i++) {
+        threadGroup.create_thread([i]() { return ThreadCoinsRead(i); });
     }
 
     g_banman =
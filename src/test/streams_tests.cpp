@@ -115,6 +115,35 @@ BOOST_AUTO_TEST_CASE(streams_vector_reader) {
     BOOST_CHECK_THROW(new_reader >> d, std::ios_base::failure);
 }
 
+BOOST_AUTO_TEST_CASE(streams_span_reader) {
+    std::vector<uint8_t> vch = {1, 2, 3, 4, 5};
+
+    SpanReader reader(SER_NETWORK, INIT_PROTO_VERSION, MakeSpan(vch));
+    BOOST_CHECK_EQUAL(reader.size(), 5);
+    BOOST_CHECK(!reader.empty());
+
+    uint8_t a;
+    uint16_t b;
+    reader >> a >> b;
+    BOOST_CHECK_EQUAL(a, 1);
+    // 770 = 2,3 in little-endian base-256
+    BOOST_CHECK_EQUAL(b, 770);
+    BOOST_CHECK_EQUAL(reader.size(), 2);
+
+    // Skipped bytes are not read.
+    reader.ignore(1);
+    BOOST_CHECK_EQUAL(reader.size(), 1);
+
+    // Reading or skipping past the end of the span throws an error.
+    BOOST_CHECK_THROW(reader >> b, std::ios_base::failure);
+    BOOST_CHECK_THROW(reader.ignore(2), std::ios_base::failure);
+
+    // Failed reads consume nothing.
+    reader >> a;
+    BOOST_CHECK_EQUAL(a, 5);
+    BOOST_CHECK(reader.empty());
+}
+
 BOOST_AUTO_TEST_CASE(bitstream_reader_writer) {
     CDataStream data(SER_NETWORK, INIT_PROTO_VERSION);
 
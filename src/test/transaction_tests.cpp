@@ -16,6 +16,7 @@
 #include <policy/policy.h>
 #include <script/script.h>
 #include <script/script_error.h>
+#include <script/sigcache.h>
 #include <script/sign.h>
 #include <script/standard.h>
 #include <streams.h>
@@ -500,6 +501,107 @@ BOOST_AUTO_TEST_CASE(test_big_transaction) {
     threadGroup.join_all();
 }
 
+static bool CheckScriptsInBatches(const CTransaction &tx,
+                                  const std::vector<CScript> &scriptPubKeys,
+                                  const Amount amount, uint32_t flags) {
+    PrecomputedTransactionData txdata(tx);
+    boost::thread_group threadGroup;
+    CCheckQueue<CScriptCheck> scriptcheckqueue(128);
+    for (int i = 0; i < 4; i++) {
+        threadGroup.create_thread(std::bind(&CCheckQueue<CScriptCheck>::Thread,
+                                            std::ref(scriptcheckqueue)));
+    }
+
+    bool fOk;
+    {
+        CCheckQueueControl<CScriptCheck> control(&scriptcheckqueue);
+        std::vector<CScriptCheck> vChecks;
+        for (size_t i = 0; i < tx.vin.size(); i++) {
+            vChecks.emplace_back(scriptPubKeys[i], amount, tx, i, flags, false,
+                                 txdata);
+        }
+        control.Add(vChecks);
+        fOk = control.Wait();
+    }
+
+    threadGroup.interrupt_all();
+    threadGroup.join_all();
+    return fOk;
+}
+
+BOOST_AUTO_TEST_CASE(test_schnorr_batch_script_checks) {
+    const Amount amount = 1000 * FIXOSHI;
+    const SigHashType sigHashType = SigHashType().withForkId();
+
+    // Spend many P2PK outputs with Schnorr signatures.
+    std::vector<CKey> keys(300);
+    std::vector<CScript> scriptPubKeys;
+    CMutableTransaction mtx;
+    for (size_t i = 0; i < keys.size(); i++) {
+        keys[i].MakeNewKey(true);
+        scriptPubKeys.push_back(CScript() << ToByteVector(keys[i].GetPubKey())
+                                          << OP_CHECKSIG);
+        mtx.vin.emplace_back(COutPoint(TxId(InsecureRand256()), i));
+    }
+    mtx.vout.emplace_back(amount, CScript() << OP_1);
+
+    const auto sign = [&](const CMutableTransaction &txTo, size_t i) {
+        const uint256 hash = SignatureHash(scriptPubKeys[i], txTo, i,
+                                           sigHashType, amount);
+        std::vector<uint8_t> sig;
+        BOOST_CHECK(keys[i].SignSchnorr(hash, sig));
+        sig.push_back(uint8_t(sigHashType.getRawSigHashType()));
+        return sig;
+    };
+    for (size_t i = 0; i < mtx.vin.size(); i++) {
+        mtx.vin[i].scriptSig = CScript() << sign(mtx, i);
+    }
+
+    // Signatures signing another transaction are invalid, but remain well
+    // formed Schnorr signatures which are deferred to the batch.
+    CMutableTransaction other(mtx);
+    other.nLockTime = 1;
+    CMutableTransaction invalid(mtx);
+    invalid.vin[123].scriptSig = CScript() << sign(other, 123);
+
+    const uint32_t flags = STANDARD_SCRIPT_VERIFY_FLAGS;
+    BOOST_REQUIRE(flags & SCRIPT_VERIFY_NULLFAIL);
+    for (const bool fBatch : {true, false}) {
+        fBatchSchnorrChecks = fBatch;
+        BOOST_CHECK(CheckScriptsInBatches(CTransaction(mtx), scriptPubKeys,
+                                          amount, flags));
+        BOOST_CHECK(!CheckScriptsInBatches(CTransaction(invalid),
+                                           scriptPubKeys, amount, flags));
+        // Without NULLFAIL a failed signature does not fail the script on its
+        // own, so it is never deferred.
+        BOOST_CHECK(!CheckScriptsInBatches(CTransaction(invalid),
+                                           scriptPubKeys, amount,
+                                           flags & ~SCRIPT_VERIFY_NULLFAIL));
+    }
+    fBatchSchnorrChecks = DEFAULT_BATCH_SCHNORR_CHECKS;
+
+    // Only signatures which are not stored in the cache are deferred.
+    const CTransaction tx(invalid);
+    PrecomputedTransactionData txdata(tx);
+    const std::vector<uint8_t> sig(invalid.vin[123].scriptSig.begin() + 1,
+                                   invalid.vin[123].scriptSig.end() - 1);
+    const CPubKey pubkey = keys[123].GetPubKey();
+    const uint256 hash =
+        SignatureHash(scriptPubKeys[123], tx, 123, sigHashType, amount);
+    SchnorrBatchVerifier batch;
+    BOOST_CHECK(
+        CachingTransactionSignatureChecker(&tx, 123, amount, false, txdata,
+                                           &batch)
+            .VerifySignature(sig, pubkey, hash));
+    BOOST_CHECK_EQUAL(batch.size(), 1);
+    BOOST_CHECK(!batch.Verify());
+    BOOST_CHECK(
+        !CachingTransactionSignatureChecker(&tx, 123, amount, true, txdata,
+                                            &batch)
+             .VerifySignature(sig, pubkey, hash));
+    BOOST_CHECK_EQUAL(batch.size(), 1);
+}
+
 SignatureData CombineSignatures(const CMutableTransaction &input1,
                                 const CMutableTransaction &input2,
                                 const CTransactionRef tx) {
@@ -11,6 +11,9 @@
 #include <txmempool.h>
 #include <validation.h>
 #include <consensus/tx_check.h>
+#include <key.h>
+#include <script/interpreter.h>
+#include <script/sighashtype.h>
 #include <util/time.h>
 
 #include <boost/test/unit_test.hpp>
@@ -111,4 +114,93 @@ BOOST_FIXTURE_TEST_CASE(tx_mempool_reject_dup_txin, TestChain100Setup) {
     }
 }
 
+static CTransactionRef SpendP2PK(const CKey &key, const COutPoint &outpoint,
+                                 const Amount amount, bool fBadSig = false) {
+    const CScript scriptPubKey = CScript() << ToByteVector(key.GetPubKey())
+                                           << OP_CHECKSIG;
+    const SigHashType sigHashType = SigHashType().withForkId();
+    CMutableTransaction tx;
+    tx.vin.emplace_back(outpoint);
+    tx.vout.emplace_back(amount - 10000 * FIXOSHI, scriptPubKey);
+    uint256 hash = SignatureHash(scriptPubKey, tx, 0, sigHashType, amount);
+    if (fBadSig) {
+        hash = InsecureRand256();
+    }
+    std::vector<uint8_t> sig;
+    BOOST_CHECK(key.SignSchnorr(hash, sig));
+    sig.push_back(uint8_t(sigHashType.getRawSigHashType()));
+    tx.vin[0].scriptSig = CScript() << sig;
+    return MakeTransactionRef(tx);
+}
+
+/**
+ * Ensure that checking a batch of transactions ahead of their acceptance
+ * neither touches the mempool nor leaves their coins in the cache, and that
+ * accepting them afterwards gives the same results.
+ */
+BOOST_FIXTURE_TEST_CASE(tx_mempool_precheck_batch, TestingSetup) {
+    const Config &config = GetConfig();
+    const Amount amount = COIN;
+    CKey key;
+    key.MakeNewKey(true);
+    const CScript scriptPubKey = CScript() << ToByteVector(key.GetPubKey())
+                                           << OP_CHECKSIG;
+
+    std::vector<COutPoint> outpoints;
+    {
+        LOCK(cs_main);
+        for (int i = 0; i < 6; i++) {
+            outpoints.emplace_back(TxId(InsecureRand256()), 0);
+            pcoinsTip->AddCoin(outpoints.back(),
+                               Coin(CTxOut(amount, scriptPubKey), 1, false),
+                               false);
+        }
+        BOOST_CHECK(pcoinsTip->Flush());
+    }
+
+    std::vector<CTransactionRef> txs;
+    for (int i = 0; i < 4; i++) {
+        txs.push_back(SpendP2PK(key, outpoints[i], amount));
+    }
+    // An invalid signature, a missing coin and a child of the first one.
+    txs.push_back(SpendP2PK(key, outpoints[4], amount, true));
+    txs.push_back(
+        SpendP2PK(key, COutPoint(TxId(InsecureRand256()), 0), amount));
+    txs.push_back(SpendP2PK(key, COutPoint(txs[0]->GetId(), 0),
+                            txs[0]->vout[0].nValue));
+
+    PreCheckTransactions(config, g_mempool, txs);
+
+    {
+        LOCK(cs_main);
+        BOOST_CHECK_EQUAL(g_mempool.size(), 0);
+        for (const COutPoint &outpoint : outpoints) {
+            BOOST_CHECK(!pcoinsTip->HaveCoinInCache(outpoint));
+        }
+
+        for (size_t i = 0; i < txs.size(); i++) {
+            CValidationState state;
+            bool fMissingInputs = false;
+            const bool fAccepted = AcceptToMemoryPool(
+                config, g_mempool, state, txs[i], &fMissingInputs,
+                false /* bypass_limits */, Amount::zero() /* nAbsurdFee */);
+            BOOST_CHECK_EQUAL(fAccepted, i != 4 && i != 5);
+            BOOST_CHECK_EQUAL(fMissingInputs, i == 5);
+            if (i == 4) {
+                BOOST_CHECK(state.GetRejectReason().find(
+                                "mandatory-script-verify-flag-failed") == 0);
+            }
+        }
+        BOOST_CHECK_EQUAL(g_mempool.size(), 5);
+    }
+
+    // Transactions already in the mempool are left alone.
+    PreCheckTransactions(config, g_mempool, txs);
+
+    LOCK(cs_main);
+    BOOST_CHECK_EQUAL(g_mempool.size(), 5);
+    BOOST_CHECK(pcoinsTip->HaveCoinInCache(outpoints[0]));
+    BOOST_CHECK(!pcoinsTip->HaveCoinInCache(outpoints[5]));
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -94,6 +94,77 @@ BOOST_FIXTURE_TEST_CASE(tx_mempool_block_doublespend, TestChain100Setup) {
     BOOST_CHECK_EQUAL(g_mempool.size(), 0U);
 }
 
+BOOST_FIXTURE_TEST_CASE(parallel_input_checks, TestChain100Setup) {
+    // Blocks must be accepted or rejected the same way when the inputs of
+    // their transactions are validated in parallel.
+    fParallelInputChecks = true;
+
+    CScript scriptPubKey = CScript() << ToByteVector(coinbaseKey.GetPubKey())
+                                     << OP_CHECKSIG;
+
+    // Make sure the first two coinbases are mature.
+    for (int i = 0; i < 2; i++) {
+        CreateAndProcessBlock({}, scriptPubKey);
+    }
+
+    // nLockTime is only used to get distinct transactions.
+    auto spend = [&](const CTransactionRef &prevTx, Amount value,
+                     uint32_t nLockTime) {
+        CMutableTransaction tx;
+        tx.nVersion = 1;
+        tx.nLockTime = nLockTime;
+        tx.vin.resize(1);
+        tx.vin[0].prevout = COutPoint(prevTx->GetId(), 0);
+        tx.vout.resize(1);
+        tx.vout[0].nValue = value;
+        tx.vout[0].scriptPubKey = scriptPubKey;
+
+        std::vector<uint8_t> vchSig;
+        uint256 hash = SignatureHash(scriptPubKey, CTransaction(tx), 0,
+                                     SigHashType().withForkId(),
+                                     prevTx->vout[0].nValue);
+        BOOST_CHECK(coinbaseKey.SignECDSA(hash, vchSig));
+        vchSig.push_back(uint8_t(SIGHASH_ALL | SIGHASH_FORKID));
+        tx.vin[0].scriptSig << vchSig;
+        return tx;
+    };
+
+    const CTransactionRef &coinbase0 = m_coinbase_txns[0];
+    const CTransactionRef &coinbase1 = m_coinbase_txns[1];
+    const Amount value0 = coinbase0->vout[0].nValue;
+    const Amount value1 = coinbase1->vout[0].nValue;
+
+    CBlock block;
+
+    // Double spend across two transactions of the block.
+    block = CreateAndProcessBlock(
+        {spend(coinbase0, value0, 0), spend(coinbase0, value0, 1)},
+        scriptPubKey);
+    BOOST_CHECK(::ChainActive().Tip()->GetBlockHash() != block.GetHash());
+
+    // Spending more than the inputs are worth.
+    block = CreateAndProcessBlock({spend(coinbase0, value0 + FIXOSHI, 0)},
+                                  scriptPubKey);
+    BOOST_CHECK(::ChainActive().Tip()->GetBlockHash() != block.GetHash());
+
+    // Invalid signature, the transaction is changed after signing.
+    CMutableTransaction badSig = spend(coinbase1, value1, 0);
+    badSig.nLockTime = 1;
+    block = CreateAndProcessBlock({spend(coinbase0, value0, 0), badSig},
+                                  scriptPubKey);
+    BOOST_CHECK(::ChainActive().Tip()->GetBlockHash() != block.GetHash());
+
+    // A valid block, including a transaction spending an output created in
+    // the same block.
+    CMutableTransaction parent = spend(coinbase0, value0, 0);
+    CMutableTransaction child = spend(MakeTransactionRef(parent), value0, 0);
+    block = CreateAndProcessBlock({parent, child, spend(coinbase1, value1, 0)},
+                                  scriptPubKey);
+    BOOST_CHECK(::ChainActive().Tip()->GetBlockHash() == block.GetHash());
+
+    fParallelInputChecks = DEFAULT_PARALLEL_INPUT_CHECKS;
+}
+
 static inline bool
 CheckInputs(const CTransaction &tx, CValidationState &state,
             const CCoinsViewCache &view, bool fScriptChecks,
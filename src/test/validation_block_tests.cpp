@@ -209,4 +209,54 @@ BOOST_AUTO_TEST_CASE(processnewblock_signals_ordering) {
                       ::ChainActive().Tip()->GetBlockHash());
 }
 
+BOOST_AUTO_TEST_CASE(processnewblockheaders_batch) {
+    GlobalConfig config;
+    const Consensus::Params &params = config.GetChainParams().GetConsensus();
+
+    std::vector<CBlockHeader> headers;
+    BlockHash prev_hash = config.GetChainParams().GenesisBlock().GetHash();
+    for (int i = 0; i < 200; i++) {
+        headers.push_back(GoodBlock(config, prev_hash)->GetBlockHeader());
+        prev_hash = headers.back().GetHash();
+    }
+
+    // Break the proof of work of a header in the middle of the batch
+    std::vector<CBlockHeader> bad_headers = headers;
+    CBlockHeader &bad_header = bad_headers[150];
+    while (CheckProofOfWork(bad_header.GetHash(), bad_header.nBits, params)) {
+        ++bad_header.nNonce;
+    }
+
+    // The headers before the invalid one are accepted, and it is reported as
+    // the first invalid one
+    CValidationState state;
+    const CBlockIndex *pindex = nullptr;
+    CBlockHeader first_invalid;
+    BOOST_CHECK(!ProcessNewBlockHeaders(config, bad_headers, state, &pindex,
+                                        &first_invalid));
+    BOOST_CHECK_EQUAL(state.GetRejectReason(), "high-hash");
+    BOOST_CHECK_EQUAL(first_invalid.GetHash(), bad_header.GetHash());
+    BOOST_REQUIRE(pindex);
+    BOOST_CHECK_EQUAL(pindex->GetBlockHash(), headers[149].GetHash());
+    {
+        LOCK(cs_main);
+        BOOST_CHECK(LookupBlockIndex(headers[149].GetHash()));
+        BOOST_CHECK(!LookupBlockIndex(headers[150].GetHash()));
+    }
+
+    // The valid batch is accepted, headers already known included
+    state = CValidationState();
+    BOOST_CHECK(ProcessNewBlockHeaders(config, headers, state, &pindex));
+    BOOST_REQUIRE(pindex);
+    BOOST_CHECK_EQUAL(pindex->GetBlockHash(), headers.back().GetHash());
+    BOOST_CHECK_EQUAL(pindex->nHeight, 200);
+
+    // A header that does not connect is rejected
+    CBlockHeader orphan = GoodBlock(config, BlockHash(InsecureRand256()))
+                              ->GetBlockHeader();
+    state = CValidationState();
+    BOOST_CHECK(!ProcessNewBlockHeaders(config, {headers[0], orphan}, state));
+    BOOST_CHECK_EQUAL(state.GetRejectReason(), "prev-blk-not-found");
+}
+
 BOOST_AUTO_TEST_SUITE_END()
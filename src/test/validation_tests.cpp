@@ -8,8 +8,10 @@
 #include <chainparams.h>
 #include <clientversion.h>
 #include <config.h>
+#include <consensus/activation.h>
 #include <consensus/consensus.h>
 #include <net.h>
+#include <pow.h>
 #include <primitives/transaction.h>
 #include <streams.h>
 #include <util/system.h>
@@ -22,6 +24,7 @@
 
 #include <cstdint>
 #include <cstdio>
+#include <memory>
 #include <vector>
 
 BOOST_FIXTURE_TEST_SUITE(validation_tests, TestingSetup)
@@ -59,6 +62,88 @@ BOOST_FIXTURE_TEST_SUITE(validation_tests, TestingSetup)
 //}
 
 
+// GetBlockSubsidy as it was before the EMA anchor was cached and the decay
+// done on native integers.
+static Amount ReferenceBlockSubsidy(const CBlockIndex *pindexPrev,
+                                    uint32_t nBits, int nHeight,
+                                    const Consensus::Params &params) {
+    arith_uint256 bnTarget;
+    bool fNegative;
+    bool fOverflow;
+    bnTarget.SetCompact(nBits, &fNegative, &fOverflow);
+    if (fNegative || fOverflow || bnTarget == 0) {
+        return Amount::zero();
+    }
+    arith_uint256 aWork = (~bnTarget / (bnTarget + 1)) + 1;
+
+    const CBlockIndex *emaBlock = pindexPrev;
+    while (emaBlock->pprev) {
+        if (IsEMAEnabled(params, emaBlock->pskip)) {
+            emaBlock = emaBlock->pskip;
+            continue;
+        }
+        if (!IsEMAEnabled(params, emaBlock->pprev)) {
+            break;
+        }
+        emaBlock = emaBlock->pprev;
+    }
+    int divisions = nHeight / params.nSubsidyHalvingInterval;
+    int emaHeight = emaBlock->nHeight / params.nSubsidyHalvingInterval;
+    for (int a = 0; a < divisions; a++) {
+        aWork *= a < emaHeight ? 99826 : 99918;
+        aWork /= 100000;
+    }
+
+    aWork /= params.nValueCalibration;
+    return int64_t(ArithToUint256(aWork).GetUint64(0)) * Amount::fixoshi();
+}
+
+BOOST_AUTO_TEST_CASE(block_subsidy_ema_decay) {
+    const auto chainParams = CreateChainParams(CBaseChainParams::MAIN);
+    const Consensus::Params &params = chainParams->GetConsensus();
+
+    // A chain activating EMA half way
+    const int nBlocks = 20000;
+    std::vector<std::unique_ptr<CBlockIndex>> blocks;
+    for (int i = 0; i < nBlocks; i++) {
+        blocks.push_back(std::make_unique<CBlockIndex>());
+        CBlockIndex &index = *blocks.back();
+        index.nHeight = i;
+        index.nTime = params.emaDAATime + (i - nBlocks / 2) * 600;
+        index.nBits = 0x1a04b500;
+        if (i > 0) {
+            index.pprev = blocks[i - 1].get();
+            index.BuildSkip();
+        }
+    }
+
+    ResetEMAAnchorBlockCache();
+    const CBlockIndex *anchor = GetEMAAnchorBlock(blocks.back().get(), params);
+    BOOST_REQUIRE(anchor);
+    BOOST_CHECK(IsEMAEnabled(params, anchor));
+    BOOST_CHECK(!IsEMAEnabled(params, anchor->pprev));
+    BOOST_CHECK(GetEMAAnchorBlock(blocks[nBlocks - 100].get(), params) ==
+                anchor);
+    BOOST_CHECK(GetEMAAnchorBlock(anchor, params) == anchor);
+    BOOST_CHECK(GetEMAAnchorBlock(anchor->pprev, params) == nullptr);
+    BOOST_CHECK(GetEMAAnchorBlock(blocks[100].get(), params) == nullptr);
+
+    // Both sides of the activation, with works that fit in 64 bits or not
+    for (const uint32_t nBits :
+         {0x1a04b500U, 0x1d00ffffU, 0x207fffffU, 0x0f0fffffU, 0x04000001U}) {
+        for (int i = 1; i < nBlocks; i += 997) {
+            const CBlockIndex *pindexPrev = blocks[i - 1].get();
+            BOOST_CHECK_EQUAL(
+                GetBlockSubsidy(const_cast<CBlockIndex *>(pindexPrev), nBits,
+                                i, params),
+                ReferenceBlockSubsidy(pindexPrev, nBits, i, params));
+        }
+    }
+
+    // The block indexes are about to be freed
+    ResetEMAAnchorBlockCache();
+}
+
 static CBlock makeLargeDummyBlock(const size_t num_tx) {
     CBlock block;
     block.vtx.reserve(num_tx);
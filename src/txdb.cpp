@@ -7,7 +7,9 @@
 
 #include <chain.h>
 #include <chainparams.h>
+#include <checkqueue.h>
 #include <hash.h>
+#include <memusage.h>
 #include <pow.h>
 #include <random.h>
 #include <shutdown.h>
@@ -17,6 +19,8 @@
 #include <boost/thread.hpp> // boost::this_thread::interruption_point() (mingw)
 
 #include <cstdint>
+#include <cstring>
+#include <functional>
 
 static const char DB_COIN = 'C';
 static const char DB_COINS = 'c';
@@ -25,6 +29,7 @@ static const char DB_BLOCK_INDEX = 'b';
 
 static const char DB_BEST_BLOCK = 'B';
 static const char DB_HEAD_BLOCKS = 'H';
+static const char DB_COINS_COMMITMENT = 'U';
 static const char DB_FLAG = 'F';
 static const char DB_REINDEX_FLAG = 'R';
 static const char DB_LAST_BLOCK = 'l';
@@ -65,6 +70,71 @@ bool CCoinsViewDB::HaveCoin(const COutPoint &outpoint) const {
     return db.Exists(CoinEntry(&outpoint));
 }
 
+namespace {
+/** Read of one coin from the coin database, done by the coins read threads. */
+class CCoinReadCheck {
+private:
+    const CDBWrapper *db;
+    const COutPoint *outpoint;
+    Coin *coin;
+
+public:
+    CCoinReadCheck() : db(nullptr), outpoint(nullptr), coin(nullptr) {}
+    CCoinReadCheck(const CDBWrapper &dbIn, const COutPoint &outpointIn,
+                   Coin &coinIn)
+        : db(&dbIn), outpoint(&outpointIn), coin(&coinIn) {}
+
+    bool operator()() {
+        try {
+            if (!db->Read(CoinEntry(outpoint), *coin)) {
+                coin->Clear();
+            }
+        } catch (const std::runtime_error &) {
+            // Let the caller run into the error again on its own thread.
+            return false;
+        }
+        return true;
+    }
+
+    void swap(CCoinReadCheck &check) {
+        std::swap(db, check.db);
+        std::swap(outpoint, check.outpoint);
+        std::swap(coin, check.coin);
+    }
+};
+} // namespace
+
+static CCheckQueue<CCoinReadCheck> coinsreadqueue(8);
+
+void ThreadCoinsRead(int worker_num) {
+    util::ThreadRename(strprintf("coinsread.%i", worker_num));
+    coinsreadqueue.Thread();
+}
+
+void CCoinsViewDB::GetCoins(const std::vector<COutPoint> &outpoints,
+                            std::vector<Coin> &coins) const {
+    coins.resize(outpoints.size());
+    std::vector<CCoinReadCheck> vChecks;
+    vChecks.reserve(outpoints.size());
+    for (size_t i = 0; i < outpoints.size(); i++) {
+        vChecks.emplace_back(db, outpoints[i], coins[i]);
+    }
+
+    CCheckQueueControl<CCoinReadCheck> control(&coinsreadqueue);
+    control.Add(vChecks);
+    if (control.Wait()) {
+        return;
+    }
+
+    // A read failed: do them again here, so that the error surfaces as an
+    // exception of this thread, as it would with GetCoin.
+    for (size_t i = 0; i < outpoints.size(); i++) {
+        if (!GetCoin(outpoints[i], coins[i])) {
+            coins[i].Clear();
+        }
+    }
+}
+
 BlockHash CCoinsViewDB::GetBestBlock() const {
     BlockHash hashBestChain;
     if (!db.Read(DB_BEST_BLOCK, hashBestChain)) {
@@ -81,7 +151,30 @@ std::vector<BlockHash> CCoinsViewDB::GetHeadBlocks() const {
     return vhashHeadBlocks;
 }
 
+bool CCoinsViewDB::ReadCommitment(BlockHash &hashBlock,
+                                  CCoinsCommitment &commitment) const {
+    std::pair<BlockHash, CCoinsCommitment> value;
+    if (!db.Read(DB_COINS_COMMITMENT, value)) {
+        return false;
+    }
+    hashBlock = value.first;
+    commitment = value.second;
+    return true;
+}
+
+bool CCoinsViewDB::WriteCommitment(const BlockHash &hashBlock,
+                                   const CCoinsCommitment &commitment) {
+    return db.Write(DB_COINS_COMMITMENT, std::make_pair(hashBlock, commitment));
+}
+
 bool CCoinsViewDB::BatchWrite(CCoinsMap &mapCoins, const BlockHash &hashBlock) {
+    bool ret = WriteCoins(mapCoins, hashBlock);
+    mapCoins.clear();
+    return ret;
+}
+
+bool CCoinsViewDB::WriteCoins(const CCoinsMap &mapCoins,
+                              const BlockHash &hashBlock) {
     CDBBatch batch(db);
     size_t count = 0;
     size_t changed = 0;
@@ -107,19 +200,17 @@ bool CCoinsViewDB::BatchWrite(CCoinsMap &mapCoins, const BlockHash &hashBlock) {
     batch.Erase(DB_BEST_BLOCK);
     batch.Write(DB_HEAD_BLOCKS, std::vector<BlockHash>{hashBlock, old_tip});
 
-    for (CCoinsMap::iterator it = mapCoins.begin(); it != mapCoins.end();) {
-        if (it->second.flags & CCoinsCacheEntry::DIRTY) {
-            CoinEntry entry(&it->first);
-            if (it->second.coin.IsSpent()) {
-                batch.Erase(entry);
+    for (const auto &entry : mapCoins) {
+        if (entry.second.flags & CCoinsCacheEntry::DIRTY) {
+            CoinEntry key(&entry.first);
+            if (entry.second.coin.IsSpent()) {
+                batch.Erase(key);
             } else {
-                batch.Write(entry, it->second.coin);
+                batch.Write(key, entry.second.coin);
             }
             changed++;
         }
         count++;
-        CCoinsMap::iterator itOld = it++;
-        mapCoins.erase(itOld);
         if (batch.SizeEstimate() > batch_size) {
             LogPrint(BCLog::COINDB, "Writing partial batch of %.2f MiB\n",
                      batch.SizeEstimate() * (1.0 / 1048576.0));
@@ -153,6 +244,118 @@ size_t CCoinsViewDB::EstimateSize() const {
     return db.EstimateSize(DB_COIN, char(DB_COIN + 1));
 }
 
+CCoinsViewBackgroundWriter::CCoinsViewBackgroundWriter(CCoinsViewDB &dbIn)
+    : CCoinsViewBacked(&dbIn), db(dbIn) {}
+
+CCoinsViewBackgroundWriter::~CCoinsViewBackgroundWriter() {
+    if (writer.joinable()) {
+        writer.join();
+    }
+}
+
+bool CCoinsViewBackgroundWriter::GetCoin(const COutPoint &outpoint,
+                                         Coin &coin) const {
+    CCoinsMap::const_iterator it = pendingCoins.find(outpoint);
+    if (it == pendingCoins.end()) {
+        return base->GetCoin(outpoint, coin);
+    }
+    coin = it->second.coin;
+    return !coin.IsSpent();
+}
+
+bool CCoinsViewBackgroundWriter::HaveCoin(const COutPoint &outpoint) const {
+    CCoinsMap::const_iterator it = pendingCoins.find(outpoint);
+    if (it == pendingCoins.end()) {
+        return base->HaveCoin(outpoint);
+    }
+    return !it->second.coin.IsSpent();
+}
+
+void CCoinsViewBackgroundWriter::GetCoins(
+    const std::vector<COutPoint> &outpoints, std::vector<Coin> &coins) const {
+    if (pendingCoins.empty()) {
+        base->GetCoins(outpoints, coins);
+        return;
+    }
+
+    // Only read the coins which are not part of the snapshot from the
+    // database.
+    coins.resize(outpoints.size());
+    std::vector<COutPoint> missing;
+    std::vector<size_t> missingIndex;
+    for (size_t i = 0; i < outpoints.size(); i++) {
+        CCoinsMap::const_iterator it = pendingCoins.find(outpoints[i]);
+        if (it == pendingCoins.end()) {
+            missing.push_back(outpoints[i]);
+            missingIndex.push_back(i);
+        } else {
+            coins[i] = it->second.coin;
+        }
+    }
+    if (missing.empty()) {
+        return;
+    }
+
+    std::vector<Coin> missingCoins;
+    base->GetCoins(missing, missingCoins);
+    for (size_t i = 0; i < missing.size(); i++) {
+        coins[missingIndex[i]] = std::move(missingCoins[i]);
+    }
+}
+
+BlockHash CCoinsViewBackgroundWriter::GetBestBlock() const {
+    if (!pendingBlock.IsNull()) {
+        return pendingBlock;
+    }
+    return base->GetBestBlock();
+}
+
+bool CCoinsViewBackgroundWriter::BatchWrite(CCoinsMap &mapCoins,
+                                            const BlockHash &hashBlock) {
+    if (!Sync()) {
+        return false;
+    }
+
+    pendingUsage = memusage::DynamicUsage(mapCoins);
+    for (const auto &entry : mapCoins) {
+        pendingUsage += entry.second.coin.DynamicMemoryUsage();
+    }
+    pendingCoins.swap(mapCoins);
+    pendingBlock = hashBlock;
+
+    fWriteDone = false;
+    writer = std::thread(
+        &TraceThread<std::function<void()>>, "coinsflush",
+        std::bind(&CCoinsViewBackgroundWriter::ThreadWrite, this));
+    return true;
+}
+
+void CCoinsViewBackgroundWriter::ThreadWrite() {
+    const int64_t nStart = GetTimeMicros();
+    try {
+        fWriteOk = db.WriteCoins(pendingCoins, pendingBlock);
+    } catch (const std::runtime_error &e) {
+        LogPrintf("Error writing to coin database: %s\n", e.what());
+        fWriteOk = false;
+    }
+    LogPrint(BCLog::COINDB, "Wrote %u coins in the background in %.2fs\n",
+             pendingCoins.size(), (GetTimeMicros() - nStart) * 0.000001);
+    fWriteDone = true;
+}
+
+bool CCoinsViewBackgroundWriter::Sync() {
+    if (writer.joinable()) {
+        writer.join();
+    }
+    if (!fWriteOk) {
+        return false;
+    }
+    pendingCoins.clear();
+    pendingBlock = BlockHash();
+    pendingUsage = 0;
+    return true;
+}
+
 CBlockTreeDB::CBlockTreeDB(size_t nCacheSize, bool fMemory, bool fWipe)
     : CDBWrapper(GetIndexDir(), nCacheSize, fMemory, fWipe) {}
 
@@ -177,6 +380,35 @@ bool CBlockTreeDB::ReadLastBlockFile(int &nFile) {
 }
 
 CCoinsViewCursor *CCoinsViewDB::Cursor() const {
+    return NewCursor(TxId(), nullptr);
+}
+
+std::vector<std::unique_ptr<CCoinsViewCursor>>
+CCoinsViewDB::Cursors(size_t nShards) const {
+    assert(nShards > 0 && nShards <= 0x10000);
+
+    // Split the txids evenly on their first two bytes, which are the first
+    // ones they are ordered by in the database.
+    std::vector<TxId> bounds;
+    for (size_t i = 1; i < nShards; i++) {
+        const uint32_t prefix = i * 0x10000 / nShards;
+        uint256 bound;
+        *bound.begin() = prefix >> 8;
+        *(bound.begin() + 1) = prefix & 0xff;
+        bounds.emplace_back(bound);
+    }
+
+    std::vector<std::unique_ptr<CCoinsViewCursor>> cursors;
+    for (size_t i = 0; i < nShards; i++) {
+        cursors.emplace_back(
+            NewCursor(i > 0 ? bounds[i - 1] : TxId(),
+                      i < bounds.size() ? &bounds[i] : nullptr));
+    }
+    return cursors;
+}
+
+CCoinsViewDBCursor *CCoinsViewDB::NewCursor(const TxId &txidBegin,
+                                            const TxId *ptxidEnd) const {
     CCoinsViewDBCursor *i = new CCoinsViewDBCursor(
         const_cast<CDBWrapper &>(db).NewIterator(), GetBestBlock());
     /**
@@ -184,16 +416,13 @@ CCoinsViewCursor *CCoinsViewDB::Cursor() const {
      * need read operations on it, use a const-cast to get around that
      * restriction.
      */
-    i->pcursor->Seek(DB_COIN);
-    // Cache key of first record
-    if (i->pcursor->Valid()) {
-        CoinEntry entry(&i->keyTmp.second);
-        i->pcursor->GetKey(entry);
-        i->keyTmp.first = entry.key;
-    } else {
-        // Make sure Valid() and GetKey() return false
-        i->keyTmp.first = 0;
+    if (ptxidEnd) {
+        i->fHasEnd = true;
+        i->txidEnd = *ptxidEnd;
     }
+    i->pcursor->Seek(std::make_pair(DB_COIN, txidBegin));
+    // Cache key of first record
+    i->ReadKey();
     return i;
 }
 
@@ -220,8 +449,17 @@ bool CCoinsViewDBCursor::Valid() const {
 
 void CCoinsViewDBCursor::Next() {
     pcursor->Next();
+    ReadKey();
+}
+
+void CCoinsViewDBCursor::ReadKey() {
     CoinEntry entry(&keyTmp.second);
-    if (!pcursor->Valid() || !pcursor->GetKey(entry)) {
+    // Keys are ordered by the bytes of the txid, which is not the order of
+    // uint256::Compare.
+    if (!pcursor->Valid() || !pcursor->GetKey(entry) ||
+        (fHasEnd && entry.key == DB_COIN &&
+         memcmp(keyTmp.second.GetTxId().begin(), txidEnd.begin(),
+                txidEnd.size()) >= 0)) {
         // Invalidate cached key after last record so that Valid() and GetKey()
         // return false
         keyTmp.first = 0;
@@ -12,9 +12,11 @@
 #include <flatfile.h>
 #include <primitives/block.h>
 
+#include <atomic>
 #include <map>
 #include <memory>
 #include <string>
+#include <thread>
 #include <utility>
 #include <vector>
 
@@ -32,6 +34,8 @@ static constexpr int MAX_BLOCK_COINSDB_USAGE = 10;
 static const int64_t nDefaultDbCache = 450;
 //! -dbbatchsize default (bytes)
 static const int64_t nDefaultDbBatchSize = 16 << 20;
+//! -dbbackgroundflush default
+static constexpr bool DEFAULT_DB_BACKGROUND_FLUSH = false;
 //! max. -dbcache (MiB)
 static const int64_t nMaxDbCache = sizeof(void *) > 4 ? 16384 : 1024;
 //! min. -dbcache (MiB)
@@ -43,6 +47,8 @@ static const int64_t nMaxBlockDBCache = 2;
 // a meaningful difference:
 // https://github.com/bitcoin/bitcoin/pull/8273#issuecomment-229601991
 static const int64_t nMaxTxIndexCache = 1024;
+//! Max memory allocated to all block filter index caches combined in MiB.
+static const int64_t max_filter_index_cache = 1024;
 //! Max memory allocated to coin DB specific cache (MiB)
 static const int64_t nMaxCoinsDBCache = 8;
 
@@ -57,15 +63,116 @@ public:
 
     bool GetCoin(const COutPoint &outpoint, Coin &coin) const override;
     bool HaveCoin(const COutPoint &outpoint) const override;
+    //! Reads the coins concurrently on the coins read threads.
+    void GetCoins(const std::vector<COutPoint> &outpoints,
+                  std::vector<Coin> &coins) const override;
     BlockHash GetBestBlock() const override;
     std::vector<BlockHash> GetHeadBlocks() const override;
     bool BatchWrite(CCoinsMap &mapCoins, const BlockHash &hashBlock) override;
     CCoinsViewCursor *Cursor() const override;
 
+    /**
+     * Split the coins between nShards cursors over consecutive ranges of
+     * txids, which can be iterated concurrently. Iterating over all of them in
+     * order is equivalent to iterating over Cursor(). As they are created
+     * together, they see the same state of the database, provided that it is
+     * not written to in the meantime.
+     */
+    std::vector<std::unique_ptr<CCoinsViewCursor>>
+    Cursors(size_t nShards) const;
+
+    /**
+     * Write the dirty coins of mapCoins, as BatchWrite does, but without
+     * modifying mapCoins. Large writes are split in batches of -dbbatchsize
+     * bytes, the database being marked as partially written in between.
+     */
+    bool WriteCoins(const CCoinsMap &mapCoins, const BlockHash &hashBlock);
+
+    /**
+     * Read the commitment to the coins as of hashBlock, which was last stored
+     * with WriteCommitment. It only commits to the coins of the database if
+     * hashBlock is still its best block.
+     */
+    bool ReadCommitment(BlockHash &hashBlock,
+                        CCoinsCommitment &commitment) const;
+    bool WriteCommitment(const BlockHash &hashBlock,
+                         const CCoinsCommitment &commitment);
+
     //! Attempt to update from an older database format.
     //! Returns whether an error occurred.
     bool Upgrade();
     size_t EstimateSize() const override;
+
+private:
+    /**
+     * Create a cursor over the coins from txidBegin, and up to the coins of
+     * *ptxidEnd excluded if it is not null.
+     */
+    CCoinsViewDBCursor *NewCursor(const TxId &txidBegin,
+                                  const TxId *ptxidEnd) const;
+};
+
+/**
+ * Run an instance of the thread reading coins from the coin database on behalf
+ * of CCoinsViewDB::GetCoins.
+ */
+void ThreadCoinsRead(int worker_num);
+
+/**
+ * CCoinsView in front of a CCoinsViewDB, which writes the coins flushed to it
+ * from a background thread.
+ *
+ * BatchWrite takes the coins over and returns immediately, while a dedicated
+ * thread writes them to the database in batches. Until they are written, the
+ * coins are looked up in that snapshot before the database, so the view keeps
+ * reflecting the state of the last flush. The database goes through the same
+ * partially written states as with a synchronous flush, and can be recovered
+ * by ReplayBlocks in the same way after a crash.
+ *
+ * Only one write is in flight at a time: a flush starting while the previous
+ * one is still being written waits for it. Like the other views, this is not
+ * thread safe, and is used under cs_main.
+ */
+class CCoinsViewBackgroundWriter final : public CCoinsViewBacked {
+private:
+    CCoinsViewDB &db;
+
+    //! The coins being written, and the block they are consistent with.
+    CCoinsMap pendingCoins;
+    BlockHash pendingBlock;
+    //! Memory held by pendingCoins.
+    size_t pendingUsage = 0;
+
+    std::thread writer;
+    //! Whether the writer thread is done with pendingCoins.
+    std::atomic<bool> fWriteDone{true};
+    //! Whether the last write succeeded, valid once fWriteDone is set.
+    std::atomic<bool> fWriteOk{true};
+
+    void ThreadWrite();
+
+public:
+    explicit CCoinsViewBackgroundWriter(CCoinsViewDB &dbIn);
+    ~CCoinsViewBackgroundWriter();
+
+    bool GetCoin(const COutPoint &outpoint, Coin &coin) const override;
+    bool HaveCoin(const COutPoint &outpoint) const override;
+    void GetCoins(const std::vector<COutPoint> &outpoints,
+                  std::vector<Coin> &coins) const override;
+    BlockHash GetBestBlock() const override;
+    //! Wait for the previous write, then start writing mapCoins, which is left
+    //! empty.
+    bool BatchWrite(CCoinsMap &mapCoins, const BlockHash &hashBlock) override;
+
+    /**
+     * Wait for the coins being written to reach the database, and release
+     * them. Returns false if the write failed.
+     */
+    bool Sync();
+    //! Whether a write was started and has not completed yet.
+    bool IsWriting() const { return !fWriteDone; }
+    //! Memory held by the coins waiting to be written.
+    size_t DynamicMemoryUsage() const { return pendingUsage; }
 };
 
 /** Specialization of CCoinsViewCursor to iterate over a CCoinsViewDB */
@@ -83,8 +190,14 @@ public:
 private:
     CCoinsViewDBCursor(CDBIterator *pcursorIn, const BlockHash &hashBlockIn)
         : CCoinsViewCursor(hashBlockIn), pcursor(pcursorIn) {}
+    //! Cache the key of the current record, or invalidate it past the end.
+    void ReadKey();
+
     std::unique_ptr<CDBIterator> pcursor;
     std::pair<char, COutPoint> keyTmp;
+    //! Txid of the first coins past the end of the cursor, if any.
+    bool fHasEnd = false;
+    TxId txidEnd;
 
     friend class CCoinsViewDB;
 };
@@ -81,41 +81,47 @@ void CTxMemPoolEntry::UpdateLockPoints(const LockPoints &lp) {
 void CTxMemPool::UpdateForDescendants(txiter updateIt,
                                       cacheMap &cachedDescendants,
                                       const std::set<TxId> &setExclude) {
-    setEntries stageEntries, setAllDescendants;
-    stageEntries = GetMemPoolChildren(updateIt);
+    const EpochGuard epoch(*this);
+    std::vector<txiter> stageEntries, allDescendants;
+    for (const CTxMemPoolEntry *child : updateIt->GetMemPoolChildren()) {
+        visited(*child);
+        stageEntries.push_back(mapTx.iterator_to(*child));
+    }
 
     while (!stageEntries.empty()) {
-        const txiter cit = *stageEntries.begin();
-        setAllDescendants.insert(cit);
-        stageEntries.erase(cit);
-        const setEntries &setChildren = GetMemPoolChildren(cit);
-        for (txiter childEntry : setChildren) {
+        const txiter cit = stageEntries.back();
+        stageEntries.pop_back();
+        allDescendants.push_back(cit);
+        for (const CTxMemPoolEntry *child : cit->GetMemPoolChildren()) {
+            const txiter childEntry = mapTx.iterator_to(*child);
             cacheMap::iterator cacheIt = cachedDescendants.find(childEntry);
             if (cacheIt != cachedDescendants.end()) {
                 // We've already calculated this one, just add the entries for
                 // this set but don't traverse again.
                 for (txiter cacheEntry : cacheIt->second) {
-                    setAllDescendants.insert(cacheEntry);
+                    if (!visited(*cacheEntry)) {
+                        allDescendants.push_back(cacheEntry);
+                    }
                 }
-            } else if (!setAllDescendants.count(childEntry)) {
+            } else if (!visited(*childEntry)) {
                 // Schedule for later processing
-                stageEntries.insert(childEntry);
+                stageEntries.push_back(childEntry);
             }
         }
     }
-    // setAllDescendants now contains all in-mempool descendants of updateIt.
+    // allDescendants now contains all in-mempool descendants of updateIt.
     // Update and add to cached descendant map
     int64_t modifySize = 0;
     int64_t modifyCount = 0;
     Amount modifyFee = Amount::zero();
     int64_t modifySigOpCount = 0;
-    for (txiter cit : setAllDescendants) {
+    for (txiter cit : allDescendants) {
         if (!setExclude.count(cit->GetTx().GetId())) {
             modifySize += cit->GetTxSize();
             modifyFee += cit->GetModifiedFee();
             modifyCount++;
             modifySigOpCount += cit->GetSigOpCount();
-            cachedDescendants[updateIt].insert(cit);
+            cachedDescendants[updateIt].push_back(cit);
             // Update ancestor state for each descendant
             mapTx.modify(cit,
                          update_ancestor_state(updateIt->GetTxSize(),
@@ -186,7 +192,8 @@ bool CTxMemPool::CalculateMemPoolAncestors(
     uint64_t limitAncestorCount, uint64_t limitAncestorSize,
     uint64_t limitDescendantCount, uint64_t limitDescendantSize,
     std::string &errString, bool fSearchForParents /* = true */) const {
-    setEntries parentHashes;
+    const EpochGuard epoch(*this);
+    std::vector<txiter> parentHashes;
     const CTransaction &tx = entry.GetTx();
 
     if (fSearchForParents) {
@@ -195,10 +202,10 @@ bool CTxMemPool::CalculateMemPoolAncestors(
         // iterate mapTx to find parents.
         for (const CTxIn &in : tx.vin) {
             boost::optional<txiter> piter = GetIter(in.prevout.GetTxId());
-            if (!piter) {
+            if (!piter || visited(**piter)) {
                 continue;
             }
-            parentHashes.insert(*piter);
+            parentHashes.push_back(*piter);
             if (parentHashes.size() + 1 > limitAncestorCount) {
                 errString =
                     strprintf("too many unconfirmed parents [limit: %u]",
@@ -209,17 +216,19 @@ bool CTxMemPool::CalculateMemPoolAncestors(
     } else {
         // If we're not searching for parents, we require this to be an entry in
         // the mempool already.
-        txiter it = mapTx.iterator_to(entry);
-        parentHashes = GetMemPoolParents(it);
+        for (const CTxMemPoolEntry *parent : entry.GetMemPoolParents()) {
+            visited(*parent);
+            parentHashes.push_back(mapTx.iterator_to(*parent));
+        }
     }
 
     size_t totalSizeWithAncestors = entry.GetTxSize();
 
     while (!parentHashes.empty()) {
-        txiter stageit = *parentHashes.begin();
+        txiter stageit = parentHashes.back();
 
         setAncestors.insert(stageit);
-        parentHashes.erase(stageit);
+        parentHashes.pop_back();
         totalSizeWithAncestors += stageit->GetTxSize();
 
         if (stageit->GetSizeWithDescendants() + entry.GetTxSize() >
@@ -243,11 +252,10 @@ bool CTxMemPool::CalculateMemPoolAncestors(
             return false;
         }
 
-        const setEntries &setMemPoolParents = GetMemPoolParents(stageit);
-        for (txiter phash : setMemPoolParents) {
+        for (const CTxMemPoolEntry *parent : stageit->GetMemPoolParents()) {
             // If this is a new ancestor, add it.
-            if (setAncestors.count(phash) == 0) {
-                parentHashes.insert(phash);
+            if (!visited(*parent)) {
+                parentHashes.push_back(mapTx.iterator_to(*parent));
             }
             if (parentHashes.size() + setAncestors.size() + 1 >
                 limitAncestorCount) {
@@ -264,10 +272,9 @@ bool CTxMemPool::CalculateMemPoolAncestors(
 
 void CTxMemPool::UpdateAncestorsOf(bool add, txiter it,
                                    setEntries &setAncestors) {
-    setEntries parentIters = GetMemPoolParents(it);
     // add or remove this tx as a child of each parent
-    for (txiter piter : parentIters) {
-        UpdateChild(piter, it, add);
+    for (const CTxMemPoolEntry *parent : it->GetMemPoolParents()) {
+        UpdateChild(mapTx.iterator_to(*parent), it, add);
     }
     const int64_t updateCount = (add ? 1 : -1);
     const int64_t updateSize = updateCount * it->GetTxSize();
@@ -297,9 +304,8 @@ void CTxMemPool::UpdateEntryForAncestors(txiter it,
 }
 
 void CTxMemPool::UpdateChildrenForRemoval(txiter it) {
-    const setEntries &setMemPoolChildren = GetMemPoolChildren(it);
-    for (txiter updateIt : setMemPoolChildren) {
-        UpdateParent(updateIt, it, false);
+    for (const CTxMemPoolEntry *child : it->GetMemPoolChildren()) {
+        UpdateParent(mapTx.iterator_to(*child), it, false);
     }
 }
 
@@ -311,8 +317,8 @@ void CTxMemPool::UpdateForRemoveFromMempool(const setEntries &entriesToRemove,
     if (updateDescendants) {
         // updateDescendants should be true whenever we're not recursively
         // removing a tx and all its descendants, eg when a transaction is
-        // confirmed in a block. Here we only update statistics and not data in
-        // mapLinks (which we need to preserve until we're finished with all
+        // confirmed in a block. Here we only update statistics and not the
+        // links between entries (which we need to preserve until we're finished with all
         // operations that need to traverse the mempool).
         for (txiter removeIt : entriesToRemove) {
             setEntries setDescendants;
@@ -338,16 +344,16 @@ void CTxMemPool::UpdateForRemoveFromMempool(const setEntries &entriesToRemove,
         // should be a bit faster.
         // However, if we happen to be in the middle of processing a reorg, then
         // the mempool can be in an inconsistent state. In this case, the set of
-        // ancestors reachable via mapLinks will be the same as the set of
+        // ancestors reachable via the entry links will be the same as the set of
         // ancestors whose packages include this transaction, because when we
         // add a new transaction to the mempool in addUnchecked(), we assume it
         // has no children, and in the case of a reorg where that assumption is
         // false, the in-mempool children aren't linked to the in-block tx's
         // until UpdateTransactionsFromBlock() is called. So if we're being
         // called during a reorg, ie before UpdateTransactionsFromBlock() has
-        // been called, then mapLinks[] will differ from the set of mempool
-        // parents we'd calculate by searching, and it's important that we use
-        // the mapLinks[] notion of ancestor transactions as the set of things
+        // been called, then the linked parents will differ from the set of
+        // mempool parents we'd calculate by searching, and it's important that
+        // we use the linked notion of ancestor transactions as the set of things
         // to update for removal.
         CalculateMemPoolAncestors(entry, setAncestors, nNoLimit, nNoLimit,
                                   nNoLimit, nNoLimit, dummy, false);
@@ -423,7 +429,6 @@ void CTxMemPool::addUnchecked(const CTxMemPoolEntry &entry,
     // Add to memory pool without checking anything.
     // Used by AcceptToMemoryPool(), which DOES do all the appropriate checks.
     indexed_transaction_set::iterator newit = mapTx.insert(entry).first;
-    mapLinks.insert(make_pair(newit, TxLinks()));
 
     // Update transaction for any feeDelta created by PrioritiseTransaction
     // TODO: refactor so that the fee delta is calculated before inserting into
@@ -485,9 +490,8 @@ void CTxMemPool::removeUnchecked(txiter it, MemPoolRemovalReason reason) {
 
     totalTxSize -= it->GetTxSize();
     cachedInnerUsage -= it->DynamicMemoryUsage();
-    cachedInnerUsage -= memusage::DynamicUsage(mapLinks[it].parents) +
-                        memusage::DynamicUsage(mapLinks[it].children);
-    mapLinks.erase(it);
+    cachedInnerUsage -= memusage::DynamicUsage(it->m_parents) +
+                        memusage::DynamicUsage(it->m_children);
     mapTx.erase(it);
     nTransactionsUpdated++;
 }
@@ -500,22 +504,21 @@ void CTxMemPool::removeUnchecked(txiter it, MemPoolRemovalReason reason) {
 // iterating over those entries.
 void CTxMemPool::CalculateDescendants(txiter entryit,
                                       setEntries &setDescendants) const {
-    setEntries stage;
-    if (setDescendants.count(entryit) == 0) {
-        stage.insert(entryit);
+    std::vector<txiter> stage;
+    if (setDescendants.insert(entryit).second) {
+        stage.push_back(entryit);
     }
     // Traverse down the children of entry, only adding children that are not
     // accounted for in setDescendants already (because those children have
     // either already been walked, or will be walked in this iteration).
     while (!stage.empty()) {
-        txiter it = *stage.begin();
-        setDescendants.insert(it);
-        stage.erase(it);
-
-        const setEntries &setChildren = GetMemPoolChildren(it);
-        for (txiter childiter : setChildren) {
-            if (!setDescendants.count(childiter)) {
-                stage.insert(childiter);
+        txiter it = stage.back();
+        stage.pop_back();
+
+        for (const CTxMemPoolEntry *child : it->GetMemPoolChildren()) {
+            txiter childiter = mapTx.iterator_to(*child);
+            if (setDescendants.insert(childiter).second) {
+                stage.push_back(childiter);
             }
         }
     }
@@ -638,7 +641,6 @@ void CTxMemPool::removeForBlock(const std::vector<CTransactionRef> &vtx,
 }
 
 void CTxMemPool::_clear() {
-    mapLinks.clear();
     mapTx.clear();
     mapNextTx.clear();
     vTxHashes.clear();
@@ -694,11 +696,8 @@ void CTxMemPool::check(const CCoinsViewCache *pcoins) const {
         checkTotal += it->GetTxSize();
         innerUsage += it->DynamicMemoryUsage();
         const CTransaction &tx = it->GetTx();
-        txlinksMap::const_iterator linksiter = mapLinks.find(it);
-        assert(linksiter != mapLinks.end());
-        const TxLinks &links = linksiter->second;
-        innerUsage += memusage::DynamicUsage(links.parents) +
-                      memusage::DynamicUsage(links.children);
+        innerUsage += memusage::DynamicUsage(it->GetMemPoolParents()) +
+                      memusage::DynamicUsage(it->GetMemPoolChildren());
         bool fDependsWait = false;
         setEntries setParentCheck;
         for (const CTxIn &txin : tx.vin) {
@@ -722,7 +721,10 @@ void CTxMemPool::check(const CCoinsViewCache *pcoins) const {
             assert(it3->second == &tx);
             i++;
         }
-        assert(setParentCheck == GetMemPoolParents(it));
+        assert(setParentCheck.size() == it->GetMemPoolParents().size());
+        for (const CTxMemPoolEntry *parent : it->GetMemPoolParents()) {
+            assert(setParentCheck.count(mapTx.iterator_to(*parent)));
+        }
         // Verify ancestor state is correct.
         setEntries setAncestors;
         uint64_t nNoLimit = std::numeric_limits<uint64_t>::max();
@@ -761,7 +763,10 @@ void CTxMemPool::check(const CCoinsViewCache *pcoins) const {
                 child_sigop_counts += childit->GetSigOpCount();
             }
         }
-        assert(setChildrenCheck == GetMemPoolChildren(it));
+        assert(setChildrenCheck.size() == it->GetMemPoolChildren().size());
+        for (const CTxMemPoolEntry *child : it->GetMemPoolChildren()) {
+            assert(setChildrenCheck.count(mapTx.iterator_to(*child)));
+        }
         // Also check to make sure size is greater than sum with immediate
         // children. Just a sanity check, not definitive that this calc is
         // correct...
@@ -1031,7 +1036,6 @@ size_t CTxMemPool::DynamicMemoryUsage() const {
                mapTx.size() +
            memusage::DynamicUsage(mapNextTx) +
            memusage::DynamicUsage(mapDeltas) +
-           memusage::DynamicUsage(mapLinks) +
            memusage::DynamicUsage(vTxHashes) + cachedInnerUsage;
 }
 
@@ -1086,38 +1090,55 @@ void CTxMemPool::addUnchecked(const CTxMemPoolEntry &entry) {
     return addUnchecked(entry, setAncestors);
 }
 
-void CTxMemPool::UpdateChild(txiter entry, txiter child, bool add) {
-    setEntries s;
-    if (add && mapLinks[entry].children.insert(child).second) {
-        cachedInnerUsage += memusage::IncrementalDynamicUsage(s);
-    } else if (!add && mapLinks[entry].children.erase(child)) {
-        cachedInnerUsage -= memusage::IncrementalDynamicUsage(s);
+// Add or remove an entry from the links of another one, keeping
+// cachedInnerUsage in line with the memory the links allocate.
+static void UpdateLinks(CTxMemPoolEntry::Links &links,
+                        const CTxMemPoolEntry &entry, bool add,
+                        uint64_t &cachedInnerUsage) {
+    auto it = std::find(links.begin(), links.end(), &entry);
+    if (add == (it != links.end())) {
+        return;
     }
+    cachedInnerUsage -= memusage::DynamicUsage(links);
+    if (add) {
+        links.push_back(&entry);
+    } else {
+        links.erase(it);
+    }
+    cachedInnerUsage += memusage::DynamicUsage(links);
+}
+
+void CTxMemPool::UpdateChild(txiter entry, txiter child, bool add) {
+    UpdateLinks(entry->m_children, *child, add, cachedInnerUsage);
 }
 
 void CTxMemPool::UpdateParent(txiter entry, txiter parent, bool add) {
-    setEntries s;
-    if (add && mapLinks[entry].parents.insert(parent).second) {
-        cachedInnerUsage += memusage::IncrementalDynamicUsage(s);
-    } else if (!add && mapLinks[entry].parents.erase(parent)) {
-        cachedInnerUsage -= memusage::IncrementalDynamicUsage(s);
-    }
+    UpdateLinks(entry->m_parents, *parent, add, cachedInnerUsage);
 }
 
-const CTxMemPool::setEntries &
+const CTxMemPoolEntry::Links &
 CTxMemPool::GetMemPoolParents(txiter entry) const {
     assert(entry != mapTx.end());
-    txlinksMap::const_iterator it = mapLinks.find(entry);
-    assert(it != mapLinks.end());
-    return it->second.parents;
+    return entry->GetMemPoolParents();
 }
 
-const CTxMemPool::setEntries &
+const CTxMemPoolEntry::Links &
 CTxMemPool::GetMemPoolChildren(txiter entry) const {
     assert(entry != mapTx.end());
-    txlinksMap::const_iterator it = mapLinks.find(entry);
-    assert(it != mapLinks.end());
-    return it->second.children;
+    return entry->GetMemPoolChildren();
+}
+
+CTxMemPool::EpochGuard::EpochGuard(const CTxMemPool &in) : pool(in) {
+    assert(!pool.m_has_epoch_guard);
+    ++pool.m_epoch;
+    pool.m_has_epoch_guard = true;
+}
+
+CTxMemPool::EpochGuard::~EpochGuard() {
+    // Entries reached during the walk are marked with the old epoch, which
+    // the next walk must not confuse with its own.
+    ++pool.m_epoch;
+    pool.m_has_epoch_guard = false;
 }
 
 CFeeRate CTxMemPool::GetMinFee(size_t sizelimit) const {
@@ -1200,22 +1221,22 @@ void CTxMemPool::TrimToSize(size_t sizelimit,
 
 uint64_t CTxMemPool::CalculateDescendantMaximum(txiter entry) const {
     // find parent with highest descendant count
+    const EpochGuard epoch(*this);
     std::vector<txiter> candidates;
-    setEntries counted;
     candidates.push_back(entry);
     uint64_t maximum = 0;
     while (candidates.size()) {
         txiter candidate = candidates.back();
         candidates.pop_back();
-        if (!counted.insert(candidate).second) {
+        if (visited(*candidate)) {
             continue;
         }
-        const setEntries &parents = GetMemPoolParents(candidate);
+        const CTxMemPoolEntry::Links &parents = candidate->GetMemPoolParents();
         if (parents.size() == 0) {
             maximum = std::max(maximum, candidate->GetCountWithDescendants());
         } else {
-            for (txiter i : parents) {
-                candidates.push_back(i);
+            for (const CTxMemPoolEntry *parent : parents) {
+                candidates.push_back(mapTx.iterator_to(*parent));
             }
         }
     }
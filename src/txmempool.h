@@ -12,6 +12,7 @@
 #include <core_memusage.h>
 #include <crypto/siphash.h>
 #include <indirectmap.h>
+#include <prevector.h>
 #include <primitives/transaction.h>
 #include <random.h>
 #include <sync.h>
@@ -22,6 +23,7 @@
 #include <boost/multi_index_container.hpp>
 #include <boost/signals2/signal.hpp>
 
+#include <cassert>
 #include <map>
 #include <set>
 #include <string>
@@ -113,6 +115,21 @@ private:
     Amount nModFeesWithAncestors;
     int64_t nSigOpCountWithAncestors;
 
+public:
+    //! In-mempool direct parents or children of a transaction. Most
+    //! transactions have very few of them, so they are kept inline.
+    using Links = prevector<2, const CTxMemPoolEntry *>;
+
+private:
+    friend class CTxMemPool;
+
+    // The links of the transaction in the mempool graph are maintained by the
+    // mempool, which stores entries as immutable elements of mapTx.
+    mutable Links m_parents;
+    mutable Links m_children;
+    //! Last epoch in which a mempool traversal reached this entry
+    mutable uint64_t m_epoch = 0;
+
 public:
     CTxMemPoolEntry(const CTransactionRef &_tx, const Amount _nFee,
                     int64_t _nTime, unsigned int _entryHeight,
@@ -161,6 +178,9 @@ public:
         return nSigOpCountWithAncestors;
     }
 
+    const Links &GetMemPoolParents() const { return m_parents; }
+    const Links &GetMemPoolChildren() const { return m_children; }
+
     //! Index in mempool's vTxHashes
     mutable size_t vTxHashesIdx = 0;
 };
@@ -429,8 +449,8 @@ public:
  *
  * In order for the feerate sort to remain correct, we must update transactions
  * in the mempool when new descendants arrive. To facilitate this, we track the
- * set of in-mempool direct parents and direct children in mapLinks. Within each
- * CTxMemPoolEntry, we track the size and fees of all descendants.
+ * set of in-mempool direct parents and direct children in each CTxMemPoolEntry,
+ * along with the size and fees of all descendants.
  *
  * Usually when a new transaction is added to the mempool, it has no in-mempool
  * children (because any such children would be an orphan). So in
@@ -462,7 +482,7 @@ public:
  * state, to account for in-mempool, out-of-block descendants for all the
  * in-block transactions by calling UpdateTransactionsFromBlock(). Note that
  * until this is called, the mempool state is not consistent, and in particular
- * mapLinks may not be correct (and therefore functions like
+ * the links between entries may not be correct (and therefore functions like
  * CalculateMemPoolAncestors() and CalculateDescendants() that rely on them to
  * walk the mempool are not generally safe to use).
  *
@@ -573,26 +593,50 @@ public:
     };
     typedef std::set<txiter, CompareIteratorById> setEntries;
 
-    const setEntries &GetMemPoolParents(txiter entry) const
+    const CTxMemPoolEntry::Links &GetMemPoolParents(txiter entry) const
         EXCLUSIVE_LOCKS_REQUIRED(cs);
-    const setEntries &GetMemPoolChildren(txiter entry) const
+    const CTxMemPoolEntry::Links &GetMemPoolChildren(txiter entry) const
         EXCLUSIVE_LOCKS_REQUIRED(cs);
     uint64_t CalculateDescendantMaximum(txiter entry) const
         EXCLUSIVE_LOCKS_REQUIRED(cs);
 
 private:
-    typedef std::map<txiter, setEntries, CompareIteratorById> cacheMap;
+    typedef std::map<txiter, std::vector<txiter>, CompareIteratorById>
+        cacheMap;
+
+    void UpdateParent(txiter entry, txiter parent, bool add);
+    void UpdateChild(txiter entry, txiter child, bool add);
 
-    struct TxLinks {
-        setEntries parents;
-        setEntries children;
+    /**
+     * Walks of the mempool graph mark the entries they reach with the current
+     * epoch instead of collecting them in a set. An EpochGuard starts a new
+     * epoch for the duration of a walk; walks may not be nested.
+     */
+    class EpochGuard {
+        const CTxMemPool &pool;
+
+    public:
+        explicit EpochGuard(const CTxMemPool &in);
+        ~EpochGuard();
     };
 
-    typedef std::map<txiter, TxLinks, CompareIteratorById> txlinksMap;
-    txlinksMap mapLinks;
+    //! Current epoch, protected by cs
+    mutable uint64_t m_epoch = 0;
+    mutable bool m_has_epoch_guard = false;
 
-    void UpdateParent(txiter entry, txiter parent, bool add);
-    void UpdateChild(txiter entry, txiter child, bool add);
+    /**
+     * Mark an entry as reached by the current walk. Returns whether it had
+     * already been reached.
+     */
+    bool visited(const CTxMemPoolEntry &entry) const
+        EXCLUSIVE_LOCKS_REQUIRED(cs) {
+        assert(m_has_epoch_guard);
+        if (entry.m_epoch >= m_epoch) {
+            return true;
+        }
+        entry.m_epoch = m_epoch;
+        return false;
+    }
 
     std::vector<indexed_transaction_set::const_iterator>
     GetSortedDepthAndScore() const EXCLUSIVE_LOCKS_REQUIRED(cs);
@@ -711,7 +755,7 @@ public:
      *  limitDescendantSize = max size of descendants any ancestor can have
      *  errString = populated with error reason if any limits are hit
      * fSearchForParents = whether to search a tx's vin for in-mempool parents,
-     * or look up parents from mapLinks. Must be true for entries not in the
+     * or look up the parents linked to the entry. Must be true for entries not in the
      * mempool
      */
     bool CalculateMemPoolAncestors(
@@ -680,6 +680,42 @@ public:
         return s;
     }
 
+    /**
+     * Appends the compact JSON string representation of the provided value to str.
+     *
+     * The type of value can be the generic UniValue,
+     * or a more specific type: bool, std::string, UniValue::Array, or UniValue::Object.
+     *
+     * This is a Bitcoin Static extension of the UniValue API.
+     */
+    template<typename Value>
+    static void stringifyAppend(std::string& str, const Value& value) {
+        Stream ss{str};
+        stringify(ss, value, 0, 0);
+    }
+
+    /**
+     * Appends the JSON escaped form of the provided string to str, without the enclosing quotes.
+     * Characters are escaped one by one, so a long string may be escaped piece by piece.
+     *
+     * This is a Bitcoin Static extension of the UniValue API.
+     */
+    static void jsonEscapeAppend(std::string& str, const std::string& inString) {
+        Stream ss{str};
+        jsonEscape(ss, inString);
+    }
+
+    /**
+     * Returns a value holding JSON text that was already serialized, such as by a streaming writer.
+     * stringify() writes the text out as is, without parsing nor indenting it.
+     *
+     * Like numbers, the text is stored as a string, so the value reports the VNUM type.
+     * Only use it for values that are serialized and not inspected.
+     *
+     * This is a Bitcoin Static extension of the UniValue API.
+     */
+    static UniValue fromSerializedJSON(std::string&& json) noexcept { return UniValue(VNUM, std::move(json)); }
+
     bool read(const char *raw, size_t len);
     bool read(const char *raw) { return read(raw, strlen(raw)); }
     bool read(const std::string& rawStr) { return read(rawStr.data(), rawStr.size()); }
@@ -0,0 +1,165 @@
+// Copyright (c) 2020 The Bitcoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_UTIL_JSONWRITER_H
+#define BITCOIN_UTIL_JSONWRITER_H
+
+#include <univalue.h>
+
+#include <functional>
+#include <string>
+#include <type_traits>
+
+/**
+ * Writes compact JSON text as it goes, without building a tree of UniValue
+ * objects first. The text is the same as UniValue::stringify() would give for
+ * the equivalent tree.
+ *
+ * The caller is responsible for the structure: every value in an object must
+ * follow a Key(), and every Begin must be matched by the corresponding End.
+ */
+class JSONWriter {
+public:
+    //! Takes the text written so far, which is then cleared
+    typedef std::function<void(std::string &)> FlushFn;
+
+    explicit JSONWriter(std::string &outIn) : out(outIn) {}
+
+    /**
+     * Hand the text over to flush whenever it reaches nFlushSizeIn, at the
+     * end of a value. Values given as UniValue are then written element by
+     * element, and long strings piece by piece, so that the text held at any
+     * time stays about that size.
+     */
+    JSONWriter(std::string &outIn, FlushFn flushIn, size_t nFlushSizeIn)
+        : out(outIn), flush(std::move(flushIn)), nFlushSize(nFlushSizeIn) {}
+
+    void BeginObject() {
+        Separate();
+        out.push_back('{');
+        fNeedComma = false;
+    }
+    void EndObject() {
+        out.push_back('}');
+        fNeedComma = true;
+        MaybeFlush();
+    }
+    void BeginArray() {
+        Separate();
+        out.push_back('[');
+        fNeedComma = false;
+    }
+    void EndArray() {
+        out.push_back(']');
+        fNeedComma = true;
+        MaybeFlush();
+    }
+
+    //! Write the key of the next value of the current object
+    void Key(const std::string &key) {
+        Separate();
+        UniValue::stringifyAppend(out, key);
+        out.push_back(':');
+        fNeedComma = false;
+    }
+
+    void Value(const std::string &str) {
+        Separate();
+        if (!flush || str.size() <= nFlushSize) {
+            UniValue::stringifyAppend(out, str);
+            MaybeFlush();
+            return;
+        }
+        out.push_back('"');
+        for (size_t pos = 0; pos < str.size(); pos += nFlushSize) {
+            UniValue::jsonEscapeAppend(out, str.substr(pos, nFlushSize));
+            MaybeFlush();
+        }
+        out.push_back('"');
+    }
+    void Value(const char *str) { Value(std::string(str)); }
+    void Value(const UniValue &value) {
+        if (!flush) {
+            Separate();
+            UniValue::stringifyAppend(out, value);
+            return;
+        }
+        switch (value.getType()) {
+            case UniValue::VOBJ:
+                Value(value.get_obj());
+                break;
+            case UniValue::VARR:
+                BeginArray();
+                for (const UniValue &element : value.get_array()) {
+                    Value(element);
+                }
+                EndArray();
+                break;
+            case UniValue::VSTR:
+                Value(value.getValStr());
+                break;
+            case UniValue::VNUM: {
+                // May be long text from UniValue::fromSerializedJSON()
+                Separate();
+                const std::string &text = value.getValStr();
+                for (size_t pos = 0; pos < text.size(); pos += nFlushSize) {
+                    out.append(text, pos, nFlushSize);
+                    MaybeFlush();
+                }
+                break;
+            }
+            default:
+                Separate();
+                UniValue::stringifyAppend(out, value);
+                break;
+        }
+    }
+    void Value(const UniValue::Object &object) {
+        if (!flush) {
+            Separate();
+            UniValue::stringifyAppend(out, object);
+            return;
+        }
+        BeginObject();
+        for (const auto &entry : object) {
+            Key(entry.first);
+            Value(entry.second);
+        }
+        EndObject();
+    }
+    template <typename Number,
+              typename = std::enable_if_t<std::is_arithmetic<Number>::value>>
+    void Value(Number n) {
+        Value(UniValue(n));
+    }
+
+    template <typename T> void KeyValue(const std::string &key, const T &value) {
+        Key(key);
+        Value(value);
+    }
+
+private:
+    std::string &out;
+    FlushFn flush;
+    size_t nFlushSize = 0;
+    //! Whether a value was written at the current level, and the next one
+    //! must be preceded by a comma
+    bool fNeedComma = false;
+
+    void Separate() {
+        if (fNeedComma) {
+            out.push_back(',');
+        }
+        fNeedComma = true;
+    }
+
+    void MaybeFlush() {
+        if (flush && out.size() >= nFlushSize) {
+            flush(out);
+            out.clear();
+        }
+    }
+};
+
+#endif // BITCOIN_UTIL_JSONWRITER_H
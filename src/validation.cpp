@@ -19,6 +19,7 @@
 #include <consensus/tx_check.h>
 #include <consensus/tx_verify.h>
 #include <consensus/validation.h>
+#include <crypto/common.h>
 #include <flatfile.h>
 #include <fs.h>
 #include <hash.h>
@@ -29,6 +30,7 @@
 #include <pow.h>
 #include <primitives/block.h>
 #include <primitives/transaction.h>
+#include <pubkey.h>
 #include <random.h>
 #include <reverse_iterator.h>
 #include <script/script.h>
@@ -36,6 +38,7 @@
 #include <script/sigcache.h>
 #include <script/standard.h>
 #include <shutdown.h>
+#include <streams.h>
 #include <timedata.h>
 #include <tinyformat.h>
 #include <txdb.h>
@@ -147,6 +150,23 @@ public:
     bool AcceptBlockHeader(const Config &config, const CBlockHeader &block,
                            CValidationState &state, CBlockIndex **ppindex)
         EXCLUSIVE_LOCKS_REQUIRED(cs_main);
+    /**
+     * AcceptBlockHeader for a header whose hash is already known and, if
+     * fCheckedPoW is set, whose proof of work was already checked, as done by
+     * ProcessNewBlockHeaders for a whole batch. Does not run CheckBlockIndex.
+     */
+    bool AcceptBlockHeader(const Config &config, const CBlockHeader &block,
+                           const BlockHash &hash, bool fCheckedPoW,
+                           int64_t nAdjustedTime, CValidationState &state,
+                           CBlockIndex **ppindex)
+        EXCLUSIVE_LOCKS_REQUIRED(cs_main);
+    /**
+     * Make various assertions about the state of the block index.
+     *
+     * By default this only executes fully when using the Regtest chain; see:
+     * fCheckBlockIndex.
+     */
+    void CheckBlockIndex(const Consensus::Params &consensusParams);
     bool AcceptBlock(const Config &config,
                      const std::shared_ptr<const CBlock> &pblock,
                      CValidationState &state, bool fRequested,
@@ -208,17 +228,12 @@ private:
 
     CBlockIndex *AddToBlockIndex(const CBlockHeader &block)
         EXCLUSIVE_LOCKS_REQUIRED(cs_main);
+    CBlockIndex *AddToBlockIndex(const CBlockHeader &block,
+                                 const BlockHash &hash)
+        EXCLUSIVE_LOCKS_REQUIRED(cs_main);
     /** Create a new block index entry for a given block hash */
     CBlockIndex *InsertBlockIndex(const BlockHash &hash)
         EXCLUSIVE_LOCKS_REQUIRED(cs_main);
-    /**
-     * Make various assertions about the state of the block index.
-     *
-     * By default this only executes fully when using the Regtest chain; see:
-     * fCheckBlockIndex.
-     */
-    void CheckBlockIndex(const Consensus::Params &consensusParams);
-
     void InvalidBlockFound(CBlockIndex *pindex, const CValidationState &state)
         EXCLUSIVE_LOCKS_REQUIRED(cs_main);
     CBlockIndex *FindMostWorkChain() EXCLUSIVE_LOCKS_REQUIRED(cs_main);
@@ -255,6 +270,9 @@ Mutex g_best_block_mutex;
 std::condition_variable g_best_block_cv;
 uint256 g_best_block;
 int nScriptCheckThreads = 0;
+bool fParallelInputChecks = DEFAULT_PARALLEL_INPUT_CHECKS;
+bool fBatchSchnorrChecks = DEFAULT_BATCH_SCHNORR_CHECKS;
+int nPrefetchThreads = DEFAULT_PREFETCH_THREADS;
 std::atomic_bool fImporting(false);
 std::atomic_bool fReindex(false);
 bool fHavePruned = false;
@@ -339,7 +357,9 @@ CBlockIndex *FindForkInGlobalIndex(const CChain &chain,
 }
 
 std::unique_ptr<CCoinsViewDB> pcoinsdbview;
+std::unique_ptr<CCoinsViewBackgroundWriter> pcoinswriter;
 std::unique_ptr<CCoinsViewCache> pcoinsTip;
+std::unique_ptr<CCoinsCommitment> pcoinscommitment;
 std::unique_ptr<CBlockTreeDB> pblocktree;
 
 enum class FlushStateMode { NONE, IF_NEEDED, PERIODIC, ALWAYS };
@@ -353,6 +373,8 @@ static void FindFilesToPruneManual(std::set<int> &setFilesToPrune,
 static void FindFilesToPrune(std::set<int> &setFilesToPrune,
                              uint64_t nPruneAfterHeight);
 static FILE *OpenUndoFile(const FlatFilePos &pos, bool fReadOnly = false);
+static Span<const uint8_t> MapUndoFile(const FlatFilePos &pos,
+                                       std::shared_ptr<const MappedFile> &file);
 static FlatFileSeq BlockFileSeq();
 static FlatFileSeq UndoFileSeq();
 static uint32_t GetNextBlockScriptFlags(const Consensus::Params &params,
@@ -568,12 +590,24 @@ AcceptToMemoryPoolWorker(const Config &config, CTxMemPool &pool,
         CCoinsViewMemPool viewMemPool(pcoinsTip.get(), pool);
         view.SetBackend(viewMemPool);
 
-        // Do all inputs exist?
+        // Remember which inputs were not cached, so that they get uncached if
+        // the transaction is rejected, and load those which are not spending
+        // the mempool at once.
+        std::vector<COutPoint> outpoints;
         for (const CTxIn &txin : tx.vin) {
             if (!pcoinsTip->HaveCoinInCache(txin.prevout)) {
                 coins_to_uncache.push_back(txin.prevout);
+                if (!pool.exists(txin.prevout.GetTxId())) {
+                    outpoints.push_back(txin.prevout);
+                }
             }
+        }
+        if (nPrefetchThreads > 0 && outpoints.size() > 1) {
+            pcoinsTip->PrefetchCoins(outpoints);
+        }
 
+        // Do all inputs exist?
+        for (const CTxIn &txin : tx.vin) {
             if (!view.HaveCoin(txin.prevout)) {
                 // Are inputs missing because we already have the tx?
                 for (size_t out = 0; out < tx.vout.size(); out++) {
@@ -888,19 +922,31 @@ bool ReadBlockFromDisk(CBlock &block, const FlatFilePos &pos,
                        const Consensus::Params &params) {
     block.SetNull();
 
-    // Open history file to read
-    CAutoFile filein(OpenBlockFile(pos, true), SER_DISK, CLIENT_VERSION);
-    if (filein.IsNull()) {
-        return error("ReadBlockFromDisk: OpenBlockFile failed for %s",
-                     pos.ToString());
-    }
+    std::shared_ptr<const MappedFile> mapping;
+    const Span<const uint8_t> data = MapBlockFile(pos, mapping);
+    if (!data.empty()) {
+        // Deserialize in place from the mapped file
+        try {
+            SpanReader(SER_DISK, CLIENT_VERSION, data) >> block;
+        } catch (const std::exception &e) {
+            return error("%s: Deserialize error - %s at %s", __func__,
+                         e.what(), pos.ToString());
+        }
+    } else {
+        // Open history file to read
+        CAutoFile filein(OpenBlockFile(pos, true), SER_DISK, CLIENT_VERSION);
+        if (filein.IsNull()) {
+            return error("ReadBlockFromDisk: OpenBlockFile failed for %s",
+                         pos.ToString());
+        }
 
-    // Read block
-    try {
-        filein >> block;
-    } catch (const std::exception &e) {
-        return error("%s: Deserialize or I/O error - %s at %s", __func__,
-                     e.what(), pos.ToString());
+        // Read block
+        try {
+            filein >> block;
+        } catch (const std::exception &e) {
+            return error("%s: Deserialize or I/O error - %s at %s", __func__,
+                         e.what(), pos.ToString());
+        }
     }
 
     // Check the header
@@ -933,6 +979,98 @@ bool ReadBlockFromDisk(CBlock &block, const CBlockIndex *pindex,
     return true;
 }
 
+bool ReadRawBlockFromDisk(std::vector<uint8_t> &block, const FlatFilePos &pos,
+                          const CMessageHeader::MessageMagic &messageStart) {
+    block.clear();
+
+    // The index header written by WriteBlockToDisk precedes the block
+    if (pos.nPos < CMessageHeader::MESSAGE_START_SIZE + sizeof(uint32_t)) {
+        return error("ReadRawBlockFromDisk: No index header for %s",
+                     pos.ToString());
+    }
+    FlatFilePos hpos = pos;
+    hpos.nPos -= CMessageHeader::MESSAGE_START_SIZE + sizeof(uint32_t);
+
+    std::shared_ptr<const MappedFile> mapping = BlockFileSeq().Map(
+        hpos, CMessageHeader::MESSAGE_START_SIZE + sizeof(uint32_t));
+    if (mapping) {
+        // Copy straight from the mapped file, anything unexpected is reported
+        // by reading the file below
+        const Span<const uint8_t> file = mapping->Data();
+        const uint32_t blk_size =
+            ReadLE32(file.data() + pos.nPos - sizeof(uint32_t));
+        if (std::equal(messageStart.begin(), messageStart.end(),
+                       file.begin() + hpos.nPos) &&
+            blk_size <= MAX_SIZE && blk_size <= file.size() - pos.nPos) {
+            block.assign(file.begin() + pos.nPos,
+                         file.begin() + pos.nPos + blk_size);
+            return true;
+        }
+    }
+
+    // Open history file to read
+    CAutoFile filein(OpenBlockFile(hpos, true), SER_DISK, CLIENT_VERSION);
+    if (filein.IsNull()) {
+        return error("ReadRawBlockFromDisk: OpenBlockFile failed for %s",
+                     pos.ToString());
+    }
+
+    try {
+        CMessageHeader::MessageMagic blk_start;
+        uint32_t blk_size;
+        filein >> blk_start >> blk_size;
+
+        if (blk_start != messageStart) {
+            return error("ReadRawBlockFromDisk: Block magic mismatch for %s",
+                         pos.ToString());
+        }
+        if (blk_size > MAX_SIZE) {
+            return error("ReadRawBlockFromDisk: Block data is larger than "
+                         "maximum deserialization size for %s: %u > %u",
+                         pos.ToString(), blk_size, MAX_SIZE);
+        }
+
+        block.resize(blk_size);
+        filein.read(reinterpret_cast<char *>(block.data()), blk_size);
+    } catch (const std::exception &e) {
+        block.clear();
+        return error("%s: Read from block file failed: %s for %s", __func__,
+                     e.what(), pos.ToString());
+    }
+
+    return true;
+}
+
+bool ReadRawBlockFromDisk(std::vector<uint8_t> &block,
+                          const CBlockIndex *pindex,
+                          const CMessageHeader::MessageMagic &messageStart) {
+    FlatFilePos blockPos;
+    {
+        LOCK(cs_main);
+        blockPos = pindex->GetBlockPos();
+    }
+
+    if (!ReadRawBlockFromDisk(block, blockPos, messageStart)) {
+        return false;
+    }
+
+    // Only the header is checked, the rest is not deserialized
+    CBlockHeader header;
+    try {
+        VectorReader(SER_NETWORK, PROTOCOL_VERSION, block, 0) >> header;
+    } catch (const std::exception &e) {
+        return error("%s: Deserialize error - %s at %s", __func__, e.what(),
+                     blockPos.ToString());
+    }
+    if (header.GetHash() != pindex->GetBlockHash()) {
+        return error("ReadRawBlockFromDisk(CBlockIndex*): GetHash() doesn't "
+                     "match index for %s at %s",
+                     pindex->ToString(), blockPos.ToString());
+    }
+
+    return true;
+}
+
 Amount GetBlockSubsidy(CBlockIndex *pindexPrev, uint32_t nBits, int nHeight,
                        const Consensus::Params &consensusParams) {
     //calculate work based on nBits like in GetBlockProof from chain.cpp
@@ -946,37 +1084,35 @@ Amount GetBlockSubsidy(CBlockIndex *pindexPrev, uint32_t nBits, int nHeight,
     }
     arith_uint256 aWork = (~bnTarget / (bnTarget + 1)) + 1;
 
-    const CBlockIndex *emaBlock = pindexPrev;
-
-    while (emaBlock->pprev) {
-        // first, skip backwards testing IsEMAEnabled
-        // The below code leverages CBlockIndex::pskip to walk back efficiently.
-        if (IsEMAEnabled(consensusParams, emaBlock->pskip)) {
-            // skip backward
-            emaBlock = emaBlock->pskip;
-            continue; // continue skipping
-        }
-        // cannot skip here, walk back by 1
-        if (!IsEMAEnabled(consensusParams, emaBlock->pprev)) {
-            // found it -- highest block where EMA is not enabled is emaBlock->pprev, and
-            // emaBlock points to the first block for which IsAxionEnabled() == true
-            break;
-        }
-        // Walking back by 1
-        emaBlock = emaBlock->pprev;
+    // The first block with EMA enabled, or pindexPrev if EMA is not enabled
+    const CBlockIndex *emaBlock =
+        GetEMAAnchorBlock(pindexPrev, consensusParams);
+    if (!emaBlock) {
+        emaBlock = pindexPrev;
     }
     int divisions = nHeight / consensusParams.nSubsidyHalvingInterval;
     int emaHeight =
         emaBlock->nHeight /consensusParams.nSubsidyHalvingInterval;
-    for(int a=0; a < divisions ; a++)  {
-        // to be tunned in few years based on high quality empirical research
-        if(a < emaHeight) {
-            aWork *= 99826;
-            aWork /= 100000;
-        }
-        else {
-            aWork *= 99918;
-            aWork /= 100000;
+    // to be tunned in few years based on high quality empirical research
+    if (aWork.bits() <= 64) {
+        // Same rounding as below, on native integers. As x = q * 100000 + r,
+        // x * k / 100000 = q * k + r * k / 100000, which cannot overflow.
+        uint64_t work = aWork.GetLow64();
+        for (int a = 0; a < divisions; a++) {
+            const uint64_t k = a < emaHeight ? 99826 : 99918;
+            work = work / 100000 * k + work % 100000 * k / 100000;
+        }
+        aWork = work;
+    } else {
+        for(int a=0; a < divisions ; a++)  {
+            if(a < emaHeight) {
+                aWork *= 99826;
+                aWork /= 100000;
+            }
+            else {
+                aWork *= 99918;
+                aWork /= 100000;
+            }
         }
     }
 
@@ -1189,11 +1325,49 @@ void UpdateCoins(CCoinsViewCache &view, const CTransaction &tx, int nHeight) {
     AddCoins(view, tx, nHeight);
 }
 
+namespace {
+/**
+ * The batch collecting the Schnorr signatures of the script checks run by this
+ * thread, if any.
+ */
+thread_local SchnorrBatchVerifier *g_schnorr_batch = nullptr;
+} // namespace
+
+ScriptCheckBatch::ScriptCheckBatch() {
+    if (!fBatchSchnorrChecks) {
+        return;
+    }
+    // Reuse the memory of the previous batches of the thread
+    static thread_local SchnorrBatchVerifier verifier;
+    verifier.clear();
+    g_schnorr_batch = &verifier;
+}
+
+ScriptCheckBatch::~ScriptCheckBatch() {
+    g_schnorr_batch = nullptr;
+}
+
+bool ScriptCheckBatch::Finish(bool fOk) {
+    if (!fOk || !g_schnorr_batch || g_schnorr_batch->empty()) {
+        return fOk;
+    }
+    std::vector<size_t> invalid;
+    if (g_schnorr_batch->Verify(&invalid)) {
+        return true;
+    }
+    LogPrintf("%s: %u of a batch of %u Schnorr signatures are invalid\n",
+              __func__, invalid.size(), g_schnorr_batch->size());
+    return false;
+}
+
 bool CScriptCheck::operator()() {
     const CScript &scriptSig = ptxTo->vin[nIn].scriptSig;
+    // Deferring a signature is only correct if failing it fails the script
+    SchnorrBatchVerifier *batch =
+        (nFlags & SCRIPT_VERIFY_NULLFAIL) ? g_schnorr_batch : nullptr;
     if (!VerifyScript(scriptSig, scriptPubKey, nFlags,
-                      CachingTransactionSignatureChecker(ptxTo, nIn, amount,
-                                                         cacheStore, txdata),
+                      CachingTransactionSignatureChecker(
+                          ptxTo, nIn, amount, cacheStore, txdata, batch),
                       metrics, &error)) {
         return false;
     }
@@ -1362,6 +1536,26 @@ bool UndoReadFromDisk(CBlockUndo &blockundo, const CBlockIndex *pindex) {
         return error("%s: no undo data available", __func__);
     }
 
+    uint256 hashChecksum;
+    std::shared_ptr<const MappedFile> mapping;
+    const Span<const uint8_t> data = MapUndoFile(pos, mapping);
+    if (!data.empty()) {
+        // Deserialize in place from the mapped file
+        SpanReader reader(SER_DISK, CLIENT_VERSION, data);
+        CHashVerifier<SpanReader> verifier(&reader);
+        try {
+            verifier << pindex->pprev->GetBlockHash();
+            verifier >> blockundo;
+            reader >> hashChecksum;
+        } catch (const std::exception &e) {
+            return error("%s: Deserialize error - %s", __func__, e.what());
+        }
+        if (hashChecksum != verifier.GetHash()) {
+            return error("%s: Checksum mismatch", __func__);
+        }
+        return true;
+    }
+
     // Open history file to read
     CAutoFile filein(OpenUndoFile(pos, true), SER_DISK, CLIENT_VERSION);
     if (filein.IsNull()) {
@@ -1369,7 +1563,6 @@ bool UndoReadFromDisk(CBlockUndo &blockundo, const CBlockIndex *pindex) {
     }
 
     // Read block
-    uint256 hashChecksum;
     // We need a CHashVerifier as reserializing may lose data
     CHashVerifier<CAutoFile> verifier(&filein);
     try {
@@ -1573,6 +1766,270 @@ void ThreadScriptCheck(int worker_num) {
     scriptcheckqueue.Thread();
 }
 
+static CCheckQueue<CTxInputsCheck> txinputscheckqueue(16);
+
+void ThreadTxInputsCheck(int worker_num) {
+    util::ThreadRename(strprintf("inputch.%i", worker_num));
+    txinputscheckqueue.Thread();
+}
+
+static CCheckQueue<CHeaderCheck> headercheckqueue(64);
+
+void ThreadHeaderCheck(int worker_num) {
+    util::ThreadRename(strprintf("headerch.%i", worker_num));
+    headercheckqueue.Thread();
+}
+
+static CCheckQueue<CTxPreCheck> txprecheckqueue(16);
+
+void ThreadTxPreCheck(int worker_num) {
+    util::ThreadRename(strprintf("txprech.%i", worker_num));
+    txprecheckqueue.Thread();
+}
+
+void EnableCheckQueueWorkStealing(int nWorkers) {
+    scriptcheckqueue.EnableWorkStealing(nWorkers);
+    txinputscheckqueue.EnableWorkStealing(nWorkers);
+    headercheckqueue.EnableWorkStealing(nWorkers);
+    txprecheckqueue.EnableWorkStealing(nWorkers);
+}
+
+bool CHeaderCheck::operator()() {
+    *phash = pheader->GetHash();
+    *pfValidPoW = fCheckPoW && CheckProofOfWork(*phash, pheader->nBits, *pparams);
+    return true;
+}
+
+bool CTxPreCheck::operator()() {
+    const CTransaction &tx = *ptx;
+    const PrecomputedTransactionData txdata(tx);
+    for (size_t i = 0; i < tx.vin.size(); i++) {
+        const CTxOut &txout = (*pspentOutputs)[i];
+        CScriptCheck check(txout.scriptPubKey, txout.nValue, tx, i, nFlags,
+                           true, txdata);
+        if (!check()) {
+            // The transaction is rejected when accepted, there is no point in
+            // checking its other inputs.
+            break;
+        }
+    }
+    return true;
+}
+
+void PreCheckTransactions(const Config &config, CTxMemPool &pool,
+                          const std::vector<CTransactionRef> &txs) {
+    // The transactions are checked in parallel with each other, so there is
+    // nothing to gain for a single one.
+    if (!nScriptCheckThreads || txs.size() < 2) {
+        return;
+    }
+
+    std::vector<std::vector<CTxOut>> spentOutputs(txs.size());
+    uint32_t flags;
+    {
+        LOCK2(cs_main, pool.cs);
+        flags = GetNextBlockScriptFlags(config.GetChainParams().GetConsensus(),
+                                        ::ChainActive().Tip()) |
+                STANDARD_SCRIPT_VERIFY_FLAGS;
+
+        // Coins read here are uncached again below: AcceptToMemoryPool
+        // decides which of them stay in the cache.
+        std::vector<COutPoint> uncached;
+        for (const CTransactionRef &ptx : txs) {
+            if (ptx->IsCoinBase() || pool.exists(ptx->GetId())) {
+                continue;
+            }
+            for (const CTxIn &txin : ptx->vin) {
+                if (!pcoinsTip->HaveCoinInCache(txin.prevout) &&
+                    !pool.exists(txin.prevout.GetTxId())) {
+                    uncached.push_back(txin.prevout);
+                }
+            }
+        }
+        if (nPrefetchThreads > 0 && uncached.size() > 1) {
+            pcoinsTip->PrefetchCoins(uncached);
+        }
+
+        CCoinsViewMemPool viewMemPool(pcoinsTip.get(), pool);
+        for (size_t i = 0; i < txs.size(); i++) {
+            const CTransaction &tx = *txs[i];
+            if (tx.IsCoinBase() || pool.exists(tx.GetId())) {
+                continue;
+            }
+            std::vector<CTxOut> outputs;
+            outputs.reserve(tx.vin.size());
+            for (const CTxIn &txin : tx.vin) {
+                Coin coin;
+                if (!viewMemPool.GetCoin(txin.prevout, coin)) {
+                    break;
+                }
+                outputs.push_back(coin.GetTxOut());
+            }
+            if (outputs.size() == tx.vin.size()) {
+                spentOutputs[i] = std::move(outputs);
+            }
+        }
+
+        for (const COutPoint &outpoint : uncached) {
+            pcoinsTip->Uncache(outpoint);
+        }
+    }
+
+    std::vector<CTxPreCheck> vChecks;
+    vChecks.reserve(txs.size());
+    for (size_t i = 0; i < txs.size(); i++) {
+        if (!spentOutputs[i].empty()) {
+            vChecks.emplace_back(*txs[i], spentOutputs[i], flags);
+        }
+    }
+
+    CCheckQueueControl<CTxPreCheck> control(&txprecheckqueue);
+    control.Add(vChecks);
+    control.Wait();
+}
+
+bool CTxInputsCheck::operator()() {
+    const CTransaction &tx = *ptx;
+    const std::vector<Coin> &coins = ptxundo->vprevout;
+
+    if (!Consensus::CheckTxInputs(tx, *pstate, coins, pindex->nHeight,
+                                  *pfee)) {
+        return false;
+    }
+
+    std::vector<int> prevheights(tx.vin.size());
+    for (size_t j = 0; j < tx.vin.size(); j++) {
+        prevheights[j] = coins[j].GetHeight();
+    }
+
+    if (!SequenceLocks(tx, nLockTimeFlags, &prevheights, *pindex)) {
+        return pstate->DoS(100, false, REJECT_INVALID, "bad-txns-nonfinal",
+                           false, "contains a non-BIP68-final transaction");
+    }
+
+    if (!fScriptChecks) {
+        return true;
+    }
+
+    const PrecomputedTransactionData txdata(tx);
+    for (size_t i = 0; i < tx.vin.size(); i++) {
+        const CTxOut &txout = coins[i].GetTxOut();
+        CScriptCheck check(txout.scriptPubKey, txout.nValue, tx, i, nFlags,
+                           sigCacheStore, txdata, pTxLimitSigChecks,
+                           pBlockLimitSigChecks);
+        if (!check()) {
+            return pstate->DoS(100, false, REJECT_INVALID, "blk-bad-inputs",
+                               false, "parallel script check failed");
+        }
+    }
+
+    return true;
+}
+
+bool ConnectBlockInputsParallel(const CBlock &block, CValidationState &state,
+                                CCoinsViewCache &view,
+                                const CBlockIndex &index, uint32_t flags,
+                                int nLockTimeFlags, bool fScriptChecks,
+                                bool fCacheResults,
+                                CheckInputsLimiter &blockLimitSigChecks,
+                                CBlockUndo &blockundo, Amount &nFeesOut) {
+    AssertLockHeld(cs_main);
+
+    // The coinbase has no inputs to check.
+    const size_t nTxs = block.vtx.size() - 1;
+    blockundo.vtxundo.resize(nTxs);
+
+    std::vector<TxSigCheckLimiter> txLimitSigChecks(nTxs);
+    std::vector<CValidationState> txStates(nTxs);
+    std::vector<Amount> txFees(nTxs, Amount::zero());
+    std::vector<CTxInputsCheck> vChecks;
+    vChecks.reserve(nTxs);
+
+    // Spend all the inputs first, as this is the only step that touches the
+    // view. The outputs of the whole block are already in the view, so the
+    // order in which transactions spend doesn't matter, and the second spend
+    // of a coin shows up as a missing input.
+    for (size_t i = 0; i < nTxs; i++) {
+        const CTransaction &tx = *block.vtx[i + 1];
+        if (!view.HaveInputs(tx)) {
+            state.DoS(100, false, REJECT_INVALID,
+                      "bad-txns-inputs-missingorspent", false,
+                      strprintf("%s: inputs missing/spent", __func__));
+            return error("%s: Consensus::CheckTxInputs: %s, %s", __func__,
+                         tx.GetId().ToString(), FormatStateMessage(state));
+        }
+
+        SpendCoins(view, tx, blockundo.vtxundo[i], index.nHeight);
+
+        if (!(flags & SCRIPT_ENFORCE_SIGCHECKS)) {
+            // See ConnectBlock.
+            txLimitSigChecks[i] = TxSigCheckLimiter::getDisabled();
+        }
+
+        // The script execution cache requires cs_main, so it is consulted
+        // here rather than from the checks.
+        bool fCheckScripts = fScriptChecks;
+        int nSigChecksCached;
+        if (fScriptChecks &&
+            IsKeyInScriptCache(ScriptCacheKey(tx, flags), !fCacheResults,
+                               nSigChecksCached)) {
+            if (!txLimitSigChecks[i].consume_and_check(nSigChecksCached) ||
+                !blockLimitSigChecks.consume_and_check(nSigChecksCached)) {
+                if (!blockLimitSigChecks.check()) {
+                    return state.DoS(100, false, REJECT_INVALID,
+                                     "blk-bad-inputs", false,
+                                     "CheckInputs exceeded SigChecks limit");
+                }
+                state.Invalid(false, REJECT_NONSTANDARD, "too-many-sigchecks");
+                return error("%s: CheckInputs on %s failed with %s", __func__,
+                             tx.GetId().ToString(), FormatStateMessage(state));
+            }
+            fCheckScripts = false;
+        }
+
+        vChecks.emplace_back(tx, blockundo.vtxundo[i], index, nLockTimeFlags,
+                             flags, fCheckScripts, fCacheResults,
+                             txLimitSigChecks[i], blockLimitSigChecks,
+                             txStates[i], txFees[i]);
+    }
+
+    CCheckQueueControl<CTxInputsCheck> control(&txinputscheckqueue);
+    control.Add(vChecks);
+    const bool fAllOk = control.Wait();
+
+    // Merge the results in block order. Once a check fails, the queue skips
+    // the remaining ones, so the failure reported is the first one in block
+    // order among the checks that ran.
+    Amount nFees = Amount::zero();
+    for (size_t i = 0; i < nTxs; i++) {
+        if (!txStates[i].IsValid()) {
+            state = txStates[i];
+            return error("%s: checks on %s failed with %s", __func__,
+                         block.vtx[i + 1]->GetId().ToString(),
+                         FormatStateMessage(state));
+        }
+
+        nFees += txFees[i];
+        if (!MoneyRange(nFees)) {
+            return state.DoS(
+                100,
+                error("%s: accumulated fee in the block out of range.",
+                      __func__),
+                REJECT_INVALID, "bad-txns-accumulated-fee-outofrange");
+        }
+    }
+
+    if (!fAllOk) {
+        // Every failing check records its reason, but the Schnorr signatures
+        // verified in batches are not traced back to their transaction.
+        return state.DoS(100, false, REJECT_INVALID, "blk-bad-inputs", false,
+                         "parallel input check failed");
+    }
+
+    nFeesOut = nFees;
+    return true;
+}
+
 int32_t ComputeBlockVersion(const CBlockIndex *pindexPrev,
                             const Consensus::Params &params) {
     return VERSIONBITS_TOP_BITS;
@@ -1860,87 +2317,123 @@ bool CChainState::ConnectBlock(const CBlock &block, CValidationState &state,
             REJECT_INVALID, "tx-duplicate");
     }
 
-    size_t txIndex = 0;
-    for (const auto &ptx : block.vtx) {
-        const CTransaction &tx = *ptx;
-        const bool isCoinBase = tx.IsCoinBase();
-        nInputs += tx.vin.size();
-
-        Amount txfee = Amount::zero();
-        if (!isCoinBase && !Consensus::CheckTxInputs(tx, state, view,
-                                                     pindex->nHeight, txfee)) {
-            return error("%s: Consensus::CheckTxInputs: %s, %s", __func__,
-                         tx.GetId().ToString(), FormatStateMessage(state));
-        }
-        nFees += txfee;
-        if (!MoneyRange(nFees)) {
-            return state.DoS(
-                100,
-                error("%s: accumulated fee in the block out of range.",
-                      __func__),
-                REJECT_INVALID, "bad-txns-accumulated-fee-outofrange");
+    // Now that the outputs of the block are cached, load all the other coins
+    // it spends at once, instead of one by one as the inputs get checked.
+    if (nPrefetchThreads > 0) {
+        std::vector<COutPoint> outpoints;
+        for (const auto &ptx : block.vtx) {
+            if (ptx->IsCoinBase()) {
+                continue;
+            }
+            for (const CTxIn &txin : ptx->vin) {
+                outpoints.push_back(txin.prevout);
+            }
         }
+        view.PrefetchCoins(outpoints);
+    }
 
-        // The following checks do not apply to the coinbase.
-        if (isCoinBase) {
-            continue;
+    if (fParallelInputChecks) {
+        for (const auto &ptx : block.vtx) {
+            nInputs += ptx->vin.size();
         }
 
-        // Check that transaction is BIP68 final BIP68 lock checks (as
-        // opposed to nLockTime checks) must be in ConnectBlock because they
-        // require the UTXO set.
-        prevheights.resize(tx.vin.size());
-        for (size_t j = 0; j < tx.vin.size(); j++) {
-            prevheights[j] = view.AccessCoin(tx.vin[j].prevout).GetHeight();
+        if (!ConnectBlockInputsParallel(block, state, view, *pindex, flags,
+                                        nLockTimeFlags, fScriptChecks,
+                                        fJustCheck, nSigChecksBlockLimiter,
+                                        blockundo, nFees)) {
+            return false;
         }
+    } else {
+        size_t txIndex = 0;
+        for (const auto &ptx : block.vtx) {
+            const CTransaction &tx = *ptx;
+            const bool isCoinBase = tx.IsCoinBase();
+            nInputs += tx.vin.size();
+
+            Amount txfee = Amount::zero();
+            if (!isCoinBase &&
+                !Consensus::CheckTxInputs(tx, state, view, pindex->nHeight,
+                                          txfee)) {
+                return error("%s: Consensus::CheckTxInputs: %s, %s", __func__,
+                             tx.GetId().ToString(), FormatStateMessage(state));
+            }
+            nFees += txfee;
+            if (!MoneyRange(nFees)) {
+                return state.DoS(
+                    100,
+                    error("%s: accumulated fee in the block out of range.",
+                          __func__),
+                    REJECT_INVALID, "bad-txns-accumulated-fee-outofrange");
+            }
 
-        if (!SequenceLocks(tx, nLockTimeFlags, &prevheights, *pindex)) {
-            return state.DoS(
-                100,
-                error("%s: contains a non-BIP68-final transaction", __func__),
-                REJECT_INVALID, "bad-txns-nonfinal");
-        }
-
-        // Don't cache results if we're actually connecting blocks (still
-        // consult the cache, though).
-        bool fCacheResults = fJustCheck;
-
-        const bool fEnforceSigCheck = flags & SCRIPT_ENFORCE_SIGCHECKS;
-        if (!fEnforceSigCheck) {
-            // Historically, there has been transactions with a very high
-            // sigcheck count, so we need to disable this check for such
-            // transactions.
-            nSigChecksTxLimiters[txIndex] = TxSigCheckLimiter::getDisabled();
-        }
-
-        std::vector<CScriptCheck> vChecks;
-        // nSigChecksRet may be accurate (found in cache) or 0 (checks were
-        // deferred into vChecks).
-        int nSigChecksRet;
-        if (!CheckInputs(tx, state, view, fScriptChecks, flags, fCacheResults,
-                         fCacheResults, PrecomputedTransactionData(tx),
-                         nSigChecksRet, nSigChecksTxLimiters[txIndex],
-                         &nSigChecksBlockLimiter, &vChecks)) {
-            // Parallel CheckInputs shouldn't fail except for this reason, which
-            // is banworthy. Use "blk-bad-inputs" to mimic the parallel script
-            // check error.
-            if (!nSigChecksBlockLimiter.check()) {
-                return state.DoS(100, false, REJECT_INVALID, "blk-bad-inputs",
-                                 false, "CheckInputs exceeded SigChecks limit");
+            // The following checks do not apply to the coinbase.
+            if (isCoinBase) {
+                continue;
+            }
+
+            // Check that transaction is BIP68 final BIP68 lock checks (as
+            // opposed to nLockTime checks) must be in ConnectBlock because they
+            // require the UTXO set.
+            prevheights.resize(tx.vin.size());
+            for (size_t j = 0; j < tx.vin.size(); j++) {
+                prevheights[j] =
+                    view.AccessCoin(tx.vin[j].prevout).GetHeight();
+            }
+
+            if (!SequenceLocks(tx, nLockTimeFlags, &prevheights, *pindex)) {
+                return state.DoS(100,
+                                 error("%s: contains a non-BIP68-final "
+                                       "transaction",
+                                       __func__),
+                                 REJECT_INVALID, "bad-txns-nonfinal");
+            }
+
+            // Don't cache results if we're actually connecting blocks (still
+            // consult the cache, though).
+            bool fCacheResults = fJustCheck;
+
+            const bool fEnforceSigCheck = flags & SCRIPT_ENFORCE_SIGCHECKS;
+            if (!fEnforceSigCheck) {
+                // Historically, there has been transactions with a very high
+                // sigcheck count, so we need to disable this check for such
+                // transactions.
+                nSigChecksTxLimiters[txIndex] =
+                    TxSigCheckLimiter::getDisabled();
+            }
+
+            std::vector<CScriptCheck> vChecks;
+            // nSigChecksRet may be accurate (found in cache) or 0 (checks were
+            // deferred into vChecks).
+            int nSigChecksRet;
+            if (!CheckInputs(tx, state, view, fScriptChecks, flags,
+                             fCacheResults, fCacheResults,
+                             PrecomputedTransactionData(tx), nSigChecksRet,
+                             nSigChecksTxLimiters[txIndex],
+                             &nSigChecksBlockLimiter, &vChecks)) {
+                // Parallel CheckInputs shouldn't fail except for this reason,
+                // which is banworthy. Use "blk-bad-inputs" to mimic the
+                // parallel script check error.
+                if (!nSigChecksBlockLimiter.check()) {
+                    return state.DoS(100, false, REJECT_INVALID,
+                                     "blk-bad-inputs", false,
+                                     "CheckInputs exceeded SigChecks limit");
+                }
+                return error(
+                    "ConnectBlock(): CheckInputs on %s failed with %s",
+                    tx.GetId().ToString(), FormatStateMessage(state));
             }
-            return error("ConnectBlock(): CheckInputs on %s failed with %s",
-                         tx.GetId().ToString(), FormatStateMessage(state));
-        }
 
-        control.Add(vChecks);
+            control.Add(vChecks);
 
-        // Note: this must execute in the same iteration as CheckTxInputs (not
-        // in a separate loop) in order to detect double spends. However,
-        // this does not prevent double-spending by duplicated transaction
-        // inputs in the same transaction (cf. CVE-2018-17144) -- that check is
-        // done in CheckBlock (CheckRegularTransaction).
-        SpendCoins(view, tx, blockundo.vtxundo.at(txIndex), pindex->nHeight);
-        txIndex++;
+            // Note: this must execute in the same iteration as CheckTxInputs
+            // (not in a separate loop) in order to detect double spends.
+            // However, this does not prevent double-spending by duplicated
+            // transaction inputs in the same transaction (cf. CVE-2018-17144)
+            // -- that check is done in CheckBlock (CheckRegularTransaction).
+            SpendCoins(view, tx, blockundo.vtxundo.at(txIndex),
+                       pindex->nHeight);
+            txIndex++;
+        }
     }
 
     int64_t nTime3 = GetTimeMicros();
@@ -2064,6 +2557,21 @@ static bool FlushStateToDisk(const CChainParams &chainparams,
             int64_t nTotalSpace =
                 nCoinCacheUsage +
                 std::max<int64_t>(nMempoolSizeMax - nMempoolUsage, 0);
+            // Coins flushed in the background are held in memory until they
+            // reach the database. Wait for them if they take the cache over
+            // the limit, or before pruning, which could remove the blocks
+            // needed to replay an interrupted write.
+            if (pcoinswriter) {
+                const bool fWaitForWrite =
+                    fFlushForPrune ||
+                    (mode != FlushStateMode::NONE &&
+                     cacheSize + int64_t(pcoinswriter->DynamicMemoryUsage()) >
+                         nTotalSpace);
+                if ((fWaitForWrite || !pcoinswriter->IsWriting()) &&
+                    !pcoinswriter->Sync()) {
+                    return AbortNode(state, "Failed to write to coin database");
+                }
+            }
             // The cache is large and we're within 10% and 10 MiB of the limit,
             // but we have time now (not in the middle of a block processing).
             bool fCacheLarge =
@@ -2149,6 +2657,22 @@ static bool FlushStateToDisk(const CChainParams &chainparams,
                 if (!pcoinsTip->Flush()) {
                     return AbortNode(state, "Failed to write to coin database");
                 }
+                // With -dbbackgroundflush, the coins are now being written by
+                // another thread. Wait for them when the caller expects them to
+                // be on disk.
+                if (pcoinswriter &&
+                    (mode == FlushStateMode::ALWAYS || fFlushForPrune) &&
+                    !pcoinswriter->Sync()) {
+                    return AbortNode(state, "Failed to write to coin database");
+                }
+                // Store the commitment to the coins along with them, so it
+                // does not have to be recomputed on startup. It is only used
+                // if the coins it commits to made it to disk.
+                if (pcoinscommitment &&
+                    !pcoinsdbview->WriteCommitment(pcoinsTip->GetBestBlock(),
+                                                   *pcoinscommitment)) {
+                    return AbortNode(state, "Failed to write to coin database");
+                }
                 nLastFlush = nNow;
                 full_flush_completed = true;
             }
@@ -2174,6 +2698,48 @@ void FlushStateToDisk() {
     }
 }
 
+bool LoadCoinsCommitment() {
+    LOCK(cs_main);
+
+    auto commitment = std::make_unique<CCoinsCommitment>();
+    BlockHash hashBlock;
+    if (pcoinsdbview->ReadCommitment(hashBlock, *commitment) &&
+        hashBlock == pcoinsTip->GetBestBlock()) {
+        pcoinscommitment = std::move(commitment);
+        return true;
+    }
+
+    // Hash the coins as of the tip, which requires them to all be on disk.
+    FlushStateToDisk();
+    if (pcoinswriter && !pcoinswriter->Sync()) {
+        return false;
+    }
+
+    LogPrintf("Computing the commitment to the UTXO set...\n");
+    int64_t nStart = GetTimeMillis();
+    *commitment = CCoinsCommitment();
+    std::unique_ptr<CCoinsViewCursor> pcursor(pcoinsdbview->Cursor());
+    for (; pcursor->Valid(); pcursor->Next()) {
+        if (ShutdownRequested()) {
+            return false;
+        }
+        COutPoint key;
+        Coin coin;
+        if (!pcursor->GetKey(key) || !pcursor->GetValue(coin)) {
+            return error("%s: unable to read value", __func__);
+        }
+        commitment->AddCoin(key, coin);
+    }
+    if (!pcoinsdbview->WriteCommitment(pcursor->GetBestBlock(), *commitment)) {
+        return error("%s: unable to write commitment", __func__);
+    }
+    LogPrintf("Computed the commitment to %d coins in %dms\n",
+              commitment->GetTransactionOutputs(), GetTimeMillis() - nStart);
+
+    pcoinscommitment = std::move(commitment);
+    return true;
+}
+
 void PruneAndFlush() {
     CValidationState state;
     fCheckForPruning = true;
@@ -2239,6 +2805,10 @@ bool CChainState::DisconnectTip(const CChainParams &params,
     {
         CCoinsViewCache view(pcoinsTip.get());
         assert(view.GetBestBlock() == pindexDelete->GetBlockHash());
+        CCoinsCommitment changes;
+        if (pcoinscommitment) {
+            view.TrackChanges(&changes);
+        }
         if (DisconnectBlock(block, pindexDelete, view) != DISCONNECT_OK) {
             return error("DisconnectTip(): DisconnectBlock %s failed",
                          pindexDelete->GetBlockHash().ToString());
@@ -2246,6 +2816,9 @@ bool CChainState::DisconnectTip(const CChainParams &params,
 
         bool flushed = view.Flush();
         assert(flushed);
+        if (pcoinscommitment) {
+            *pcoinscommitment += changes;
+        }
     }
 
     LogPrint(BCLog::BENCH, "- Disconnect block: %.2fms\n",
@@ -2493,6 +3066,10 @@ bool CChainState::ConnectTip(const Config &config, CValidationState &state,
              (nTime2 - nTime1) * MILLI, nTimeReadFromDisk * MICRO);
     {
         CCoinsViewCache view(pcoinsTip.get());
+        CCoinsCommitment changes;
+        if (pcoinscommitment) {
+            view.TrackChanges(&changes);
+        }
         bool rv = ConnectBlock(blockConnecting, state, pindexNew, view, params,
                                BlockValidationOptions(config));
         GetMainSignals().BlockChecked(blockConnecting, state);
@@ -2531,6 +3108,9 @@ bool CChainState::ConnectTip(const Config &config, CValidationState &state,
                  nTimeConnectTotal * MILLI / nBlocksTotal);
         bool flushed = view.Flush();
         assert(flushed);
+        if (pcoinscommitment) {
+            *pcoinscommitment += changes;
+        }
     }
 
     int64_t nTime4 = GetTimeMicros();
@@ -3373,10 +3953,14 @@ bool IsBlockFinalized(const CBlockIndex *pindex) {
 }
 
 CBlockIndex *CChainState::AddToBlockIndex(const CBlockHeader &block) {
+    return AddToBlockIndex(block, block.GetHash());
+}
+
+CBlockIndex *CChainState::AddToBlockIndex(const CBlockHeader &block,
+                                          const BlockHash &hash) {
     AssertLockHeld(cs_main);
 
     // Check for duplicate
-    BlockHash hash = block.GetHash();
     BlockMap::iterator it = mapBlockIndex.find(hash);
     if (it != mapBlockIndex.end()) {
         return it->second;
@@ -3898,10 +4482,26 @@ bool CChainState::AcceptBlockHeader(const Config &config,
                                     CValidationState &state,
                                     CBlockIndex **ppindex) {
     AssertLockHeld(cs_main);
+
+    if (!AcceptBlockHeader(config, block, block.GetHash(), false,
+                           GetAdjustedTime(), state, ppindex)) {
+        return false;
+    }
+
+    CheckBlockIndex(config.GetChainParams().GetConsensus());
+    return true;
+}
+
+bool CChainState::AcceptBlockHeader(const Config &config,
+                                    const CBlockHeader &block,
+                                    const BlockHash &hash, bool fCheckedPoW,
+                                    int64_t nAdjustedTime,
+                                    CValidationState &state,
+                                    CBlockIndex **ppindex) {
+    AssertLockHeld(cs_main);
     const CChainParams &chainparams = config.GetChainParams();
 
     // Check for duplicate
-    BlockHash hash = block.GetHash();
     BlockMap::iterator miSelf = mapBlockIndex.find(hash);
     CBlockIndex *pindex = nullptr;
     if (hash != chainparams.GetConsensus().hashGenesisBlock) {
@@ -3921,7 +4521,8 @@ bool CChainState::AcceptBlockHeader(const Config &config,
             return true;
         }
 
-        if (!CheckBlockHeader(block, state, chainparams.GetConsensus(),
+        if (!fCheckedPoW &&
+            !CheckBlockHeader(block, state, chainparams.GetConsensus(),
                               BlockValidationOptions(config))) {
             return error("%s: Consensus::CheckBlockHeader: %s, %s", __func__,
                          hash.ToString(), FormatStateMessage(state));
@@ -3942,7 +4543,7 @@ bool CChainState::AcceptBlockHeader(const Config &config,
         }
 
         if (!ContextualCheckBlockHeader(chainparams, block, state, pindexPrev,
-                                        GetAdjustedTime())) {
+                                        nAdjustedTime)) {
             return error("%s: Consensus::ContextualCheckBlockHeader: %s, %s",
                          __func__, hash.ToString(), FormatStateMessage(state));
         }
@@ -3991,14 +4592,13 @@ bool CChainState::AcceptBlockHeader(const Config &config,
     }
 
     if (pindex == nullptr) {
-        pindex = AddToBlockIndex(block);
+        pindex = AddToBlockIndex(block, hash);
     }
 
     if (ppindex) {
         *ppindex = pindex;
     }
 
-    CheckBlockIndex(chainparams.GetConsensus());
     return true;
 }
 
@@ -4012,23 +4612,57 @@ bool ProcessNewBlockHeaders(const Config &config,
         first_invalid->SetNull();
     }
 
+    // Hash the headers and check their proof of work before taking cs_main,
+    // on the script check threads when there are any. A failed check is not
+    // reported here, the header is checked again in order below so that the
+    // first invalid header and the duplicate checks are as for a single one.
+    std::vector<BlockHash> hashes(headers.size());
+    std::vector<uint8_t> validPoW(headers.size());
+    const bool fCheckPoW = BlockValidationOptions(config).shouldValidatePoW();
+    {
+        std::vector<CHeaderCheck> vChecks;
+        vChecks.reserve(headers.size());
+        for (size_t i = 0; i < headers.size(); i++) {
+            vChecks.emplace_back(headers[i],
+                                 config.GetChainParams().GetConsensus(),
+                                 fCheckPoW, hashes[i], validPoW[i]);
+        }
+        if (nScriptCheckThreads && headers.size() > 1) {
+            CCheckQueueControl<CHeaderCheck> control(&headercheckqueue);
+            control.Add(vChecks);
+            control.Wait();
+        } else {
+            for (CHeaderCheck &check : vChecks) {
+                check();
+            }
+        }
+    }
+
     {
         LOCK(cs_main);
-        for (const CBlockHeader &header : headers) {
+        const int64_t nAdjustedTime = GetAdjustedTime();
+        bool fAccepted = true;
+        for (size_t i = 0; i < headers.size(); i++) {
             // Use a temp pindex instead of ppindex to avoid a const_cast
             CBlockIndex *pindex = nullptr;
-            if (!g_chainstate.AcceptBlockHeader(config, header, state,
-                                                &pindex)) {
+            if (!g_chainstate.AcceptBlockHeader(config, headers[i], hashes[i],
+                                                validPoW[i], nAdjustedTime,
+                                                state, &pindex)) {
                 if (first_invalid) {
-                    *first_invalid = header;
+                    *first_invalid = headers[i];
                 }
-                return false;
+                fAccepted = false;
+                break;
             }
 
             if (ppindex) {
                 *ppindex = pindex;
             }
         }
+        g_chainstate.CheckBlockIndex(config.GetChainParams().GetConsensus());
+        if (!fAccepted) {
+            return false;
+        }
     }
 
     NotifyHeaderTip();
@@ -4384,6 +5018,8 @@ void PruneOneBlockFile(const int fileNumber) {
 void UnlinkPrunedFiles(const std::set<int> &setFilesToPrune) {
     for (const int i : setFilesToPrune) {
         FlatFilePos pos(i, 0);
+        BlockFileSeq().Unmap(pos);
+        UndoFileSeq().Unmap(pos);
         fs::remove(BlockFileSeq().FileName(pos));
         fs::remove(UndoFileSeq().FileName(pos));
         LogPrintf("Prune: %s deleted blk/rev (%05u)\n", __func__, i);
@@ -4537,6 +5173,49 @@ static FILE *OpenUndoFile(const FlatFilePos &pos, bool fReadOnly) {
     return UndoFileSeq().Open(pos, fReadOnly);
 }
 
+/**
+ * Map the record stored at the given position, preceded by the index header
+ * holding its size, and followed by trailing_size more bytes.
+ */
+static Span<const uint8_t> MapRecord(FlatFileSeq seq, const FlatFilePos &pos,
+                                     size_t trailing_size,
+                                     std::shared_ptr<const MappedFile> &file) {
+    file.reset();
+    if (pos.nPos < sizeof(uint32_t)) {
+        return {};
+    }
+    FlatFilePos size_pos = pos;
+    size_pos.nPos -= sizeof(uint32_t);
+    std::shared_ptr<const MappedFile> mapping =
+        seq.Map(size_pos, sizeof(uint32_t));
+    if (!mapping) {
+        return {};
+    }
+    const Span<const uint8_t> data = mapping->Data();
+    const size_t record_size =
+        size_t(ReadLE32(data.data() + size_pos.nPos)) + trailing_size;
+    if (record_size > data.size() - pos.nPos) {
+        // Either corrupted or written after the file was mapped
+        mapping = seq.Map(pos, record_size);
+        if (!mapping) {
+            return {};
+        }
+    }
+    file = std::move(mapping);
+    return file->Data().subspan(pos.nPos, record_size);
+}
+
+Span<const uint8_t> MapBlockFile(const FlatFilePos &pos,
+                                 std::shared_ptr<const MappedFile> &file) {
+    return MapRecord(BlockFileSeq(), pos, 0, file);
+}
+
+/** Map the undo data at the given position, followed by its checksum */
+static Span<const uint8_t> MapUndoFile(const FlatFilePos &pos,
+                                       std::shared_ptr<const MappedFile> &file) {
+    return MapRecord(UndoFileSeq(), pos, sizeof(uint256), file);
+}
+
 fs::path GetBlockPosFilename(const FlatFilePos &pos) {
     return BlockFileSeq().FileName(pos);
 }
@@ -5053,6 +5732,7 @@ void UnloadBlockIndex() {
     pindexBestForkTip = nullptr;
     pindexBestForkBase = nullptr;
     ResetASERTAnchorBlockCache();
+    ResetEMAAnchorBlockCache();
     g_mempool.clear();
     mapBlocksUnlinked.clear();
     vinfoBlockFile.clear();
@@ -14,6 +14,7 @@
 #include <amount.h>
 #include <blockfileinfo.h>
 #include <chain.h>
+#include <checkqueue.h>
 #include <coins.h>
 #include <consensus/consensus.h>
 #include <flatfile.h>
@@ -42,6 +43,7 @@ class CBlockTreeDB;
 class CBlockUndo;
 class CChainParams;
 class CChain;
+class CCoinsViewBackgroundWriter;
 class CCoinsViewDB;
 class CConnman;
 class CInv;
@@ -95,6 +97,16 @@ static constexpr unsigned int UNDOFILE_CHUNK_SIZE = 0x100000; // 1 MiB
 static constexpr int MAX_SCRIPTCHECK_THREADS = 16;
 /** -par default (number of script-checking threads, 0 = auto) */
 static constexpr int DEFAULT_SCRIPTCHECK_THREADS = 0;
+/** Default for -parallelinputchecks */
+static constexpr bool DEFAULT_PARALLEL_INPUT_CHECKS = false;
+/** Maximum number of coin prefetching threads allowed */
+static constexpr int MAX_PREFETCH_THREADS = 32;
+/** -prefetchthreads default (number of threads reading coins, 0 = disabled) */
+static constexpr int DEFAULT_PREFETCH_THREADS = 4;
+/** Default for -workstealing */
+static constexpr bool DEFAULT_WORK_STEALING = false;
+/** Default for -batchschnorr */
+static constexpr bool DEFAULT_BATCH_SCHNORR_CHECKS = true;
 /**
  * Number of blocks that can be requested at any given time from a single peer.
  */
@@ -152,6 +164,8 @@ static constexpr int64_t MAX_FEE_ESTIMATION_TIP_AGE = 3 * 60 * 60;
 static constexpr bool DEFAULT_PERMIT_BAREMULTISIG = true;
 static constexpr bool DEFAULT_CHECKPOINTS_ENABLED = true;
 static constexpr bool DEFAULT_TXINDEX = false;
+static const char *const DEFAULT_BLOCKFILTERINDEX = "0";
+static constexpr bool DEFAULT_UTXO_COMMITMENT = false;
 static constexpr unsigned int DEFAULT_BANSCORE_THRESHOLD = 100;
 
 /** Default for -persistmempool */
@@ -202,6 +216,21 @@ extern uint256 g_best_block;
 extern std::atomic_bool fImporting;
 extern std::atomic_bool fReindex;
 extern int nScriptCheckThreads;
+/**
+ * Whether ConnectBlock validates the inputs of the transactions of a block
+ * concurrently on the input check queue rather than one after the other.
+ */
+extern bool fParallelInputChecks;
+/**
+ * Whether the script checks run on the check queues verify the Schnorr
+ * signatures they meet in batches rather than one by one.
+ */
+extern bool fBatchSchnorrChecks;
+/**
+ * Number of threads reading the coins spent by a block or a transaction from
+ * the coin database ahead of their validation, 0 when prefetching is disabled.
+ */
+extern int nPrefetchThreads;
 extern bool fIsBareMultisigStd;
 extern bool fRequireStandard;
 extern bool fCheckBlockIndex;
@@ -357,6 +386,17 @@ bool ProcessNewBlockHeaders(const Config &config,
  */
 FILE *OpenBlockFile(const FlatFilePos &pos, bool fReadOnly = false);
 
+/**
+ * Map the block stored at the given position in a block file, to deserialize
+ * it in place.
+ *
+ * @param[out] file Keeps the mapping alive while the data is used.
+ * @return The serialized block, or an empty span if it could not be mapped,
+ * in which case OpenBlockFile should be used.
+ */
+Span<const uint8_t> MapBlockFile(const FlatFilePos &pos,
+                                 std::shared_ptr<const MappedFile> &file);
+
 /**
  * Translation to a filesystem path.
  */
@@ -395,6 +435,30 @@ void UnloadBlockIndex();
  */
 void ThreadScriptCheck(int worker_num);
 
+/**
+ * Run an instance of the transaction input checking thread, used when
+ * -parallelinputchecks is enabled.
+ */
+void ThreadTxInputsCheck(int worker_num);
+
+/**
+ * Run an instance of the block header checking thread.
+ */
+void ThreadHeaderCheck(int worker_num);
+
+/**
+ * Run an instance of the thread checking transactions ahead of their
+ * acceptance to the mempool.
+ */
+void ThreadTxPreCheck(int worker_num);
+
+/**
+ * Make the script and transaction input check queues spread their work over
+ * one queue per thread, nWorkers being the number of worker threads of each.
+ * Must be called before any checking thread is started.
+ */
+void EnableCheckQueueWorkStealing(int nWorkers);
+
 /**
  * Check whether we are doing an initial block download (synchronizing from disk
  * or network)
@@ -459,6 +523,21 @@ bool AcceptToMemoryPool(const Config &config, CTxMemPool &pool,
                         const Amount nAbsurdFee, bool test_accept = false)
     EXCLUSIVE_LOCKS_REQUIRED(cs_main);
 
+/**
+ * Run the scripts of a batch of transactions received from peers in parallel,
+ * without holding cs_main, before they are accepted to the mempool one at a
+ * time with AcceptToMemoryPool.
+ *
+ * Nothing is decided here: the signatures found valid are stored in the
+ * signature cache, so that accepting the transactions right after only runs
+ * the cheap part of the scripts under cs_main. Transactions which are already
+ * in the mempool or spend coins that can't be found are skipped, and the coins
+ * cache is left as it was.
+ */
+void PreCheckTransactions(const Config &config, CTxMemPool &pool,
+                          const std::vector<CTransactionRef> &txs)
+    LOCKS_EXCLUDED(cs_main);
+
 /** Convert CValidationState to a human-readable message for logging */
 std::string FormatStateMessage(const CValidationState &state);
 
@@ -650,12 +729,196 @@ public:
     ScriptExecutionMetrics GetScriptExecutionMetrics() const { return metrics; }
 };
 
+/**
+ * Closure representing the validation of all the inputs of one transaction of
+ * a block against the coins it spends: input amounts and coinbase maturity,
+ * BIP68 sequence locks and, optionally, scripts.
+ *
+ * The spent coins are read from the undo data of the transaction, so that the
+ * check does not need to access the UTXO view and can run on any thread once
+ * the coins have been spent. The outcome is stored in the state and fee slots
+ * passed at construction, which the caller must keep alive until the check ran.
+ */
+class CTxInputsCheck {
+private:
+    const CTransaction *ptx;
+    const CTxUndo *ptxundo;
+    const CBlockIndex *pindex;
+    int nLockTimeFlags;
+    uint32_t nFlags;
+    bool fScriptChecks;
+    bool sigCacheStore;
+    TxSigCheckLimiter *pTxLimitSigChecks;
+    CheckInputsLimiter *pBlockLimitSigChecks;
+    CValidationState *pstate;
+    Amount *pfee;
+
+public:
+    CTxInputsCheck()
+        : ptx(nullptr), ptxundo(nullptr), pindex(nullptr), nLockTimeFlags(0),
+          nFlags(0), fScriptChecks(false), sigCacheStore(false),
+          pTxLimitSigChecks(nullptr), pBlockLimitSigChecks(nullptr),
+          pstate(nullptr), pfee(nullptr) {}
+
+    CTxInputsCheck(const CTransaction &txIn, const CTxUndo &txundoIn,
+                   const CBlockIndex &indexIn, int nLockTimeFlagsIn,
+                   uint32_t nFlagsIn, bool fScriptChecksIn, bool cacheIn,
+                   TxSigCheckLimiter &txLimitSigChecksIn,
+                   CheckInputsLimiter &blockLimitSigChecksIn,
+                   CValidationState &stateOut, Amount &feeOut)
+        : ptx(&txIn), ptxundo(&txundoIn), pindex(&indexIn),
+          nLockTimeFlags(nLockTimeFlagsIn), nFlags(nFlagsIn),
+          fScriptChecks(fScriptChecksIn), sigCacheStore(cacheIn),
+          pTxLimitSigChecks(&txLimitSigChecksIn),
+          pBlockLimitSigChecks(&blockLimitSigChecksIn), pstate(&stateOut),
+          pfee(&feeOut) {}
+
+    bool operator()();
+
+    void swap(CTxInputsCheck &check) {
+        std::swap(ptx, check.ptx);
+        std::swap(ptxundo, check.ptxundo);
+        std::swap(pindex, check.pindex);
+        std::swap(nLockTimeFlags, check.nLockTimeFlags);
+        std::swap(nFlags, check.nFlags);
+        std::swap(fScriptChecks, check.fScriptChecks);
+        std::swap(sigCacheStore, check.sigCacheStore);
+        std::swap(pTxLimitSigChecks, check.pTxLimitSigChecks);
+        std::swap(pBlockLimitSigChecks, check.pBlockLimitSigChecks);
+        std::swap(pstate, check.pstate);
+        std::swap(pfee, check.pfee);
+    }
+};
+
+/**
+ * The Schnorr signatures met by the script checks a thread takes from a check
+ * queue at once are only verified when all of them ran, in a single batch,
+ * when fBatchSchnorrChecks is set.
+ */
+class ScriptCheckBatch {
+public:
+    ScriptCheckBatch();
+    ~ScriptCheckBatch();
+
+    ScriptCheckBatch(const ScriptCheckBatch &) = delete;
+    ScriptCheckBatch &operator=(const ScriptCheckBatch &) = delete;
+
+    bool Finish(bool fOk);
+};
+
+template <> class CCheckQueueBatch<CScriptCheck> : public ScriptCheckBatch {};
+template <>
+class CCheckQueueBatch<CTxInputsCheck> : public ScriptCheckBatch {};
+
+/**
+ * Closure hashing a block header received from a peer and checking its proof
+ * of work, which do not depend on the chain and can be done for a whole batch
+ * of headers in parallel.
+ *
+ * The hash and the outcome are stored in the slots passed at construction. The
+ * check itself always succeeds, so that a batch with an invalid header is still
+ * fully hashed.
+ */
+class CHeaderCheck {
+private:
+    const CBlockHeader *pheader;
+    const Consensus::Params *pparams;
+    bool fCheckPoW;
+    BlockHash *phash;
+    uint8_t *pfValidPoW;
+
+public:
+    CHeaderCheck()
+        : pheader(nullptr), pparams(nullptr), fCheckPoW(false),
+          phash(nullptr), pfValidPoW(nullptr) {}
+
+    CHeaderCheck(const CBlockHeader &headerIn, const Consensus::Params &paramsIn,
+                 bool fCheckPoWIn, BlockHash &hashOut, uint8_t &fValidPoWOut)
+        : pheader(&headerIn), pparams(&paramsIn), fCheckPoW(fCheckPoWIn),
+          phash(&hashOut), pfValidPoW(&fValidPoWOut) {}
+
+    bool operator()();
+
+    void swap(CHeaderCheck &check) {
+        std::swap(pheader, check.pheader);
+        std::swap(pparams, check.pparams);
+        std::swap(fCheckPoW, check.fCheckPoW);
+        std::swap(phash, check.phash);
+        std::swap(pfValidPoW, check.pfValidPoW);
+    }
+};
+
+/**
+ * Closure running the scripts of a transaction received from a peer against
+ * the outputs it spends, to fill the signature cache before the transaction is
+ * accepted to the mempool.
+ *
+ * The spent outputs are copied from the UTXO set and the mempool beforehand,
+ * so that the check does not need cs_main. The check itself always succeeds,
+ * so that a batch with an invalid transaction is still fully checked, but it
+ * stops at the first failing input of its transaction.
+ */
+class CTxPreCheck {
+private:
+    const CTransaction *ptx;
+    const std::vector<CTxOut> *pspentOutputs;
+    uint32_t nFlags;
+
+public:
+    CTxPreCheck() : ptx(nullptr), pspentOutputs(nullptr), nFlags(0) {}
+
+    CTxPreCheck(const CTransaction &txIn,
+                const std::vector<CTxOut> &spentOutputsIn, uint32_t nFlagsIn)
+        : ptx(&txIn), pspentOutputs(&spentOutputsIn), nFlags(nFlagsIn) {}
+
+    bool operator()();
+
+    void swap(CTxPreCheck &check) {
+        std::swap(ptx, check.ptx);
+        std::swap(pspentOutputs, check.pspentOutputs);
+        std::swap(nFlags, check.nFlags);
+    }
+};
+
+/**
+ * Validate and spend the inputs of all the transactions of a block, using the
+ * input check queue to run the per transaction checks concurrently.
+ *
+ * All the outputs of the block must already have been added to view. The
+ * inputs are first spent serially, which detects missing and double spent
+ * inputs and fills blockundo. The remaining checks are then run by
+ * CTxInputsCheck in parallel, and their results are merged in block order so
+ * that the reported failure, the fee total in nFeesOut and the sigchecks
+ * accounting do not depend on thread scheduling.
+ *
+ * With fScriptChecks set, scripts are executed as part of the checks, except
+ * for transactions found in the script execution cache.
+ */
+bool ConnectBlockInputsParallel(const CBlock &block, CValidationState &state,
+                                CCoinsViewCache &view,
+                                const CBlockIndex &index, uint32_t flags,
+                                int nLockTimeFlags, bool fScriptChecks,
+                                bool fCacheResults,
+                                CheckInputsLimiter &blockLimitSigChecks,
+                                CBlockUndo &blockundo, Amount &nFeesOut)
+    EXCLUSIVE_LOCKS_REQUIRED(cs_main);
+
 /** Functions for disk access for blocks */
 bool ReadBlockFromDisk(CBlock &block, const FlatFilePos &pos,
                        const Consensus::Params &params);
 bool ReadBlockFromDisk(CBlock &block, const CBlockIndex *pindex,
                        const Consensus::Params &params);
 
+/**
+ * Read a block as it is serialized on disk, which is also how it is sent over
+ * the network, without deserializing it.
+ */
+bool ReadRawBlockFromDisk(std::vector<uint8_t> &block, const FlatFilePos &pos,
+                          const CMessageHeader::MessageMagic &messageStart);
+bool ReadRawBlockFromDisk(std::vector<uint8_t> &block,
+                          const CBlockIndex *pindex,
+                          const CMessageHeader::MessageMagic &messageStart);
+
 bool UndoReadFromDisk(CBlockUndo &blockundo, const CBlockIndex *pindex);
 
 /** Functions for validating blocks and updating the block tree */
@@ -764,11 +1027,32 @@ CChain &ChainActive();
  */
 extern std::unique_ptr<CCoinsViewDB> pcoinsdbview;
 
+/**
+ * Global variable that points to the view writing the coins database in the
+ * background, between pcoinsdbview and pcoinsTip. Null unless
+ * -dbbackgroundflush is set. (protected by cs_main)
+ */
+extern std::unique_ptr<CCoinsViewBackgroundWriter> pcoinswriter;
+
 /**
  * Global variable that points to the active CCoinsView (protected by cs_main)
  */
 extern std::unique_ptr<CCoinsViewCache> pcoinsTip;
 
+/**
+ * Global variable that points to the commitment to the coins of pcoinsTip,
+ * which is updated as blocks are connected and disconnected. Null unless
+ * -utxocommitment is set. (protected by cs_main)
+ */
+extern std::unique_ptr<CCoinsCommitment> pcoinscommitment;
+
+/**
+ * Set up pcoinscommitment, from the commitment stored in the coins database if
+ * it is up to date, or else by hashing all the coins. Returns false if this
+ * fails or is interrupted by a shutdown request.
+ */
+bool LoadCoinsCommitment();
+
 /**
  * Global variable that points to the active block tree (protected by cs_main)
  */
@@ -0,0 +1,98 @@
+#!/usr/bin/env python3
+# Copyright (c) 2020 The Bitcoin Static developers
+# Distributed under the MIT software license, see the accompanying
+# file COPYING or http://www.opensource.org/licenses/mit-license.php.
+'''
+p2p_socketevents -- loopback message throughput versus peer count
+
+Connects an increasing number of local P2P peers to a single node, has every
+peer send a burst of pings and measures how many ping/pong round trips per
+second the node serves, once for every -socketevents mode.
+
+Run it from this directory, for example:
+
+  ./p2p_socketevents.py --configfile=../../build/test/config.ini
+
+The Python side shares a single event loop for all peers, so absolute numbers
+are bounded by it; compare the modes with each other on the same machine.
+'''
+
+import os
+import sys
+import time
+
+sys.path.insert(0, os.path.join('..', 'functional'))
+from test_framework.messages import msg_ping  # noqa: E402
+from test_framework.mininode import P2PInterface, mininode_lock  # noqa: E402
+from test_framework.test_framework import BitcoinTestFramework  # noqa: E402
+from test_framework.util import wait_until  # noqa: E402
+
+SOCKET_EVENTS_MODES = ["select", "epoll"]
+PEER_COUNTS = [1, 8, 32, 128, 512, 2048]
+# select() can only wait on descriptors below FD_SETSIZE (1024), so the node
+# trims -maxconnections to fit
+SELECT_MAX_PEERS = 800
+PINGS_PER_PEER = 200
+
+
+class PongCounter(P2PInterface):
+    def __init__(self):
+        super().__init__()
+        self.pongs = 0
+
+    def on_pong(self, message):
+        self.pongs += 1
+
+
+class SocketEventsBenchmark(BitcoinTestFramework):
+    def set_test_params(self):
+        self.num_nodes = 1
+        self.extra_args = [["-debugexclude=net"]]
+
+    def measure(self, node, peers):
+        with mininode_lock:
+            for p in peers:
+                p.pongs = 0
+        expected = PINGS_PER_PEER * len(peers)
+
+        t0 = time.time()
+        for p in peers:
+            burst = b"".join(p.build_message(msg_ping(nonce))
+                             for nonce in range(1, PINGS_PER_PEER + 1))
+            p.send_raw_message(burst)
+        wait_until(lambda: sum(p.pongs for p in peers) == expected,
+                   timeout=600, lock=mininode_lock)
+        elapsed = time.time() - t0
+        return expected / elapsed
+
+    def run_test(self):
+        node = self.nodes[0]
+        results = {}
+        for mode in SOCKET_EVENTS_MODES:
+            counts = [c for c in PEER_COUNTS
+                      if mode != "select" or c <= SELECT_MAX_PEERS]
+            self.restart_node(0, self.extra_args[0] + [
+                "-socketevents={}".format(mode),
+                "-maxconnections={}".format(max(counts) + 16)])
+            peers = []
+            for count in counts:
+                while len(peers) < count:
+                    peers.append(node.add_p2p_connection(PongCounter()))
+                rate = self.measure(node, peers)
+                results[(mode, count)] = rate
+                self.log.info("{:>6}: {:4d} peers, {:9.0f} round trips/sec".format(
+                    mode, count, rate))
+            node.disconnect_p2ps()
+
+        print()
+        print("peers  " + "".join("{:>12}".format(m)
+                                  for m in SOCKET_EVENTS_MODES))
+        for count in PEER_COUNTS:
+            print("{:5d}  ".format(count) +
+                  "".join("{:12.0f}".format(results[(m, count)])
+                          if (m, count) in results else "{:>12}".format("-")
+                          for m in SOCKET_EVENTS_MODES))
+
+
+if __name__ == '__main__':
+    SocketEventsBenchmark().main()
@@ -126,9 +126,10 @@ class GBTLightBGCleanerTest(BitcoinTestFramework):
         seen_jobs_in_gbt_dir &= job_ids
 
         # Note: due to a possible race condition in the case of this test executing slowly,
-        # the job_id file may be gone now and moved to trash -- so also check the set `seen_jobs_in_gbt_dir`
-        assert all(os.path.exists(path_for_job(x)) or x in seen_jobs_in_gbt_dir
-                   for x in job_ids)
+        # the job_id file may be gone now and moved to trash -- so also check the set `seen_jobs_in_gbt_dir`.
+        # The job_id files are written in the background, so the last ones may take a moment to appear.
+        wait_until(lambda: all(os.path.exists(path_for_job(x)) or os.path.exists(trash_path_for_job(x))
+                               or x in seen_jobs_in_gbt_dir for x in job_ids), timeout=10)
 
         trashed_ids = set() | seen_jobs_in_trash_dir
         removed_ids = set() | {x for x in seen_jobs_in_trash_dir
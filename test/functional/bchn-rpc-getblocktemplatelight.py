@@ -17,7 +17,8 @@ import time
 from decimal import Decimal
 
 from test_framework.test_framework import BitcoinTestFramework
-from test_framework.util import assert_equal, assert_raises_rpc_error, assert_blocktemplate_equal
+from test_framework.authproxy import JSONRPCException
+from test_framework.util import assert_equal, assert_raises_rpc_error, assert_blocktemplate_equal, wait_until
 from test_framework import messages, script, util, blocktools
 
 
@@ -203,7 +204,8 @@ class GBTLightTest(BitcoinTestFramework):
         def check_gbt_store_dir(gbtdir, job_id):
             expected_data_file = os.path.join(gbtdir, job_id)
             assert os.path.exists(gbtdir), "The -gbtstoredir must exist"
-            assert os.path.exists(expected_data_file), "The -gbtstoredir must contain the expected job_id file"
+            # the job_id file is written in the background
+            wait_until(lambda: os.path.exists(expected_data_file), timeout=10)
         # check that node[1] is using the custom -gbtstoredir argument we gave it.
         check_gbt_store_dir(self._custom_gbt_dir, gbtl1['job_id'])
 
@@ -385,12 +387,19 @@ class GBTLightTest(BitcoinTestFramework):
                 orig_mode = os.stat(self._custom_gbt_dir).st_mode
                 new_mode = orig_mode & ~(stat.S_IWUSR | stat.S_IWGRP | stat.S_IWOTH)
                 # Set chmod of data directory to read-only to simulate an error writing to the job data file.
-                # This should cause the anticipated error on the C++ side.
+                # This should cause the anticipated error on the C++ side. The job data file is written in the
+                # background, so the error is reported by a subsequent call.
                 os.chmod(self._custom_gbt_dir, new_mode)
-                assert_raises_rpc_error(-32603,  # RPC_INTERNAL_ERROR
-                                        "failed to save job tx data to disk",
-                                        self.nodes[1].getblocktemplatelight,
-                                        {}, extratxs)
+
+                def save_failure_reported():
+                    try:
+                        self.nodes[1].getblocktemplatelight({}, extratxs)
+                    except JSONRPCException as e:
+                        assert_equal(e.error['code'], -32603)  # RPC_INTERNAL_ERROR
+                        assert "failed to save job tx data to disk" in e.error['message']
+                        return True
+                    return False
+                wait_until(save_failure_reported, timeout=10)
             finally:
                 if orig_mode is not None:
                     # undo the damage to the directory's mode from above
@@ -6,6 +6,7 @@
 import os
 
 from test_framework.test_framework import BitcoinTestFramework
+from test_framework.test_node import ErrorMatch
 
 
 class ConfArgsTest(BitcoinTestFramework):
@@ -66,6 +67,12 @@ class ConfArgsTest(BitcoinTestFramework):
         self.nodes[0].assert_start_raises_init_error(
             expected_msg='Error: Invalid header finalization penalty (DoS score) (-1) - must be between 0 and 100')
 
+        with open(inc_conf_file_path, 'w', encoding='utf-8') as conf:
+            conf.write('socketevents=kqueue\n')
+        self.nodes[0].assert_start_raises_init_error(
+            expected_msg="Error: Invalid -socketevents mode 'kqueue', must be one of: select",
+            match=ErrorMatch.PARTIAL_REGEX)
+
         inc_conf_file2_path = os.path.join(
             self.nodes[0].datadir, 'include2.conf')
         with open(os.path.join(self.nodes[0].datadir, 'bitcoin.conf'), 'a', encoding='utf-8') as conf:
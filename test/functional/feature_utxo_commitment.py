@@ -0,0 +1,78 @@
+#!/usr/bin/env python3
+# Copyright (c) 2020 The Bitcoin developers
+# Distributed under the MIT software license, see the accompanying
+# file COPYING or http://www.opensource.org/licenses/mit-license.php.
+"""Test the UTXO set commitment maintained with -utxocommitment.
+
+- gettxoutsetinfo "ecmh" agrees with a scan of the UTXO set
+- the commitment follows the chain when blocks are disconnected
+- it is stored on shutdown, and recomputed on startup when it is out of date
+"""
+
+from test_framework.test_framework import BitcoinTestFramework
+from test_framework.util import (
+    assert_equal,
+    assert_raises_rpc_error,
+)
+
+
+class UTXOCommitmentTest(BitcoinTestFramework):
+    def set_test_params(self):
+        self.num_nodes = 1
+        self.extra_args = [["-utxocommitment"]]
+
+    def get_commitment(self):
+        node = self.nodes[0]
+        ecmh = node.gettxoutsetinfo("ecmh")
+        scan = node.gettxoutsetinfo()
+        assert 'hash_serialized' not in ecmh
+        assert 'utxo_commitment' not in scan
+        for key in ['height', 'bestblock', 'txouts', 'bogosize',
+                    'total_amount']:
+            assert_equal(ecmh[key], scan[key])
+        return ecmh['utxo_commitment']
+
+    def mine_block(self):
+        node = self.nodes[0]
+        if self.is_wallet_compiled():
+            node.sendtoaddress(node.getnewaddress(), 1)
+        node.generatetoaddress(1, node.get_deterministic_priv_key().address)
+
+    def run_test(self):
+        node = self.nodes[0]
+
+        self.log.info("The commitment to the cached chain is computed")
+        commitments = [self.get_commitment()]
+        for _ in range(3):
+            self.mine_block()
+            commitments.append(self.get_commitment())
+        assert_equal(len(set(commitments)), len(commitments))
+
+        self.log.info("The commitment follows the disconnected blocks")
+        tip = node.getbestblockhash()
+        node.invalidateblock(node.getblockhash(node.getblockcount() - 1))
+        assert_equal(self.get_commitment(), commitments[-3])
+        node.reconsiderblock(tip)
+        assert_equal(self.get_commitment(), commitments[-1])
+
+        self.log.info("The commitment is loaded on restart")
+        self.restart_node(0)
+        assert_equal(self.get_commitment(), commitments[-1])
+
+        self.log.info("An outdated commitment is recomputed")
+        self.restart_node(0, extra_args=[])
+        assert_raises_rpc_error(-1, "The UTXO set commitment is not enabled",
+                                node.gettxoutsetinfo, "ecmh")
+        self.mine_block()
+        with node.assert_debug_log(["Computing the commitment to the UTXO set"]):
+            self.restart_node(0)
+        commitments.append(self.get_commitment())
+        self.mine_block()
+        assert commitments[-1] != self.get_commitment()
+
+        assert_raises_rpc_error(-8, "unknown is not a valid hash_type",
+                                node.gettxoutsetinfo, "unknown")
+
+
+if __name__ == '__main__':
+    UTXOCommitmentTest().main()
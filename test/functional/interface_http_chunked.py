@@ -0,0 +1,96 @@
+#!/usr/bin/env python3
+# Copyright (c) 2020 The Bitcoin Static developers
+# Distributed under the MIT software license, see the accompanying
+# file COPYING or http://www.opensource.org/licenses/mit-license.php.
+"""Test chunked HTTP replies.
+
+Replies larger than a chunk are sent with chunked transfer encoding as they
+are produced, smaller ones as before. Check that both give the same body, and
+that a client going away in the middle of a large reply does not get a worker
+thread stuck.
+"""
+
+import http.client
+import json
+import socket
+import urllib.parse
+
+from test_framework.test_framework import BitcoinTestFramework
+from test_framework.util import assert_equal, str_to_b64str
+
+CHUNK_SIZE = 64 * 1024
+
+
+class HTTPChunkedTest(BitcoinTestFramework):
+    def set_test_params(self):
+        self.num_nodes = 1
+        # A single worker thread, which a stuck reply would block for good
+        self.extra_args = [["-rest", "-rpcthreads=1"]]
+
+    def request(self, method, path, body=None):
+        url = urllib.parse.urlparse(self.nodes[0].url)
+        authpair = url.username + ':' + url.password
+        headers = {"Authorization": "Basic " + str_to_b64str(authpair)}
+        conn = http.client.HTTPConnection(url.hostname, url.port)
+        conn.request(method, path, body, headers)
+        response = conn.getresponse()
+        assert_equal(response.status, 200)
+        chunked = response.getheader('Transfer-Encoding') == 'chunked'
+        data = response.read()
+        conn.close()
+        return chunked, data
+
+    def rpc_echo(self, arg):
+        return self.request('POST', '/', json.dumps(
+            {"method": "echo", "params": [arg], "id": 1}))
+
+    def run_test(self):
+        node = self.nodes[0]
+
+        self.log.info("Small JSON-RPC replies are sent at once")
+        chunked, data = self.rpc_echo("x")
+        assert not chunked
+        assert_equal(json.loads(data), {"result": ["x"], "error": None,
+                                        "id": 1})
+
+        self.log.info("Large JSON-RPC replies are sent in chunks")
+        arg = "\"quoted\"\t" * (CHUNK_SIZE // 2)
+        chunked, data = self.rpc_echo(arg)
+        assert chunked
+        assert data.endswith(b"}\n")
+        assert_equal(json.loads(data), {"result": [arg], "error": None,
+                                        "id": 1})
+
+        self.log.info("Large REST replies are sent in chunks")
+        start = node.getblockhash(1)
+        for count, expect_chunked in [(1, False), (200, True)]:
+            chunked, data = self.request(
+                'GET', '/rest/headers/{}/{}.json'.format(count, start))
+            assert_equal(chunked, expect_chunked)
+            headers = json.loads(data)
+            assert_equal(len(headers), count)
+            assert_equal([h['hash'] for h in headers],
+                         [node.getblockhash(i) for i in range(1, count + 1)])
+
+        self.log.info("Drop the connection in the middle of a large reply")
+        url = urllib.parse.urlparse(node.url)
+        authpair = url.username + ':' + url.password
+        body = json.dumps({"method": "echo", "params": ["0" * (8 << 20)]})
+        request = ("POST / HTTP/1.1\r\nHost: {}\r\nAuthorization: Basic {}\r\n"
+                   "Content-Length: {}\r\n\r\n{}").format(
+                       url.hostname, str_to_b64str(authpair), len(body), body)
+        sock = socket.create_connection((url.hostname, url.port))
+        sock.setsockopt(socket.SOL_SOCKET, socket.SO_RCVBUF, 4096)
+        sock.sendall(request.encode())
+        assert sock.recv(4096).startswith(b"HTTP/1.1 200 OK")
+        sock.close()
+
+        # The only worker thread must be free to serve further requests
+        assert_equal(node.getblockcount(), 200)
+        chunked, data = self.rpc_echo(arg)
+        assert chunked
+        assert_equal(json.loads(data)["result"], [arg])
+
+
+if __name__ == '__main__':
+    HTTPChunkedTest().main()
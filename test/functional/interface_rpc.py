@@ -49,9 +49,31 @@ class RPCInterfaceTest(BitcoinTestFramework):
         assert_equal(result_by_id[3]['error'], None)
         assert result_by_id[3]['result'] is not None
 
+    def test_large_batch_request(self):
+        self.log.info("Testing large JSON-RPC batch requests...")
+        node = self.nodes[0]
+        hashes = node.generatetoaddress(
+            20, node.get_deterministic_priv_key().address)
+
+        for args in [[], ["-rpcbatchconcurrency=1"],
+                     ["-rpcbatchconcurrency=16", "-rpcthreads=8"]]:
+            self.restart_node(0, args)
+            # Requests run in parallel, but replies are in request order
+            results = node.batch([
+                {"method": "getblockhash", "params": [height % 21],
+                 "id": height} for height in range(500)])
+            assert_equal(len(results), 500)
+            for height, res in enumerate(results):
+                assert_equal(res['id'], height)
+                assert_equal(res['error'], None)
+                assert_equal(res['result'], node.getblockhash(height % 21))
+                if height % 21 > 0:
+                    assert_equal(res['result'], hashes[height % 21 - 1])
+
     def run_test(self):
         self.test_getrpcinfo()
         self.test_batch_request()
+        self.test_large_batch_request()
 
 
 if __name__ == '__main__':
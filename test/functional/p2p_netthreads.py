@@ -0,0 +1,90 @@
+#!/usr/bin/env python3
+# Copyright (c) 2020 The Bitcoin Static developers
+# Distributed under the MIT software license, see the accompanying
+# file COPYING or http://www.opensource.org/licenses/mit-license.php.
+"""Test serving peers from several network threads (-netthreads).
+
+Peers are spread over the threads by id, so connecting a batch of peers
+exercises every thread. Check that all of them are served, that peers can
+come and go, and that blocks still relay between nodes using either socket
+events mode.
+"""
+
+from test_framework.messages import msg_ping
+from test_framework.mininode import P2PInterface, mininode_lock
+from test_framework.test_framework import BitcoinTestFramework
+from test_framework.util import (
+    assert_equal,
+    connect_nodes_bi,
+    sync_blocks,
+    wait_until,
+)
+
+NUM_PEERS = 16
+PINGS_PER_PEER = 50
+
+
+class PongCounter(P2PInterface):
+    def __init__(self):
+        super().__init__()
+        self.pongs = 0
+
+    def on_pong(self, message):
+        self.pongs += 1
+
+
+class NetThreadsTest(BitcoinTestFramework):
+    def set_test_params(self):
+        self.setup_clean_chain = True
+        self.num_nodes = 2
+        self.extra_args = [["-netthreads=4"],
+                           ["-netthreads=3", "-socketevents=select"]]
+
+    def setup_network(self):
+        self.setup_nodes()
+        connect_nodes_bi(self.nodes[0], self.nodes[1])
+
+    def ping_all(self, peers):
+        with mininode_lock:
+            for p in peers:
+                p.pongs = 0
+        for p in peers:
+            p.send_raw_message(b"".join(
+                p.build_message(msg_ping(nonce))
+                for nonce in range(1, PINGS_PER_PEER + 1)))
+        wait_until(lambda: all(p.pongs == PINGS_PER_PEER for p in peers),
+                   timeout=60, lock=mininode_lock)
+
+    def run_test(self):
+        node = self.nodes[0]
+        # Both directions of the connection to the other node
+        num_nodes_peers = len(node.getpeerinfo())
+
+        self.log.info("Serve a batch of peers spread over all threads")
+        peers = [node.add_p2p_connection(PongCounter())
+                 for _ in range(NUM_PEERS)]
+        assert_equal(len(node.getpeerinfo()), NUM_PEERS + num_nodes_peers)
+        self.ping_all(peers)
+
+        self.log.info("Replace half of the peers")
+        for p in peers[:NUM_PEERS // 2]:
+            p.peer_disconnect()
+            p.wait_for_disconnect()
+        del peers[:NUM_PEERS // 2]
+        wait_until(lambda: len(node.getpeerinfo()) ==
+                   NUM_PEERS // 2 + num_nodes_peers,
+                   timeout=10)
+        peers += [node.add_p2p_connection(PongCounter())
+                  for _ in range(NUM_PEERS // 2)]
+        assert_equal(len(node.getpeerinfo()), NUM_PEERS + num_nodes_peers)
+        self.ping_all(peers)
+
+        self.log.info("Relay blocks both ways between the nodes")
+        for n in self.nodes:
+            n.generatetoaddress(5, n.get_deterministic_priv_key().address)
+            sync_blocks(self.nodes)
+        assert_equal(self.nodes[0].getblockcount(), 10)
+
+
+if __name__ == '__main__':
+    NetThreadsTest().main()
@@ -0,0 +1,75 @@
+#!/usr/bin/env python3
+# Copyright (c) 2020 The Bitcoin Static developers
+# Distributed under the MIT software license, see the accompanying
+# file COPYING or http://www.opensource.org/licenses/mit-license.php.
+"""Test serving blocks to peers straight from the block files.
+
+Blocks requested with getdata are sent as they are stored on disk, through a
+cache shared by all peers (-rawblockcache). Check that several peers get the
+same blocks as getblock returns, with the cache enabled and disabled, and that
+old blocks requested as compact blocks are sent whole.
+"""
+
+from test_framework.messages import (
+    CInv,
+    MSG_BLOCK,
+    MSG_CMPCTBLOCK,
+    msg_getdata,
+)
+from test_framework.mininode import P2PInterface, mininode_lock
+from test_framework.test_framework import BitcoinTestFramework
+from test_framework.util import assert_equal, wait_until
+
+NUM_BLOCKS = 20
+NUM_PEERS = 3
+
+
+class BlockCollector(P2PInterface):
+    def __init__(self):
+        super().__init__()
+        self.blocks = {}
+
+    def on_block(self, message):
+        message.block.calc_sha256()
+        self.blocks[message.block.sha256] = message.block.serialize().hex()
+
+
+class RawBlockCacheTest(BitcoinTestFramework):
+    def set_test_params(self):
+        self.setup_clean_chain = True
+        self.num_nodes = 1
+
+    def request_blocks(self, node, hashes, inv_type):
+        peers = [node.add_p2p_connection(BlockCollector())
+                 for _ in range(NUM_PEERS)]
+        for p in peers:
+            p.send_message(msg_getdata(
+                [CInv(inv_type, int(h, 16)) for h in hashes]))
+        wait_until(lambda: all(len(p.blocks) == len(hashes) for p in peers),
+                   timeout=60, lock=mininode_lock)
+        for p in peers:
+            for h in hashes:
+                assert_equal(p.blocks[int(h, 16)], node.getblock(h, 0))
+        node.disconnect_p2ps()
+
+    def run_test(self):
+        node = self.nodes[0]
+        hashes = node.generatetoaddress(
+            NUM_BLOCKS, node.get_deterministic_priv_key().address)
+
+        for args in [[], ["-rawblockcache=0"]]:
+            # Restart so that no block is kept in memory after being mined
+            self.restart_node(0, args)
+            self.log.info(
+                "Serve blocks to several peers with {}".format(args or
+                                                               "defaults"))
+            self.request_blocks(node, hashes, MSG_BLOCK)
+            self.request_blocks(node, hashes, MSG_BLOCK)
+
+            self.log.info("Serve old blocks requested as compact blocks")
+            self.request_blocks(node, hashes[:NUM_BLOCKS // 2],
+                                MSG_CMPCTBLOCK)
+
+
+if __name__ == '__main__':
+    RawBlockCacheTest().main()
@@ -0,0 +1,81 @@
+#!/usr/bin/env python3
+# Copyright (c) 2020 The Bitcoin Static developers
+# Distributed under the MIT software license, see the accompanying
+# file COPYING or http://www.opensource.org/licenses/mit-license.php.
+"""Test serving relayed transactions to peers.
+
+A transaction announced to our peers is serialized the first time one of them
+requests it, and the same bytes are then sent to every peer requesting it.
+Check that several peers, requesting the transactions once or twice, all get
+the transactions as getrawtransaction returns them.
+"""
+
+from test_framework.messages import CInv, MSG_TX, msg_getdata
+from test_framework.mininode import P2PInterface, mininode_lock
+from test_framework.test_framework import BitcoinTestFramework
+from test_framework.util import assert_equal, wait_until
+
+NUM_TXS = 5
+NUM_PEERS = 3
+
+
+class TxCollector(P2PInterface):
+    def __init__(self):
+        super().__init__()
+        self.txs = {}
+        self.received = 0
+
+    def on_tx(self, message):
+        message.tx.rehash()
+        self.txs[message.tx.hash] = message.tx.serialize().hex()
+        self.received += 1
+
+
+class TxRelayTest(BitcoinTestFramework):
+    def set_test_params(self):
+        self.setup_clean_chain = True
+        self.num_nodes = 1
+
+    def spend_coinbase(self, node, blockhash, key):
+        coinbase = node.getblock(blockhash, 2)['tx'][0]
+        rawtx = node.createrawtransaction(
+            [{"txid": coinbase['txid'], "vout": 0}], {"data": "00"})
+        signed = node.signrawtransactionwithkey(rawtx, [key])
+        assert signed['complete']
+        # Regtest coinbases are worthless, so let the transaction in for free
+        txid = node.decoderawtransaction(signed['hex'])['txid']
+        node.prioritisetransaction(txid, 0, 1000)
+        return node.sendrawtransaction(signed['hex'])
+
+    def run_test(self):
+        node = self.nodes[0]
+        address, key = node.get_deterministic_priv_key()
+        hashes = node.generatetoaddress(100 + NUM_TXS, address)
+
+        peers = [node.add_p2p_connection(TxCollector())
+                 for _ in range(NUM_PEERS)]
+
+        self.log.info("Announce transactions to several peers")
+        txids = [self.spend_coinbase(node, h, key) for h in hashes[:NUM_TXS]]
+        wait_until(lambda: all(len(p.txs) == NUM_TXS for p in peers),
+                   timeout=60, lock=mininode_lock)
+        for p in peers:
+            for txid in txids:
+                assert_equal(p.txs[txid], node.getrawtransaction(txid))
+
+        self.log.info("Serve the transactions again from the relay memory")
+        for p in peers:
+            with mininode_lock:
+                p.txs = {}
+                p.received = 0
+            p.send_message(msg_getdata(
+                [CInv(MSG_TX, int(txid, 16)) for txid in txids]))
+        wait_until(lambda: all(p.received == NUM_TXS for p in peers),
+                   timeout=60, lock=mininode_lock)
+        for p in peers:
+            for txid in txids:
+                assert_equal(p.txs[txid], node.getrawtransaction(txid))
+
+
+if __name__ == '__main__':
+    TxRelayTest().main()
@@ -8,6 +8,7 @@
 Test the following RPCs:
     - getblockchaininfo
     - gettxoutsetinfo
+    - getcoinscacheinfo
     - getdifficulty
     - getbestblockhash
     - getblockhash
@@ -61,6 +62,7 @@ class BlockchainTest(BitcoinTestFramework):
         self._test_getblockchaininfo()
         self._test_getchaintxstats()
         self._test_gettxoutsetinfo()
+        self._test_getcoinscacheinfo()
         self._test_getblockheader()
         self._test_getdifficulty()
         self._test_getnetworkhashps()
@@ -235,6 +237,20 @@ class BlockchainTest(BitcoinTestFramework):
         assert_equal(res['bestblock'], res3['bestblock'])
         assert_equal(res['hash_serialized'], res3['hash_serialized'])
 
+    def _test_getcoinscacheinfo(self):
+        self.log.info("Test getcoinscacheinfo")
+        res = self.nodes[0].getcoinscacheinfo()
+        assert_equal(sorted(res.keys()), sorted([
+            'entries',
+            'usage',
+            'hits',
+            'misses',
+            'prefetch_hits',
+            'prefetch_misses',
+        ]))
+        for value in res.values():
+            assert_greater_than_or_equal(value, 0)
+
     def _test_getblockheader(self):
         node = self.nodes[0]
 
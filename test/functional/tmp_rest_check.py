@@ -0,0 +1,34 @@
+#!/usr/bin/env python3
+import http.client, json, time, urllib.parse
+from test_framework.test_framework import BitcoinTestFramework
+from test_framework.util import assert_equal, str_to_b64str
+class T(BitcoinTestFramework):
+    def set_test_params(self):
+        self.num_nodes = 1
+        self.extra_args = [["-rest"]]
+    def get(self, path):
+        url = urllib.parse.urlparse(self.nodes[0].url)
+        c = http.client.HTTPConnection(url.hostname, url.port); c.request('GET', path)
+        r = c.getresponse(); d = r.read(); assert_equal(r.status, 200); return d
+    def run_test(self):
+        n = self.nodes[0]
+        h = n.getbestblockhash()
+        assert_equal(self.get('/rest/block/%s.hex' % h).decode(), n.getblock(h, 0) + "\n")
+        assert_equal(self.get('/rest/block/%s.bin' % h).hex(), n.getblock(h, 0))
+        assert_equal(json.loads(self.get('/rest/block/%s.json' % h))['hash'], h)
+        assert_equal(json.loads(self.get('/rest/mempool/contents.json')), {})
+        # slow reader of a large reply
+        url = urllib.parse.urlparse(n.url)
+        hdr = {"Authorization": "Basic " + str_to_b64str(url.username + ':' + url.password)}
+        c = http.client.HTTPConnection(url.hostname, url.port)
+        arg = "ab" * (3 << 20)
+        c.request('POST', '/', json.dumps({"method": "echo", "params": [arg], "id": 1}), hdr)
+        r = c.getresponse()
+        parts = []
+        while True:
+            d = r.read(256 * 1024)
+            if not d: break
+            parts.append(d); time.sleep(0.05)
+        assert_equal(json.loads(b"".join(parts))["result"], [arg])
+        self.log.info("ok")
+T().main()